@@ -29,8 +29,11 @@
 #include "Utils/Settings.h"
 #include "Utils/Log.h"
 #include "Utils/CudaUtils.h"
+#include "Utils/ModelLoader.h"
 #include "Runners/WindowRunner.h"
 #include "Runners/ConsoleRunner.h"
+#include "Runners/CoordinatorRunner.h"
+#include "Runners/WorkerRunner.h"
 
 using namespace Valo;
 
@@ -58,6 +61,8 @@ BOOL consoleCtrlHandler(DWORD fdwCtrlType)
 	{
 		App::getLog().logInfo("Interrupted!");
 		App::getConsoleRunner().interrupt();
+		App::getCoordinatorRunner().interrupt();
+		App::getWorkerRunner().interrupt();
 
 		return true;
 	}
@@ -71,6 +76,8 @@ void signalHandler(int signal)
 
 	App::getLog().logInfo("Interrupted!");
 	App::getConsoleRunner().interrupt();
+	App::getCoordinatorRunner().interrupt();
+	App::getWorkerRunner().interrupt();
 }
 #endif
 
@@ -127,10 +134,15 @@ int App::run(int argc, char** argv)
 		Settings& settings = getSettings();
 		WindowRunner& windowRunner = getWindowRunner();
 		ConsoleRunner& consoleRunner = getConsoleRunner();
+		CoordinatorRunner& coordinatorRunner = getCoordinatorRunner();
+		WorkerRunner& workerRunner = getWorkerRunner();
 
 		if (!settings.load(argc, argv))
 			return 0;
 
+		// workers started by a coordinator write to their own log files
+		log.setLogFile(settings.general.logFileName);
+
 		log.logInfo(std::string("Valo v") + VALO_VERSION);
 
 		if (settings.general.maxCpuThreadCount == 0)
@@ -138,6 +150,14 @@ int App::run(int argc, char** argv)
 
 		log.logInfo("CPU thread count: %s", settings.general.maxCpuThreadCount);
 
+		if (settings.convert.enabled)
+		{
+			ModelLoader modelLoader;
+			modelLoader.convert(settings.convert.inputFileName, settings.convert.outputFileName);
+
+			return 0;
+		}
+
 #ifdef USE_CUDA
 
 		int deviceCount;
@@ -159,6 +179,12 @@ int App::run(int argc, char** argv)
 
 #endif
 
+		if (settings.coordinator.enabled)
+			return coordinatorRunner.run();
+
+		if (settings.worker.enabled)
+			return workerRunner.run();
+
 		if (settings.general.windowed)
 			return windowRunner.run();
 		else
@@ -173,7 +199,7 @@ int App::run(int argc, char** argv)
 
 Log& App::getLog()
 {
-	static Log log("valo.log");
+	static Log log;
 	return log;
 }
 
@@ -194,3 +220,15 @@ ConsoleRunner& App::getConsoleRunner()
 	static ConsoleRunner consoleRunner;
 	return consoleRunner;
 }
+
+CoordinatorRunner& App::getCoordinatorRunner()
+{
+	static CoordinatorRunner coordinatorRunner;
+	return coordinatorRunner;
+}
+
+WorkerRunner& App::getWorkerRunner()
+{
+	static WorkerRunner workerRunner;
+	return workerRunner;
+}
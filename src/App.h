@@ -9,6 +9,8 @@ namespace Valo
 	class Settings;
 	class WindowRunner;
 	class ConsoleRunner;
+	class CoordinatorRunner;
+	class WorkerRunner;
 
 	class App
 	{
@@ -20,5 +22,7 @@ namespace Valo
 		static Settings& getSettings();
 		static WindowRunner& getWindowRunner();
 		static ConsoleRunner& getConsoleRunner();
+		static CoordinatorRunner& getCoordinatorRunner();
+		static WorkerRunner& getWorkerRunner();
 	};
 }
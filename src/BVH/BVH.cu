@@ -34,6 +34,39 @@ void BVH::build(std::vector<Triangle>& triangles)
 	}
 }
 
+void BVH::save(std::ostream& stream) const
+{
+	uint32_t typeValue = uint32_t(type);
+	stream.write(reinterpret_cast<const char*>(&typeValue), sizeof(typeValue));
+
+	switch (type)
+	{
+		case BVHType::BVH2: bvh2.save(stream); break;
+		case BVHType::BVH4: bvh4.save(stream); break;
+		case BVHType::BVH8: bvh8.save(stream); break;
+		default: break;
+	}
+}
+
+void BVH::load(std::istream& stream)
+{
+	uint32_t typeValue = 0;
+	stream.read(reinterpret_cast<char*>(&typeValue), sizeof(typeValue));
+
+	if (!stream.good() || typeValue > uint32_t(BVHType::BVH8))
+		throw std::runtime_error("Could not read the BVH type");
+
+	type = BVHType(typeValue);
+
+	switch (type)
+	{
+		case BVHType::BVH2: bvh2.load(stream); break;
+		case BVHType::BVH4: bvh4.load(stream); break;
+		case BVHType::BVH8: bvh8.load(stream); break;
+		default: break;
+	}
+}
+
 CUDA_CALLABLE bool BVH::intersect(const Scene& scene, const Ray& ray, Intersection& intersection) const
 {
 	switch (type)
@@ -45,6 +78,35 @@ CUDA_CALLABLE bool BVH::intersect(const Scene& scene, const Ray& ray, Intersecti
 	}
 }
 
+// applies the build order in place by following the permutation cycles, so no second triangle array is needed
+void BVH::reorderTriangles(std::vector<Triangle>& triangles, const std::vector<BVHBuildTriangle>& buildTriangles)
+{
+	std::vector<uint32_t> sourceIndices(buildTriangles.size());
+
+	for (uint32_t i = 0; i < uint32_t(buildTriangles.size()); ++i)
+		sourceIndices[i] = uint32_t(buildTriangles[i].triangle - triangles.data());
+
+	for (uint32_t i = 0; i < uint32_t(sourceIndices.size()); ++i)
+	{
+		if (sourceIndices[i] == i)
+			continue;
+
+		Triangle first = triangles[i];
+		uint32_t j = i;
+
+		while (sourceIndices[j] != i)
+		{
+			uint32_t k = sourceIndices[j];
+			triangles[j] = triangles[k];
+			sourceIndices[j] = j;
+			j = k;
+		}
+
+		triangles[j] = first;
+		sourceIndices[j] = j;
+	}
+}
+
 BVHSplitOutput BVH::calculateSplit(std::vector<BVHBuildTriangle>& buildTriangles, std::vector<BVHSplitCache>& cache, uint32_t start, uint32_t end)
 {
 	assert(end > start);
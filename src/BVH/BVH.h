@@ -27,7 +27,11 @@ namespace Valo
 		void build(std::vector<Triangle>& triangles);
 		CUDA_CALLABLE bool intersect(const Scene& scene, const Ray& ray, Intersection& intersection) const;
 
+		void save(std::ostream& stream) const;
+		void load(std::istream& stream);
+
 		static BVHSplitOutput calculateSplit(std::vector<BVHBuildTriangle>& buildTriangles, std::vector<BVHSplitCache>& cache, uint32_t start, uint32_t end);
+		static void reorderTriangles(std::vector<Triangle>& triangles, const std::vector<BVHBuildTriangle>& buildTriangles);
 
 		BVHType type = DEFAULT_BVH_TYPE;
 
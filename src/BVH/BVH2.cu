@@ -132,14 +132,19 @@ void BVH2::build(std::vector<Triangle>& triangles)
 		nodesAlloc.write(nodes.data(), nodes.size());
 	}
 
-	std::vector<Triangle> sortedTriangles(triangleCount);
+	BVH::reorderTriangles(triangles, buildTriangles);
 
-	for (uint32_t i = 0; i < triangleCount; ++i)
-		sortedTriangles[i] = *buildTriangles[i].triangle;
+	log.logInfo("BVH2 building finished (time: %s, nodes: %d, leafs: %d, triangles/leaf: %.2f)", timer.getElapsed().getString(true), nodeCount - leafCount, leafCount, float(triangleCount) / float(leafCount));
+}
 
-	triangles = sortedTriangles;
+void BVH2::save(std::ostream& stream) const
+{
+	nodesAlloc.save(stream);
+}
 
-	log.logInfo("BVH2 building finished (time: %s, nodes: %d, leafs: %d, triangles/leaf: %.2f)", timer.getElapsed().getString(true), nodeCount - leafCount, leafCount, float(triangleCount) / float(leafCount));
+void BVH2::load(std::istream& stream)
+{
+	nodesAlloc.load(stream);
 }
 
 CUDA_CALLABLE bool BVH2::intersect(const Scene& scene, const Ray& ray, Intersection& intersection) const
@@ -166,7 +171,7 @@ CUDA_CALLABLE bool BVH2::intersect(const Scene& scene, const Ray& ray, Intersect
 		{
 			for (uint32_t i = 0; i < node.triangleCount; ++i)
 			{
-				if (scene.getTriangles()[node.triangleOffset + i].intersect(scene, ray, intersection))
+				if (Triangle::intersect(scene, ray, node.triangleOffset + i, intersection))
 				{
 					if (ray.isVisibilityRay)
 						return true;
@@ -244,14 +244,21 @@ void BVH4::build(std::vector<Triangle>& triangles)
 		triangles4Alloc.write(triangles4.data(), triangles4.size());
 	}
 
-	std::vector<Triangle> sortedTriangles(triangleCount);
+	BVH::reorderTriangles(triangles, buildTriangles);
 
-	for (uint32_t i = 0; i < triangleCount; ++i)
-		sortedTriangles[i] = *buildTriangles[i].triangle;
+	log.logInfo("BVH4 building finished (time: %s, nodes: %d, leafs: %d, triangles/leaf: %.2f)", timer.getElapsed().getString(true), nodeCount - leafCount, leafCount, float(triangleCount) / float(leafCount));
+}
 
-	triangles = sortedTriangles;
+void BVH4::save(std::ostream& stream) const
+{
+	nodesAlloc.save(stream);
+	triangles4Alloc.save(stream);
+}
 
-	log.logInfo("BVH4 building finished (time: %s, nodes: %d, leafs: %d, triangles/leaf: %.2f)", timer.getElapsed().getString(true), nodeCount - leafCount, leafCount, float(triangleCount) / float(leafCount));
+void BVH4::load(std::istream& stream)
+{
+	nodesAlloc.load(stream);
+	triangles4Alloc.load(stream);
 }
 
 CUDA_CALLABLE bool BVH4::intersect(const Scene& scene, const Ray& ray, Intersection& intersection) const
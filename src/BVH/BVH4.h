@@ -26,6 +26,9 @@ namespace Valo
 		void build(std::vector<Triangle>& triangles);
 		CUDA_CALLABLE bool intersect(const Scene& scene, const Ray& ray, Intersection& intersection) const;
 
+		void save(std::ostream& stream) const;
+		void load(std::istream& stream);
+
 	private:
 
 		CudaAlloc<BVHNodeSOA<4>> nodesAlloc;
@@ -244,14 +244,21 @@ void BVH8::build(std::vector<Triangle>& triangles)
 		triangles8Alloc.write(triangles8.data(), triangles8.size());
 	}
 
-	std::vector<Triangle> sortedTriangles(triangleCount);
+	BVH::reorderTriangles(triangles, buildTriangles);
 
-	for (uint32_t i = 0; i < triangleCount; ++i)
-		sortedTriangles[i] = *buildTriangles[i].triangle;
+	log.logInfo("BVH8 building finished (time: %s, nodes: %d, leafs: %d, triangles/leaf: %.2f)", timer.getElapsed().getString(true), nodeCount - leafCount, leafCount, float(triangleCount) / float(leafCount));
+}
 
-	triangles = sortedTriangles;
+void BVH8::save(std::ostream& stream) const
+{
+	nodesAlloc.save(stream);
+	triangles8Alloc.save(stream);
+}
 
-	log.logInfo("BVH8 building finished (time: %s, nodes: %d, leafs: %d, triangles/leaf: %.2f)", timer.getElapsed().getString(true), nodeCount - leafCount, leafCount, float(triangleCount) / float(leafCount));
+void BVH8::load(std::istream& stream)
+{
+	nodesAlloc.load(stream);
+	triangles8Alloc.load(stream);
 }
 
 CUDA_CALLABLE bool BVH8::intersect(const Scene& scene, const Ray& ray, Intersection& intersection) const
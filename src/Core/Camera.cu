@@ -13,6 +13,7 @@
 #include "Math/MathUtils.h"
 #include "Math/Vector2.h"
 #include "Math/Mapper.h"
+#include "Math/Sampler.h"
 #include "Runners/WindowRunner.h"
 #include "Utils/Log.h"
 
@@ -197,7 +198,7 @@ void Camera::update(float timeStep)
 	orthoSize = MAX(0.0f, orthoSize);
 	fishEyeAngle = MAX(1.0f, MIN(fishEyeAngle, 360.0f));
 
-	float imagePlaneDistance = 0.5f / std::tan(MathUtils::degToRad(fov / 2.0f));
+	imagePlaneDistance = 0.5f / std::tan(MathUtils::degToRad(fov / 2.0f));
 	imagePlaneCenter = position + (forward * imagePlaneDistance);
 }
 
@@ -236,13 +237,27 @@ void Camera::saveState(const std::string& fileName) const
 	file.close();
 }
 
-CUDA_CALLABLE CameraRay Camera::getRay(const Vector2& pixel, Random& random) const
+CUDA_CALLABLE CameraRay Camera::getRay(const Vector2& pixel, Sampler& sampler) const
+{
+	switch (type)
+	{
+		case CameraType::PERSPECTIVE: return getRay<CameraType::PERSPECTIVE>(pixel, sampler);
+		case CameraType::ORTHOGRAPHIC: return getRay<CameraType::ORTHOGRAPHIC>(pixel, sampler);
+		case CameraType::FISHEYE: return getRay<CameraType::FISHEYE>(pixel, sampler);
+		default: return CameraRay();
+	}
+}
+
+template <CameraType cameraType>
+CUDA_CALLABLE CameraRay Camera::getRay(const Vector2& pixel, Sampler& sampler) const
 {
 	Vector3 origin;
 	Vector3 direction;
+	float coneWidth = 0.0f;
+	float coneSpread = 0.0f;
 	bool offLens = false;
 
-	switch (type)
+	switch (cameraType)
 	{
 		case CameraType::PERSPECTIVE:
 		{
@@ -253,6 +268,7 @@ CUDA_CALLABLE CameraRay Camera::getRay(const Vector2& pixel, Random& random) con
 
 			origin = position;
 			direction = (imagePlanePixelPosition - position).normalized();
+			coneSpread = 1.0f / ((imagePlaneWidth + 1.0f) * imagePlaneDistance);
 
 		} break;
 
@@ -263,6 +279,7 @@ CUDA_CALLABLE CameraRay Camera::getRay(const Vector2& pixel, Random& random) con
 
 			origin = position + (dx * orthoSize * right) + (dy * orthoSize * aspectRatio * up);
 			direction = forward;
+			coneWidth = orthoSize / (imagePlaneWidth + 1.0f);
 
 		} break;
 
@@ -289,6 +306,7 @@ CUDA_CALLABLE CameraRay Camera::getRay(const Vector2& pixel, Random& random) con
 
 			origin = position;
 			direction = u * right + v * up + w * forward;
+			coneSpread = MathUtils::degToRad(fishEyeAngle) / (imagePlaneWidth + 1.0f);
 
 		} break;
 
@@ -298,7 +316,7 @@ CUDA_CALLABLE CameraRay Camera::getRay(const Vector2& pixel, Random& random) con
 	if (depthOfField)
 	{
 		Vector3 focalPoint = origin + direction * focalDistance;
-		Vector2 originOffset = Mapper::mapToDisc(random.getVector2());
+		Vector2 originOffset = Mapper::mapToDisc(sampler.getVector2());
 
 		origin = origin + ((originOffset.x * apertureSize) * right + (originOffset.y * apertureSize) * up);
 		direction = (focalPoint - origin).normalized();
@@ -307,6 +325,8 @@ CUDA_CALLABLE CameraRay Camera::getRay(const Vector2& pixel, Random& random) con
 	CameraRay cameraRay;
 	cameraRay.ray.origin = origin;
 	cameraRay.ray.direction = direction;
+	cameraRay.ray.coneWidth = coneWidth;
+	cameraRay.ray.coneSpread = coneSpread;
 	cameraRay.offLens = offLens;
 	cameraRay.ray.precalculate();
 
@@ -320,6 +340,37 @@ CUDA_CALLABLE CameraRay Camera::getRay(const Vector2& pixel, Random& random) con
 	return cameraRay;
 }
 
+// the inverse of getRay for the pinhole perspective and orthographic cameras (fisheye is not supported)
+bool Camera::project(const Vector3& point, Vector2& pixel) const
+{
+	Vector3 offset = point - position;
+	float depth = offset.dot(forward);
+
+	if (depth <= 0.0f)
+		return false;
+
+	float dx, dy;
+
+	if (type == CameraType::PERSPECTIVE)
+	{
+		float scale = imagePlaneDistance / depth;
+		dx = offset.dot(right) * scale;
+		dy = offset.dot(up) * scale / aspectRatio;
+	}
+	else if (type == CameraType::ORTHOGRAPHIC)
+	{
+		dx = offset.dot(right) / orthoSize;
+		dy = offset.dot(up) / (orthoSize * aspectRatio);
+	}
+	else
+		return false;
+
+	pixel.x = (dx + 0.5f) * imagePlaneWidth;
+	pixel.y = (dy + 0.5f) * imagePlaneHeight;
+
+	return true;
+}
+
 Vector3 Camera::getRight() const
 {
 	return right;
@@ -345,3 +396,10 @@ std::string Camera::getName() const
 		default: return "unknown";
 	}
 }
+
+namespace Valo
+{
+	template CUDA_CALLABLE CameraRay Camera::getRay<CameraType::PERSPECTIVE>(const Vector2& pixel, Sampler& sampler) const;
+	template CUDA_CALLABLE CameraRay Camera::getRay<CameraType::ORTHOGRAPHIC>(const Vector2& pixel, Sampler& sampler) const;
+	template CUDA_CALLABLE CameraRay Camera::getRay<CameraType::FISHEYE>(const Vector2& pixel, Sampler& sampler) const;
+}
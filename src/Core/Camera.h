@@ -13,7 +13,7 @@
 
 namespace Valo
 {
-	class Random;
+	class Sampler;
 	class Scene;
 	class ONB;
 
@@ -37,7 +37,12 @@ namespace Valo
 		bool isMoving() const;
 		void saveState(const std::string& fileName) const;
 
-		CUDA_CALLABLE CameraRay getRay(const Vector2& pixel, Random& random) const;
+		CUDA_CALLABLE CameraRay getRay(const Vector2& pixel, Sampler& sampler) const;
+
+		template <CameraType cameraType>
+		CUDA_CALLABLE CameraRay getRay(const Vector2& pixel, Sampler& sampler) const;
+
+		bool project(const Vector3& point, Vector2& pixel) const;
 
 		Vector3 getRight() const;
 		Vector3 getUp() const;
@@ -77,6 +82,7 @@ namespace Valo
 		float aspectRatio = 1.0f;
 		float imagePlaneWidth = 0.0f;
 		float imagePlaneHeight = 0.0f;
+		float imagePlaneDistance = 0.0f;
 		float currentSpeedModifier = 1.0f;
 		float maxVignetteDistance = 0.0f;
 
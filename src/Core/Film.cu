@@ -17,7 +17,10 @@
 #include "Tonemappers/Tonemapper.h"
 #include "Utils/Log.h"
 #include "Utils/GLUtils.h"
+#include "Utils/ImageWriter.h"
 #include "Renderers/Renderer.h"
+#include "Utils/Settings.h"
+#include "Utils/StringUtils.h"
 #include "Utils/SysUtils.h"
 
 using namespace Valo;
@@ -41,6 +44,12 @@ void Film::initialize()
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 		GLUtils::checkError("Could not set OpenGL texture parameters");
+
+		// persistent mapping needs glBufferStorage (OpenGL 4.4)
+		usePixelBuffers = gl3wIsSupported(4, 4) && glBufferStorage != nullptr;
+
+		if (usePixelBuffers)
+			App::getLog().logInfo("Using persistently mapped pixel buffers for the film upload");
 	}
 }
 
@@ -58,6 +67,7 @@ void Film::shutdown()
 
 #endif
 
+		deletePixelBuffers();
 		glDeleteTextures(1, &textureId);
 
 		GLUtils::checkError("Could not delete OpenGL texture");
@@ -72,9 +82,13 @@ void Film::resize(uint32_t width_, uint32_t height_, RendererType type)
 
 	App::getLog().logInfo("Resizing film to %sx%s", width, height);
 
-	cumulativeImage.resize(width, height);
-	normalizedImage.resize(width, height);
-	tonemappedImage.resize(width, height);
+	// the CUDA renderer accumulates through float surfaces
+	ImageFormat format = (App::getSettings().film.compactAccumulation && type == RendererType::CPU) ? ImageFormat::RGB16F_A32F : ImageFormat::RGBA32F;
+
+	if (format != cumulativeImage.getFormat())
+		cumulativeImage = Image(width, height, format);
+	else
+		cumulativeImage.resize(width, height);
 
 	if (windowed)
 	{
@@ -88,8 +102,19 @@ void Film::resize(uint32_t width_, uint32_t height_, RendererType type)
 
 #endif
 
+		if (usePixelBuffers)
+		{
+			resolvedPixels.clear();
+			resolvedPixels.shrink_to_fit();
+			createPixelBuffers();
+		}
+		else
+			resolvedPixels.resize(length);
+
+		tonemappedPixels = nullptr;
+
 		glBindTexture(GL_TEXTURE_2D, textureId);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, GLsizei(width), GLsizei(height), 0, GL_RGBA, GL_FLOAT, nullptr);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, GLsizei(width), GLsizei(height), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 		glBindTexture(GL_TEXTURE_2D, 0);
 
 		GLUtils::checkError("Could not reserve OpenGL texture memory");
@@ -119,80 +144,114 @@ void Film::resetCleared()
 	cleared = false;
 }
 
-void Film::load(uint32_t width_, uint32_t height_, const std::string& fileName, RendererType type)
+void Film::seed(const Image& image)
 {
-	App::getLog().logInfo("Loading film from %s", fileName);
-
-	uint64_t fileSize = SysUtils::getFileSize(fileName);
+	const uint32_t imageWidth = image.getWidth();
+	const uint32_t imageHeight = image.getHeight();
+	const float areaRatio = float(image.getLength()) / float(length);
 
-	if (fileSize != (width_ * height_ * sizeof(Color)))
-		throw std::runtime_error("Film file has wrong size");
+	#pragma omp parallel for
+	for (int32_t y = 0; y < int32_t(height); ++y)
+	{
+		uint32_t imageY = MIN(imageHeight - 1, uint32_t((float(y) + 0.5f) * float(imageHeight) / float(height)));
 
-	std::ifstream file(fileName, std::ios::in | std::ios::binary);
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint32_t imageX = MIN(imageWidth - 1, uint32_t((float(x) + 0.5f) * float(imageWidth) / float(width)));
+			cumulativeImage.setPixel(x, uint32_t(y), image.getPixel(imageX, imageY) * areaRatio);
+		}
+	}
+}
 
-	if (!file.is_open())
-		throw std::runtime_error("Could not open the film file for reading");
+FilmFileInfo Film::load(uint32_t width_, uint32_t height_, const std::string& fileName, RendererType type, uint64_t sceneHash)
+{
+	App::getLog().logInfo("Loading film from %s", fileName);
 
 	resize(width_, height_, type);
-
-	file.read(reinterpret_cast<char*>(cumulativeImage.getData()), fileSize);
-	file.close();
-
-	cumulativeImage.upload();
+	return merge({ fileName }, sceneHash);
 }
 
-void Film::loadMultiple(uint32_t width_, uint32_t height_, const std::string& dirName, RendererType type)
+FilmFileInfo Film::loadMultiple(uint32_t width_, uint32_t height_, const std::string& dirName, RendererType type, uint64_t sceneHash)
 {
-	(void)width_;
-	(void)height_;
-	(void)dirName;
-
 	App::getLog().logInfo("Loading multiple films from %s", dirName);
 
 	resize(width_, height_, type);
 
+	// a fixed order makes the summed result independent of the directory listing order
 	std::vector<std::string> fileNames = SysUtils::getAllFiles(dirName);
-	std::vector<Color> inputData(length);
+	std::sort(fileNames.begin(), fileNames.end());
+
+	return merge(fileNames, sceneHash);
+}
 
-	Color* inputPtr = inputData.data();
-	Color* cumulativePtr = cumulativeImage.getData();
+uint32_t Film::save(const std::string& fileName, uint64_t sceneHash, bool writeToLog) const
+{
+	if (writeToLog)
+		App::getLog().logInfo("Saving film to %s", fileName);
 
-	for (const std::string& fileName : fileNames)
+	FilmFileInfo info;
+	info.width = width;
+	info.height = height;
+	info.pixelSamples = pixelSamples;
+	info.sceneHash = sceneHash;
+
+	return FilmFile::write(fileName, cumulativeImage, info);
+}
+
+void Film::saveImage(const std::string& fileName, Tonemapper& tonemapper, bool writeToLog) const
+{
+	// the streamed formats are normalized and tonemapped one row at a time straight from the cumulative image
+	if (ImageWriter::isSupported(fileName))
 	{
-		App::getLog().logInfo("Loading film from %s", fileName);
+		if (writeToLog)
+			App::getLog().logInfo("Saving image to %s", fileName);
 
-		uint64_t fileSize = SysUtils::getFileSize(fileName);
+		tonemapper.gatherStatistics(cumulativeImage);
 
-		if (fileSize != length * sizeof(Color))
-			throw std::runtime_error("Film file has wrong size");
+		ImageWriter::write(fileName, width, height, [&](uint32_t y, Color* row)
+		{
+			tonemapper.resolveRow(cumulativeImage, y, row);
+		});
+	}
+	else if (StringUtils::endsWith(fileName, ".bmp") || StringUtils::endsWith(fileName, ".tga"))
+	{
+		Image image(width, height, ImageFormat::RGBA8);
+		tonemapper.resolve(cumulativeImage, static_cast<uint32_t*>(image.getRawData()));
+		image.save(fileName, writeToLog);
+	}
+	else
+	{
+		Image image(width, height);
+		Color* pixels = image.getData();
 
-		std::ifstream file(fileName, std::ios::in | std::ios::binary);
+		#pragma omp parallel for
+		for (int32_t i = 0; i < int32_t(length); ++i)
+		{
+			Color color = cumulativeImage.getPixel(uint32_t(i));
 
-		if (!file.is_open())
-			throw std::runtime_error("Could not open the film file for reading");
+			if (color.a != 0.0f)
+				color /= color.a;
 
-		file.read(reinterpret_cast<char*>(inputPtr), fileSize);
-		file.close();
+			color.a = 1.0f;
+			pixels[i] = color;
+		}
 
-		for (uint32_t i = 0; i < length; ++i)
-			cumulativePtr[i] += inputPtr[i];
+		tonemapper.apply(image, image);
+		image.save(fileName, writeToLog);
 	}
-
-	cumulativeImage.upload();
 }
 
-void Film::save(const std::string& fileName, bool writeToLog) const
+FilmFileInfo Film::merge(const std::vector<std::string>& fileNames, uint64_t sceneHash)
 {
-	if (writeToLog)
-		App::getLog().logInfo("Saving film to %s", fileName);
+	FilmFileInfo info = FilmFile::merge(fileNames, cumulativeImage);
 
-	std::ofstream file(fileName, std::ios::out | std::ios::binary);
+	if (sceneHash != 0 && info.sceneHash != 0 && info.sceneHash != sceneHash)
+		App::getLog().logWarning("Loaded film was rendered from a different scene or camera");
 
-	if (!file.is_open())
-		throw std::runtime_error("Could not open the film file for writing");
+	pixelSamples = uint32_t(info.pixelSamples);
+	cumulativeImage.upload();
 
-	file.write(reinterpret_cast<const char*>(cumulativeImage.getData()), sizeof(Color) * length);
-	file.close();
+	return info;
 }
 
 CUDA_CALLABLE void Film::addSample(uint32_t x, uint32_t y, const Color& color, float filterWeight)
@@ -221,66 +280,7 @@ CUDA_CALLABLE void Film::addSample(uint32_t index, const Color& color, float fil
 
 #ifdef USE_CUDA
 
-__global__ void normalizeKernel(cudaSurfaceObject_t cumulative, cudaSurfaceObject_t normalized, uint32_t width, uint32_t height)
-{
-	uint32_t x = threadIdx.x + blockIdx.x * blockDim.x;
-	uint32_t y = threadIdx.y + blockIdx.y * blockDim.y;
-
-	if (x >= width || y >= height)
-		return;
-
-	float4 color;
-	surf2Dread(&color, cumulative, x * sizeof(float4), y);
-
-	color.x /= color.w;
-	color.y /= color.w;
-	color.z /= color.w;
-	color.w = 1.0f;
-
-	surf2Dwrite(color, normalized, x * sizeof(float4), y);
-}
-
-#endif
-
-void Film::normalize(RendererType type)
-{
-	auto normalize_ = [&]()
-	{
-		#pragma omp parallel for
-		for (int32_t i = 0; i < int32_t(length); ++i)
-		{
-			Color color = cumulativeImage.getPixel(i);
-			color /= color.a;
-			color.a = 1.0f;
-
-			normalizedImage.setPixel(i, color);
-		}
-	};
-
-	if (type == RendererType::CPU)
-		normalize_();
-	else
-	{
-#ifdef USE_CUDA
-
-		dim3 dimBlock(16, 16);
-		dim3 dimGrid;
-
-		dimGrid.x = (width + dimBlock.x - 1) / dimBlock.x;
-		dimGrid.y = (height + dimBlock.y - 1) / dimBlock.y;
-
-		normalizeKernel<<<dimGrid, dimBlock>>>(cumulativeImage.getSurfaceObject(), normalizedImage.getSurfaceObject(), width, height);
-		CudaUtils::checkError(cudaPeekAtLastError(), "Could not launch normalize kernel");
-		CudaUtils::checkError(cudaDeviceSynchronize(), "Could not execute normalize kernel");
-#else
-		normalize_();
-#endif
-	}
-}
-
-#ifdef USE_CUDA
-
-__global__ void tonemapKernel(cudaSurfaceObject_t input, cudaSurfaceObject_t output, uint32_t width, uint32_t height)
+__global__ void resolveKernel(cudaSurfaceObject_t cumulative, cudaSurfaceObject_t output, uint32_t width, uint32_t height)
 {
 	uint32_t x = threadIdx.x + blockIdx.x * blockDim.x;
 	uint32_t y = threadIdx.y + blockIdx.y * blockDim.y;
@@ -289,108 +289,101 @@ __global__ void tonemapKernel(cudaSurfaceObject_t input, cudaSurfaceObject_t out
 		return;
 
 	float4 temp;
-	surf2Dread(&temp, input, x * sizeof(float4), y);
+	surf2Dread(&temp, cumulative, x * sizeof(float4), y);
 
-	Color color(temp.x, temp.y, temp.z, temp.w);
+	Color color(temp.x / temp.w, temp.y / temp.w, temp.z / temp.w, 1.0f);
 	color.clamp();
 	color = Color::pow(color, 1.0f / 2.2f);
 	color.a = 1.0f;
 
-	surf2Dwrite(make_float4(color.r, color.g, color.b, color.a), output, x * sizeof(float4), y);
+	uint32_t abgr = color.getAbgrValue();
+	surf2Dwrite(make_uchar4(abgr & 0xff, (abgr >> 8) & 0xff, (abgr >> 16) & 0xff, abgr >> 24), output, x * sizeof(uchar4), y);
 }
 
 #endif
 
-void Film::tonemap(Tonemapper& tonemapper, RendererType type)
+void Film::resolve(Tonemapper& tonemapper, RendererType type)
 {
-	if (type == RendererType::CPU)
+	auto resolve_ = [&]()
 	{
-		tonemapper.apply(normalizedImage, tonemappedImage);
-	}
-	else
-	{
-#ifdef USE_CUDA
-
-		dim3 dimBlock(16, 16);
-		dim3 dimGrid;
-
-		dimGrid.x = (width + dimBlock.x - 1) / dimBlock.x;
-		dimGrid.y = (height + dimBlock.y - 1) / dimBlock.y;
+		if (!usePixelBuffers)
+		{
+			tonemapper.resolve(cumulativeImage, resolvedPixels.data());
+			tonemappedPixels = resolvedPixels.data();
 
-		tonemapKernel<<<dimGrid, dimBlock>>>(normalizedImage.getSurfaceObject(), tonemappedImage.getSurfaceObject(), width, height);
-		CudaUtils::checkError(cudaPeekAtLastError(), "Could not launch tonemap kernel");
-		CudaUtils::checkError(cudaDeviceSynchronize(), "Could not execute tonemap kernel");
-#else
-		tonemapper.apply(normalizedImage, tonemappedImage);
-#endif
-	}
-}
+			glBindTexture(GL_TEXTURE_2D, textureId);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GLsizei(width), GLsizei(height), GL_RGBA, GL_UNSIGNED_BYTE, resolvedPixels.data());
+			glBindTexture(GL_TEXTURE_2D, 0);
 
-#ifdef USE_CUDA
+			GLUtils::checkError("Could not upload OpenGL texture data");
+			return;
+		}
 
-__global__ void updateTextureKernel(cudaSurfaceObject_t input, cudaSurfaceObject_t output, uint32_t width, uint32_t height)
-{
-	uint32_t x = threadIdx.x + blockIdx.x * blockDim.x;
-	uint32_t y = threadIdx.y + blockIdx.y * blockDim.y;
+		GLsync& fence = pixelBufferFences[pixelBufferIndex];
 
-	if (x >= width || y >= height)
-		return;
+		// the ring is deep enough that this normally returns right away
+		if (fence != nullptr)
+		{
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+				;
 
-	float4 color;
-	surf2Dread(&color, input, x * sizeof(float4), y);
-	surf2Dwrite(color, output, x * sizeof(float4), y);
-}
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
 
-#endif
+		tonemapper.resolve(cumulativeImage, pixelBufferPointers[pixelBufferIndex]);
+		tonemappedPixels = pixelBufferPointers[pixelBufferIndex];
 
-void Film::updateTexture(RendererType type)
-{
-	auto update = [&]()
-	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBufferIds[pixelBufferIndex]);
 		glBindTexture(GL_TEXTURE_2D, textureId);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GLsizei(width), GLsizei(height), GL_RGBA, GL_FLOAT, tonemappedImage.getData());
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GLsizei(width), GLsizei(height), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
 		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		pixelBufferIndex = (pixelBufferIndex + 1) % PIXEL_BUFFER_COUNT;
 
 		GLUtils::checkError("Could not upload OpenGL texture data");
 	};
 
-	if (windowed)
+	if (!windowed)
+		return;
+
+	if (type == RendererType::CPU)
+		resolve_();
+	else
 	{
-		if (type == RendererType::CPU)
-			update();
-		else
-		{
 #ifdef USE_CUDA
 
-			CudaUtils::checkError(cudaGraphicsMapResources(1, &textureResource, 0), "Could not map texture resource");
+		CudaUtils::checkError(cudaGraphicsMapResources(1, &textureResource, 0), "Could not map texture resource");
 
-			cudaArray_t textureData;
-			CudaUtils::checkError(cudaGraphicsSubResourceGetMappedArray(&textureData, textureResource, 0, 0), "Could not get mapped array");
+		cudaArray_t textureData;
+		CudaUtils::checkError(cudaGraphicsSubResourceGetMappedArray(&textureData, textureResource, 0, 0), "Could not get mapped array");
 
-			cudaResourceDesc resDesc;
-			memset(&resDesc, 0, sizeof(resDesc));
-			resDesc.resType = cudaResourceTypeArray;
-			resDesc.res.array.array = textureData;
+		cudaResourceDesc resDesc;
+		memset(&resDesc, 0, sizeof(resDesc));
+		resDesc.resType = cudaResourceTypeArray;
+		resDesc.res.array.array = textureData;
 
-			cudaSurfaceObject_t surfaceObject;
-			CudaUtils::checkError(cudaCreateSurfaceObject(&surfaceObject, &resDesc), "Could not create surface object");
-			
-			dim3 dimBlock(16, 16);
-			dim3 dimGrid;
+		cudaSurfaceObject_t surfaceObject;
+		CudaUtils::checkError(cudaCreateSurfaceObject(&surfaceObject, &resDesc), "Could not create surface object");
 
-			dimGrid.x = (width + dimBlock.x - 1) / dimBlock.x;
-			dimGrid.y = (height + dimBlock.y - 1) / dimBlock.y;
+		dim3 dimBlock(16, 16);
+		dim3 dimGrid;
+
+		dimGrid.x = (width + dimBlock.x - 1) / dimBlock.x;
+		dimGrid.y = (height + dimBlock.y - 1) / dimBlock.y;
+
+		resolveKernel<<<dimGrid, dimBlock>>>(cumulativeImage.getSurfaceObject(), surfaceObject, width, height);
+		CudaUtils::checkError(cudaPeekAtLastError(), "Could not launch resolve kernel");
+		CudaUtils::checkError(cudaDeviceSynchronize(), "Could not execute resolve kernel");
 
-			updateTextureKernel<<<dimGrid, dimBlock>>>(tonemappedImage.getSurfaceObject(), surfaceObject, width, height);
-			CudaUtils::checkError(cudaPeekAtLastError(), "Could not launch update texture kernel");
-			CudaUtils::checkError(cudaDeviceSynchronize(), "Could not execute update texture kernel");
+		CudaUtils::checkError(cudaDestroySurfaceObject(surfaceObject), "Could not destroy surface object");
+		CudaUtils::checkError(cudaGraphicsUnmapResources(1, &textureResource, 0), "Could not unmap texture resource");
 
-			CudaUtils::checkError(cudaDestroySurfaceObject(surfaceObject), "Could not destroy surface object");
-			CudaUtils::checkError(cudaGraphicsUnmapResources(1, &textureResource, 0), "Could not unmap texture resource");
 #else
-			update();
+		resolve_();
 #endif
-		}
 	}
 }
 
@@ -401,12 +394,22 @@ Color Film::getCumulativeColor(uint32_t x, uint32_t y) const
 
 Color Film::getNormalizedColor(uint32_t x, uint32_t y) const
 {
-	return normalizedImage.getPixel(x, y);
+	Color color = cumulativeImage.getPixel(x, y);
+
+	if (color.a != 0.0f)
+		color /= color.a;
+
+	color.a = 1.0f;
+
+	return color;
 }
 
 Color Film::getTonemappedColor(uint32_t x, uint32_t y) const
 {
-	return tonemappedImage.getPixel(x, y);
+	if (tonemappedPixels == nullptr)
+		return Color();
+
+	return Color::fromAbgrValue(tonemappedPixels[y * width + x]);
 }
 
 CUDA_CALLABLE Image& Film::getCumulativeImage()
@@ -414,16 +417,6 @@ CUDA_CALLABLE Image& Film::getCumulativeImage()
 	return cumulativeImage;
 }
 
-CUDA_CALLABLE Image& Film::getNormalizedImage()
-{
-	return normalizedImage;
-}
-
-CUDA_CALLABLE Image& Film::getTonemappedImage()
-{
-	return tonemappedImage;
-}
-
 CUDA_CALLABLE uint32_t Film::getWidth() const
 {
 	return width;
@@ -443,3 +436,54 @@ GLuint Film::getTextureId() const
 {
 	return textureId;
 }
+
+void Film::createPixelBuffers()
+{
+	deletePixelBuffers();
+
+	// buffer storage is immutable, so the buffers are recreated for every size
+	const GLsizeiptr size = GLsizeiptr(length) * GLsizeiptr(sizeof(uint32_t));
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(PIXEL_BUFFER_COUNT, pixelBufferIds);
+
+	for (uint32_t i = 0; i < PIXEL_BUFFER_COUNT; ++i)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBufferIds[i]);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+		pixelBufferPointers[i] = static_cast<uint32_t*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+
+		if (pixelBufferPointers[i] == nullptr)
+			throw std::runtime_error("Could not map OpenGL pixel buffer");
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	pixelBufferIndex = 0;
+
+	GLUtils::checkError("Could not create OpenGL pixel buffers");
+}
+
+void Film::deletePixelBuffers()
+{
+	for (uint32_t i = 0; i < PIXEL_BUFFER_COUNT; ++i)
+	{
+		if (pixelBufferFences[i] != nullptr)
+		{
+			glDeleteSync(pixelBufferFences[i]);
+			pixelBufferFences[i] = nullptr;
+		}
+
+		if (pixelBufferIds[i] != 0)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBufferIds[i]);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glDeleteBuffers(1, &pixelBufferIds[i]);
+
+			pixelBufferIds[i] = 0;
+			pixelBufferPointers[i] = nullptr;
+		}
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	tonemappedPixels = nullptr;
+}
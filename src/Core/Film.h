@@ -5,6 +5,7 @@
 
 #include <atomic>
 #include <cstdint>
+#include <vector>
 
 #include <GL/glcorearb.h>
 
@@ -13,8 +14,36 @@
 #endif
 
 #include "Core/Common.h"
+#include "Core/FilmFile.h"
 #include "Core/Image.h"
 
+/*
+
+Only the cumulative image is kept for the whole render. The window path uses resolve, which normalizes,
+tonemaps and quantizes the cumulative image in a single pass straight into the RGBA8 buffer that is
+uploaded to the OpenGL texture. saveImage streams PNG, HDR and PFM files through ImageWriter, normalizing and
+tonemapping one row at a time, so no full-size copy of the image is made. BMP and TGA are resolved to a
+temporary RGBA8 image and the remaining formats to a temporary float image.
+
+If OpenGL 4.4 is available, the resolve writes into a ring of persistently mapped pixel buffers and the
+texture is updated from the buffer, so the upload runs asynchronously. Each buffer is fenced and only
+rewritten once the GPU has consumed it, three frames later. Otherwise the pixels are uploaded synchronously.
+
+With film.compactAccumulation the cumulative image stores a half float running mean and a float weight sum
+(RGB16F_A32F, 10 bytes per pixel instead of 16). The mean keeps about three significant digits and stops
+improving once a single sample moves it less than the half float precision, so this is meant for very large
+renders with modest sample counts. It is only used with the CPU renderer. Film files are always written
+as float.
+
+A film can be seeded with the cumulative image of a lower resolution film (nearest pixel). The weights are
+scaled by the pixel area ratio, so the seeded samples count as a fraction of a sample per pixel and are soon
+outweighed by the samples rendered at the new resolution.
+
+Film files carry the pixel sample count and a hash of the scene and camera (see FilmFile). Loading a film
+restores the sample count and warns if the film was rendered from a different scene.
+
+*/
+
 namespace Valo
 {
 	class Color;
@@ -32,24 +61,22 @@ namespace Valo
 		void clear(RendererType type);
 		bool hasBeenCleared() const;
 		void resetCleared();
-		void load(uint32_t width, uint32_t height, const std::string& fileName, RendererType type);
-		void loadMultiple(uint32_t width, uint32_t height, const std::string& dirName, RendererType type);
-		void save(const std::string& fileName, bool writeToLog = true) const;
+		void seed(const Image& image);
+		FilmFileInfo load(uint32_t width, uint32_t height, const std::string& fileName, RendererType type, uint64_t sceneHash = 0);
+		FilmFileInfo loadMultiple(uint32_t width, uint32_t height, const std::string& dirName, RendererType type, uint64_t sceneHash = 0);
+		uint32_t save(const std::string& fileName, uint64_t sceneHash, bool writeToLog = true) const;
+		void saveImage(const std::string& fileName, Tonemapper& tonemapper, bool writeToLog = true) const;
 
 		CUDA_CALLABLE void addSample(uint32_t x, uint32_t y, const Color& color, float filterWeight);
 		CUDA_CALLABLE void addSample(uint32_t index, const Color& color, float filterWeight);
 
-		void normalize(RendererType type);
-		void tonemap(Tonemapper& tonemapper, RendererType type);
-		void updateTexture(RendererType type);
+		void resolve(Tonemapper& tonemapper, RendererType type);
 
 		Color getCumulativeColor(uint32_t x, uint32_t y) const;
 		Color getNormalizedColor(uint32_t x, uint32_t y) const;
 		Color getTonemappedColor(uint32_t x, uint32_t y) const;
 
 		CUDA_CALLABLE Image& getCumulativeImage();
-		CUDA_CALLABLE Image& getNormalizedImage();
-		CUDA_CALLABLE Image& getTonemappedImage();
 
 		CUDA_CALLABLE uint32_t getWidth() const;
 		CUDA_CALLABLE uint32_t getHeight() const;
@@ -61,6 +88,10 @@ namespace Valo
 
 	private:
 
+		FilmFileInfo merge(const std::vector<std::string>& fileNames, uint64_t sceneHash);
+		void createPixelBuffers();
+		void deletePixelBuffers();
+
 		uint32_t width = 0;
 		uint32_t height = 0;
 		uint32_t length = 0;
@@ -69,11 +100,20 @@ namespace Valo
 		bool cleared = false;
 		
 		Image cumulativeImage;
-		Image normalizedImage;
-		Image tonemappedImage;
+
+		std::vector<uint32_t> resolvedPixels;
+		const uint32_t* tonemappedPixels = nullptr;
 
 		GLuint textureId = 0;
 
+		static const uint32_t PIXEL_BUFFER_COUNT = 3;
+
+		bool usePixelBuffers = false;
+		uint32_t pixelBufferIndex = 0;
+		GLuint pixelBufferIds[PIXEL_BUFFER_COUNT] = {};
+		GLsync pixelBufferFences[PIXEL_BUFFER_COUNT] = {};
+		uint32_t* pixelBufferPointers[PIXEL_BUFFER_COUNT] = {};
+
 #ifdef USE_CUDA
 		cudaGraphicsResource* textureResource = nullptr;
 #endif
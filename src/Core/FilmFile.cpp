@@ -0,0 +1,279 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include <omp.h>
+#include <zlib.h>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "tinyformat/tinyformat.h"
+
+#include "Core/FilmFile.h"
+#include "App.h"
+#include "Core/Common.h"
+#include "Core/Image.h"
+#include "Math/Color.h"
+#include "Utils/Log.h"
+#include "Utils/SysUtils.h"
+
+using namespace Valo;
+
+namespace bi = boost::interprocess;
+
+namespace
+{
+	const char MAGIC[4] = { 'V', 'F', 'L', 'M' };
+	const uint32_t VERSION = 1;
+	const uint32_t CHUNK_PIXELS = 64 * 1024;
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint64_t pixelSamples;
+		uint64_t sceneHash;
+		uint32_t checksum;
+		uint32_t reserved[3];
+	};
+
+	static_assert(sizeof(Header) == 48, "Film file header has wrong size");
+	static_assert(sizeof(Color) == 4 * sizeof(float), "Color has wrong size");
+
+	struct MappedFilm
+	{
+		bi::mapped_region region;
+		Header header;
+		bool legacy = false;
+		const float* pixels = nullptr;
+	};
+
+	uint32_t getChunkCount(uint32_t length)
+	{
+		return (length + CHUNK_PIXELS - 1) / CHUNK_PIXELS;
+	}
+
+	uLong calculateChecksum(const void* data, uint32_t pixelCount)
+	{
+		return crc32(crc32(0L, Z_NULL, 0), static_cast<const Bytef*>(data), uInt(pixelCount * sizeof(Color)));
+	}
+
+	// combines the checksums of consecutive chunks
+	uint32_t combineChecksums(const std::vector<uLong>& checksums, uint32_t length)
+	{
+		uLong checksum = crc32(0L, Z_NULL, 0);
+
+		for (uint32_t i = 0; i < uint32_t(checksums.size()); ++i)
+		{
+			uint32_t pixelCount = MIN(CHUNK_PIXELS, length - i * CHUNK_PIXELS);
+			checksum = crc32_combine(checksum, checksums[i], z_off_t(pixelCount * sizeof(Color)));
+		}
+
+		return uint32_t(checksum);
+	}
+}
+
+uint32_t FilmFile::write(const std::string& fileName, const Image& image, const FilmFileInfo& info)
+{
+	std::ofstream file(fileName, std::ios::out | std::ios::binary);
+
+	if (!file.is_open())
+		throw std::runtime_error(tfm::format("Could not open the film file for writing: %s", fileName));
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.width = info.width;
+	header.height = info.height;
+	header.pixelSamples = info.pixelSamples;
+	header.sceneHash = info.sceneHash;
+
+	// the checksum is filled in after the pixels have been written
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	uint32_t length = image.getLength();
+	uint32_t chunkCount = getChunkCount(length);
+	uint32_t batchSize = uint32_t(omp_get_max_threads());
+	bool isFloat = (image.getFormat() == ImageFormat::RGBA32F);
+
+	std::vector<uLong> checksums(chunkCount);
+	std::vector<std::vector<Color>> buffers(batchSize);
+	std::vector<const Color*> chunks(batchSize);
+
+	for (uint32_t firstChunk = 0; firstChunk < chunkCount; firstChunk += batchSize)
+	{
+		uint32_t batchChunkCount = MIN(batchSize, chunkCount - firstChunk);
+
+		#pragma omp parallel for
+		for (int32_t i = 0; i < int32_t(batchChunkCount); ++i)
+		{
+			uint32_t start = (firstChunk + uint32_t(i)) * CHUNK_PIXELS;
+			uint32_t pixelCount = MIN(CHUNK_PIXELS, length - start);
+
+			// film files always hold float pixels regardless of the accumulation format
+			if (isFloat)
+				chunks[i] = image.getData() + start;
+			else
+			{
+				buffers[i].resize(pixelCount);
+
+				for (uint32_t j = 0; j < pixelCount; ++j)
+					buffers[i][j] = image.getPixel(start + j);
+
+				chunks[i] = buffers[i].data();
+			}
+
+			checksums[firstChunk + i] = calculateChecksum(chunks[i], pixelCount);
+		}
+
+		for (uint32_t i = 0; i < batchChunkCount; ++i)
+		{
+			uint32_t pixelCount = MIN(CHUNK_PIXELS, length - (firstChunk + i) * CHUNK_PIXELS);
+			file.write(reinterpret_cast<const char*>(chunks[i]), pixelCount * sizeof(Color));
+		}
+	}
+
+	header.checksum = combineChecksums(checksums, length);
+
+	file.seekp(0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.close();
+
+	if (file.fail())
+		throw std::runtime_error(tfm::format("Could not write the film file: %s", fileName));
+
+	return header.checksum;
+}
+
+FilmFileInfo FilmFile::merge(const std::vector<std::string>& fileNames, Image& image)
+{
+	uint32_t length = image.getLength();
+	uint64_t dataSize = uint64_t(length) * sizeof(Color);
+
+	FilmFileInfo info;
+	info.width = image.getWidth();
+	info.height = image.getHeight();
+
+	std::vector<MappedFilm> films(fileNames.size());
+
+	for (size_t i = 0; i < fileNames.size(); ++i)
+	{
+		const std::string& fileName = fileNames[i];
+		MappedFilm& film = films[i];
+
+		uint64_t fileSize = SysUtils::getFileSize(fileName);
+
+		if (fileSize == 0)
+			throw std::runtime_error(tfm::format("Film file is empty: %s", fileName));
+
+		try
+		{
+			bi::file_mapping fileMapping(fileName.c_str(), bi::read_only);
+			film.region = bi::mapped_region(fileMapping, bi::read_only);
+		}
+		catch (const bi::interprocess_exception& ex)
+		{
+			throw std::runtime_error(tfm::format("Could not map the film file %s: %s", fileName, ex.what()));
+		}
+
+		const char* data = static_cast<const char*>(film.region.get_address());
+
+		if (fileSize >= sizeof(Header) && memcmp(data, MAGIC, sizeof(MAGIC)) == 0)
+		{
+			memcpy(&film.header, data, sizeof(Header));
+
+			if (film.header.version != VERSION)
+				throw std::runtime_error(tfm::format("Film file %s has an unsupported version (%d)", fileName, film.header.version));
+
+			if (film.header.width != info.width || film.header.height != info.height)
+				throw std::runtime_error(tfm::format("Film file %s has wrong dimensions (%dx%d, expected %dx%d)", fileName, film.header.width, film.header.height, info.width, info.height));
+
+			if (fileSize != sizeof(Header) + dataSize)
+				throw std::runtime_error(tfm::format("Film file %s has wrong size", fileName));
+
+			// zero scene hash is unknown and matches anything
+			if (film.header.sceneHash != 0)
+			{
+				if (info.sceneHash != 0 && film.header.sceneHash != info.sceneHash)
+					throw std::runtime_error(tfm::format("Film file %s was rendered from a different scene or camera than the other films", fileName));
+
+				info.sceneHash = film.header.sceneHash;
+			}
+
+			info.pixelSamples += film.header.pixelSamples;
+			film.pixels = reinterpret_cast<const float*>(data + sizeof(Header));
+		}
+		else if (fileSize == dataSize)
+		{
+			App::getLog().logWarning("Film file %s has no header and cannot be validated", fileName);
+
+			film.legacy = true;
+			film.pixels = reinterpret_cast<const float*>(data);
+		}
+		else
+			throw std::runtime_error(tfm::format("Film file %s is not valid", fileName));
+	}
+
+	uint32_t chunkCount = getChunkCount(length);
+	bool isFloat = (image.getFormat() == ImageFormat::RGBA32F);
+	std::vector<std::vector<uLong>> checksums(films.size(), std::vector<uLong>(chunkCount));
+
+	// the sums go to a scratch buffer so that the image is left untouched if a checksum does not match
+	std::vector<Color> sums(length);
+
+	// one chunk at a time across all the films keeps the sums in the cache
+	#pragma omp parallel for schedule(dynamic)
+	for (int32_t c = 0; c < int32_t(chunkCount); ++c)
+	{
+		uint32_t start = uint32_t(c) * CHUNK_PIXELS;
+		uint32_t pixelCount = MIN(CHUNK_PIXELS, length - start);
+		uint32_t valueCount = pixelCount * 4;
+
+		if (isFloat)
+			memcpy(&sums[start], image.getData() + start, pixelCount * sizeof(Color));
+		else
+		{
+			for (uint32_t j = 0; j < pixelCount; ++j)
+				sums[start + j] = image.getPixel(start + j);
+		}
+
+		float* destination = reinterpret_cast<float*>(&sums[start]);
+
+		for (size_t f = 0; f < films.size(); ++f)
+		{
+			const float* source = films[f].pixels + uint64_t(start) * 4;
+
+			if (!films[f].legacy)
+				checksums[f][c] = calculateChecksum(source, pixelCount);
+
+			#pragma omp simd
+			for (uint32_t k = 0; k < valueCount; ++k)
+				destination[k] += source[k];
+		}
+	}
+
+	for (size_t f = 0; f < films.size(); ++f)
+	{
+		if (!films[f].legacy && combineChecksums(checksums[f], length) != films[f].header.checksum)
+			throw std::runtime_error(tfm::format("Film file %s is corrupted (checksum mismatch)", fileNames[f]));
+	}
+
+	if (isFloat)
+		memcpy(image.getData(), sums.data(), size_t(dataSize));
+	else
+	{
+		#pragma omp parallel for
+		for (int32_t i = 0; i < int32_t(length); ++i)
+			image.setPixel(uint32_t(i), sums[i]);
+	}
+
+	if (films.size() == 1)
+		info.checksum = films[0].header.checksum;
+
+	return info;
+}
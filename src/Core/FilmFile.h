@@ -0,0 +1,54 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+
+Film checkpoint files. All values are little endian.
+
+header (48 bytes):
+char[4] magic ("VFLM")
+uint32 version (1)
+uint32 width
+uint32 height
+uint64 pixelSamples
+uint64 sceneHash (Scene::getHash, zero if unknown)
+uint32 checksum (CRC-32 of the pixel data)
+uint32[3] reserved
+
+pixels: width * height * float RGBA (cumulative color, alpha is the filter weight sum), bottom row first
+
+Files are memory mapped. merge sums any number of files into an image in parallel, one chunk of pixels
+at a time across all the files, and validates that the files are compatible and that the checksums
+match. The image is only modified if all the files are valid. A zero scene hash matches any scene.
+write returns the checksum of the written pixels. Headerless files written by older versions (raw
+pixels only) are still read, without validation.
+
+*/
+
+namespace Valo
+{
+	class Image;
+
+	struct FilmFileInfo
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint64_t pixelSamples = 0;
+		uint64_t sceneHash = 0;
+		uint32_t checksum = 0; // only set when a single file is merged
+	};
+
+	class FilmFile
+	{
+	public:
+
+		static uint32_t write(const std::string& fileName, const Image& image, const FilmFileInfo& info);
+		static FilmFileInfo merge(const std::vector<std::string>& fileNames, Image& image);
+	};
+}
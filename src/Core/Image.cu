@@ -8,6 +8,11 @@
 #include "Utils/CudaUtils.h"
 #endif
 
+#if !defined(__CUDA_ARCH__) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define IMAGE_USE_SSE
+#endif
+
 #include "tinyformat/tinyformat.h"
 
 #include "stb/stb_image.h"
@@ -17,6 +22,7 @@
 #include "Core/Image.h"
 #include "App.h"
 #include "Utils/Log.h"
+#include "Utils/ImageWriter.h"
 #include "Utils/StringUtils.h"
 #include "Math/MathUtils.h"
 #include "Filters/Filter.h"
@@ -25,6 +31,73 @@
 
 using namespace Valo;
 
+namespace
+{
+	uint32_t getPixelSize(ImageFormat format)
+	{
+		switch (format)
+		{
+			case ImageFormat::RGBA32F: return sizeof(Color);
+			case ImageFormat::RGBA8:
+			case ImageFormat::RGBA8_SRGB: return sizeof(uint32_t);
+			case ImageFormat::RGBA16F: return 4 * sizeof(uint16_t);
+			case ImageFormat::RGB16F_A32F: return 3 * sizeof(uint16_t) + sizeof(float);
+			default: return 0;
+		}
+	}
+
+	float srgbToLinear(float x)
+	{
+		return (x <= 0.04045f) ? x / 12.92f : std::pow((x + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linearToSrgb(float x)
+	{
+		return (x <= 0.0031308f) ? x * 12.92f : 1.055f * std::pow(x, 1.0f / 2.4f) - 0.055f;
+	}
+
+	uint32_t toByte(float x)
+	{
+		return uint32_t(MIN(MAX(x, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+
+	struct SrgbTable
+	{
+		SrgbTable()
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+				values[i] = srgbToLinear(float(i) / 255.0f);
+		}
+
+		float values[256];
+	};
+
+	const SrgbTable srgbTable;
+
+#ifdef IMAGE_USE_SSE
+
+	__m128 loadSrgbPixel(uint32_t abgr)
+	{
+		return _mm_setr_ps(srgbTable.values[abgr & 0xff], srgbTable.values[(abgr >> 8) & 0xff], srgbTable.values[(abgr >> 16) & 0xff], float(abgr >> 24) * (1.0f / 255.0f));
+	}
+
+	// same operation order as the scalar path so that the results are identical
+	Color blendBilinear(__m128 c11, __m128 c21, __m128 c12, __m128 c22, float tx, float ty)
+	{
+		__m128 tx1 = _mm_set1_ps(1.0f - tx);
+		__m128 tx2 = _mm_set1_ps(tx);
+		__m128 top = _mm_add_ps(_mm_mul_ps(tx1, c11), _mm_mul_ps(tx2, c21));
+		__m128 bottom = _mm_add_ps(_mm_mul_ps(tx1, c12), _mm_mul_ps(tx2, c22));
+		__m128 result = _mm_add_ps(_mm_mul_ps(top, _mm_set1_ps(1.0f - ty)), _mm_mul_ps(bottom, _mm_set1_ps(ty)));
+
+		Color color;
+		_mm_storeu_ps(&color.r, result);
+		return color;
+	}
+
+#endif
+}
+
 Image::Image()
 {
 }
@@ -37,6 +110,18 @@ Image::~Image()
 		data = nullptr;
 	}
 
+	if (packedData != nullptr)
+	{
+		free(packedData);
+		packedData = nullptr;
+	}
+
+	if (halfData != nullptr)
+	{
+		free(halfData);
+		halfData = nullptr;
+	}
+
 #ifdef USE_CUDA
 
 	if (textureObject != 0)
@@ -65,6 +150,11 @@ Image::Image(uint32_t width_, uint32_t height_)
 	resize(width_, height_);
 }
 
+Image::Image(uint32_t width_, uint32_t height_, ImageFormat format_) : format(format_)
+{
+	resize(width_, height_);
+}
+
 Image::Image(uint32_t width_, uint32_t height_, float* rgbaData)
 {
 	load(width_, height_, rgbaData);
@@ -77,24 +167,48 @@ Image::Image(const std::string& fileName)
 
 Image::Image(const Image& other)
 {
+	format = other.format;
 	resize(other.width, other.height);
-
-	for (uint32_t i = 0; i < length; ++i)
-		data[i] = other.data[i];
+	memcpy(getRawData(), other.getRawData(), length * getPixelSize(format));
 }
 
 Image& Image::operator=(const Image& other)
 {
+	format = other.format;
 	resize(other.width, other.height);
+	memcpy(getRawData(), other.getRawData(), length * getPixelSize(format));
 
-	for (uint32_t i = 0; i < length; ++i)
-		data[i] = other.data[i];
+	return *this;
+}
+
+Image::Image(Image&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+// the moved from image gets the old contents and releases them
+Image& Image::operator=(Image&& other) noexcept
+{
+	std::swap(width, other.width);
+	std::swap(height, other.height);
+	std::swap(length, other.length);
+	std::swap(format, other.format);
+	std::swap(data, other.data);
+	std::swap(packedData, other.packedData);
+	std::swap(halfData, other.halfData);
+
+#ifdef USE_CUDA
+	std::swap(cudaData, other.cudaData);
+	std::swap(textureObject, other.textureObject);
+	std::swap(surfaceObject, other.surfaceObject);
+#endif
 
 	return *this;
 }
 
 void Image::load(uint32_t width_, uint32_t height_, float* rgbaData)
 {
+	format = ImageFormat::RGBA32F;
 	resize(width_, height_);
 
 	for (uint32_t i = 0; i < length; ++i)
@@ -108,10 +222,12 @@ void Image::load(uint32_t width_, uint32_t height_, float* rgbaData)
 	}
 }
 
-void Image::load(const std::string& fileName)
+void Image::load(const std::string& fileName, ImageFormat format_)
 {
 	App::getLog().logInfo("Loading image from %s", fileName);
 
+	format = ImageFormat::RGBA32F;
+
 	if (StringUtils::endsWith(fileName, ".jpg") || StringUtils::endsWith(fileName, ".png") || StringUtils::endsWith(fileName, ".bmp") || StringUtils::endsWith(fileName, ".tga"))
 	{
 		int32_t newWidth, newHeight, components;
@@ -120,12 +236,30 @@ void Image::load(const std::string& fileName)
 		if (loadData == nullptr)
 			throw std::runtime_error(tfm::format("Could not load image file: %s", stbi_failure_reason()));
 
-		resize(uint32_t(newWidth), uint32_t(newHeight));
+		// 8-bit formats take the file data as is
+		if (format_ == ImageFormat::RGBA8 || format_ == ImageFormat::RGBA8_SRGB)
+		{
+			format = format_;
+			resize(uint32_t(newWidth), uint32_t(newHeight));
 
-		for (uint32_t y = 0; y < height; ++y)
+			#pragma omp parallel for
+			for (int32_t y = 0; y < int32_t(height); ++y)
+				memcpy(&packedData[uint32_t(y) * width], &loadData[(height - 1 - uint32_t(y)) * width], width * sizeof(uint32_t)); // flip vertically
+		}
+		else
 		{
-			for (uint32_t x = 0; x < width; ++x)
-				data[y * width + x] = Color::fromAbgrValue(loadData[(height - 1 - y) * width + x]); // flip vertically
+			resize(uint32_t(newWidth), uint32_t(newHeight));
+
+			#pragma omp parallel for
+			for (int32_t y = 0; y < int32_t(height); ++y)
+			{
+				const uint32_t* source = &loadData[(height - 1 - uint32_t(y)) * width]; // flip vertically
+				Color* destination = &data[uint32_t(y) * width];
+
+				#pragma omp simd
+				for (uint32_t x = 0; x < width; ++x)
+					destination[x] = Color::fromAbgrValue(source[x]);
+			}
 		}
 
 		stbi_image_free(loadData);
@@ -140,17 +274,19 @@ void Image::load(const std::string& fileName)
 
 		resize(uint32_t(newWidth), uint32_t(newHeight));
 
-		for (uint32_t y = 0; y < height; ++y)
+		#pragma omp parallel for
+		for (int32_t y = 0; y < int32_t(height); ++y)
 		{
+			const float* source = &loadData[(height - 1 - uint32_t(y)) * width * 3]; // flip vertically
+			Color* destination = &data[uint32_t(y) * width];
+
+			#pragma omp simd
 			for (uint32_t x = 0; x < width; ++x)
 			{
-				uint32_t pixelIndex = y * width + x;
-				uint32_t dataIndex = (height - 1 - y) * width * 3 + x * 3; // flip vertically
-
-				data[pixelIndex].r = loadData[dataIndex];
-				data[pixelIndex].g = loadData[dataIndex + 1];
-				data[pixelIndex].b = loadData[dataIndex + 2];
-				data[pixelIndex].a = 1.0f;
+				destination[x].r = source[x * 3];
+				destination[x].g = source[x * 3 + 1];
+				destination[x].b = source[x * 3 + 2];
+				destination[x].a = 1.0f;
 			}
 		}
 
@@ -181,6 +317,8 @@ void Image::load(const std::string& fileName)
 	}
 	else
 		throw std::runtime_error("Could not load the image (non-supported format)");
+
+	setFormat(format_);
 }
 
 void Image::save(const std::string& fileName, bool writeToLog) const
@@ -188,21 +326,27 @@ void Image::save(const std::string& fileName, bool writeToLog) const
 	if (writeToLog)
 		App::getLog().logInfo("Saving image to %s", fileName);
 
-	if (StringUtils::endsWith(fileName, ".png") || StringUtils::endsWith(fileName, ".bmp") || StringUtils::endsWith(fileName, ".tga"))
+	auto getRow = [this](uint32_t y, Color* row)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+			row[x] = getPixel(x, y);
+	};
+
+	if (ImageWriter::isSupported(fileName))
+		ImageWriter::write(fileName, width, height, getRow);
+	else if (StringUtils::endsWith(fileName, ".bmp") || StringUtils::endsWith(fileName, ".tga"))
 	{
 		std::vector<uint32_t> saveData(length);
 
 		for (uint32_t y = 0; y < height; ++y)
 		{
 			for (uint32_t x = 0; x < width; ++x)
-				saveData[(height - 1 - y) * width + x] = data[y * width + x].clamped().getAbgrValue(); // flip vertically
+				saveData[(height - 1 - y) * width + x] = getPixel(x, y).clamped().getAbgrValue(); // flip vertically
 		}
 
 		int32_t result = 0;
 
-		if (StringUtils::endsWith(fileName, ".png"))
-			result = stbi_write_png(fileName.c_str(), int32_t(width), int32_t(height), 4, &saveData[0], int32_t(width * sizeof(uint32_t)));
-		else if (StringUtils::endsWith(fileName, ".bmp"))
+		if (StringUtils::endsWith(fileName, ".bmp"))
 			result = stbi_write_bmp(fileName.c_str(), int32_t(width), int32_t(height), 4, &saveData[0]);
 		else if (StringUtils::endsWith(fileName, ".tga"))
 			result = stbi_write_tga(fileName.c_str(), int32_t(width), int32_t(height), 4, &saveData[0]);
@@ -210,30 +354,11 @@ void Image::save(const std::string& fileName, bool writeToLog) const
 		if (result == 0)
 			throw std::runtime_error(tfm::format("Could not save the image: %s", stbi_failure_reason()));
 	}
-	else if (StringUtils::endsWith(fileName, ".hdr"))
-	{
-		std::vector<float> saveData(length * 3);
-
-		for (uint32_t y = 0; y < height; ++y)
-		{
-			for (uint32_t x = 0; x < width; ++x)
-			{
-				uint32_t dataIndex = (height - 1 - y) * width * 3 + x * 3; // flip vertically
-				uint32_t pixelIndex = y * width + x;
-
-				saveData[dataIndex] = float(data[pixelIndex].r);
-				saveData[dataIndex + 1] = float(data[pixelIndex].g);
-				saveData[dataIndex + 2] = float(data[pixelIndex].b);
-			}
-		}
-
-		int32_t result = stbi_write_hdr(fileName.c_str(), int32_t(width), int32_t(height), 3, &saveData[0]);
-
-		if (result == 0)
-			throw std::runtime_error(tfm::format("Could not save the image: %s", stbi_failure_reason()));
-	}
 	else if (StringUtils::endsWith(fileName, ".bin"))
 	{
+		if (format != ImageFormat::RGBA32F)
+			throw std::runtime_error("Binary image files can only be saved from float images");
+
 		std::ofstream file(fileName, std::ios::out | std::ios::binary);
 
 		if (!file.is_open())
@@ -266,9 +391,29 @@ void Image::resize(uint32_t width_, uint32_t height_)
 		data = nullptr;
 	}
 
-	data = static_cast<Color*>(malloc(length * sizeof(Color)));
+	if (packedData != nullptr)
+	{
+		free(packedData);
+		packedData = nullptr;
+	}
+
+	if (halfData != nullptr)
+	{
+		free(halfData);
+		halfData = nullptr;
+	}
 
-	if (data == nullptr)
+	switch (format)
+	{
+		case ImageFormat::RGBA32F: data = static_cast<Color*>(malloc(length * sizeof(Color))); break;
+		case ImageFormat::RGBA8:
+		case ImageFormat::RGBA8_SRGB: packedData = static_cast<uint32_t*>(malloc(length * sizeof(uint32_t))); break;
+		case ImageFormat::RGBA16F: halfData = static_cast<uint16_t*>(malloc(length * 4 * sizeof(uint16_t))); break;
+		case ImageFormat::RGB16F_A32F: halfData = static_cast<uint16_t*>(malloc(length * getPixelSize(format))); break;
+		default: break;
+	}
+
+	if (getRawData() == nullptr)
 		throw std::runtime_error("Could not allocate memory for image");
 
 #ifdef USE_CUDA
@@ -291,7 +436,16 @@ void Image::resize(uint32_t width_, uint32_t height_)
 		cudaData = nullptr;
 	}
 
-	cudaChannelFormatDesc channelDesc = cudaCreateChannelDesc(32, 32, 32, 32, cudaChannelFormatKindFloat);
+	cudaChannelFormatDesc channelDesc;
+
+	switch (format)
+	{
+		case ImageFormat::RGBA8:
+		case ImageFormat::RGBA8_SRGB: channelDesc = cudaCreateChannelDesc(8, 8, 8, 8, cudaChannelFormatKindUnsigned); break;
+		case ImageFormat::RGBA16F: channelDesc = cudaCreateChannelDescHalf4(); break;
+		default: channelDesc = cudaCreateChannelDesc(32, 32, 32, 32, cudaChannelFormatKindFloat); break;
+	}
+
 	CudaUtils::checkError(cudaMallocArray(&cudaData, &channelDesc, width, height, cudaArraySurfaceLoadStore), "Could not allocate memory");
 
 	if (cudaData == nullptr)
@@ -307,7 +461,8 @@ void Image::resize(uint32_t width_, uint32_t height_)
 	texDesc.addressMode[0] = cudaAddressModeWrap;
 	texDesc.addressMode[1] = cudaAddressModeWrap;
 	texDesc.filterMode = cudaFilterModeLinear;
-	texDesc.readMode = cudaReadModeElementType;
+	texDesc.readMode = (format == ImageFormat::RGBA8 || format == ImageFormat::RGBA8_SRGB) ? cudaReadModeNormalizedFloat : cudaReadModeElementType;
+	texDesc.sRGB = (format == ImageFormat::RGBA8_SRGB) ? 1 : 0;
 	texDesc.normalizedCoords = 1;
 
 	CudaUtils::checkError(cudaCreateTextureObject(&textureObject, &resDesc, &texDesc, nullptr), "Could not create texture object");
@@ -335,7 +490,7 @@ __global__ void clearKernel(cudaSurfaceObject_t surfaceObject, uint32_t width, u
 void Image::clear(RendererType type)
 {
 	if (type == RendererType::CPU)
-		memset(data, 0, length * sizeof(Color));
+		memset(getRawData(), 0, length * getPixelSize(format));
 	else
 	{
 #ifdef USE_CUDA
@@ -350,7 +505,7 @@ void Image::clear(RendererType type)
 		CudaUtils::checkError(cudaPeekAtLastError(), "Could not launch clear kernel");
 		CudaUtils::checkError(cudaDeviceSynchronize(), "Could not execute clear kernel");
 #else
-		memset(data, 0, length * sizeof(Color));
+		memset(getRawData(), 0, length * getPixelSize(format));
 #endif
 	}
 }
@@ -361,6 +516,15 @@ void Image::clear(const Color& color)
 		data[i] = color;
 }
 
+void Image::clearRegion(uint32_t regionX, uint32_t regionY, uint32_t regionWidth, uint32_t regionHeight)
+{
+	const uint32_t pixelSize = getPixelSize(format);
+	uint8_t* rawData = static_cast<uint8_t*>(getRawData());
+
+	for (uint32_t y = regionY; y < regionY + regionHeight; ++y)
+		memset(rawData + (size_t(y) * width + regionX) * pixelSize, 0, size_t(regionWidth) * pixelSize);
+}
+
 void Image::applyGamma(float gamma)
 {
 	for (uint32_t i = 0; i < length; ++i)
@@ -402,6 +566,155 @@ void Image::fillWithTestPattern()
 	}
 }
 
+// 2x2 box filter, odd edges are clamped
+void Image::downsample(const Image& source)
+{
+	format = ImageFormat::RGBA32F;
+	resize(MAX(1u, source.width / 2), MAX(1u, source.height / 2));
+
+	#pragma omp parallel for
+	for (int32_t y = 0; y < int32_t(height); ++y)
+	{
+		uint32_t sy0 = MIN(uint32_t(y) * 2, source.height - 1);
+		uint32_t sy1 = MIN(uint32_t(y) * 2 + 1, source.height - 1);
+
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint32_t sx0 = MIN(x * 2, source.width - 1);
+			uint32_t sx1 = MIN(x * 2 + 1, source.width - 1);
+
+			Color sum = source.getPixel(sx0, sy0) + source.getPixel(sx1, sy0) + source.getPixel(sx0, sy1) + source.getPixel(sx1, sy1);
+			data[uint32_t(y) * width + x] = sum * 0.25f;
+		}
+	}
+
+	setFormat(source.format);
+}
+
+void Image::setFormat(ImageFormat format_)
+{
+	if (format_ == format)
+		return;
+
+	std::vector<Color> pixels(length);
+
+	#pragma omp parallel for
+	for (int32_t i = 0; i < int32_t(length); ++i)
+		pixels[i] = getPixel(uint32_t(i));
+
+	format = format_;
+	resize(width, height);
+
+	#pragma omp parallel for
+	for (int32_t i = 0; i < int32_t(length); ++i)
+		encodePixel(uint32_t(i), pixels[i]);
+}
+
+template <ImageFormat imageFormat>
+Color Image::decodePixel(uint32_t index) const
+{
+	switch (imageFormat)
+	{
+		case ImageFormat::RGBA8: return Color::fromAbgrValue(packedData[index]);
+
+		case ImageFormat::RGBA8_SRGB:
+		{
+			uint32_t abgr = packedData[index];
+			return Color(srgbTable.values[abgr & 0xff], srgbTable.values[(abgr >> 8) & 0xff], srgbTable.values[(abgr >> 16) & 0xff], float(abgr >> 24) * (1.0f / 255.0f));
+		}
+
+		case ImageFormat::RGBA16F:
+		{
+			const uint16_t* pixel = &halfData[index * 4];
+			return Color(MathUtils::halfToFloat(pixel[0]), MathUtils::halfToFloat(pixel[1]), MathUtils::halfToFloat(pixel[2]), MathUtils::halfToFloat(pixel[3]));
+		}
+
+		case ImageFormat::RGB16F_A32F:
+		{
+			const uint16_t* pixel = &halfData[index * 5];
+			float weight;
+			memcpy(&weight, &pixel[3], sizeof(float));
+
+			return Color(MathUtils::halfToFloat(pixel[0]) * weight, MathUtils::halfToFloat(pixel[1]) * weight, MathUtils::halfToFloat(pixel[2]) * weight, weight);
+		}
+
+		default: return data[index];
+	}
+}
+
+template <ImageFormat imageFormat>
+Color Image::interpolateBilinear(uint32_t index11, uint32_t index21, uint32_t index12, uint32_t index22, float tx, float ty) const
+{
+#ifdef IMAGE_USE_SSE
+
+	// the four 8-bit texels are widened and blended as whole pixels, the sRGB channels still go through the table
+	if (imageFormat == ImageFormat::RGBA8)
+	{
+		__m128i zero = _mm_setzero_si128();
+		__m128i packed = _mm_set_epi32(int32_t(packedData[index22]), int32_t(packedData[index12]), int32_t(packedData[index21]), int32_t(packedData[index11]));
+		__m128i low = _mm_unpacklo_epi8(packed, zero);
+		__m128i high = _mm_unpackhi_epi8(packed, zero);
+
+		__m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+		return blendBilinear(
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero)), scale),
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero)), scale),
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero)), scale),
+			_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero)), scale),
+			tx, ty);
+	}
+
+	if (imageFormat == ImageFormat::RGBA8_SRGB)
+		return blendBilinear(loadSrgbPixel(packedData[index11]), loadSrgbPixel(packedData[index21]), loadSrgbPixel(packedData[index12]), loadSrgbPixel(packedData[index22]), tx, ty);
+
+#endif
+
+	Color c11 = decodePixel<imageFormat>(index11);
+	Color c21 = decodePixel<imageFormat>(index21);
+	Color c12 = decodePixel<imageFormat>(index12);
+	Color c22 = decodePixel<imageFormat>(index22);
+
+	float tx1 = 1.0f - tx;
+	float ty1 = 1.0f - ty;
+
+	return (tx1 * c11 + tx * c21) * ty1 + (tx1 * c12 + tx * c22) * ty;
+}
+
+void Image::encodePixel(uint32_t index, const Color& color)
+{
+	switch (format)
+	{
+		case ImageFormat::RGBA8: packedData[index] = color.clamped().getAbgrValue(); break;
+
+		case ImageFormat::RGBA8_SRGB:
+			packedData[index] = toByte(color.a) << 24 | toByte(linearToSrgb(MAX(color.b, 0.0f))) << 16 | toByte(linearToSrgb(MAX(color.g, 0.0f))) << 8 | toByte(linearToSrgb(MAX(color.r, 0.0f)));
+			break;
+
+		case ImageFormat::RGBA16F:
+		{
+			uint16_t* pixel = &halfData[index * 4];
+			pixel[0] = MathUtils::floatToHalf(color.r);
+			pixel[1] = MathUtils::floatToHalf(color.g);
+			pixel[2] = MathUtils::floatToHalf(color.b);
+			pixel[3] = MathUtils::floatToHalf(color.a);
+		} break;
+
+		case ImageFormat::RGB16F_A32F:
+		{
+			uint16_t* pixel = &halfData[index * 5];
+			float invWeight = (color.a != 0.0f) ? 1.0f / color.a : 0.0f;
+
+			pixel[0] = MathUtils::floatToHalf(color.r * invWeight);
+			pixel[1] = MathUtils::floatToHalf(color.g * invWeight);
+			pixel[2] = MathUtils::floatToHalf(color.b * invWeight);
+			memcpy(&pixel[3], &color.a, sizeof(float));
+		} break;
+
+		default: data[index] = color; break;
+	}
+}
+
 CUDA_CALLABLE void Image::setPixel(uint32_t x, uint32_t y, const Color& color)
 {
 #if (defined(__CUDA_ARCH__) && (__CUDA_ARCH__ > 0))
@@ -411,7 +724,7 @@ CUDA_CALLABLE void Image::setPixel(uint32_t x, uint32_t y, const Color& color)
 #else
 
 	assert(x < width && y < height);
-	data[y * width + x] = color;
+	encodePixel(y * width + x, color);
 
 #endif
 }
@@ -425,7 +738,7 @@ CUDA_CALLABLE void Image::setPixel(uint32_t index, const Color& color)
 #else
 
 	assert(index < length);
-	data[index] = color;
+	encodePixel(index, color);
 
 #endif
 }
@@ -434,6 +747,12 @@ CUDA_CALLABLE Color Image::getPixel(uint32_t x, uint32_t y) const
 {
 #if (defined(__CUDA_ARCH__) && (__CUDA_ARCH__ > 0))
 
+	if (format != ImageFormat::RGBA32F)
+	{
+		float4 color = tex2D<float4>(textureObject, (float(x) + 0.5f) / float(width), (float(y) + 0.5f) / float(height));
+		return Color(color.x, color.y, color.z, color.w);
+	}
+
 	float4 color;
 	surf2Dread(&color, surfaceObject, x * sizeof(float4), y);
 	return Color(color.x, color.y, color.z, color.w);
@@ -441,7 +760,7 @@ CUDA_CALLABLE Color Image::getPixel(uint32_t x, uint32_t y) const
 #else
 
 	assert(x < width && y < height);
-	return data[y * width + x];
+	return getPixel(y * width + x);
 
 #endif
 }
@@ -457,7 +776,15 @@ CUDA_CALLABLE Color Image::getPixel(uint32_t index) const
 #else
 
 	assert(index < length);
-	return data[index];
+
+	switch (format)
+	{
+		case ImageFormat::RGBA8: return decodePixel<ImageFormat::RGBA8>(index);
+		case ImageFormat::RGBA8_SRGB: return decodePixel<ImageFormat::RGBA8_SRGB>(index);
+		case ImageFormat::RGBA16F: return decodePixel<ImageFormat::RGBA16F>(index);
+		case ImageFormat::RGB16F_A32F: return decodePixel<ImageFormat::RGB16F_A32F>(index);
+		default: return data[index];
+	}
 
 #endif
 }
@@ -491,9 +818,6 @@ CUDA_CALLABLE Color Image::getPixelBilinear(float u, float v) const
 	tx2 = MathUtils::smoothstep(tx2);
 	ty2 = MathUtils::smoothstep(ty2);
 
-	float tx1 = 1.0f - tx2;
-	float ty1 = 1.0f - ty2;
-
 	uint32_t ix1 = ix + 1;
 	uint32_t iy1 = iy + 1;
 
@@ -503,13 +827,19 @@ CUDA_CALLABLE Color Image::getPixelBilinear(float u, float v) const
 	if (iy1 > height - 1)
 		iy1 = height - 1;
 
-	Color c11 = getPixel(ix, iy);
-	Color c21 = getPixel(ix1, iy);
-	Color c12 = getPixel(ix, iy1);
-	Color c22 = getPixel(ix1, iy1);
+	uint32_t index11 = iy * width + ix;
+	uint32_t index21 = iy * width + ix1;
+	uint32_t index12 = iy1 * width + ix;
+	uint32_t index22 = iy1 * width + ix1;
 
-	// bilinear interpolation
-	return (tx1 * c11 + tx2 * c21) * ty1 + (tx1 * c12 + tx2 * c22) * ty2;
+	switch (format)
+	{
+		case ImageFormat::RGBA8: return interpolateBilinear<ImageFormat::RGBA8>(index11, index21, index12, index22, tx2, ty2);
+		case ImageFormat::RGBA8_SRGB: return interpolateBilinear<ImageFormat::RGBA8_SRGB>(index11, index21, index12, index22, tx2, ty2);
+		case ImageFormat::RGBA16F: return interpolateBilinear<ImageFormat::RGBA16F>(index11, index21, index12, index22, tx2, ty2);
+		case ImageFormat::RGB16F_A32F: return interpolateBilinear<ImageFormat::RGB16F_A32F>(index11, index21, index12, index22, tx2, ty2);
+		default: return interpolateBilinear<ImageFormat::RGBA32F>(index11, index21, index12, index22, tx2, ty2);
+	}
 
 #endif
 }
@@ -573,17 +903,27 @@ CUDA_CALLABLE uint32_t Image::getLength() const
 	return length;
 }
 
+CUDA_CALLABLE ImageFormat Image::getFormat() const
+{
+	return format;
+}
+
+uint64_t Image::getMemoryUsage() const
+{
+	return uint64_t(length) * getPixelSize(format);
+}
+
 void Image::upload()
 {
 #ifdef USE_CUDA
-	CudaUtils::checkError(cudaMemcpyToArray(cudaData, 0, 0, data, length * sizeof(Color), cudaMemcpyHostToDevice), "Could not upload image to device");
+	CudaUtils::checkError(cudaMemcpyToArray(cudaData, 0, 0, getRawData(), length * getPixelSize(format), cudaMemcpyHostToDevice), "Could not upload image to device");
 #endif
 }
 
 void Image::download()
 {
 #ifdef USE_CUDA
-	CudaUtils::checkError(cudaMemcpyFromArray(data, cudaData, 0, 0, length * sizeof(Color), cudaMemcpyDeviceToHost), "Could not download image from device");
+	CudaUtils::checkError(cudaMemcpyFromArray(getRawData(), cudaData, 0, 0, length * getPixelSize(format), cudaMemcpyDeviceToHost), "Could not download image from device");
 #endif
 }
 
@@ -597,6 +937,23 @@ const Color* Image::getData() const
 	return data;
 }
 
+void* Image::getRawData()
+{
+	switch (format)
+	{
+		case ImageFormat::RGBA8:
+		case ImageFormat::RGBA8_SRGB: return packedData;
+		case ImageFormat::RGBA16F:
+		case ImageFormat::RGB16F_A32F: return halfData;
+		default: return data;
+	}
+}
+
+const void* Image::getRawData() const
+{
+	return const_cast<Image*>(this)->getRawData();
+}
+
 #ifdef USE_CUDA
 
 CUDA_CALLABLE cudaSurfaceObject_t Image::getSurfaceObject() const
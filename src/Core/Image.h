@@ -17,6 +17,15 @@
 
 Origin (0, 0) is at the bottom left corner.
 
+Pixels are stored as float RGBA by default. Read-only textures can be stored in a compact format
+that is decoded on the fly: RGBA8 (linear), RGBA8_SRGB (sRGB color, linear alpha) or RGBA16F (half).
+getData only works with the float format, getRawData returns the pixels in the storage format.
+clearRegion zeroes a rectangle of the host data in any format.
+
+RGB16F_A32F is meant for accumulation (10 bytes per pixel). It stores the color divided by alpha in half
+floats and alpha (the weight sum) as a float, and decodes back to the premultiplied color. Sums stored as
+half floats would stop growing or overflow after a few thousand samples, a mean never does.
+
 */
 
 namespace Valo
@@ -24,6 +33,8 @@ namespace Valo
 	enum class RendererType;
 	class Filter;
 
+	enum class ImageFormat { RGBA32F, RGBA8, RGBA8_SRGB, RGBA16F, RGB16F_A32F };
+
 	class Image
 	{
 	public:
@@ -32,24 +43,30 @@ namespace Valo
 		~Image();
 
 		Image(uint32_t width, uint32_t height);
+		Image(uint32_t width, uint32_t height, ImageFormat format);
 		Image(uint32_t width, uint32_t height, float* rgbaData);
 		Image(const std::string& fileName);
 		Image(const Image& other);
 
 		Image& operator=(const Image& other);
+		Image(Image&& other) noexcept;
+		Image& operator=(Image&& other) noexcept;
 
 		void load(uint32_t width, uint32_t height, float* rgbaData);
-		void load(const std::string& fileName);
+		void load(const std::string& fileName, ImageFormat format = ImageFormat::RGBA32F);
 		void save(const std::string& fileName, bool writeToLog = true) const;
 		void resize(uint32_t length);
 		void resize(uint32_t width, uint32_t height);
 		void clear(RendererType type);
 		void clear(const Color& color);
+		void clearRegion(uint32_t regionX, uint32_t regionY, uint32_t regionWidth, uint32_t regionHeight);
 
 		void applyGamma(float gamma);
 		void applyFastGamma(float gamma);
 		void swapComponents();
 		void fillWithTestPattern();
+		void downsample(const Image& source);
+		void setFormat(ImageFormat format);
 
 		CUDA_CALLABLE void setPixel(uint32_t x, uint32_t y, const Color& color);
 		CUDA_CALLABLE void setPixel(uint32_t index, const Color& color);
@@ -63,12 +80,16 @@ namespace Valo
 		CUDA_CALLABLE uint32_t getWidth() const;
 		CUDA_CALLABLE uint32_t getHeight() const;
 		CUDA_CALLABLE uint32_t getLength() const;
+		CUDA_CALLABLE ImageFormat getFormat() const;
+		uint64_t getMemoryUsage() const;
 
 		void upload();
 		void download();
 
 		Color* getData();
 		const Color* getData() const;
+		void* getRawData();
+		const void* getRawData() const;
 
 #ifdef USE_CUDA
 		CUDA_CALLABLE cudaSurfaceObject_t getSurfaceObject() const;
@@ -76,11 +97,22 @@ namespace Valo
 
 	private:
 
+		template <ImageFormat imageFormat>
+		Color decodePixel(uint32_t index) const;
+
+		template <ImageFormat imageFormat>
+		Color interpolateBilinear(uint32_t index11, uint32_t index21, uint32_t index12, uint32_t index22, float tx, float ty) const;
+
+		void encodePixel(uint32_t index, const Color& color);
+
 		uint32_t width = 0;
 		uint32_t height = 0;
 		uint32_t length = 0;
+		ImageFormat format = ImageFormat::RGBA32F;
 
 		Color* data = nullptr;
+		uint32_t* packedData = nullptr;
+		uint16_t* halfData = nullptr;
 
 #ifdef USE_CUDA
 		cudaArray* cudaData = nullptr;
@@ -3,37 +3,155 @@
 
 #include "Precompiled.h"
 
+#include <set>
+
+#include "App.h"
 #include "Core/ImagePool.h"
 #include "Core/Image.h"
+#include "Utils/Log.h"
+#include "Utils/StringUtils.h"
+#include "Utils/Timer.h"
 
 using namespace Valo;
 
 ImagePool::ImagePool() : imagesAlloc(true)
 {
-	// TODO: implement proper copy/move constructors for image to avoid this
-	images.reserve(1000);
 }
 
-uint32_t ImagePool::load(const std::string& fileName, bool applyGamma)
+uint32_t ImagePool::load(const std::string& fileName, bool applyGamma, bool generateMipmaps)
 {
 	if (!imagesMap.count(fileName))
 	{
-		images.emplace_back(fileName);
-		imagesMap[fileName] = uint32_t(images.size() - 1);
+		std::vector<Image> levels = loadLevels(fileName, applyGamma, generateMipmaps, compactStorage);
+		add(fileName, levels);
+	}
 
-		if (applyGamma)
-			images.back().applyFastGamma(2.2f);
+	return imagesMap[fileName];
+}
 
-		images.back().upload();
+// decodes the images concurrently, load calls with the same file names then return the already loaded images
+void ImagePool::preload(const std::vector<ImageLoadInfo>& infos)
+{
+	std::vector<ImageLoadInfo> newInfos;
+	std::set<std::string> fileNames;
+
+	for (const ImageLoadInfo& info : infos)
+	{
+		if (!imagesMap.count(info.fileName) && fileNames.insert(info.fileName).second)
+			newInfos.push_back(info);
 	}
 
-	return imagesMap[fileName];
+	if (newInfos.empty())
+		return;
+
+	Timer timer;
+	std::vector<std::vector<Image>> allLevels(newInfos.size());
+	std::vector<std::exception_ptr> exceptions(newInfos.size());
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int32_t i = 0; i < int32_t(newInfos.size()); ++i)
+	{
+		try
+		{
+			allLevels[i] = loadLevels(newInfos[i].fileName, newInfos[i].applyGamma, newInfos[i].generateMipmaps, compactStorage);
+		}
+		catch (...)
+		{
+			exceptions[i] = std::current_exception();
+		}
+	}
+
+	for (const std::exception_ptr& exception : exceptions)
+	{
+		if (exception != nullptr)
+			std::rethrow_exception(exception);
+	}
+
+	for (uint32_t i = 0; i < newInfos.size(); ++i)
+		add(newInfos[i].fileName, allLevels[i]);
+
+	App::getLog().logInfo("Images loaded (time: %s, images: %d)", timer.getElapsed().getString(true), newInfos.size());
+}
+
+uint32_t ImagePool::getMipLevelCount(uint32_t index) const
+{
+	return mipLevelCounts[index];
+}
+
+uint32_t ImagePool::getWidth(uint32_t index) const
+{
+	return images[index].getWidth();
+}
+
+uint32_t ImagePool::getHeight(uint32_t index) const
+{
+	return images[index].getHeight();
+}
+
+std::vector<Image> ImagePool::loadLevels(const std::string& fileName, bool applyGamma, bool generateMipmaps, bool compactStorage)
+{
+	std::vector<Image> levels(1);
+	loadImage(levels[0], fileName, applyGamma, compactStorage);
+
+	if (generateMipmaps)
+	{
+		while (levels.back().getWidth() > 1 || levels.back().getHeight() > 1)
+		{
+			levels.emplace_back();
+			levels.back().downsample(levels[levels.size() - 2]);
+		}
+	}
+
+	return levels;
+}
+
+void ImagePool::loadImage(Image& image, const std::string& fileName, bool applyGamma, bool compactStorage)
+{
+	ImageFormat format = ImageFormat::RGBA32F;
+
+	if (compactStorage && StringUtils::endsWith(fileName, ".hdr"))
+		format = ImageFormat::RGBA16F;
+	else if (compactStorage && !StringUtils::endsWith(fileName, ".bin"))
+		format = applyGamma ? ImageFormat::RGBA8_SRGB : ImageFormat::RGBA8;
+
+	// sRGB textures are decoded with a lookup table, everything else gets the gamma applied at load time
+	if (applyGamma && format != ImageFormat::RGBA8_SRGB)
+	{
+		image.load(fileName);
+		image.applyFastGamma(2.2f);
+		image.setFormat(format);
+	}
+	else
+		image.load(fileName, format);
+}
+
+// mip levels are stored right after the base level
+void ImagePool::add(const std::string& fileName, std::vector<Image>& levels)
+{
+	uint32_t index = uint32_t(images.size());
+	imagesMap[fileName] = index;
+
+	for (Image& level : levels)
+	{
+		level.upload();
+		images.push_back(std::move(level));
+	}
+
+	mipLevelCounts.resize(images.size(), 0);
+	mipLevelCounts[index] = uint32_t(levels.size());
 }
 
 void ImagePool::commit()
 {
 	if (images.size() > 0)
 	{
+		uint64_t memoryUsage = 0;
+
+		for (const Image& image : images)
+			memoryUsage += image.getMemoryUsage();
+
+		App::getLog().logInfo("Image pool: %d images (memory: %sB)", images.size(), StringUtils::humanizeNumber(double(memoryUsage), true));
+
 		imagesAlloc.resize(images.size());
 		imagesAlloc.write(images.data(), images.size());
 	}
@@ -13,21 +13,41 @@
 
 namespace Valo
 {
+	struct ImageLoadInfo
+	{
+		std::string fileName;
+		bool applyGamma = false;
+		bool generateMipmaps = false;
+	};
+
 	class ImagePool
 	{
 	public:
 
 		ImagePool();
 
-		uint32_t load(const std::string& fileName, bool applyGamma);
+		uint32_t load(const std::string& fileName, bool applyGamma, bool generateMipmaps = false);
+		void preload(const std::vector<ImageLoadInfo>& infos);
 		void commit();
+
+		uint32_t getMipLevelCount(uint32_t index) const;
+		uint32_t getWidth(uint32_t index) const;
+		uint32_t getHeight(uint32_t index) const;
 		
 		CUDA_CALLABLE Image* getImages() const;
 		CUDA_CALLABLE Image& getImage(uint32_t index) const;
 
+		static std::vector<Image> loadLevels(const std::string& fileName, bool applyGamma, bool generateMipmaps, bool compactStorage);
+		static void loadImage(Image& image, const std::string& fileName, bool applyGamma, bool compactStorage);
+
+		bool compactStorage = true; // keep textures in 8-bit or half precision
+
 	private:
 
+		void add(const std::string& fileName, std::vector<Image>& levels);
+
 		std::vector<Image> images;
+		std::vector<uint32_t> mipLevelCounts;
 		std::map<std::string, uint32_t> imagesMap;
 
 		CudaAlloc<Image> imagesAlloc;
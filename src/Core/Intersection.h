@@ -22,6 +22,8 @@ namespace Valo
 
 		float distance = FLT_MAX;
 		float area = 0.0f;
+		float coneWidth = 0.0f;
+		float texcoordFootprint = 0.0f;
 
 		Vector3 position;
 		Vector3 normal;
@@ -23,6 +23,10 @@ namespace Valo
 		float minDistance = 0.0f;
 		float maxDistance = FLT_MAX;
 
+		// ray cone for texture filtering, width at the origin and spread angle in radians
+		float coneWidth = 0.0f;
+		float coneSpread = 0.0f;
+
 		bool isVisibilityRay = false;
 		bool isPrimaryRay = false;
 		bool directionIsNegative[3];
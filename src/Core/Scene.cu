@@ -6,19 +6,148 @@
 
 #include "Precompiled.h"
 
+#include <iterator>
+#include <unordered_map>
+
 #include "tinyformat/tinyformat.h"
 
 #include "App.h"
+#include "Core/AABB.h"
 #include "Core/Common.h"
 #include "Core/Intersection.h"
 #include "Core/Scene.h"
+#include "Renderers/Renderer.h"
 #include "Textures/Texture.h"
 #include "Utils/Log.h"
+#include "Utils/Settings.h"
+#include "Utils/StringUtils.h"
 #include "Utils/Timer.h"
 
 using namespace Valo;
 
-Scene::Scene() : texturesAlloc(false), materialsAlloc(false), trianglesAlloc(false), emissiveTrianglesAlloc(false)
+namespace
+{
+	const uint32_t NOT_FOUND = 0xffffffff;
+
+	// maps object ids to array indices, a flat table is used unless the ids are very sparse
+	class IdMap
+	{
+	public:
+
+		template <typename T>
+		explicit IdMap(const std::vector<T>& objects)
+		{
+			if (objects.empty())
+				return;
+
+			uint32_t maxId = objects[0].id;
+			minId = objects[0].id;
+
+			for (const T& object : objects)
+			{
+				minId = MIN(minId, object.id);
+				maxId = MAX(maxId, object.id);
+			}
+
+			uint64_t range = uint64_t(maxId) - uint64_t(minId) + 1;
+			flat = range <= 16 * uint64_t(objects.size()) + 4096;
+
+			if (flat)
+				table.assign(size_t(range), NOT_FOUND);
+			else
+				sparseTable.reserve(objects.size());
+		}
+
+		bool insert(uint32_t id, uint32_t index)
+		{
+			if (!flat)
+				return sparseTable.emplace(id, index).second;
+
+			uint32_t& entry = table[id - minId];
+
+			if (entry != NOT_FOUND)
+				return false;
+
+			entry = index;
+			return true;
+		}
+
+		uint32_t find(uint32_t id) const
+		{
+			if (!flat)
+			{
+				auto it = sparseTable.find(id);
+				return (it != sparseTable.end()) ? it->second : NOT_FOUND;
+			}
+
+			if (id < minId || id - minId >= table.size())
+				return NOT_FOUND;
+
+			return table[id - minId];
+		}
+
+		void resolve(uint32_t id, int32_t& index) const
+		{
+			uint32_t foundIndex = find(id);
+
+			if (foundIndex != NOT_FOUND)
+				index = int32_t(foundIndex);
+		}
+
+	private:
+
+		bool flat = true;
+		uint32_t minId = 0;
+		std::vector<uint32_t> table;
+		std::unordered_map<uint32_t, uint32_t> sparseTable;
+	};
+
+	// keeps the triangle order, every block is counted and then filled in parallel
+	std::vector<uint32_t> gatherEmissiveTriangles(const std::vector<Triangle>& triangles, const std::vector<Material>& materials)
+	{
+		const int64_t BLOCK_SIZE = 65536;
+
+		std::vector<uint8_t> emissiveMaterials(materials.size());
+
+		for (size_t i = 0; i < materials.size(); ++i)
+			emissiveMaterials[i] = materials[i].isEmissive();
+
+		int64_t triangleCount = int64_t(triangles.size());
+		int64_t blockCount = (triangleCount + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		std::vector<uint32_t> blockOffsets(blockCount + 1, 0);
+
+		#pragma omp parallel for
+		for (int64_t block = 0; block < blockCount; ++block)
+		{
+			int64_t end = MIN(triangleCount, (block + 1) * BLOCK_SIZE);
+
+			for (int64_t i = block * BLOCK_SIZE; i < end; ++i)
+				blockOffsets[block + 1] += emissiveMaterials[triangles[i].materialIndex];
+		}
+
+		for (int64_t block = 0; block < blockCount; ++block)
+			blockOffsets[block + 1] += blockOffsets[block];
+
+		std::vector<uint32_t> emissiveTriangles(blockOffsets[blockCount]);
+
+		#pragma omp parallel for
+		for (int64_t block = 0; block < blockCount; ++block)
+		{
+			int64_t end = MIN(triangleCount, (block + 1) * BLOCK_SIZE);
+			uint32_t offset = blockOffsets[block];
+
+			for (int64_t i = block * BLOCK_SIZE; i < end; ++i)
+			{
+				if (emissiveMaterials[triangles[i].materialIndex])
+					emissiveTriangles[offset++] = uint32_t(i);
+			}
+		}
+
+		return emissiveTriangles;
+	}
+}
+
+Scene::Scene() : texturesAlloc(false), materialsAlloc(false), verticesAlloc(false), trianglesAlloc(false), emissiveTrianglesAlloc(false)
 {
 }
 
@@ -29,41 +158,142 @@ void Scene::initialize()
 
 	Timer timer;
 
+	// a loaded snapshot already has its models loaded, indices resolved and the geometry built
+	if (!snapshotLoaded)
+		loadModels();
+
+	// TEXTURE INITIALIZATION
+
+	if (!textureCache.enabled)
+	{
+		std::vector<ImageLoadInfo> imageLoadInfos;
+
+		for (const Texture& texture : allTextures)
+		{
+			if (texture.type != TextureType::IMAGE)
+				continue;
+
+			ImageLoadInfo info;
+			info.fileName = texture.imageTexture.imageFileName;
+			info.applyGamma = texture.imageTexture.applyGamma;
+			info.generateMipmaps = texture.imageTexture.generateMipmaps;
+			imageLoadInfos.push_back(info);
+		}
+
+		imagePool.preload(imageLoadInfos);
+	}
+
+	for (Texture& texture : allTextures)
+		texture.initialize(*this);
+
+	if (!snapshotLoaded)
+		buildGeometry();
+
+	// MEMORY ALLOC & WRITE
+
+	if (allTextures.size() > 0)
+	{
+		texturesAlloc.resize(allTextures.size());
+		texturesAlloc.write(allTextures.data(), allTextures.size());
+	}
+	
+	if (allMaterials.size() > 0)
+	{
+		materialsAlloc.resize(allMaterials.size());
+		materialsAlloc.write(allMaterials.data(), allMaterials.size());
+	}
+
+	// MISC
+
+	camera.initialize();
+	imagePool.commit();
+	volume.noiseDensity.initialize(volume.noiseSeed);
+
+	// VOLUME DENSITY
+
+	if (volume.enabled && !volume.constant && volume.useDensityGrid && verticesAlloc.getCount() > 0)
+	{
+		const CompactVertex* vertices = verticesAlloc.getHostPtr();
+		AABB bounds = AABB::createFromMinMax(vertices[0].position, vertices[0].position);
+
+		for (size_t i = 0; i < verticesAlloc.getCount(); ++i)
+			bounds.expand(AABB::createFromMinMax(vertices[i].position, vertices[i].position));
+
+		if (volume.densityGrid.voxelSize == 0.0f)
+			volume.densityGrid.voxelSize = 0.125f / volume.noiseScale;
+
+		volume.densityGrid.bake(bounds, [this](const Vector3& position)
+		{
+			return volume.noiseDensity.getNoise(position * volume.noiseScale);
+		});
+	}
+
+	log.logInfo("Scene initialization finished (time: %s)", timer.getElapsed().getString(true));
+}
+
+void Scene::loadModels()
+{
 	allTextures.insert(allTextures.end(), textures.begin(), textures.end());
 	allMaterials.insert(allMaterials.end(), materials.begin(), materials.end());
-	allTriangles.insert(allTriangles.end(), triangles.begin(), triangles.end());
 
 	// MODEL LOADING
 
+	std::vector<ModelLoaderResult> results;
+
 	if (!models.empty())
 	{
 		ModelLoader modelLoader;
+		results.reserve(models.size());
 
 		for (ModelLoaderInfo& modelInfo : models)
-		{
-			ModelLoaderResult result = modelLoader.load(modelInfo);
+			results.push_back(modelLoader.load(modelInfo));
+	}
+
+	size_t triangleCount = allTriangles.size() + triangles.size();
 
-			allTextures.insert(allTextures.end(), result.textures.begin(), result.textures.end());
-			allMaterials.insert(allMaterials.end(), result.materials.begin(), result.materials.end());
+	for (const ModelLoaderResult& result : results)
+		triangleCount += result.triangles.size();
+
+	// a single model is moved as is, otherwise the results are released one by one after appending
+	if (allTriangles.empty() && triangles.empty() && results.size() == 1)
+		allTriangles = std::move(results[0].triangles);
+	else
+	{
+		allTriangles.reserve(triangleCount);
+		allTriangles.insert(allTriangles.end(), triangles.begin(), triangles.end());
+
+		for (ModelLoaderResult& result : results)
+		{
 			allTriangles.insert(allTriangles.end(), result.triangles.begin(), result.triangles.end());
+			std::vector<Triangle>().swap(result.triangles);
 		}
 	}
 
+	for (ModelLoaderResult& result : results)
+	{
+		allTextures.insert(allTextures.end(), std::make_move_iterator(result.textures.begin()), std::make_move_iterator(result.textures.end()));
+		allMaterials.insert(allMaterials.end(), std::make_move_iterator(result.materials.begin()), std::make_move_iterator(result.materials.end()));
+	}
+
+	results.clear();
+}
+
+void Scene::buildGeometry()
+{
+	Log& log = App::getLog();
+
 	// INDEX ASSIGNMENT & INITIALIZATION
 
-	std::map<uint32_t, uint32_t> texturesMap;
-	std::map<uint32_t, uint32_t> materialsMap;
+	IdMap texturesMap(allTextures);
+	IdMap materialsMap(allMaterials);
 
 	for (uint32_t i = 0; i < allTextures.size(); ++i)
 	{
 		if (allTextures[i].id == 0)
 			throw std::runtime_error(tfm::format("A texture must have a non-zero id"));
 
-		if (texturesMap.count(allTextures[i].id))
-			throw std::runtime_error(tfm::format("A duplicate texture id was found (id: %s, type: %s)", allTextures[i].id));
-
-		texturesMap[allTextures[i].id] = i;
-		allTextures[i].initialize(*this);
+		if (!texturesMap.insert(allTextures[i].id, i))
+			throw std::runtime_error(tfm::format("A duplicate texture id was found (id: %s)", allTextures[i].id));
 	}
 
 	for (uint32_t i = 0; i < allMaterials.size(); ++i)
@@ -71,67 +301,75 @@ void Scene::initialize()
 		if (allMaterials[i].id == 0)
 			throw std::runtime_error(tfm::format("A material must have a non-zero id"));
 
-		if (materialsMap.count(allMaterials[i].id))
+		if (!materialsMap.insert(allMaterials[i].id, i))
 			throw std::runtime_error(tfm::format("A duplicate material id was found (id: %s)", allMaterials[i].id));
 
-		materialsMap[allMaterials[i].id] = i;
-
-		if (texturesMap.count(allMaterials[i].emittanceTextureId))
-			allMaterials[i].emittanceTextureIndex = texturesMap[allMaterials[i].emittanceTextureId];
-
-		if (texturesMap.count(allMaterials[i].reflectanceTextureId))
-			allMaterials[i].reflectanceTextureIndex = texturesMap[allMaterials[i].reflectanceTextureId];
+		texturesMap.resolve(allMaterials[i].emittanceTextureId, allMaterials[i].emittanceTextureIndex);
+		texturesMap.resolve(allMaterials[i].reflectanceTextureId, allMaterials[i].reflectanceTextureIndex);
+		texturesMap.resolve(allMaterials[i].normalTextureId, allMaterials[i].normalTextureIndex);
+		texturesMap.resolve(allMaterials[i].maskTextureId, allMaterials[i].maskTextureIndex);
+		texturesMap.resolve(allMaterials[i].blinnPhongMaterial.specularReflectanceTextureId, allMaterials[i].blinnPhongMaterial.specularReflectanceTextureIndex);
+		texturesMap.resolve(allMaterials[i].blinnPhongMaterial.glossinessTextureId, allMaterials[i].blinnPhongMaterial.glossinessTextureIndex);
+	}
 
-		if (texturesMap.count(allMaterials[i].normalTextureId))
-			allMaterials[i].normalTextureIndex = texturesMap[allMaterials[i].normalTextureId];
+	int64_t invalidTriangleIndex = int64_t(allTriangles.size());
 
-		if (texturesMap.count(allMaterials[i].maskTextureId))
-			allMaterials[i].maskTextureIndex = texturesMap[allMaterials[i].maskTextureId];
+	#pragma omp parallel for
+	for (int64_t i = 0; i < int64_t(allTriangles.size()); ++i)
+	{
+		Triangle& triangle = allTriangles[i];
+		triangle.materialIndex = materialsMap.find(triangle.materialId);
 
-		if (texturesMap.count(allMaterials[i].blinnPhongMaterial.specularReflectanceTextureId))
-			allMaterials[i].blinnPhongMaterial.specularReflectanceTextureIndex = texturesMap[allMaterials[i].blinnPhongMaterial.specularReflectanceTextureId];
+		if (triangle.materialIndex == NOT_FOUND)
+		{
+			#pragma omp critical
+			invalidTriangleIndex = MIN(invalidTriangleIndex, i);
 
-		if (texturesMap.count(allMaterials[i].blinnPhongMaterial.glossinessTextureId))
-			allMaterials[i].blinnPhongMaterial.glossinessTextureIndex = texturesMap[allMaterials[i].blinnPhongMaterial.glossinessTextureId];
-	}
+			continue;
+		}
 
-	for (Triangle& triangle : allTriangles)
-	{
-		if (materialsMap.count(triangle.materialId))
-			triangle.materialIndex = materialsMap[triangle.materialId];
-		else
-			throw std::runtime_error(tfm::format("A triangle has a non-existent material id (%d)", triangle.materialId));
-		
 		triangle.initialize();
-
-		if (allMaterials[triangle.materialIndex].isEmissive())
-			emissiveTriangles.push_back(triangle);
 	}
 
+	if (invalidTriangleIndex < int64_t(allTriangles.size()))
+		throw std::runtime_error(tfm::format("A triangle has a non-existent material id (%d)", allTriangles[invalidTriangleIndex].materialId));
+
 	// BVH BUILD
 
 	bvh.build(allTriangles);
 
-	// MEMORY ALLOC & WRITE
+	// the BVH build reorders the triangles, so the emissive indices are gathered only after it
+	std::vector<uint32_t> emissiveTriangles = gatherEmissiveTriangles(allTriangles, allMaterials);
 
-	if (allTextures.size() > 0)
+	// COMPACT GEOMETRY
+
+	// the compact triangles are written directly to their final buffer
+	std::vector<CompactVertex> compactVertices;
+	uint32_t compactTriangleCount = uint32_t(allTriangles.size());
+
+	if (compactTriangleCount > 0)
 	{
-		texturesAlloc.resize(allTextures.size());
-		texturesAlloc.write(allTextures.data(), allTextures.size());
+		trianglesAlloc.resize(compactTriangleCount);
+		Triangle::compact(allTriangles, compactVertices, trianglesAlloc.getHostPtr());
+		trianglesAlloc.write(compactTriangleCount);
 	}
-	
-	if (allMaterials.size() > 0)
-	{
-		materialsAlloc.resize(allMaterials.size());
-		materialsAlloc.write(allMaterials.data(), allMaterials.size());
-	}
-	
-	if (allTriangles.size() > 0)
+
+	// the full triangles are only needed for loading and the BVH build
+	std::vector<Triangle>().swap(allTriangles);
+
+	uint32_t compactVertexCount = uint32_t(compactVertices.size());
+
+	if (compactVertexCount > 0)
 	{
-		trianglesAlloc.resize(allTriangles.size());
-		trianglesAlloc.write(allTriangles.data(), allTriangles.size());
+		verticesAlloc.resize(compactVertexCount);
+		verticesAlloc.write(compactVertices.data(), compactVertexCount);
 	}
-	
+
+	std::vector<CompactVertex>().swap(compactVertices);
+
+	uint64_t geometrySize = uint64_t(compactVertexCount) * sizeof(CompactVertex) + uint64_t(compactTriangleCount) * sizeof(CompactTriangle);
+	log.logInfo("Geometry compacted (vertices: %s, triangles: %s, memory: %sB)", StringUtils::humanizeNumber(double(compactVertexCount), false), StringUtils::humanizeNumber(double(compactTriangleCount), false), StringUtils::humanizeNumber(double(geometrySize), true));
+
 	if (emissiveTriangles.size() > 0)
 	{
 		emissiveTrianglesAlloc.resize(emissiveTriangles.size());
@@ -139,14 +377,74 @@ void Scene::initialize()
 	}
 
 	emissiveTrianglesCount = uint32_t(emissiveTriangles.size());
-	
-	// MISC
+}
 
-	camera.initialize();
-	imagePool.commit();
-	volume.noiseDensity.initialize(volume.noiseSeed);
+namespace
+{
+	// FNV-1a
+	void hashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
 
-	log.logInfo("Scene initialization finished (time: %s)", timer.getElapsed().getString(true));
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	template <typename T>
+	void hashValue(uint64_t& hash, const T& value)
+	{
+		hashBytes(hash, &value, sizeof(T));
+	}
+}
+
+// the texture cache is only used by the CPU renderer
+void Scene::configureTextureCache(const Settings& settings)
+{
+	textureCache.enabled = settings.scene.textureCache && RendererType(settings.renderer.type) == RendererType::CPU;
+	textureCache.maxMemoryUsage = settings.scene.textureCacheSize;
+	textureCache.cacheDirName = settings.scene.textureCacheDirName;
+}
+
+uint64_t Scene::getHash() const
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	hashValue(hash, camera.type);
+	hashValue(hash, camera.position);
+	hashValue(hash, camera.orientation);
+	hashValue(hash, camera.fov);
+	hashValue(hash, camera.orthoSize);
+	hashValue(hash, camera.fishEyeAngle);
+	hashValue(hash, camera.apertureSize);
+	hashValue(hash, camera.focalDistance);
+	hashValue(hash, camera.depthOfField);
+	hashValue(hash, integrator.type);
+
+	uint64_t vertexCount = verticesAlloc.getCount();
+	uint64_t triangleCount = trianglesAlloc.getCount();
+	uint64_t materialCount = materialsAlloc.getCount();
+	uint64_t textureCount = texturesAlloc.getCount();
+
+	hashValue(hash, vertexCount);
+	hashValue(hash, triangleCount);
+	hashValue(hash, materialCount);
+	hashValue(hash, textureCount);
+
+	// a sparse sample of the vertex positions is enough to tell scenes apart
+	if (vertexCount > 0)
+	{
+		const CompactVertex* vertices = verticesAlloc.getHostPtr();
+		uint64_t step = MAX(uint64_t(1), vertexCount / 4096);
+
+		for (uint64_t i = 0; i < vertexCount; i += step)
+			hashValue(hash, vertices[i].position);
+	}
+
+	// zero is reserved for unknown
+	return (hash != 0) ? hash : 1;
 }
 
 CUDA_CALLABLE bool Scene::intersect(const Ray& ray, Intersection& intersection) const
@@ -162,7 +460,7 @@ CUDA_CALLABLE void Scene::calculateNormalMapping(Intersection& intersection) con
 		return;
 
 	const Texture& normalTexture = getTexture(material.normalTextureIndex);
-	Color normalColor = normalTexture.getColor(*this, intersection.texcoord, intersection.position);
+	Color normalColor = normalTexture.getColor(*this, intersection.texcoord, intersection.position, intersection.texcoordFootprint);
 	Vector3 normal(normalColor.r * 2.0f - 1.0f, normalColor.g * 2.0f - 1.0f, normalColor.b * 2.0f - 1.0f);
 	Vector3 mappedNormal = intersection.onb.u * normal.x + intersection.onb.v * normal.y + intersection.onb.w * normal.z;
 	intersection.normal = mappedNormal.normalized();
@@ -178,12 +476,17 @@ CUDA_CALLABLE const Material* Scene::getMaterials() const
 	return materialsAlloc.getPtr();
 }
 
-CUDA_CALLABLE const Triangle* Scene::getTriangles() const
+CUDA_CALLABLE const CompactVertex* Scene::getVertices() const
+{
+	return verticesAlloc.getPtr();
+}
+
+CUDA_CALLABLE const CompactTriangle* Scene::getTriangles() const
 {
 	return trianglesAlloc.getPtr();
 }
 
-CUDA_CALLABLE const Triangle* Scene::getEmissiveTriangles() const
+CUDA_CALLABLE const uint32_t* Scene::getEmissiveTriangleIndices() const
 {
 	return emissiveTrianglesAlloc.getPtr();
 }
@@ -203,7 +506,12 @@ CUDA_CALLABLE const Material& Scene::getMaterial(uint32_t index) const
 	return materialsAlloc.getPtr()[index];
 }
 
-CUDA_CALLABLE const Triangle& Scene::getTriangle(uint32_t index) const
+CUDA_CALLABLE const CompactVertex& Scene::getVertex(uint32_t index) const
+{
+	return verticesAlloc.getPtr()[index];
+}
+
+CUDA_CALLABLE const CompactTriangle& Scene::getTriangle(uint32_t index) const
 {
 	return trianglesAlloc.getPtr()[index];
 }
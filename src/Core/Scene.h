@@ -4,6 +4,7 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 #include <vector>
 
 #include "BVH/BVH.h"
@@ -15,12 +16,31 @@
 #include "Integrators/Integrator.h"
 #include "Materials/Material.h"
 #include "Math/Color.h"
+#include "Math/Sampler.h"
 #include "Textures/Texture.h"
 #include "Tonemappers/Tonemapper.h"
+#include "Utils/DensityGrid.h"
 #include "Utils/ModelLoader.h"
+#include "Utils/TextureCache.h"
+
+/*
+
+Scenes are loaded and saved based on the file extension:
+
+.xml/.json: human-readable scene description (settings, models, textures, materials and triangles)
+.bin: binary snapshot of an initialized scene (settings, resolved textures and materials,
+compact geometry and the BVH). Initializing a loaded snapshot skips the model loading, index
+resolution and BVH building. Image files are still loaded from their original paths.
+The geometry and the BVH are written as raw host-endian structs, so a snapshot can only be
+loaded on a machine with the same byte order and struct layout as the one that wrote it (a
+byte order marker is checked on load).
+
+*/
 
 namespace Valo
 {
+	class Settings;
+
 	class Scene
 	{
 	public:
@@ -28,19 +48,25 @@ namespace Valo
 		Scene();
 
 		void initialize();
+		void load(const std::string& fileName);
+		void save(const std::string& fileName) const;
+		void configureTextureCache(const Settings& settings);
+		uint64_t getHash() const;
 
 		CUDA_CALLABLE bool intersect(const Ray& ray, Intersection& intersection) const;
 		CUDA_CALLABLE void calculateNormalMapping(Intersection& intersection) const;
 
 		CUDA_CALLABLE const Texture* getTextures() const;
 		CUDA_CALLABLE const Material* getMaterials() const;
-		CUDA_CALLABLE const Triangle* getTriangles() const;
-		CUDA_CALLABLE const Triangle* getEmissiveTriangles() const;
+		CUDA_CALLABLE const CompactVertex* getVertices() const;
+		CUDA_CALLABLE const CompactTriangle* getTriangles() const;
+		CUDA_CALLABLE const uint32_t* getEmissiveTriangleIndices() const;
 		CUDA_CALLABLE uint32_t getEmissiveTrianglesCount() const;
 
 		CUDA_CALLABLE const Texture& getTexture(uint32_t index) const;
 		CUDA_CALLABLE const Material& getMaterial(uint32_t index) const;
-		CUDA_CALLABLE const Triangle& getTriangle(uint32_t index) const;
+		CUDA_CALLABLE const CompactVertex& getVertex(uint32_t index) const;
+		CUDA_CALLABLE const CompactTriangle& getTriangle(uint32_t index) const;
 
 		struct General
 		{
@@ -58,6 +84,7 @@ namespace Valo
 		{
 			bool filtering = true;
 			Filter filter;
+			SamplerType samplerType = SamplerType::SOBOL;
 
 		} renderer;
 
@@ -78,6 +105,8 @@ namespace Valo
 			PerlinNoise noiseDensity;
 			uint32_t noiseSeed = 1;
 			float noiseScale = 1.0f;
+			bool useDensityGrid = true;
+			DensityGrid densityGrid;
 
 		} volume;
 
@@ -86,6 +115,7 @@ namespace Valo
 		Tonemapper tonemapper;
 		BVH bvh;
 		ImagePool imagePool;
+		TextureCache textureCache;
 
 		std::vector<ModelLoaderInfo> models;
 		std::vector<Texture> textures;
@@ -94,15 +124,22 @@ namespace Valo
 
 	private:
 
+		void loadModels();
+		void buildGeometry();
+		void loadSnapshot(const std::string& fileName);
+		void saveSnapshot(const std::string& fileName) const;
+
+		bool snapshotLoaded = false;
+
 		std::vector<Texture> allTextures;
 		std::vector<Material> allMaterials;
 		std::vector<Triangle> allTriangles;
-		std::vector<Triangle> emissiveTriangles;
 
 		CudaAlloc<Texture> texturesAlloc;
 		CudaAlloc<Material> materialsAlloc;
-		CudaAlloc<Triangle> trianglesAlloc;
-		CudaAlloc<Triangle> emissiveTrianglesAlloc;
+		CudaAlloc<CompactVertex> verticesAlloc;
+		CudaAlloc<CompactTriangle> trianglesAlloc;
+		CudaAlloc<uint32_t> emissiveTrianglesAlloc;
 		uint32_t emissiveTrianglesCount = 0;	
 	};
 }
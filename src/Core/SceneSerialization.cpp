@@ -0,0 +1,399 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include "cereal/cereal.hpp"
+#include "cereal/archives/json.hpp"
+#include "cereal/archives/portable_binary.hpp"
+#include "cereal/archives/xml.hpp"
+#include "cereal/types/string.hpp"
+#include "cereal/types/vector.hpp"
+
+#include "tinyformat/tinyformat.h"
+
+#include "App.h"
+#include "Core/Scene.h"
+#include "Utils/Log.h"
+#include "Utils/StringUtils.h"
+#include "Utils/Timer.h"
+
+using namespace Valo;
+
+#define NVP(name, value) cereal::make_nvp(name, value)
+
+namespace Valo
+{
+	template <typename Archive>
+	void serialize(Archive& a, Vector2& v)
+	{
+		a(NVP("x", v.x), NVP("y", v.y));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, Vector3& v)
+	{
+		a(NVP("x", v.x), NVP("y", v.y), NVP("z", v.z));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, EulerAngle& e)
+	{
+		a(NVP("pitch", e.pitch), NVP("yaw", e.yaw), NVP("roll", e.roll));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, Color& c)
+	{
+		a(NVP("r", c.r), NVP("g", c.g), NVP("b", c.b), NVP("a", c.a));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, Scene::General& g)
+	{
+		a(NVP("rayMinDistance", g.rayMinDistance),
+			NVP("backgroundColor", g.backgroundColor),
+			NVP("offLensColor", g.offLensColor),
+			NVP("normalMapping", g.normalMapping),
+			NVP("normalInterpolation", g.normalInterpolation),
+			NVP("normalVisualization", g.normalVisualization),
+			NVP("interpolationVisualization", g.interpolationVisualization));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, Scene::Renderer& r)
+	{
+		a(NVP("filtering", r.filtering),
+			NVP("filterType", r.filter.type),
+			NVP("samplerType", r.samplerType));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, Scene::Volume& v)
+	{
+		a(NVP("enabled", v.enabled),
+			NVP("attenuation", v.attenuation),
+			NVP("emission", v.emission),
+			NVP("inscatter", v.inscatter),
+			NVP("attenuationColor", v.attenuationColor),
+			NVP("emissionColor", v.emissionColor),
+			NVP("inscatterColor", v.inscatterColor),
+			NVP("attenuationFactor", v.attenuationFactor),
+			NVP("emissionFactor", v.emissionFactor),
+			NVP("inscatterFactor", v.inscatterFactor),
+			NVP("stepSize", v.stepSize),
+			NVP("constant", v.constant),
+			NVP("noiseSeed", v.noiseSeed),
+			NVP("noiseScale", v.noiseScale),
+			NVP("useDensityGrid", v.useDensityGrid),
+			NVP("densityGridVoxelSize", v.densityGrid.voxelSize),
+			NVP("densityGridMaxMemoryUsage", v.densityGrid.maxMemoryUsage),
+			NVP("densityGridUniformThreshold", v.densityGrid.uniformThreshold));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, Camera& c)
+	{
+		a(NVP("type", c.type),
+			NVP("position", c.position),
+			NVP("orientation", c.orientation),
+			NVP("fov", c.fov),
+			NVP("orthoSize", c.orthoSize),
+			NVP("fishEyeAngle", c.fishEyeAngle),
+			NVP("apertureSize", c.apertureSize),
+			NVP("focalDistance", c.focalDistance),
+			NVP("vignettePower", c.vignettePower),
+			NVP("vignetteOffset", c.vignetteOffset),
+			NVP("moveSpeed", c.moveSpeed),
+			NVP("mouseSpeed", c.mouseSpeed),
+			NVP("moveDrag", c.moveDrag),
+			NVP("mouseDrag", c.mouseDrag),
+			NVP("autoStopSpeed", c.autoStopSpeed),
+			NVP("slowSpeedModifier", c.slowSpeedModifier),
+			NVP("fastSpeedModifier", c.fastSpeedModifier),
+			NVP("veryFastSpeedModifier", c.veryFastSpeedModifier),
+			NVP("depthOfField", c.depthOfField),
+			NVP("vignette", c.vignette),
+			NVP("enableMovement", c.enableMovement),
+			NVP("smoothMovement", c.smoothMovement),
+			NVP("freeLook", c.freeLook));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, Integrator& i)
+	{
+		a(NVP("type", i.type),
+			NVP("pathMinPathLength", i.pathIntegrator.minPathLength),
+			NVP("pathMaxPathLength", i.pathIntegrator.maxPathLength),
+			NVP("pathTerminationProbability", i.pathIntegrator.terminationProbability),
+			NVP("dotUseReflectance", i.dotIntegrator.useReflectance),
+			NVP("aoMaxDistance", i.aoIntegrator.maxDistance),
+			NVP("aoUseReflectance", i.aoIntegrator.useReflectance));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, Tonemapper& t)
+	{
+		a(NVP("type", t.type),
+			NVP("linearApplyGamma", t.linearTonemapper.applyGamma),
+			NVP("linearShouldClamp", t.linearTonemapper.shouldClamp),
+			NVP("linearGamma", t.linearTonemapper.gamma),
+			NVP("linearExposure", t.linearTonemapper.exposure),
+			NVP("simpleApplyGamma", t.simpleTonemapper.applyGamma),
+			NVP("simpleShouldClamp", t.simpleTonemapper.shouldClamp),
+			NVP("simpleGamma", t.simpleTonemapper.gamma),
+			NVP("simpleExposure", t.simpleTonemapper.exposure),
+			NVP("reinhardApplyGamma", t.reinhardTonemapper.applyGamma),
+			NVP("reinhardShouldClamp", t.reinhardTonemapper.shouldClamp),
+			NVP("reinhardGamma", t.reinhardTonemapper.gamma),
+			NVP("reinhardKey", t.reinhardTonemapper.key),
+			NVP("reinhardEnableAveraging", t.reinhardTonemapper.enableAveraging),
+			NVP("reinhardAveragingAlpha", t.reinhardTonemapper.averagingAlpha));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, ModelLoaderInfo& m)
+	{
+		a(NVP("modelFileName", m.modelFileName),
+			NVP("scale", m.scale),
+			NVP("rotate", m.rotate),
+			NVP("translate", m.translate),
+			NVP("defaultMaterialId", m.defaultMaterialId),
+			NVP("triangleCountEstimate", m.triangleCountEstimate),
+			NVP("loadOnlyMaterials", m.loadOnlyMaterials),
+			NVP("substituteMaterial", m.substituteMaterial),
+			NVP("substituteMaterialFileName", m.substituteMaterialFileName));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, Texture& t)
+	{
+		a(NVP("id", t.id),
+			NVP("type", t.type),
+			NVP("imageFileName", t.imageTexture.imageFileName),
+			NVP("imageApplyGamma", t.imageTexture.applyGamma),
+			NVP("imageGenerateMipmaps", t.imageTexture.generateMipmaps),
+			NVP("checkerColor1", t.checkerTexture.color1),
+			NVP("checkerColor2", t.checkerTexture.color2),
+			NVP("checkerStripeMode", t.checkerTexture.stripeMode),
+			NVP("checkerStripeWidth", t.checkerTexture.stripeWidth),
+			NVP("marbleSeed", t.marbleTexture.seed),
+			NVP("marbleColor", t.marbleTexture.marbleColor),
+			NVP("marbleStreakColor", t.marbleTexture.streakColor),
+			NVP("marbleDensity", t.marbleTexture.density),
+			NVP("marbleSwirliness", t.marbleTexture.swirliness),
+			NVP("marbleTransparency", t.marbleTexture.transparency),
+			NVP("marbleScale", t.marbleTexture.scale),
+			NVP("woodSeed", t.woodTexture.seed),
+			NVP("woodColor", t.woodTexture.woodColor),
+			NVP("woodDensity", t.woodTexture.density),
+			NVP("woodBumpiness", t.woodTexture.bumpiness),
+			NVP("woodScale", t.woodTexture.scale),
+			NVP("fireSeed", t.fireTexture.seed),
+			NVP("fireScale", t.fireTexture.scale));
+	}
+
+	// the texture indices are only meaningful in snapshots, the description files resolve them from the ids
+	template <typename Archive>
+	void serialize(Archive& a, Material& m)
+	{
+		a(NVP("id", m.id),
+			NVP("type", m.type),
+			NVP("normalInterpolation", m.normalInterpolation),
+			NVP("autoInvertNormal", m.autoInvertNormal),
+			NVP("invertNormal", m.invertNormal),
+			NVP("invisible", m.invisible),
+			NVP("primaryRayInvisible", m.primaryRayInvisible),
+			NVP("showEmittance", m.showEmittance),
+			NVP("texcoordScale", m.texcoordScale),
+			NVP("emittance", m.emittance),
+			NVP("emittanceTextureId", m.emittanceTextureId),
+			NVP("emittanceTextureIndex", m.emittanceTextureIndex),
+			NVP("reflectance", m.reflectance),
+			NVP("reflectanceTextureId", m.reflectanceTextureId),
+			NVP("reflectanceTextureIndex", m.reflectanceTextureIndex),
+			NVP("normalTextureId", m.normalTextureId),
+			NVP("normalTextureIndex", m.normalTextureIndex),
+			NVP("maskTextureId", m.maskTextureId),
+			NVP("maskTextureIndex", m.maskTextureIndex),
+			NVP("blinnPhongSpecularReflectance", m.blinnPhongMaterial.specularReflectance),
+			NVP("blinnPhongSpecularReflectanceTextureId", m.blinnPhongMaterial.specularReflectanceTextureId),
+			NVP("blinnPhongSpecularReflectanceTextureIndex", m.blinnPhongMaterial.specularReflectanceTextureIndex),
+			NVP("blinnPhongGlossiness", m.blinnPhongMaterial.glossiness),
+			NVP("blinnPhongGlossinessTextureId", m.blinnPhongMaterial.glossinessTextureId),
+			NVP("blinnPhongGlossinessTextureIndex", m.blinnPhongMaterial.glossinessTextureIndex));
+	}
+
+	template <typename Archive>
+	void serialize(Archive& a, Triangle& t)
+	{
+		a(NVP("vertex1", t.vertices[0]),
+			NVP("vertex2", t.vertices[1]),
+			NVP("vertex3", t.vertices[2]),
+			NVP("normal1", t.normals[0]),
+			NVP("normal2", t.normals[1]),
+			NVP("normal3", t.normals[2]),
+			NVP("texcoord1", t.texcoords[0]),
+			NVP("texcoord2", t.texcoords[1]),
+			NVP("texcoord3", t.texcoords[2]),
+			NVP("materialId", t.materialId));
+	}
+}
+
+namespace
+{
+	const uint32_t SNAPSHOT_MAGIC = 0x504e5356; // "VSNP"
+	const uint32_t SNAPSHOT_VERSION = 2;
+	const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304; // written raw, reads back differently on a machine with the other byte order
+
+	template <typename Archive>
+	void serializeSettings(Archive& a, Scene& scene)
+	{
+		a(NVP("general", scene.general),
+			NVP("renderer", scene.renderer),
+			NVP("volume", scene.volume),
+			NVP("camera", scene.camera),
+			NVP("integrator", scene.integrator),
+			NVP("tonemapper", scene.tonemapper),
+			NVP("bvhType", scene.bvh.type));
+	}
+
+	template <typename Archive>
+	void serializeDescription(Archive& a, Scene& scene)
+	{
+		serializeSettings(a, scene);
+
+		a(NVP("models", scene.models),
+			NVP("textures", scene.textures),
+			NVP("materials", scene.materials),
+			NVP("triangles", scene.triangles));
+	}
+}
+
+void Scene::load(const std::string& fileName)
+{
+	App::getLog().logInfo("Loading the scene from %s", fileName);
+
+	if (StringUtils::endsWith(fileName, ".bin"))
+	{
+		loadSnapshot(fileName);
+		return;
+	}
+
+	std::ifstream file(fileName, std::ios::in | std::ios::binary);
+
+	if (!file.is_open())
+		throw std::runtime_error(tfm::format("Could not open the scene file for reading (%s)", fileName));
+
+	if (StringUtils::endsWith(fileName, ".xml"))
+	{
+		cereal::XMLInputArchive archive(file);
+		serializeDescription(archive, *this);
+	}
+	else if (StringUtils::endsWith(fileName, ".json"))
+	{
+		cereal::JSONInputArchive archive(file);
+		serializeDescription(archive, *this);
+	}
+	else
+		throw std::runtime_error(tfm::format("Unknown scene file format (%s)", fileName));
+
+	snapshotLoaded = false;
+}
+
+void Scene::save(const std::string& fileName) const
+{
+	App::getLog().logInfo("Saving the scene to %s", fileName);
+
+	if (StringUtils::endsWith(fileName, ".bin"))
+	{
+		saveSnapshot(fileName);
+		return;
+	}
+
+	std::ofstream file(fileName, std::ios::out | std::ios::binary);
+
+	if (!file.is_open())
+		throw std::runtime_error(tfm::format("Could not open the scene file for writing (%s)", fileName));
+
+	// the archives flush their output when they are destroyed
+	if (StringUtils::endsWith(fileName, ".xml"))
+	{
+		cereal::XMLOutputArchive archive(file);
+		serializeDescription(archive, const_cast<Scene&>(*this));
+	}
+	else if (StringUtils::endsWith(fileName, ".json"))
+	{
+		cereal::JSONOutputArchive archive(file);
+		serializeDescription(archive, const_cast<Scene&>(*this));
+	}
+	else
+		throw std::runtime_error(tfm::format("Unknown scene file format (%s)", fileName));
+}
+
+// the settings, textures and materials go through the portable binary archive, the geometry and the BVH are stored as raw host-endian arrays after it
+void Scene::loadSnapshot(const std::string& fileName)
+{
+	Timer timer;
+
+	std::ifstream file(fileName, std::ios::in | std::ios::binary);
+
+	if (!file.is_open())
+		throw std::runtime_error(tfm::format("Could not open the scene snapshot file for reading (%s)", fileName));
+
+	cereal::PortableBinaryInputArchive archive(file);
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+
+	archive(magic, version);
+
+	if (magic != SNAPSHOT_MAGIC)
+		throw std::runtime_error(tfm::format("The file is not a scene snapshot (%s)", fileName));
+
+	if (version != SNAPSHOT_VERSION)
+		throw std::runtime_error(tfm::format("Unsupported scene snapshot version (%d)", version));
+
+	serializeSettings(archive, *this);
+	archive(allTextures, allMaterials);
+
+	uint32_t byteOrder = 0;
+	file.read(reinterpret_cast<char*>(&byteOrder), sizeof(byteOrder));
+
+	if (byteOrder != SNAPSHOT_BYTE_ORDER)
+		throw std::runtime_error(tfm::format("The scene snapshot was written on a machine with a different byte order (%s)", fileName));
+
+	verticesAlloc.load(file);
+	trianglesAlloc.load(file);
+	emissiveTrianglesAlloc.load(file);
+	bvh.load(file);
+
+	emissiveTrianglesCount = uint32_t(emissiveTrianglesAlloc.getCount());
+	snapshotLoaded = true;
+
+	App::getLog().logInfo("Scene snapshot loaded (time: %s, triangles: %s)", timer.getElapsed().getString(true), StringUtils::humanizeNumber(double(trianglesAlloc.getCount()), false));
+}
+
+void Scene::saveSnapshot(const std::string& fileName) const
+{
+	if (trianglesAlloc.getHostPtr() == nullptr)
+		throw std::runtime_error("Only an initialized scene with geometry can be saved as a snapshot");
+
+	std::ofstream file(fileName, std::ios::out | std::ios::binary);
+
+	if (!file.is_open())
+		throw std::runtime_error(tfm::format("Could not open the scene snapshot file for writing (%s)", fileName));
+
+	cereal::PortableBinaryOutputArchive archive(file);
+
+	archive(SNAPSHOT_MAGIC, SNAPSHOT_VERSION);
+	serializeSettings(archive, const_cast<Scene&>(*this));
+	archive(allTextures, allMaterials);
+
+	file.write(reinterpret_cast<const char*>(&SNAPSHOT_BYTE_ORDER), sizeof(SNAPSHOT_BYTE_ORDER));
+
+	verticesAlloc.save(file);
+	trianglesAlloc.save(file);
+	emissiveTrianglesAlloc.save(file);
+	bvh.save(file);
+}
@@ -3,18 +3,56 @@
 
 #include "Precompiled.h"
 
+#ifdef _WIN32
+#include <ppl.h>
+#define PARALLEL_SORT concurrency::parallel_sort
+#endif
+
+#ifdef __linux
+#include <parallel/algorithm>
+#define PARALLEL_SORT __gnu_parallel::sort
+#endif
+
+#ifdef __APPLE__
+#define PARALLEL_SORT std::sort
+#endif
+
 #include "Core/Common.h"
 #include "Core/Intersection.h"
 #include "Core/Ray.h"
 #include "Core/Scene.h"
 #include "Core/Triangle.h"
 #include "Materials/Material.h"
+#include "Math/MathUtils.h"
 #include "Math/ONB.h"
 #include "Textures/Texture.h"
-#include "Math/Random.h"
+#include "Math/Sampler.h"
 
 using namespace Valo;
 
+namespace
+{
+	struct CompactVertexKey
+	{
+		uint32_t values[5];
+
+		bool operator==(const CompactVertexKey& other) const
+		{
+			return memcmp(values, other.values, sizeof(values)) == 0;
+		}
+	};
+
+	uint32_t encodeTexcoord(const Vector2& texcoord)
+	{
+		return uint32_t(MathUtils::floatToHalf(texcoord.x)) | (uint32_t(MathUtils::floatToHalf(texcoord.y)) << 16);
+	}
+
+	CUDA_CALLABLE Vector2 decodeTexcoord(uint32_t value)
+	{
+		return Vector2(MathUtils::halfToFloat(uint16_t(value & 0xffff)), MathUtils::halfToFloat(uint16_t(value >> 16)));
+	}
+}
+
 void Triangle::initialize()
 {
 	Vector3 v0tov1 = vertices[1] - vertices[0];
@@ -28,6 +66,9 @@ void Triangle::initialize()
 
 	float denominator = t0tot1.x * t0tot2.y - t0tot1.y * t0tot2.x;
 
+	// texcoord units per world unit, used for ray cone texture filtering
+	texcoordDensity = (area > 0.0f) ? std::sqrt(0.5f * std::abs(denominator) / area) : 0.0f;
+
 	// tangent space aligned to texcoords
 	if (std::abs(denominator) > 0.0000000001f)
 	{
@@ -44,15 +85,93 @@ void Triangle::initialize()
 	}
 }
 
+void Triangle::compact(const std::vector<Triangle>& triangles, std::vector<CompactVertex>& compactVertices, CompactTriangle* compactTriangles)
+{
+	std::vector<CompactVertexKey> keys(triangles.size() * 3);
+
+	#pragma omp parallel for
+	for (int64_t i = 0; i < int64_t(triangles.size()); ++i)
+	{
+		const Triangle& triangle = triangles[i];
+		CompactTriangle& compactTriangle = compactTriangles[i];
+
+		compactTriangle.normal = MathUtils::encodeOctahedral(triangle.normal);
+		compactTriangle.tangent = MathUtils::encodeOctahedral(triangle.tangent);
+		compactTriangle.bitangent = MathUtils::encodeOctahedral(triangle.bitangent);
+		compactTriangle.area = triangle.area;
+		compactTriangle.texcoordDensity = triangle.texcoordDensity;
+		compactTriangle.materialIndex = triangle.materialIndex;
+
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+			CompactVertexKey& key = keys[i * 3 + j];
+
+			memcpy(&key.values[0], &triangle.vertices[j].x, sizeof(float));
+			memcpy(&key.values[1], &triangle.vertices[j].y, sizeof(float));
+			memcpy(&key.values[2], &triangle.vertices[j].z, sizeof(float));
+			key.values[3] = MathUtils::encodeOctahedral(triangle.normals[j]);
+			key.values[4] = encodeTexcoord(triangle.texcoords[j]);
+		}
+	}
+
+	// weld the vertices that are identical after encoding, sorting brings the corners with equal keys next to each other
+	std::vector<uint32_t> order(keys.size());
+
+	#pragma omp parallel for
+	for (int64_t i = 0; i < int64_t(keys.size()); ++i)
+		order[i] = uint32_t(i);
+
+	PARALLEL_SORT(order.begin(), order.end(), [&keys](uint32_t i1, uint32_t i2)
+	{
+		int32_t result = memcmp(keys[i1].values, keys[i2].values, sizeof(keys[i1].values));
+		return (result != 0) ? (result < 0) : (i1 < i2);
+	});
+
+	// every corner points to the first corner with the same key
+	std::vector<uint32_t> firstCorners(keys.size());
+
+	for (size_t i = 0; i < order.size(); ++i)
+		firstCorners[order[i]] = (i > 0 && keys[order[i]] == keys[order[i - 1]]) ? firstCorners[order[i - 1]] : order[i];
+
+	// the vertices are numbered in the order of their first corners, the sort order is no longer needed
+	std::vector<uint32_t>& vertexIndices = order;
+	compactVertices.clear();
+
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		if (firstCorners[i] != i)
+			continue;
+
+		CompactVertex vertex;
+		memcpy(&vertex.position.x, &keys[i].values[0], sizeof(float));
+		memcpy(&vertex.position.y, &keys[i].values[1], sizeof(float));
+		memcpy(&vertex.position.z, &keys[i].values[2], sizeof(float));
+		vertex.normal = keys[i].values[3];
+		vertex.texcoord = keys[i].values[4];
+
+		vertexIndices[i] = uint32_t(compactVertices.size());
+		compactVertices.push_back(vertex);
+	}
+
+	#pragma omp parallel for
+	for (int64_t i = 0; i < int64_t(keys.size()); ++i)
+		compactTriangles[i / 3].vertexIndices[i % 3] = vertexIndices[firstCorners[i]];
+}
+
 // Möller-Trumbore algorithm
 // http://www.scratchapixel.com/lessons/3d-basic-rendering/ray-tracing-rendering-a-triangle/moller-trumbore-ray-triangle-intersection
-CUDA_CALLABLE bool Triangle::intersect(const Scene& scene, const Ray& ray, Intersection& intersection) const
+CUDA_CALLABLE bool Triangle::intersect(const Scene& scene, const Ray& ray, uint32_t triangleIndex, Intersection& intersection)
 {
 	if (ray.isVisibilityRay && intersection.wasFound)
 		return true;
 
-	Vector3 v0v1 = vertices[1] - vertices[0];
-	Vector3 v0v2 = vertices[2] - vertices[0];
+	const CompactTriangle& triangle = scene.getTriangle(triangleIndex);
+	const Vector3& vertex0 = scene.getVertex(triangle.vertexIndices[0]).position;
+	const Vector3& vertex1 = scene.getVertex(triangle.vertexIndices[1]).position;
+	const Vector3& vertex2 = scene.getVertex(triangle.vertexIndices[2]).position;
+
+	Vector3 v0v1 = vertex1 - vertex0;
+	Vector3 v0v2 = vertex2 - vertex0;
 
 	Vector3 pvec = ray.direction.cross(v0v2);
 	float determinant = v0v1.dot(pvec);
@@ -62,7 +181,7 @@ CUDA_CALLABLE bool Triangle::intersect(const Scene& scene, const Ray& ray, Inter
 
 	float invDeterminant = 1.0f / determinant;
 
-	Vector3 tvec = ray.origin - vertices[0];
+	Vector3 tvec = ray.origin - vertex0;
 	float u = tvec.dot(pvec) * invDeterminant;
 
 	if (u < 0.0f || u > 1.0f)
@@ -85,7 +204,7 @@ CUDA_CALLABLE bool Triangle::intersect(const Scene& scene, const Ray& ray, Inter
 	if (distance > intersection.distance)
 		return false;
 
-	return calculateIntersectionData(scene, ray, *this, intersection, distance, u, v);
+	return calculateIntersectionData(scene, ray, triangleIndex, intersection, distance, u, v);
 }
 
 template <uint32_t N>
@@ -193,7 +312,7 @@ CUDA_CALLABLE bool Triangle::intersect(
 	if (!findIntersectionValues<N>(hits, distances, uValues, vValues, triangleIndices, distance, u, v, triangleIndex))
 		return false;
 
-	return calculateIntersectionData(scene, ray, scene.getTriangle(triangleIndex), intersection, distance, u, v);
+	return calculateIntersectionData(scene, ray, triangleIndex, intersection, distance, u, v);
 }
 
 template <uint32_t N>
@@ -222,8 +341,9 @@ template bool Triangle::intersect<4>(const float* __restrict vertex1X, const flo
 template bool Triangle::intersect<8>(const float* __restrict vertex1X, const float* __restrict vertex1Y, const float* __restrict vertex1Z, const float* __restrict vertex2X, const float* __restrict vertex2Y, const float* __restrict vertex2Z, const float* __restrict vertex3X, const float* __restrict vertex3Y, const float* __restrict vertex3Z, const uint32_t* __restrict triangleIndices, const Scene& scene, const Ray& ray, Intersection& intersection);
 template bool Triangle::intersect<16>(const float* __restrict vertex1X, const float* __restrict vertex1Y, const float* __restrict vertex1Z, const float* __restrict vertex2X, const float* __restrict vertex2Y, const float* __restrict vertex2Z, const float* __restrict vertex3X, const float* __restrict vertex3Y, const float* __restrict vertex3Z, const uint32_t* __restrict triangleIndices, const Scene& scene, const Ray& ray, Intersection& intersection);
 
-CUDA_CALLABLE bool Triangle::calculateIntersectionData(const Scene& scene, const Ray& ray, const Triangle& triangle, Intersection& intersection, float distance, float u, float v)
+CUDA_CALLABLE bool Triangle::calculateIntersectionData(const Scene& scene, const Ray& ray, uint32_t triangleIndex, Intersection& intersection, float distance, float u, float v)
 {
+	const CompactTriangle& triangle = scene.getTriangle(triangleIndex);
 	const Material& material = scene.getMaterial(triangle.materialIndex);
 
 	if (material.invisible)
@@ -232,21 +352,34 @@ CUDA_CALLABLE bool Triangle::calculateIntersectionData(const Scene& scene, const
 	if (ray.isPrimaryRay && material.primaryRayInvisible)
 		return false;
 
+	const CompactVertex& vertex0 = scene.getVertex(triangle.vertexIndices[0]);
+	const CompactVertex& vertex1 = scene.getVertex(triangle.vertexIndices[1]);
+	const CompactVertex& vertex2 = scene.getVertex(triangle.vertexIndices[2]);
+
 	float w = 1.0f - u - v;
 
 	Vector3 intersectionPosition = ray.origin + (distance * ray.direction);
-	Vector2 texcoord = (w * triangle.texcoords[0] + u * triangle.texcoords[1] + v * triangle.texcoords[2]) * material.texcoordScale;
+	Vector2 texcoord = (w * decodeTexcoord(vertex0.texcoord) + u * decodeTexcoord(vertex1.texcoord) + v * decodeTexcoord(vertex2.texcoord)) * material.texcoordScale;
 
 	texcoord.x = texcoord.x - floor(texcoord.x);
 	texcoord.y = texcoord.y - floor(texcoord.y);
 
+	Vector3 triangleNormal = MathUtils::decodeOctahedral(triangle.normal);
+
+	float coneWidth = ray.coneWidth + ray.coneSpread * distance;
+	float coneCosine = MAX(std::abs(ray.direction.dot(triangleNormal)), 0.01f);
+	float texcoordFootprint = (coneWidth / coneCosine) * triangle.texcoordDensity * std::sqrt(std::abs(material.texcoordScale.x * material.texcoordScale.y));
+
 	if (material.maskTextureIndex != -1)
 	{
-		if (scene.getTexture(material.maskTextureIndex).getColor(scene, texcoord, intersectionPosition).r < 0.5f)
+		if (scene.getTexture(material.maskTextureIndex).getColor(scene, texcoord, intersectionPosition, texcoordFootprint).r < 0.5f)
 			return false;
 	}
 
-	Vector3 tempNormal = (scene.general.normalInterpolation && material.normalInterpolation) ? (w * triangle.normals[0] + u * triangle.normals[1] + v * triangle.normals[2]) : triangle.normal;
+	Vector3 tempNormal = triangleNormal;
+
+	if (scene.general.normalInterpolation && material.normalInterpolation)
+		tempNormal = w * MathUtils::decodeOctahedral(vertex0.normal) + u * MathUtils::decodeOctahedral(vertex1.normal) + v * MathUtils::decodeOctahedral(vertex2.normal);
 
 	if (material.invertNormal)
 		tempNormal = -tempNormal;
@@ -265,30 +398,37 @@ CUDA_CALLABLE bool Triangle::calculateIntersectionData(const Scene& scene, const
 	intersection.wasFound = true;
 	intersection.distance = distance;
 	intersection.area = triangle.area;
+	intersection.coneWidth = coneWidth;
+	intersection.texcoordFootprint = texcoordFootprint;
 	intersection.position = intersectionPosition;
 	intersection.normal = tempNormal;
 	intersection.texcoord = texcoord;
-	intersection.onb = ONB(triangle.tangent, triangle.bitangent, tempNormal);
+	intersection.onb = ONB(MathUtils::decodeOctahedral(triangle.tangent), MathUtils::decodeOctahedral(triangle.bitangent), tempNormal);
 	intersection.materialIndex = triangle.materialIndex;
 
 	return true;
 }
 
-CUDA_CALLABLE Intersection Triangle::getRandomIntersection(const Scene& scene, Random& random) const
+CUDA_CALLABLE Intersection Triangle::getRandomIntersection(const Scene& scene, uint32_t triangleIndex, Sampler& sampler)
 {
-	const Material& material = scene.getMaterial(materialIndex);
+	const CompactTriangle& triangle = scene.getTriangle(triangleIndex);
+	const Material& material = scene.getMaterial(triangle.materialIndex);
 
-	float r1 = random.getFloat();
-	float r2 = random.getFloat();
+	const CompactVertex& vertex0 = scene.getVertex(triangle.vertexIndices[0]);
+	const CompactVertex& vertex1 = scene.getVertex(triangle.vertexIndices[1]);
+	const CompactVertex& vertex2 = scene.getVertex(triangle.vertexIndices[2]);
+
+	float r1 = sampler.getFloat();
+	float r2 = sampler.getFloat();
 	float sr1 = std::sqrt(r1);
 
 	float u = 1.0f - sr1;
 	float v = r2 * sr1;
 	float w = 1.0f - u - v;
 
-	Vector3 position = u * vertices[0] + v * vertices[1] + w * vertices[2];
-	Vector3 tempNormal = material.normalInterpolation ? (w * normals[0] + u * normals[1] + v * normals[2]) : normal;
-	Vector2 texcoord = (w * texcoords[0] + u * texcoords[1] + v * texcoords[2]) * material.texcoordScale;
+	Vector3 position = u * vertex0.position + v * vertex1.position + w * vertex2.position;
+	Vector3 tempNormal = material.normalInterpolation ? (w * MathUtils::decodeOctahedral(vertex0.normal) + u * MathUtils::decodeOctahedral(vertex1.normal) + v * MathUtils::decodeOctahedral(vertex2.normal)) : MathUtils::decodeOctahedral(triangle.normal);
+	Vector2 texcoord = (w * decodeTexcoord(vertex0.texcoord) + u * decodeTexcoord(vertex1.texcoord) + v * decodeTexcoord(vertex2.texcoord)) * material.texcoordScale;
 
 	texcoord.x = texcoord.x - floor(texcoord.x);
 	texcoord.y = texcoord.y - floor(texcoord.y);
@@ -296,12 +436,12 @@ CUDA_CALLABLE Intersection Triangle::getRandomIntersection(const Scene& scene, R
 	Intersection intersection;
 
 	intersection.wasFound = true;
-	intersection.area = area;
+	intersection.area = triangle.area;
 	intersection.position = position;
 	intersection.normal = tempNormal;
 	intersection.texcoord = texcoord;
-	intersection.onb = ONB(tangent, bitangent, tempNormal);
-	intersection.materialIndex = materialIndex;
+	intersection.onb = ONB(MathUtils::decodeOctahedral(triangle.tangent), MathUtils::decodeOctahedral(triangle.bitangent), tempNormal);
+	intersection.materialIndex = triangle.materialIndex;
 
 	return intersection;
 }
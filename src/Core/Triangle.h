@@ -4,17 +4,26 @@
 #pragma once
 
 #include <cstdint>
+#include <vector>
 
 #include "Core/Common.h"
 #include "Math/Vector3.h"
 #include "Math/Vector2.h"
 
+/*
+
+Triangles are the input format of the scene and the BVH build. For rendering they are converted to
+indexed compact triangles that share their vertices and store the normals and tangents octahedral
+encoded and the texcoords as halfs.
+
+*/
+
 namespace Valo
 {
 	class Scene;
 	class Ray;
 	class Intersection;
-	class Random;
+	class Sampler;
 	class AABB;
 
 	template <uint32_t N>
@@ -32,17 +41,38 @@ namespace Valo
 		uint32_t triangleIndex[N];
 	};
 
+	// shared vertex of the indexed triangle storage used for rendering
+	struct CompactVertex
+	{
+		Vector3 position;
+		uint32_t normal; // octahedral
+		uint32_t texcoord; // 2 x half
+	};
+
+	struct CompactTriangle
+	{
+		uint32_t vertexIndices[3];
+		uint32_t normal; // octahedral
+		uint32_t tangent; // octahedral
+		uint32_t bitangent; // octahedral
+		float area;
+		float texcoordDensity;
+		uint32_t materialIndex;
+	};
+
 	class Triangle
 	{
 	public:
 
 		void initialize();
-		CUDA_CALLABLE bool intersect(const Scene& scene, const Ray& ray, Intersection& intersection) const;
+		static void compact(const std::vector<Triangle>& triangles, std::vector<CompactVertex>& compactVertices, CompactTriangle* compactTriangles);
+
+		CUDA_CALLABLE static bool intersect(const Scene& scene, const Ray& ray, uint32_t triangleIndex, Intersection& intersection);
 
 		template <uint32_t N>
 		CUDA_CALLABLE static bool intersect(const float* __restrict vertex1X, const float* __restrict vertex1Y, const float* __restrict vertex1Z, const float* __restrict vertex2X, const float* __restrict vertex2Y, const float* __restrict vertex2Z, const float* __restrict vertex3X, const float* __restrict vertex3Y, const float* __restrict vertex3Z, const uint32_t* __restrict triangleIndices, const Scene& scene, const Ray& ray, Intersection& intersection);
 
-		CUDA_CALLABLE Intersection getRandomIntersection(const Scene& scene, Random& random) const;
+		CUDA_CALLABLE static Intersection getRandomIntersection(const Scene& scene, uint32_t triangleIndex, Sampler& sampler);
 		AABB getAABB() const;
 
 		Vector3 vertices[3];
@@ -52,6 +82,7 @@ namespace Valo
 		Vector3 tangent;
 		Vector3 bitangent;
 		float area = 0.0f;
+		float texcoordDensity = 0.0f;
 		uint32_t materialId = 0;
 		uint32_t materialIndex = 0;
 		
@@ -60,6 +91,6 @@ namespace Valo
 		template <uint32_t N>
 		CUDA_CALLABLE static bool findIntersectionValues(const uint32_t* hits, const float* distances, const float* uValues, const float* vValues, const uint32_t* triangleIndices, float& distance, float& u, float& v, uint32_t& triangleIndex);
 
-		CUDA_CALLABLE static bool calculateIntersectionData(const Scene& scene, const Ray& ray, const Triangle& triangle, Intersection& intersection, float distance, float u, float v);
+		CUDA_CALLABLE static bool calculateIntersectionData(const Scene& scene, const Ray& ray, uint32_t triangleIndex, Intersection& intersection, float distance, float u, float v);
 	};
 }
@@ -11,6 +11,77 @@ using namespace Valo;
 Filter::Filter(FilterType type_)
 {
 	type = type_;
+
+	initialize();
+}
+
+void Filter::initialize()
+{
+	Vector2 radius = getRadius();
+
+	float* cdfs[2] = { cdfX, cdfY };
+	float* signs[2] = { signsX, signsY };
+
+	for (uint32_t axis = 0; axis < 2; ++axis)
+	{
+		float* cdf = cdfs[axis];
+		float axisRadius = (axis == 0) ? radius.x : radius.y;
+		float binSize = 2.0f * axisRadius / float(TABLE_SIZE);
+
+		cdf[0] = 0.0f;
+
+		for (uint32_t i = 0; i < TABLE_SIZE; ++i)
+		{
+			float s = -axisRadius + (float(i) + 0.5f) * binSize;
+			float weight = (axis == 0) ? getWeight(Vector2(s, 0.0f)) : getWeight(Vector2(0.0f, s));
+
+			signs[axis][i] = (weight < 0.0f) ? -1.0f : 1.0f;
+			cdf[i + 1] = cdf[i] + std::abs(weight);
+		}
+
+		float total = cdf[TABLE_SIZE];
+
+		for (uint32_t i = 1; i <= TABLE_SIZE; ++i)
+			cdf[i] = (total > 0.0f) ? cdf[i] / total : float(i) / float(TABLE_SIZE);
+
+		cdf[TABLE_SIZE] = 1.0f;
+	}
+}
+
+CUDA_CALLABLE float Filter::sampleAxis(const float* cdf, const float* signs, float radius, float u, float& sign)
+{
+	uint32_t low = 0;
+	uint32_t high = TABLE_SIZE;
+
+	while (low + 1 < high)
+	{
+		uint32_t middle = (low + high) / 2;
+
+		if (cdf[middle] <= u)
+			low = middle;
+		else
+			high = middle;
+	}
+
+	float binWidth = cdf[low + 1] - cdf[low];
+	float t = (binWidth > 0.0f) ? (u - cdf[low]) / binWidth : 0.5f;
+
+	sign = signs[low];
+
+	return -radius + (float(low) + t) * (2.0f * radius / float(TABLE_SIZE));
+}
+
+CUDA_CALLABLE FilterSample Filter::getSample(const Vector2& point) const
+{
+	Vector2 radius = getRadius();
+	FilterSample result;
+	float signX, signY;
+
+	result.offset.x = sampleAxis(cdfX, signsX, radius.x, point.x, signX);
+	result.offset.y = sampleAxis(cdfY, signsY, radius.y, point.y, signY);
+	result.weight = signX * signY;
+
+	return result;
 }
 
 CUDA_CALLABLE float Filter::getWeight(float s) const
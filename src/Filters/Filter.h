@@ -12,19 +12,36 @@
 #include "Filters/GaussianFilter.h"
 #include "Filters/MitchellFilter.h"
 #include "Filters/LanczosSincFilter.h"
+#include "Math/Vector2.h"
+
+/*
+
+All filters are separable. initialize tabulates the absolute filter weight along both axes into CDFs
+so that getSample can distribute the samples proportionally to |weight|. The returned sample weight
+is then just the sign of the filter at the offset (the constant normalization cancels out in the film).
+
+*/
 
 namespace Valo
 {
-	class Vector2;
-
 	enum class FilterType { BOX, TENT, BELL, GAUSSIAN, MITCHELL, LANCZOS_SINC };
 
+	struct FilterSample
+	{
+		Vector2 offset;
+		float weight = 1.0f;
+	};
+
 	class Filter
 	{
 	public:
 
 		explicit Filter(FilterType type = FilterType::MITCHELL);
 
+		void initialize();
+
+		CUDA_CALLABLE FilterSample getSample(const Vector2& point) const;
+
 		CUDA_CALLABLE float getWeight(float s) const;
 		CUDA_CALLABLE float getWeight(const Vector2& point) const;
 
@@ -40,5 +57,16 @@ namespace Valo
 		GaussianFilter gaussianFilter;
 		MitchellFilter mitchellFilter;
 		LanczosSincFilter lanczosSincFilter;
+
+		static const uint32_t TABLE_SIZE = 128;
+
+	private:
+
+		CUDA_CALLABLE static float sampleAxis(const float* cdf, const float* signs, float radius, float u, float& sign);
+
+		float cdfX[TABLE_SIZE + 1];
+		float cdfY[TABLE_SIZE + 1];
+		float signsX[TABLE_SIZE];
+		float signsY[TABLE_SIZE];
 	};
 }
@@ -8,19 +8,19 @@
 #include "Core/Scene.h"
 #include "Integrators/AmbientOcclusionIntegrator.h"
 #include "Materials/Material.h"
-#include "Math/Random.h"
+#include "Math/Sampler.h"
 #include "Math/Mapper.h"
 
 using namespace Valo;
 
-CUDA_CALLABLE Color AmbientOcclusionIntegrator::calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Random& random) const
+CUDA_CALLABLE Color AmbientOcclusionIntegrator::calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler) const
 {
 	(void)ray;
 
 	Ray aoRay;
 
 	aoRay.origin = intersection.position;
-	aoRay.direction = Mapper::mapToCosineHemisphere(random.getVector2(), intersection.onb);
+	aoRay.direction = Mapper::mapToCosineHemisphere(sampler.getVector2(), intersection.onb);
 	aoRay.minDistance = scene.general.rayMinDistance;
 	aoRay.maxDistance = maxDistance;
 	aoRay.precalculate();
@@ -33,7 +33,7 @@ CUDA_CALLABLE Color AmbientOcclusionIntegrator::calculateLight(const Scene& scen
 	if (useReflectance)
 	{
 		const Material& material = scene.getMaterial(intersection.materialIndex);
-		aoColor *= material.getReflectance(scene, intersection.texcoord, intersection.position);
+		aoColor *= material.getReflectance(scene, intersection.texcoord, intersection.position, intersection.texcoordFootprint);
 	}
 
 	return aoColor;
@@ -11,13 +11,13 @@ namespace Valo
 	class Scene;
 	class Intersection;
 	class Ray;
-	class Random;
+	class Sampler;
 
 	class AmbientOcclusionIntegrator
 	{
 	public:
 
-		CUDA_CALLABLE Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Random& random) const;
+		CUDA_CALLABLE Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler) const;
 
 		float maxDistance = 1.0f;
 		bool useReflectance = false;
@@ -8,19 +8,19 @@
 #include "Core/Scene.h"
 #include "Integrators/DirectLightIntegrator.h"
 #include "Materials/Material.h"
-#include "Math/Random.h"
+#include "Math/Sampler.h"
 
 using namespace Valo;
 
-CUDA_CALLABLE Color DirectLightIntegrator::calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Random& random) const
+CUDA_CALLABLE Color DirectLightIntegrator::calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler) const
 {
 	const Material& material = scene.getMaterial(intersection.materialIndex);
 
 	if (!intersection.isBehind && material.showEmittance && material.isEmissive())
-		return material.getEmittance(scene, intersection.texcoord, intersection.position);
+		return material.getEmittance(scene, intersection.texcoord, intersection.position, intersection.texcoordFootprint);
 
 	Color result(0.0f, 0.0f, 0.0f);
-	Intersection emissiveIntersection = Integrator::getRandomEmissiveIntersection(scene, random);
+	Intersection emissiveIntersection = Integrator::getRandomEmissiveIntersection(scene, sampler);
 
 	if (Integrator::isIntersectionVisible(scene, intersection, emissiveIntersection))
 	{
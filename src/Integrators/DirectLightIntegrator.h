@@ -11,12 +11,12 @@ namespace Valo
 	class Scene;
 	class Intersection;
 	class Ray;
-	class Random;
+	class Sampler;
 
 	class DirectLightIntegrator
 	{
 	public:
 
-		CUDA_CALLABLE Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Random& random) const;
+		CUDA_CALLABLE Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler) const;
 	};
 }
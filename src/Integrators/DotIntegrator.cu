@@ -8,13 +8,13 @@
 #include "Core/Scene.h"
 #include "Integrators/DotIntegrator.h"
 #include "Materials/Material.h"
-#include "Math/Random.h"
+#include "Math/Sampler.h"
 
 using namespace Valo;
 
-CUDA_CALLABLE Color DotIntegrator::calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Random& random) const
+CUDA_CALLABLE Color DotIntegrator::calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler) const
 {
-	(void)random;
+	(void)sampler;
 
 	float dot = std::abs(ray.direction.dot(intersection.normal));
 	Color dotColor = Color(dot, dot, dot);
@@ -22,7 +22,7 @@ CUDA_CALLABLE Color DotIntegrator::calculateLight(const Scene& scene, const Inte
 	if (useReflectance)
 	{
 		const Material& material = scene.getMaterial(intersection.materialIndex);
-		dotColor *= material.getReflectance(scene, intersection.texcoord, intersection.position);
+		dotColor *= material.getReflectance(scene, intersection.texcoord, intersection.position, intersection.texcoordFootprint);
 	}
 
 	return dotColor;
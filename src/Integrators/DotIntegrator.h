@@ -11,13 +11,13 @@ namespace Valo
 	class Scene;
 	class Intersection;
 	class Ray;
-	class Random;
+	class Sampler;
 
 	class DotIntegrator
 	{
 	public:
 
-		CUDA_CALLABLE Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Random& random) const;
+		CUDA_CALLABLE Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler) const;
 
 		bool useReflectance = true;
 	};
@@ -8,18 +8,18 @@
 #include "Core/Scene.h"
 #include "Integrators/Integrator.h"
 #include "Materials/Material.h"
-#include "Math/Random.h"
+#include "Math/Sampler.h"
 
 using namespace Valo;
 
-CUDA_CALLABLE Color Integrator::calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Random& random) const
+CUDA_CALLABLE Color Integrator::calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler) const
 {
 	switch (type)
 	{
-		case IntegratorType::PATH: return pathIntegrator.calculateLight(scene, intersection, ray, random);
-		case IntegratorType::DOT: return dotIntegrator.calculateLight(scene, intersection, ray, random);
-		case IntegratorType::AMBIENT_OCCLUSION: return aoIntegrator.calculateLight(scene, intersection, ray, random);
-		case IntegratorType::DIRECT_LIGHT: return directIntegrator.calculateLight(scene, intersection, ray, random);
+		case IntegratorType::PATH: return pathIntegrator.calculateLight(scene, intersection, ray, sampler);
+		case IntegratorType::DOT: return dotIntegrator.calculateLight(scene, intersection, ray, sampler);
+		case IntegratorType::AMBIENT_OCCLUSION: return aoIntegrator.calculateLight(scene, intersection, ray, sampler);
+		case IntegratorType::DIRECT_LIGHT: return directIntegrator.calculateLight(scene, intersection, ray, sampler);
 		default: return Color::black();
 	}
 }
@@ -36,10 +36,10 @@ std::string Integrator::getName() const
 	}
 }
 
-CUDA_CALLABLE Intersection Integrator::getRandomEmissiveIntersection(const Scene& scene, Random& random)
+CUDA_CALLABLE Intersection Integrator::getRandomEmissiveIntersection(const Scene& scene, Sampler& sampler)
 {
-	const Triangle& triangle = scene.getEmissiveTriangles()[random.getUint32(0, scene.getEmissiveTrianglesCount() - 1)];
-	return triangle.getRandomIntersection(scene, random);
+	uint32_t triangleIndex = scene.getEmissiveTriangleIndices()[sampler.getUint32(0, scene.getEmissiveTrianglesCount() - 1)];
+	return Triangle::getRandomIntersection(scene, triangleIndex, sampler);
 }
 
 CUDA_CALLABLE bool Integrator::isIntersectionVisible(const Scene& scene, const Intersection& origin, const Intersection& emissiveIntersection)
@@ -80,7 +80,7 @@ CUDA_CALLABLE DirectLightSample Integrator::calculateDirectLightSample(const Sce
 
 	const Material& emissiveMaterial = scene.getMaterial(emissiveIntersection.materialIndex);
 
-	result.emittance = emissiveMaterial.getEmittance(scene, emissiveIntersection.texcoord, emissiveIntersection.position);
+	result.emittance = emissiveMaterial.getEmittance(scene, emissiveIntersection.texcoord, emissiveIntersection.position, emissiveIntersection.texcoordFootprint);
 	result.lightPdf = (1.0f / scene.getEmissiveTrianglesCount()) * (1.0f / emissiveIntersection.area) * (distance2 / result.lightCosine);
 	result.visible = true;
 
@@ -100,7 +100,7 @@ CUDA_CALLABLE float Integrator::powerHeuristic(uint32_t nf, float fPdf, uint32_t
 	return (f * f) / (f * f + g * g);
 }
 
-VolumeEffect Integrator::calculateVolumeEffect(const Scene& scene, const Vector3& start, const Vector3& end, Random& random)
+VolumeEffect Integrator::calculateVolumeEffect(const Scene& scene, const Vector3& start, const Vector3& end, Sampler& sampler)
 {
 	Vector3 startToEnd = end - start;
 	float distance = startToEnd.length();
@@ -118,8 +118,12 @@ VolumeEffect Integrator::calculateVolumeEffect(const Scene& scene, const Vector3
 
 		if (!scene.volume.constant)
 		{
-			density = scene.volume.noiseDensity.getNoise(position * scene.volume.noiseScale);
-			stepSize = scene.volume.stepSize + random.getFloat() * scene.volume.stepSize;
+			if (scene.volume.useDensityGrid && scene.volume.densityGrid.isInside(position))
+				density = scene.volume.densityGrid.getDensity(position);
+			else
+				density = scene.volume.noiseDensity.getNoise(position * scene.volume.noiseScale);
+
+			stepSize = scene.volume.stepSize + sampler.getFloat() * scene.volume.stepSize;
 		}
 
 		travelled += stepSize;
@@ -129,7 +133,7 @@ VolumeEffect Integrator::calculateVolumeEffect(const Scene& scene, const Vector3
 		if (scene.volume.inscatter)
 		{
 			Intersection origin;
-			Intersection emissiveIntersection = getRandomEmissiveIntersection(scene, random);
+			Intersection emissiveIntersection = getRandomEmissiveIntersection(scene, sampler);
 
 			origin.position = position;
 			origin.normal = (emissiveIntersection.position - position).normalized();
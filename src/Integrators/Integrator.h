@@ -16,7 +16,7 @@ namespace Valo
 	class Color;
 	class Scene;
 	class Ray;
-	class Random;
+	class Sampler;
 
 	enum class IntegratorType { PATH, DOT, AMBIENT_OCCLUSION, DIRECT_LIGHT };
 
@@ -41,16 +41,16 @@ namespace Valo
 	{
 	public:
 
-		CUDA_CALLABLE Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Random& random) const;
+		CUDA_CALLABLE Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler) const;
 
 		std::string getName() const;
 
-		CUDA_CALLABLE static Intersection getRandomEmissiveIntersection(const Scene& scene, Random& random);
+		CUDA_CALLABLE static Intersection getRandomEmissiveIntersection(const Scene& scene, Sampler& sampler);
 		CUDA_CALLABLE static bool isIntersectionVisible(const Scene& scene, const Intersection& origin, const Intersection& emissiveIntersection);
 		CUDA_CALLABLE static DirectLightSample calculateDirectLightSample(const Scene& scene, const Intersection& origin, const Intersection& emissiveIntersection);
 		CUDA_CALLABLE static float balanceHeuristic(uint32_t nf, float fPdf, uint32_t ng, float gPdf);
 		CUDA_CALLABLE static float powerHeuristic(uint32_t nf, float fPdf, uint32_t ng, float gPdf);
-		CUDA_CALLABLE static VolumeEffect calculateVolumeEffect(const Scene& scene, const Vector3& start, const Vector3& end, Random& random);
+		CUDA_CALLABLE static VolumeEffect calculateVolumeEffect(const Scene& scene, const Vector3& start, const Vector3& end, Sampler& sampler);
 
 		IntegratorType type = IntegratorType::PATH;
 
@@ -8,11 +8,11 @@
 #include "Core/Scene.h"
 #include "Materials/Material.h"
 #include "Integrators/PathIntegrator.h"
-#include "Math/Random.h"
+#include "Math/Sampler.h"
 
 using namespace Valo;
 
-CUDA_CALLABLE Color PathIntegrator::calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Random& random) const
+CUDA_CALLABLE Color PathIntegrator::calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler) const
 {
 	Color result(0.0f, 0.0f, 0.0f);
 
@@ -30,12 +30,12 @@ CUDA_CALLABLE Color PathIntegrator::calculateLight(const Scene& scene, const Int
 		const Material& material = scene.getMaterial(pathIntersection.materialIndex);
 
 		if (pathLength == 1 && !pathIntersection.isBehind && material.showEmittance && material.isEmissive())
-			result += pathThroughput * material.getEmittance(scene, pathIntersection.texcoord, pathIntersection.position);
+			result += pathThroughput * material.getEmittance(scene, pathIntersection.texcoord, pathIntersection.position, pathIntersection.texcoordFootprint);
 
 		Vector3 in = -pathRay.direction;
-		Vector3 out = material.getDirection(pathIntersection, random);
+		Vector3 out = material.getDirection(pathIntersection, sampler);
 
-		Intersection emissiveIntersection = Integrator::getRandomEmissiveIntersection(scene, random);
+		Intersection emissiveIntersection = Integrator::getRandomEmissiveIntersection(scene, sampler);
 
 		if (Integrator::isIntersectionVisible(scene, pathIntersection, emissiveIntersection))
 		{
@@ -50,9 +50,14 @@ CUDA_CALLABLE Color PathIntegrator::calculateLight(const Scene& scene, const Int
 			}
 		}
 
+		// keep the cone growing along the path, surface curvature is not taken into account
+		float coneSpread = pathRay.coneSpread;
+
 		pathRay = Ray();
 		pathRay.origin = pathIntersection.position;
 		pathRay.direction = out;
+		pathRay.coneWidth = pathIntersection.coneWidth;
+		pathRay.coneSpread = coneSpread;
 		pathRay.minDistance = scene.general.rayMinDistance;
 		pathRay.precalculate();
 
@@ -96,7 +101,7 @@ CUDA_CALLABLE Color PathIntegrator::calculateLight(const Scene& scene, const Int
 
 		if (pathLength >= minPathLength)
 		{
-			if (random.getFloat() < terminationProbability)
+			if (sampler.getFloat() < terminationProbability)
 				break;
 
 			pathThroughput /= (1.0f - terminationProbability);
@@ -11,13 +11,13 @@ namespace Valo
 	class Scene;
 	class Intersection;
 	class Ray;
-	class Random;
+	class Sampler;
 
 	class PathIntegrator
 	{
 	public:
 
-		CUDA_CALLABLE Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Random& random) const;
+		CUDA_CALLABLE Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler) const;
 
 		uint32_t minPathLength = 2;
 		uint32_t maxPathLength = 6;
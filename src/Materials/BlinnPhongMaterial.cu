@@ -9,15 +9,15 @@
 #include "Materials/Material.h"
 #include "Math/Mapper.h"
 #include "Textures/Texture.h"
-#include "Math/Random.h"
+#include "Math/Sampler.h"
 
 using namespace Valo;
 
-CUDA_CALLABLE Vector3 BlinnPhongMaterial::getDirection(const Material& material, const Intersection& intersection, Random& random) const
+CUDA_CALLABLE Vector3 BlinnPhongMaterial::getDirection(const Material& material, const Intersection& intersection, Sampler& sampler) const
 {
 	(void)material;
 
-	return Mapper::mapToCosineHemisphere(random.getVector2(), intersection.onb);
+	return Mapper::mapToCosineHemisphere(sampler.getVector2(), intersection.onb);
 }
 
 CUDA_CALLABLE Color BlinnPhongMaterial::getBrdf(const Scene& scene, const Material& material, const Intersection& intersection, const Vector3& in, const Vector3& out) const
@@ -25,7 +25,7 @@ CUDA_CALLABLE Color BlinnPhongMaterial::getBrdf(const Scene& scene, const Materi
 	(void)in;
 	(void)out;
 
-	return material.getReflectance(scene, intersection.texcoord, intersection.position) / float(M_PI);
+	return material.getReflectance(scene, intersection.texcoord, intersection.position, intersection.texcoordFootprint) / float(M_PI);
 }
 
 CUDA_CALLABLE float BlinnPhongMaterial::getPdf(const Material& material, const Intersection& intersection, const Vector3& out) const
@@ -35,18 +35,18 @@ CUDA_CALLABLE float BlinnPhongMaterial::getPdf(const Material& material, const I
 	return intersection.normal.dot(out) / float(M_PI);
 }
 
-CUDA_CALLABLE Color BlinnPhongMaterial::getSpecularReflectance(const Scene& scene, const Vector2& texcoord, const Vector3& position) const
+CUDA_CALLABLE Color BlinnPhongMaterial::getSpecularReflectance(const Scene& scene, const Vector2& texcoord, const Vector3& position, float texcoordFootprint) const
 {
 	if (specularReflectanceTextureIndex != -1)
-		return scene.getTexture(specularReflectanceTextureIndex).getColor(scene, texcoord, position);
+		return scene.getTexture(specularReflectanceTextureIndex).getColor(scene, texcoord, position, texcoordFootprint);
 	else
 		return specularReflectance;
 }
 
-CUDA_CALLABLE Color BlinnPhongMaterial::getGlossiness(const Scene& scene, const Vector2& texcoord, const Vector3& position) const
+CUDA_CALLABLE Color BlinnPhongMaterial::getGlossiness(const Scene& scene, const Vector2& texcoord, const Vector3& position, float texcoordFootprint) const
 {
 	if (glossinessTextureIndex != -1)
-		return scene.getTexture(glossinessTextureIndex).getColor(scene, texcoord, position);
+		return scene.getTexture(glossinessTextureIndex).getColor(scene, texcoord, position, texcoordFootprint);
 	else
 		return glossiness;
 }
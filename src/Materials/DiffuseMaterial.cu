@@ -7,15 +7,15 @@
 #include "Materials/DiffuseMaterial.h"
 #include "Materials/Material.h"
 #include "Math/Mapper.h"
-#include "Math/Random.h"
+#include "Math/Sampler.h"
 
 using namespace Valo;
 
-CUDA_CALLABLE Vector3 DiffuseMaterial::getDirection(const Material& material, const Intersection& intersection, Random& random) const
+CUDA_CALLABLE Vector3 DiffuseMaterial::getDirection(const Material& material, const Intersection& intersection, Sampler& sampler) const
 {
 	(void)material;
 
-	return Mapper::mapToCosineHemisphere(random.getVector2(), intersection.onb);
+	return Mapper::mapToCosineHemisphere(sampler.getVector2(), intersection.onb);
 }
 
 CUDA_CALLABLE Color DiffuseMaterial::getBrdf(const Scene& scene, const Material& material, const Intersection& intersection, const Vector3& in, const Vector3& out) const
@@ -23,7 +23,7 @@ CUDA_CALLABLE Color DiffuseMaterial::getBrdf(const Scene& scene, const Material&
 	(void)in;
 	(void)out;
 
-	return material.getReflectance(scene, intersection.texcoord, intersection.position) / float(M_PI);
+	return material.getReflectance(scene, intersection.texcoord, intersection.position, intersection.texcoordFootprint) / float(M_PI);
 }
 
 CUDA_CALLABLE float DiffuseMaterial::getPdf(const Material& material, const Intersection& intersection, const Vector3& out) const
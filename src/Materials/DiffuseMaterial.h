@@ -10,7 +10,7 @@ namespace Valo
 	class Scene;
 	class Vector3;
 	class Intersection;
-	class Random;
+	class Sampler;
 	class Color;
 	class Material;
 
@@ -18,7 +18,7 @@ namespace Valo
 	{
 	public:
 
-		CUDA_CALLABLE Vector3 getDirection(const Material& material, const Intersection& intersection, Random& random) const;
+		CUDA_CALLABLE Vector3 getDirection(const Material& material, const Intersection& intersection, Sampler& sampler) const;
 		CUDA_CALLABLE Color getBrdf(const Scene& scene, const Material& material, const Intersection& intersection, const Vector3& in, const Vector3& out) const;
 		CUDA_CALLABLE float getPdf(const Material& material, const Intersection& intersection, const Vector3& out) const;
 	};
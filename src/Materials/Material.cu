@@ -10,12 +10,12 @@
 
 using namespace Valo;
 
-CUDA_CALLABLE Vector3 Material::getDirection(const Intersection& intersection, Random& random) const
+CUDA_CALLABLE Vector3 Material::getDirection(const Intersection& intersection, Sampler& sampler) const
 {
 	switch (type)
 	{
-		case MaterialType::DIFFUSE: return diffuseMaterial.getDirection(*this, intersection, random);
-		case MaterialType::BLINN_PHONG: return blinnPhongMaterial.getDirection(*this, intersection, random);
+		case MaterialType::DIFFUSE: return diffuseMaterial.getDirection(*this, intersection, sampler);
+		case MaterialType::BLINN_PHONG: return blinnPhongMaterial.getDirection(*this, intersection, sampler);
 		default: return Vector3();
 	}
 }
@@ -45,18 +45,18 @@ CUDA_CALLABLE bool Material::isEmissive() const
 	return emittanceTextureIndex != -1 || !emittance.isZero();
 }
 
-CUDA_CALLABLE Color Material::getEmittance(const Scene& scene, const Vector2& texcoord, const Vector3& position) const
+CUDA_CALLABLE Color Material::getEmittance(const Scene& scene, const Vector2& texcoord, const Vector3& position, float texcoordFootprint) const
 {
 	if (emittanceTextureIndex != -1)
-		return scene.getTexture(emittanceTextureIndex).getColor(scene, texcoord, position);
+		return scene.getTexture(emittanceTextureIndex).getColor(scene, texcoord, position, texcoordFootprint);
 	else
 		return emittance;
 }
 
-CUDA_CALLABLE Color Material::getReflectance(const Scene& scene, const Vector2& texcoord, const Vector3& position) const
+CUDA_CALLABLE Color Material::getReflectance(const Scene& scene, const Vector2& texcoord, const Vector3& position, float texcoordFootprint) const
 {
 	if (reflectanceTextureIndex != -1)
-		return scene.getTexture(reflectanceTextureIndex).getColor(scene, texcoord, position);
+		return scene.getTexture(reflectanceTextureIndex).getColor(scene, texcoord, position, texcoordFootprint);
 	else
 		return reflectance;
 }
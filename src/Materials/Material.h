@@ -19,13 +19,13 @@ namespace Valo
 	{
 	public:
 
-		CUDA_CALLABLE Vector3 getDirection(const Intersection& intersection, Random& random) const;
+		CUDA_CALLABLE Vector3 getDirection(const Intersection& intersection, Sampler& sampler) const;
 		CUDA_CALLABLE Color getBrdf(const Scene& scene, const Intersection& intersection, const Vector3& in, const Vector3& out) const;
 		CUDA_CALLABLE float getPdf(const Intersection& intersection, const Vector3& out) const;
 
 		CUDA_CALLABLE bool isEmissive() const;
-		CUDA_CALLABLE Color getEmittance(const Scene& scene, const Vector2& texcoord, const Vector3& position) const;
-		CUDA_CALLABLE Color getReflectance(const Scene& scene, const Vector2& texcoord, const Vector3& position) const;
+		CUDA_CALLABLE Color getEmittance(const Scene& scene, const Vector2& texcoord, const Vector3& position, float texcoordFootprint = 0.0f) const;
+		CUDA_CALLABLE Color getReflectance(const Scene& scene, const Vector2& texcoord, const Vector3& position, float texcoordFootprint = 0.0f) const;
 
 		uint32_t id = 0;
 		MaterialType type = MaterialType::DIFFUSE;
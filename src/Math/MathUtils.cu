@@ -4,6 +4,7 @@
 #include "Precompiled.h"
 
 #include "Math/MathUtils.h"
+#include "Math/Vector3.h"
 
 using namespace Valo;
 
@@ -66,3 +67,123 @@ CUDA_CALLABLE float MathUtils::fastPow(float a, float b)
 
 	return float(u.d);
 }
+
+// IEEE 754 binary16, rounds to nearest even
+CUDA_CALLABLE uint16_t MathUtils::floatToHalf(float value)
+{
+	union
+	{
+		float f;
+		uint32_t i;
+	} u = {value};
+
+	uint32_t sign = (u.i >> 16) & 0x8000;
+	uint32_t floatExponent = (u.i >> 23) & 0xff;
+	uint32_t mantissa = u.i & 0x7fffff;
+	int32_t exponent = int32_t(floatExponent) - 127 + 15;
+
+	// inf and nan
+	if (floatExponent == 0xff)
+		return uint16_t(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+
+	if (exponent >= 31)
+		return uint16_t(sign | 0x7c00);
+
+	// subnormal or zero
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return uint16_t(sign);
+
+		mantissa |= 0x800000;
+		uint32_t shift = uint32_t(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+
+		if (remainder > halfway || (remainder == halfway && (half & 1)))
+			++half;
+
+		return uint16_t(sign | half);
+	}
+
+	uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1fff;
+
+	// a carry into the exponent is the correct result
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+		++half;
+
+	return uint16_t(half);
+}
+
+CUDA_CALLABLE float MathUtils::halfToFloat(uint16_t value)
+{
+	uint32_t sign = uint32_t(value & 0x8000) << 16;
+	uint32_t exponent = (value >> 10) & 0x1f;
+	uint32_t mantissa = value & 0x3ff;
+
+	union
+	{
+		uint32_t i;
+		float f;
+	} u;
+
+	if (exponent == 0)
+	{
+		float result = float(mantissa) * (1.0f / 16777216.0f);
+		return sign ? -result : result;
+	}
+	else if (exponent == 31)
+		u.i = sign | 0x7f800000 | (mantissa << 13);
+	else
+		u.i = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+	return u.f;
+}
+
+namespace
+{
+	CUDA_CALLABLE float signNotZero(float value)
+	{
+		return (value >= 0.0f) ? 1.0f : -1.0f;
+	}
+}
+
+// unit vector as 2 x 16 bit octahedral coordinates
+// http://jcgt.org/published/0003/02/01/
+CUDA_CALLABLE uint32_t MathUtils::encodeOctahedral(const Vector3& direction)
+{
+	float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	float x = (length > 0.0f) ? direction.x / length : 0.0f;
+	float y = (length > 0.0f) ? direction.y / length : 0.0f;
+
+	if (direction.z < 0.0f)
+	{
+		float foldedX = (1.0f - std::abs(y)) * signNotZero(x);
+		float foldedY = (1.0f - std::abs(x)) * signNotZero(y);
+
+		x = foldedX;
+		y = foldedY;
+	}
+
+	uint32_t ux = uint32_t(MIN(MAX(x * 0.5f + 0.5f, 0.0f), 1.0f) * 65535.0f + 0.5f);
+	uint32_t uy = uint32_t(MIN(MAX(y * 0.5f + 0.5f, 0.0f), 1.0f) * 65535.0f + 0.5f);
+
+	return ux | (uy << 16);
+}
+
+CUDA_CALLABLE Vector3 MathUtils::decodeOctahedral(uint32_t value)
+{
+	float x = float(value & 0xffff) * (2.0f / 65535.0f) - 1.0f;
+	float y = float(value >> 16) * (2.0f / 65535.0f) - 1.0f;
+	Vector3 result(x, y, 1.0f - std::abs(x) - std::abs(y));
+
+	if (result.z < 0.0f)
+	{
+		result.x = (1.0f - std::abs(y)) * signNotZero(x);
+		result.y = (1.0f - std::abs(x)) * signNotZero(y);
+	}
+
+	return result.normalized();
+}
@@ -10,6 +10,8 @@
 
 namespace Valo
 {
+	class Vector3;
+
 	class MathUtils
 	{
 	public:
@@ -22,5 +24,9 @@ namespace Valo
 		CUDA_CALLABLE static float smoothstep(float t);
 		CUDA_CALLABLE static float smootherstep(float t);
 		CUDA_CALLABLE static float fastPow(float a, float b);
+		CUDA_CALLABLE static uint16_t floatToHalf(float value);
+		CUDA_CALLABLE static float halfToFloat(uint16_t value);
+		CUDA_CALLABLE static uint32_t encodeOctahedral(const Vector3& direction);
+		CUDA_CALLABLE static Vector3 decodeOctahedral(uint32_t value);
 	};
 }
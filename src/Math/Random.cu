@@ -31,10 +31,14 @@ CUDA_CALLABLE RandomGenerator::RandomGenerator(RandomGeneratorState state_)
 	seed(state_);
 }
 
+// pcg32_srandom_r, the stream does not depend on the object address
 CUDA_CALLABLE void RandomGenerator::seed(uint64_t seed_)
 {
-	state.state = seed_;
-	state.inc = reinterpret_cast<uint64_t>(this);
+	state.state = 0;
+	state.inc = (0xda3e39cb94b95bdbULL << 1u) | 1u;
+	(*this)();
+	state.state += seed_;
+	(*this)();
 }
 
 CUDA_CALLABLE void RandomGenerator::seed(RandomGeneratorState state_)
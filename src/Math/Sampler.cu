@@ -0,0 +1,233 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include "Math/Sampler.h"
+#include "Math/Vector2.h"
+
+using namespace Valo;
+
+namespace
+{
+	CUDA_CALLABLE uint32_t reverseBits(uint32_t x)
+	{
+		x = (x << 16) | (x >> 16);
+		x = ((x & 0x00ff00ff) << 8) | ((x & 0xff00ff00) >> 8);
+		x = ((x & 0x0f0f0f0f) << 4) | ((x & 0xf0f0f0f0) >> 4);
+		x = ((x & 0x33333333) << 2) | ((x & 0xcccccccc) >> 2);
+		x = ((x & 0x55555555) << 1) | ((x & 0xaaaaaaaa) >> 1);
+
+		return x;
+	}
+
+	// https://nullprogram.com/blog/2018/07/31/
+	CUDA_CALLABLE uint32_t hash(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352d;
+		x ^= x >> 15;
+		x *= 0x846ca68b;
+		x ^= x >> 16;
+
+		return x;
+	}
+
+	CUDA_CALLABLE uint32_t hashCombine(uint32_t seed, uint32_t value)
+	{
+		return seed ^ (hash(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+	}
+
+	CUDA_CALLABLE uint32_t laineKarrasPermutation(uint32_t x, uint32_t seed)
+	{
+		x += seed;
+		x ^= x * 0x6c50b47c;
+		x ^= x * 0xb82f1e52;
+		x ^= x * 0xc7afe638;
+		x ^= x * 0x8d22f6e6;
+
+		return x;
+	}
+
+	CUDA_CALLABLE uint32_t nestedUniformScramble(uint32_t x, uint32_t seed)
+	{
+		return reverseBits(laineKarrasPermutation(reverseBits(x), seed));
+	}
+
+	// first two Sobol dimensions, the results are bit reversed
+	CUDA_CALLABLE uint32_t sobolReversed(uint32_t index, uint32_t dimension)
+	{
+		if (dimension == 0)
+			return index;
+
+		uint32_t result = 0;
+		uint32_t direction = 1;
+
+		for (; index != 0; index >>= 1)
+		{
+			if (index & 1)
+				result ^= direction;
+
+			direction ^= direction << 1;
+		}
+
+		return result;
+	}
+
+	CUDA_CALLABLE float toFloat(uint32_t x)
+	{
+		return float(x >> 8) * (1.0f / 16777216.0f);
+	}
+
+	CUDA_CALLABLE float wrap(float x)
+	{
+		return (x >= 1.0f) ? x - 1.0f : x;
+	}
+}
+
+CUDA_CALLABLE Sampler::Sampler(SamplerType type_) : type(type_)
+{
+}
+
+CUDA_CALLABLE void Sampler::startSample(uint32_t x, uint32_t y, uint32_t sampleIndex)
+{
+	index = sampleIndex;
+	dimension = 0;
+
+	switch (type)
+	{
+		case SamplerType::RANDOM:
+		case SamplerType::SOBOL:
+			seed = hashCombine(hash(x), y);
+			break;
+
+		case SamplerType::BLUE_NOISE:
+		{
+			// R2 dither, http://extremelearning.com.au/unreasonable-effectiveness-of-quasirandom-sequences/
+			float value = 0.7548776662f * float(x) + 0.5698402910f * float(y);
+			dither = value - float(uint32_t(value));
+			seed = 0;
+		} break;
+
+		default: break;
+	}
+}
+
+CUDA_CALLABLE float Sampler::getDither(uint32_t dimension_, uint32_t offset) const
+{
+	return wrap(dither + toFloat(hashCombine(dimension_, offset)));
+}
+
+CUDA_CALLABLE float Sampler::generateFloat(uint32_t dimension_) const
+{
+	if (type == SamplerType::RANDOM)
+		return toFloat(hash(hashCombine(hashCombine(seed, index), dimension_)));
+
+	uint32_t dimensionSeed = hashCombine(seed, dimension_);
+	uint32_t shuffledIndex = nestedUniformScramble(index, dimensionSeed);
+	float result = toFloat(reverseBits(laineKarrasPermutation(sobolReversed(shuffledIndex, 0), hashCombine(dimensionSeed, 0))));
+
+	if (type == SamplerType::BLUE_NOISE)
+		result = wrap(result + getDither(dimension_, 0));
+
+	return result;
+}
+
+CUDA_CALLABLE float Sampler::getFloat()
+{
+	return generateFloat(dimension++);
+}
+
+CUDA_CALLABLE Vector2 Sampler::getVector2()
+{
+	Vector2 result;
+
+	if (type == SamplerType::RANDOM)
+	{
+		result.x = generateFloat(dimension);
+		result.y = generateFloat(dimension + 1);
+		dimension += 2;
+
+		return result;
+	}
+
+	uint32_t dimensionSeed = hashCombine(seed, dimension);
+	uint32_t shuffledIndex = nestedUniformScramble(index, dimensionSeed);
+
+	result.x = toFloat(reverseBits(laineKarrasPermutation(sobolReversed(shuffledIndex, 0), hashCombine(dimensionSeed, 0))));
+	result.y = toFloat(reverseBits(laineKarrasPermutation(sobolReversed(shuffledIndex, 1), hashCombine(dimensionSeed, 1))));
+
+	if (type == SamplerType::BLUE_NOISE)
+	{
+		result.x = wrap(result.x + getDither(dimension, 0));
+		result.y = wrap(result.y + getDither(dimension, 1));
+	}
+
+	dimension += 2;
+	return result;
+}
+
+CUDA_CALLABLE uint32_t Sampler::getUint32(uint32_t min, uint32_t max)
+{
+	uint32_t range = max - min + 1;
+	return min + MIN(uint32_t(getFloat() * float(range)), range - 1);
+}
+
+// same values as generateFloat, the type is switched on once so that the loops are branch free and vectorize
+void Sampler::getFloats(float* values, uint32_t count)
+{
+	const uint32_t firstDimension = dimension;
+
+	switch (type)
+	{
+		case SamplerType::RANDOM:
+		{
+			const uint32_t indexSeed = hashCombine(seed, index);
+
+			#pragma omp simd
+			for (uint32_t i = 0; i < count; ++i)
+				values[i] = toFloat(hash(hashCombine(indexSeed, firstDimension + i)));
+
+		} break;
+
+		case SamplerType::SOBOL:
+		{
+			#pragma omp simd
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				uint32_t dimensionSeed = hashCombine(seed, firstDimension + i);
+				uint32_t shuffledIndex = nestedUniformScramble(index, dimensionSeed);
+				values[i] = toFloat(reverseBits(laineKarrasPermutation(shuffledIndex, hashCombine(dimensionSeed, 0))));
+			}
+
+		} break;
+
+		case SamplerType::BLUE_NOISE:
+		{
+			#pragma omp simd
+			for (uint32_t i = 0; i < count; ++i)
+			{
+				uint32_t dimensionSeed = hashCombine(seed, firstDimension + i);
+				uint32_t shuffledIndex = nestedUniformScramble(index, dimensionSeed);
+				float value = toFloat(reverseBits(laineKarrasPermutation(shuffledIndex, hashCombine(dimensionSeed, 0))));
+				values[i] = wrap(value + wrap(dither + toFloat(hashCombine(firstDimension + i, 0))));
+			}
+
+		} break;
+
+		default: break;
+	}
+
+	dimension += count;
+}
+
+std::string Sampler::getName() const
+{
+	switch (type)
+	{
+		case SamplerType::RANDOM: return "random";
+		case SamplerType::SOBOL: return "sobol";
+		case SamplerType::BLUE_NOISE: return "blue_noise";
+		default: return "unknown";
+	}
+}
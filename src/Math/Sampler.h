@@ -0,0 +1,61 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <string>
+
+#include "Core/Common.h"
+
+/*
+
+Sample stream for a single pixel sample. Call startSample before generating the values for a new sample.
+Every getFloat/getVector2/getUint32 call consumes the next dimension(s) of the stream.
+getFloats generates a batch of consecutive dimensions with a vectorizable loop.
+
+All values are pure functions of (pixel, sample index, dimension), so renders are reproducible
+regardless of thread count, scheduling or the machine they are run on.
+
+RANDOM: counter-based hash of (pixel, sample index, dimension)
+SOBOL: Owen-scrambled and shuffled Sobol (0,2)-sequence padded over dimension pairs, decorrelated per pixel
+BLUE_NOISE: same sequence for all pixels, toroidally shifted per pixel with a blue-noise-like dither
+
+https://www.jcgt.org/published/0009/04/01/
+
+*/
+
+namespace Valo
+{
+	class Vector2;
+
+	enum class SamplerType { RANDOM, SOBOL, BLUE_NOISE };
+
+	class Sampler
+	{
+	public:
+
+		CUDA_CALLABLE explicit Sampler(SamplerType type = SamplerType::RANDOM);
+
+		CUDA_CALLABLE void startSample(uint32_t x, uint32_t y, uint32_t sampleIndex);
+
+		CUDA_CALLABLE float getFloat();
+		CUDA_CALLABLE Vector2 getVector2();
+		CUDA_CALLABLE uint32_t getUint32(uint32_t min, uint32_t max);
+
+		void getFloats(float* values, uint32_t count);
+
+		std::string getName() const;
+
+		SamplerType type = SamplerType::RANDOM;
+
+	private:
+
+		CUDA_CALLABLE float generateFloat(uint32_t dimension) const;
+		CUDA_CALLABLE float getDither(uint32_t dimension, uint32_t offset) const;
+
+		uint32_t seed = 0;
+		uint32_t index = 0;
+		uint32_t dimension = 0;
+		float dither = 0.0f;
+	};
+}
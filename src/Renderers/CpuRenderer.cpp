@@ -9,132 +9,218 @@
 #include "Core/Ray.h"
 #include "Core/Scene.h"
 #include "Core/Intersection.h"
+#include "Math/Sampler.h"
 #include "Renderers/CpuRenderer.h"
 #include "Renderers/Renderer.h"
+#include "Renderers/RenderJournal.h"
 #include "Utils/Settings.h"
 #include "App.h"
 
 using namespace Valo;
 
-void CpuRenderer::initialize()
+namespace
 {
-	omp_set_num_threads(maxThreadCount);
-	uint32_t maxThreads = MAX(1, omp_get_max_threads());
+	enum RenderPassFlags { FILTERING = 1, VOLUME = 2, NORMAL_VISUALIZATION = 4 };
 
-	assert(maxThreads >= 1);
+	template <IntegratorType integratorType>
+	Color calculateLight(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler);
 
-	if (maxThreads != randoms.size())
+	template <>
+	Color calculateLight<IntegratorType::PATH>(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler)
 	{
-		randoms.resize(maxThreads);
-		std::random_device rd;
-		std::mt19937_64 generator(rd());
+		return scene.integrator.pathIntegrator.calculateLight(scene, intersection, ray, sampler);
+	}
 
-		for (Random& random : randoms)
-			random.seed(generator());
+	template <>
+	Color calculateLight<IntegratorType::DOT>(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler)
+	{
+		return scene.integrator.dotIntegrator.calculateLight(scene, intersection, ray, sampler);
 	}
-}
 
-void CpuRenderer::resize(uint32_t width, uint32_t height)
-{
-	(void)width;
-	(void)height;
-}
+	template <>
+	Color calculateLight<IntegratorType::AMBIENT_OCCLUSION>(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler)
+	{
+		return scene.integrator.aoIntegrator.calculateLight(scene, intersection, ray, sampler);
+	}
 
-void CpuRenderer::render(RenderJob& job, bool filtering)
-{
-	Scene& scene = *job.scene;
-	Film& film = *job.film;
-	Settings& settings = App::getSettings();
+	template <>
+	Color calculateLight<IntegratorType::DIRECT_LIGHT>(const Scene& scene, const Intersection& intersection, const Ray& ray, Sampler& sampler)
+	{
+		return scene.integrator.directIntegrator.calculateLight(scene, intersection, ray, sampler);
+	}
 
-	std::mutex ompThreadExceptionMutex;
-	std::exception_ptr ompThreadException = nullptr;
+	template <IntegratorType integratorType, CameraType cameraType, uint32_t flags>
+	void renderPass(RenderJob& job, const std::vector<RenderBucket*>& buckets)
+	{
+		Scene& scene = *job.scene;
+		Film& film = *job.film;
+		Settings& settings = App::getSettings();
 
-	const uint32_t filmWidth = film.getWidth();
-	const uint32_t filmHeight = film.getHeight();
-	const int32_t pixelCount = int32_t(filmWidth * filmHeight);
+		std::mutex ompThreadExceptionMutex;
+		std::exception_ptr ompThreadException = nullptr;
 
-	#pragma omp parallel for schedule(dynamic, 1000)
-	for (int32_t pixelIndex = 0; pixelIndex < pixelCount; ++pixelIndex)
-	{
-		try
-		{
-			if ((pixelIndex + 1) % 100 == 0)
-				job.totalSampleCount += 100 * settings.renderer.pixelSamples;
+		const uint32_t filmWidth = film.getWidth();
+		const int32_t bucketCount = int32_t(buckets.size());
+		const uint32_t firstSampleIndex = film.pixelSamples;
+		const uint32_t pixelSamples = settings.renderer.pixelSamples;
 
-			for (uint32_t i = 0; i < settings.renderer.pixelSamples; ++i)
+		#pragma omp parallel for schedule(dynamic, 1)
+		for (int32_t bucketIndex = 0; bucketIndex < bucketCount; ++bucketIndex)
+		{
+			try
 			{
+				// buckets are only skipped as a whole so that the film never holds a partial bucket
 				if (job.interrupted)
 					continue;
 
-				float x = float(uint32_t(pixelIndex) % filmWidth);
-				float y = float(uint32_t(pixelIndex) / filmWidth);
-
-				Random& random = randoms[omp_get_thread_num()];
+				RenderBucket& bucket = *buckets[bucketIndex];
 
-				Vector2 pixel = Vector2(x, y);
-				float filterWeight = 1.0f;
-
-				if (filtering && scene.renderer.filtering)
+				for (uint32_t y = bucket.y; y < bucket.y + bucket.height; ++y)
 				{
-					Vector2 offset = (random.getVector2() - Vector2(0.5f, 0.5f)) * 2.0f * scene.renderer.filter.getRadius();
-					filterWeight = scene.renderer.filter.getWeight(offset);
-					pixel += offset;
+					for (uint32_t x = bucket.x; x < bucket.x + bucket.width; ++x)
+					{
+						const uint32_t pixelIndex = y * filmWidth + x;
+						Sampler sampler(scene.renderer.samplerType);
+
+						for (uint32_t i = 0; i < pixelSamples; ++i)
+						{
+							sampler.startSample(x, y, firstSampleIndex + i);
+
+							Vector2 pixel = Vector2(float(x), float(y));
+							float filterWeight = 1.0f;
+
+							if (flags & FILTERING)
+							{
+								FilterSample filterSample = scene.renderer.filter.getSample(sampler.getVector2());
+								filterWeight = filterSample.weight;
+								pixel += filterSample.offset;
+							}
+
+							CameraRay cameraRay = scene.camera.getRay<cameraType>(pixel, sampler);
+							cameraRay.ray.isPrimaryRay = true;
+
+							if (cameraRay.offLens)
+							{
+								film.addSample(pixelIndex, scene.general.offLensColor, filterWeight);
+								continue;
+							}
+
+							Intersection intersection;
+
+							if (!scene.intersect(cameraRay.ray, intersection))
+							{
+								film.addSample(pixelIndex, scene.general.backgroundColor * cameraRay.brightness, filterWeight);
+								continue;
+							}
+
+							if (intersection.hasColor)
+							{
+								film.addSample(pixelIndex, intersection.color * cameraRay.brightness, filterWeight);
+								continue;
+							}
+
+							scene.calculateNormalMapping(intersection);
+
+							if (flags & NORMAL_VISUALIZATION)
+							{
+								film.addSample(pixelIndex, Color::fromNormal(intersection.normal) * cameraRay.brightness, filterWeight);
+								continue;
+							}
+
+							Color color = calculateLight<integratorType>(scene, intersection, cameraRay.ray, sampler);
+
+							if (flags & VOLUME)
+							{
+								VolumeEffect volumeEffect = Integrator::calculateVolumeEffect(scene, cameraRay.ray.origin, intersection.position, sampler);
+								color = color * volumeEffect.transmittance + volumeEffect.emittance;
+							}
+				
+							if (!color.isNegative() && !color.isNan())
+								film.addSample(pixelIndex, color * cameraRay.brightness, filterWeight);
+						}
+					}
 				}
 
-				CameraRay cameraRay = scene.camera.getRay(pixel, random);
-				cameraRay.ray.isPrimaryRay = true;
+				job.totalSampleCount += bucket.width * bucket.height * pixelSamples;
+				bucket.completed = true;
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(ompThreadExceptionMutex);
 
-				if (cameraRay.offLens)
-				{
-					film.addSample(pixelIndex, scene.general.offLensColor, filterWeight);
-					continue;
-				}
+				if (ompThreadException == nullptr)
+					ompThreadException = std::current_exception();
 
-				Intersection intersection;
+				job.interrupted = true;
+			}
+		}
 
-				if (!scene.intersect(cameraRay.ray, intersection))
-				{
-					film.addSample(pixelIndex, scene.general.backgroundColor * cameraRay.brightness, filterWeight);
-					continue;
-				}
+		if (ompThreadException != nullptr)
+			std::rethrow_exception(ompThreadException);
+	}
 
-				if (intersection.hasColor)
-				{
-					film.addSample(pixelIndex, intersection.color * cameraRay.brightness, filterWeight);
-					continue;
-				}
+	template <IntegratorType integratorType, CameraType cameraType>
+	void dispatchFlags(RenderJob& job, const std::vector<RenderBucket*>& buckets, uint32_t flags)
+	{
+		switch (flags)
+		{
+			case 0: renderPass<integratorType, cameraType, 0>(job, buckets); break;
+			case 1: renderPass<integratorType, cameraType, 1>(job, buckets); break;
+			case 2: renderPass<integratorType, cameraType, 2>(job, buckets); break;
+			case 3: renderPass<integratorType, cameraType, 3>(job, buckets); break;
+			case 4: renderPass<integratorType, cameraType, 4>(job, buckets); break;
+			case 5: renderPass<integratorType, cameraType, 5>(job, buckets); break;
+			case 6: renderPass<integratorType, cameraType, 6>(job, buckets); break;
+			case 7: renderPass<integratorType, cameraType, 7>(job, buckets); break;
+			default: break;
+		}
+	}
 
-				scene.calculateNormalMapping(intersection);
+	template <IntegratorType integratorType>
+	void dispatchCamera(RenderJob& job, const std::vector<RenderBucket*>& buckets, CameraType cameraType, uint32_t flags)
+	{
+		switch (cameraType)
+		{
+			case CameraType::PERSPECTIVE: dispatchFlags<integratorType, CameraType::PERSPECTIVE>(job, buckets, flags); break;
+			case CameraType::ORTHOGRAPHIC: dispatchFlags<integratorType, CameraType::ORTHOGRAPHIC>(job, buckets, flags); break;
+			case CameraType::FISHEYE: dispatchFlags<integratorType, CameraType::FISHEYE>(job, buckets, flags); break;
+			default: break;
+		}
+	}
+}
 
-				if (scene.general.normalVisualization)
-				{
-					film.addSample(pixelIndex, Color::fromNormal(intersection.normal) * cameraRay.brightness, filterWeight);
-					continue;
-				}
+void CpuRenderer::initialize()
+{
+	omp_set_num_threads(maxThreadCount);
+}
 
-				Color color = scene.integrator.calculateLight(scene, intersection, cameraRay.ray, random);
+void CpuRenderer::resize(uint32_t width, uint32_t height)
+{
+	(void)width;
+	(void)height;
+}
 
-				if (scene.volume.enabled)
-				{
-					VolumeEffect volumeEffect = Integrator::calculateVolumeEffect(scene, cameraRay.ray.origin, intersection.position, random);
-					color = color * volumeEffect.transmittance + volumeEffect.emittance;
-				}
-				
-				if (!color.isNegative() && !color.isNan())
-					film.addSample(pixelIndex, color * cameraRay.brightness, filterWeight);
-			}
-		}
-		catch (...)
-		{
-			std::lock_guard<std::mutex> lock(ompThreadExceptionMutex);
+// the scene-constant choices are resolved here once per pass instead of per sample
+void CpuRenderer::render(RenderJob& job, const std::vector<RenderBucket*>& buckets, bool filtering)
+{
+	Scene& scene = *job.scene;
+	uint32_t flags = 0;
 
-			if (ompThreadException == nullptr)
-				ompThreadException = std::current_exception();
+	if (filtering && scene.renderer.filtering)
+		flags |= FILTERING;
 
-			job.interrupted = true;
-		}
-	}
+	if (scene.volume.enabled)
+		flags |= VOLUME;
+
+	if (scene.general.normalVisualization)
+		flags |= NORMAL_VISUALIZATION;
 
-	if (ompThreadException != nullptr)
-		std::rethrow_exception(ompThreadException);
+	switch (scene.integrator.type)
+	{
+		case IntegratorType::PATH: dispatchCamera<IntegratorType::PATH>(job, buckets, scene.camera.type, flags); break;
+		case IntegratorType::DOT: dispatchCamera<IntegratorType::DOT>(job, buckets, scene.camera.type, flags); break;
+		case IntegratorType::AMBIENT_OCCLUSION: dispatchCamera<IntegratorType::AMBIENT_OCCLUSION>(job, buckets, scene.camera.type, flags); break;
+		case IntegratorType::DIRECT_LIGHT: dispatchCamera<IntegratorType::DIRECT_LIGHT>(job, buckets, scene.camera.type, flags); break;
+		default: break;
+	}
 }
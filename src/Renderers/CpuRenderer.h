@@ -3,13 +3,13 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
-#include "Math/Random.h"
-
 namespace Valo
 {
 	struct RenderJob;
+	struct RenderBucket;
 	
 	class CpuRenderer
 	{
@@ -17,12 +17,8 @@ namespace Valo
 
 		void initialize();
 		void resize(uint32_t width, uint32_t height);
-		void render(RenderJob& job, bool filtering);
+		void render(RenderJob& job, const std::vector<RenderBucket*>& buckets, bool filtering);
 
 		int32_t maxThreadCount = 4;
-
-	private:
-
-		std::vector<Random> randoms;
 	};
 }
@@ -20,7 +20,7 @@
 
 using namespace Valo;
 
-CudaRenderer::CudaRenderer() : sceneAlloc(true), filmAlloc(true), randomStatesAlloc(false)
+CudaRenderer::CudaRenderer() : sceneAlloc(true), filmAlloc(true)
 {
 }
 
@@ -32,54 +32,43 @@ void CudaRenderer::initialize()
 
 void CudaRenderer::resize(uint32_t width, uint32_t height)
 {
-	std::vector<RandomGeneratorState> randomStates(width * height);
-
-	std::random_device rd;
-	std::mt19937_64 generator(rd());
-
-	for (RandomGeneratorState& randomState : randomStates)
-	{
-		randomState.state = generator();
-		randomState.inc = generator();
-	}
-
-	randomStatesAlloc.resize(width * height);
-	randomStatesAlloc.write(randomStates.data(), width * height);
+	(void)width;
+	(void)height;
 }
 
 #ifdef USE_CUDA
 
-__global__ void renderKernel(const Scene& scene, Film& film, RandomGeneratorState* randomStates, bool filtering, uint32_t pixelSamples)
+__global__ void renderKernel(const Scene& scene, Film& film, bool filtering, uint32_t pixelSamples, uint32_t firstSampleIndex)
 {
 	uint32_t x = threadIdx.x + blockIdx.x * blockDim.x;
 	uint32_t y = threadIdx.y + blockIdx.y * blockDim.y;
-	uint32_t index = y * film.getWidth() + x;
 
 	if (x >= film.getWidth() || y >= film.getHeight())
 		return;
 
-	Random random(randomStates[index]);
+	Sampler sampler(scene.renderer.samplerType);
 
 	for (uint32_t i = 0; i < pixelSamples; ++i)
 	{
+		sampler.startSample(x, y, firstSampleIndex + i);
+
 		Vector2 pixel = Vector2(x, y);
 		float filterWeight = 1.0f;
 
 		if (filtering && scene.renderer.filtering)
 		{
-			Vector2 offset = (random.getVector2() - Vector2(0.5f, 0.5f)) * 2.0f * scene.renderer.filter.getRadius();
-			filterWeight = scene.renderer.filter.getWeight(offset);
-			pixel += offset;
+			FilterSample filterSample = scene.renderer.filter.getSample(sampler.getVector2());
+			filterWeight = filterSample.weight;
+			pixel += filterSample.offset;
 		}
 
-		CameraRay cameraRay = scene.camera.getRay(pixel, random);
+		CameraRay cameraRay = scene.camera.getRay(pixel, sampler);
 		cameraRay.ray.isPrimaryRay = true;
 
 		if (cameraRay.offLens)
 		{
 			film.addSample(x, y, scene.general.offLensColor, filterWeight);
-			randomStates[index] = random.getState();
-			return;
+			continue;
 		}
 
 		Intersection intersection;
@@ -87,15 +76,13 @@ __global__ void renderKernel(const Scene& scene, Film& film, RandomGeneratorStat
 		if (!scene.intersect(cameraRay.ray, intersection))
 		{
 			film.addSample(x, y, scene.general.backgroundColor, filterWeight);
-			randomStates[index] = random.getState();
-			return;
+			continue;
 		}
 
 		if (intersection.hasColor)
 		{
 			film.addSample(x, y, intersection.color, filterWeight);
-			randomStates[index] = random.getState();
-			return;
+			continue;
 		}
 
 		scene.calculateNormalMapping(intersection);
@@ -103,23 +90,20 @@ __global__ void renderKernel(const Scene& scene, Film& film, RandomGeneratorStat
 		if (scene.general.normalVisualization)
 		{
 			film.addSample(x, y, Color::fromNormal(intersection.normal), filterWeight);
-			randomStates[index] = random.getState();
-			return;
+			continue;
 		}
 
-		Color color = scene.integrator.calculateLight(scene, intersection, cameraRay.ray, random);
+		Color color = scene.integrator.calculateLight(scene, intersection, cameraRay.ray, sampler);
 
 		if (scene.volume.enabled)
 		{
-			VolumeEffect volumeEffect = Integrator::calculateVolumeEffect(scene, cameraRay.ray.origin, intersection.position, random);
+			VolumeEffect volumeEffect = Integrator::calculateVolumeEffect(scene, cameraRay.ray.origin, intersection.position, sampler);
 			color = color * volumeEffect.transmittance + volumeEffect.emittance;
 		}
 
 		if (!color.isNegative() && !color.isNan())
 			film.addSample(x, y, color * cameraRay.brightness, filterWeight);
 	}
-
-	randomStates[index] = random.getState();
 }
 
 void CudaRenderer::render(RenderJob& job, bool filtering)
@@ -128,6 +112,12 @@ void CudaRenderer::render(RenderJob& job, bool filtering)
 	Film& film = *job.film;
 	Settings& settings = App::getSettings();
 
+	if (scene.textureCache.enabled)
+		throw std::runtime_error("The texture cache is not supported by the CUDA renderer");
+
+	if (film.getCumulativeImage().getFormat() != ImageFormat::RGBA32F)
+		throw std::runtime_error("Compact film accumulation is not supported by the CUDA renderer");
+
 	sceneAlloc.write(&scene, 1);
 	filmAlloc.write(&film, 1);
 
@@ -137,7 +127,7 @@ void CudaRenderer::render(RenderJob& job, bool filtering)
 	dimGrid.x = (film.getWidth() + dimBlock.x - 1) / dimBlock.x;
 	dimGrid.y = (film.getHeight() + dimBlock.y - 1) / dimBlock.y;
 
-	renderKernel<<<dimGrid, dimBlock>>>(*sceneAlloc.getDevicePtr(), *filmAlloc.getDevicePtr(), randomStatesAlloc.getDevicePtr(), filtering, settings.renderer.pixelSamples);
+	renderKernel<<<dimGrid, dimBlock>>>(*sceneAlloc.getDevicePtr(), *filmAlloc.getDevicePtr(), filtering, settings.renderer.pixelSamples, film.pixelSamples);
 	CudaUtils::checkError(cudaPeekAtLastError(), "Could not launch render kernel");
 	CudaUtils::checkError(cudaDeviceSynchronize(), "Could not execute render kernel");
 
@@ -10,7 +10,6 @@ namespace Valo
 	struct RenderJob;
 	class Scene;
 	class Film;
-	struct RandomGeneratorState;
 
 	class CudaRenderer
 	{
@@ -26,6 +25,5 @@ namespace Valo
 
 		CudaAlloc<Scene> sceneAlloc;
 		CudaAlloc<Film> filmAlloc;
-		CudaAlloc<RandomGeneratorState> randomStatesAlloc;
 	};
 }
@@ -0,0 +1,239 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include <boost/filesystem.hpp>
+
+#include "tinyformat/tinyformat.h"
+
+#include "Renderers/RenderJournal.h"
+#include "Core/Common.h"
+
+using namespace Valo;
+
+namespace bf = boost::filesystem;
+
+namespace
+{
+	const char MAGIC[4] = { 'V', 'J', 'R', 'N' };
+	const uint32_t VERSION = 1;
+
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t filmWidth;
+		uint32_t filmHeight;
+		uint32_t regionX;
+		uint32_t regionY;
+		uint32_t regionWidth;
+		uint32_t regionHeight;
+		uint32_t bucketSize;
+		uint32_t bucketCount;
+		uint32_t pixelSamples;
+		uint32_t completedPasses;
+		uint32_t filmChecksum;
+		uint32_t reserved;
+		uint64_t sceneHash;
+	};
+
+	static_assert(sizeof(Header) == 64, "Render journal header has wrong size");
+}
+
+void RenderJournal::initialize(uint32_t filmWidth_, uint32_t filmHeight_, uint32_t regionX_, uint32_t regionY_, uint32_t regionWidth_, uint32_t regionHeight_, uint32_t bucketSize_)
+{
+	filmWidth = filmWidth_;
+	filmHeight = filmHeight_;
+
+	// zero width or height extends the region to the film edge
+	regionX = MIN(regionX_, filmWidth);
+	regionY = MIN(regionY_, filmHeight);
+	regionWidth = (regionWidth_ == 0) ? filmWidth - regionX : MIN(regionWidth_, filmWidth - regionX);
+	regionHeight = (regionHeight_ == 0) ? filmHeight - regionY : MIN(regionHeight_, filmHeight - regionY);
+	bucketSize = MAX(uint32_t(1), bucketSize_);
+
+	if (regionWidth == 0 || regionHeight == 0)
+		throw std::runtime_error(tfm::format("Render region is empty (%d, %d, %dx%d) for film size %dx%d", regionX_, regionY_, regionWidth_, regionHeight_, filmWidth, filmHeight));
+
+	buckets.clear();
+
+	for (uint32_t y = regionY; y < regionY + regionHeight; y += bucketSize)
+	{
+		for (uint32_t x = regionX; x < regionX + regionWidth; x += bucketSize)
+		{
+			RenderBucket bucket;
+			bucket.x = x;
+			bucket.y = y;
+			bucket.width = MIN(bucketSize, regionX + regionWidth - x);
+			bucket.height = MIN(bucketSize, regionY + regionHeight - y);
+
+			buckets.push_back(bucket);
+		}
+	}
+
+	restart();
+}
+
+void RenderJournal::load(const std::string& fileName)
+{
+	std::ifstream file(fileName, std::ios::in | std::ios::binary);
+
+	if (!file.is_open())
+		throw std::runtime_error(tfm::format("Could not open the render journal for reading: %s", fileName));
+
+	Header header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (!file || memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+		throw std::runtime_error(tfm::format("Render journal %s is not valid", fileName));
+
+	if (header.version != VERSION)
+		throw std::runtime_error(tfm::format("Render journal %s has an unsupported version (%d)", fileName, header.version));
+
+	if (header.filmWidth != filmWidth || header.filmHeight != filmHeight || header.regionX != regionX || header.regionY != regionY || header.regionWidth != regionWidth || header.regionHeight != regionHeight || header.bucketSize != bucketSize || header.bucketCount != uint32_t(buckets.size()))
+		throw std::runtime_error(tfm::format("Render journal %s was written with a different film size, render region or bucket size", fileName));
+
+	std::vector<uint8_t> completed(buckets.size());
+	file.read(reinterpret_cast<char*>(completed.data()), completed.size());
+
+	if (!file)
+		throw std::runtime_error(tfm::format("Render journal %s is truncated", fileName));
+
+	for (size_t i = 0; i < buckets.size(); ++i)
+		buckets[i].completed = (completed[i] != 0);
+
+	completedPasses = header.completedPasses;
+	pixelSamples = header.pixelSamples;
+	filmChecksum = header.filmChecksum;
+	sceneHash = header.sceneHash;
+}
+
+void RenderJournal::save(const std::string& fileName) const
+{
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+	header.filmWidth = filmWidth;
+	header.filmHeight = filmHeight;
+	header.regionX = regionX;
+	header.regionY = regionY;
+	header.regionWidth = regionWidth;
+	header.regionHeight = regionHeight;
+	header.bucketSize = bucketSize;
+	header.bucketCount = uint32_t(buckets.size());
+	header.pixelSamples = pixelSamples;
+	header.completedPasses = completedPasses;
+	header.filmChecksum = filmChecksum;
+	header.sceneHash = sceneHash;
+
+	std::vector<uint8_t> completed(buckets.size());
+
+	for (size_t i = 0; i < buckets.size(); ++i)
+		completed[i] = buckets[i].completed ? 1 : 0;
+
+	// write to a temporary file first so that a preempted write never replaces the previous journal
+	std::string tempFileName = fileName + ".tmp";
+	std::ofstream file(tempFileName, std::ios::out | std::ios::binary);
+
+	if (!file.is_open())
+		throw std::runtime_error(tfm::format("Could not open the render journal for writing: %s", tempFileName));
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(completed.data()), completed.size());
+	file.close();
+
+	if (file.fail())
+		throw std::runtime_error(tfm::format("Could not write the render journal: %s", tempFileName));
+
+	bf::rename(tempFileName, fileName);
+}
+
+void RenderJournal::restart()
+{
+	completedPasses = 0;
+
+	for (RenderBucket& bucket : buckets)
+		bucket.completed = false;
+}
+
+void RenderJournal::completePass()
+{
+	++completedPasses;
+
+	for (RenderBucket& bucket : buckets)
+		bucket.completed = false;
+}
+
+void RenderJournal::setPassCompleted()
+{
+	for (RenderBucket& bucket : buckets)
+		bucket.completed = true;
+}
+
+bool RenderJournal::isPassCompleted() const
+{
+	for (const RenderBucket& bucket : buckets)
+	{
+		if (!bucket.completed)
+			return false;
+	}
+
+	return true;
+}
+
+bool RenderJournal::coversFilm() const
+{
+	return regionX == 0 && regionY == 0 && regionWidth == filmWidth && regionHeight == filmHeight;
+}
+
+std::vector<RenderBucket*> RenderJournal::getPendingBuckets(uint32_t maxCount)
+{
+	std::vector<RenderBucket*> pendingBuckets;
+
+	for (RenderBucket& bucket : buckets)
+	{
+		if (pendingBuckets.size() >= maxCount)
+			break;
+
+		if (!bucket.completed)
+			pendingBuckets.push_back(&bucket);
+	}
+
+	return pendingBuckets;
+}
+
+uint32_t RenderJournal::getCompletedBucketCount() const
+{
+	uint32_t count = 0;
+
+	for (const RenderBucket& bucket : buckets)
+	{
+		if (bucket.completed)
+			++count;
+	}
+
+	return count;
+}
+
+uint32_t RenderJournal::getBucketCount() const
+{
+	return uint32_t(buckets.size());
+}
+
+uint64_t RenderJournal::getRemainingPixelCount(uint32_t passCount) const
+{
+	if (completedPasses >= passCount)
+		return 0;
+
+	uint64_t completedPixelCount = 0;
+
+	for (const RenderBucket& bucket : buckets)
+	{
+		if (bucket.completed)
+			completedPixelCount += uint64_t(bucket.width) * bucket.height;
+	}
+
+	return uint64_t(regionWidth) * regionHeight * (passCount - completedPasses) - completedPixelCount;
+}
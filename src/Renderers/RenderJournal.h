@@ -0,0 +1,80 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+
+The render region (a pixel rectangle of the film, the whole film by default) is split into square buckets.
+A bucket is always rendered completely or not at all, and the journal records how many image samples (passes)
+have been completed and which buckets of the current pass are done. The renderer writes the journal together
+with the auto-written film, so an interrupted or preempted render can be resumed exactly where it stopped.
+
+journal file (all values little endian):
+char[4] magic ("VJRN")
+uint32 version (1)
+uint32 filmWidth, filmHeight
+uint32 regionX, regionY, regionWidth, regionHeight
+uint32 bucketSize, bucketCount
+uint32 pixelSamples (per pass)
+uint32 completedPasses
+uint32 filmChecksum (FilmFile checksum of the film written with the journal)
+uint32 reserved
+uint64 sceneHash
+uint8[bucketCount] completed flags of the current pass
+
+*/
+
+namespace Valo
+{
+	struct RenderBucket
+	{
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		bool completed = false;
+	};
+
+	class RenderJournal
+	{
+	public:
+
+		void initialize(uint32_t filmWidth, uint32_t filmHeight, uint32_t regionX, uint32_t regionY, uint32_t regionWidth, uint32_t regionHeight, uint32_t bucketSize);
+		void load(const std::string& fileName);
+		void save(const std::string& fileName) const;
+
+		void restart();
+		void completePass();
+		void setPassCompleted();
+
+		bool isPassCompleted() const;
+		bool coversFilm() const;
+
+		std::vector<RenderBucket*> getPendingBuckets(uint32_t maxCount);
+		uint32_t getCompletedBucketCount() const;
+		uint32_t getBucketCount() const;
+		uint64_t getRemainingPixelCount(uint32_t passCount) const;
+
+		uint32_t completedPasses = 0;
+		uint32_t pixelSamples = 0;
+		uint32_t filmChecksum = 0;
+		uint64_t sceneHash = 0;
+
+	private:
+
+		uint32_t filmWidth = 0;
+		uint32_t filmHeight = 0;
+		uint32_t regionX = 0;
+		uint32_t regionY = 0;
+		uint32_t regionWidth = 0;
+		uint32_t regionHeight = 0;
+		uint32_t bucketSize = 0;
+
+		std::vector<RenderBucket> buckets;
+	};
+}
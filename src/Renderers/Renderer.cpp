@@ -3,14 +3,22 @@
 
 #include "Precompiled.h"
 
+#include <boost/filesystem.hpp>
+
+#include "tinyformat/tinyformat.h"
+
 #include "Core/Film.h"
+#include "Core/FilmFile.h"
 #include "Core/Scene.h"
 #include "Renderers/Renderer.h"
+#include "Utils/Log.h"
 #include "Utils/Settings.h"
 #include "App.h"
 
 using namespace Valo;
 
+namespace bf = boost::filesystem;
+
 void Renderer::initialize(const Settings& settings)
 {
 	type = static_cast<RendererType>(settings.renderer.type);
@@ -21,6 +29,13 @@ void Renderer::initialize(const Settings& settings)
 	filmAutoWrite = settings.film.autoWrite;
 	filmAutoWriteInterval = settings.film.autoWriteInterval;
 	filmAutoWriteFileName = settings.film.autoWriteFileName;
+	journalFileName = settings.film.journalFileName;
+	imageSamples = settings.renderer.imageSamples;
+	regionX = settings.renderer.regionX;
+	regionY = settings.renderer.regionY;
+	regionWidth = settings.renderer.regionWidth;
+	regionHeight = settings.renderer.regionHeight;
+	bucketSize = settings.renderer.bucketSize;
 
 	cpuRenderer.initialize();
 	cudaRenderer.initialize();
@@ -30,6 +45,8 @@ void Renderer::resize(uint32_t width, uint32_t height)
 {
 	cpuRenderer.resize(width, height);
 	cudaRenderer.resize(width, height);
+
+	journal.initialize(width, height, regionX, regionY, regionWidth, regionHeight, bucketSize);
 }
 
 void Renderer::render(RenderJob& job)
@@ -38,38 +55,110 @@ void Renderer::render(RenderJob& job)
 	Film& film = *job.film;
 	Settings& settings = App::getSettings();
 
+	if (type == RendererType::CUDA && !journal.coversFilm())
+		throw std::runtime_error("Render regions are only supported by the CPU renderer");
+
 	imageAutoWriteTimer.restart();
 	filmAutoWriteTimer.restart();
 
-	for (uint32_t i = 0; i < settings.renderer.imageSamples && !job.interrupted; ++i)
+	scene.renderer.filter.initialize();
+
+	// with checkpoints the passes are split into batches of buckets so that the film can be written mid-pass
+	uint32_t bucketBatchSize = filmAutoWrite ? uint32_t(MAX(1, cpuRenderer.maxThreadCount)) * 16 : journal.getBucketCount();
+
+	while (journal.completedPasses < imageSamples && !job.interrupted)
 	{
 		switch (type)
 		{
-			case RendererType::CPU: cpuRenderer.render(job, filtering); break;
-			case RendererType::CUDA: cudaRenderer.render(job, filtering); break;
+			case RendererType::CPU: cpuRenderer.render(job, journal.getPendingBuckets(bucketBatchSize), filtering); break;
+			case RendererType::CUDA: cudaRenderer.render(job, filtering); journal.setPassCompleted(); break;
 			default: break;
 		}
 
-		film.pixelSamples += settings.renderer.pixelSamples;
+		if (journal.isPassCompleted())
+		{
+			film.pixelSamples += settings.renderer.pixelSamples;
+			journal.completePass();
+		}
 
 		if (imageAutoWrite && imageAutoWriteTimer.getElapsedSeconds() > imageAutoWriteInterval)
 		{
-			film.normalize(type);
-			film.tonemap(scene.tonemapper, type);
-			film.getTonemappedImage().download();
-			film.getTonemappedImage().save(imageAutoWriteFileName, false);
+			film.getCumulativeImage().download();
+			film.saveImage(imageAutoWriteFileName, scene.tonemapper, false);
 
 			imageAutoWriteTimer.restart();
 		}
 
 		if (filmAutoWrite && filmAutoWriteTimer.getElapsedSeconds() > filmAutoWriteInterval)
 		{
-			film.getCumulativeImage().download();
-			film.save(filmAutoWriteFileName, false);
-
+			writeCheckpoint(scene, film);
 			filmAutoWriteTimer.restart();
 		}
 	}
+
+	// an interrupted render leaves a checkpoint that it can be resumed from
+	if (job.interrupted && filmAutoWrite && filmAutoWriteOnInterrupt)
+		writeCheckpoint(scene, film);
+
+	if (!job.interrupted)
+		journal.restart();
+}
+
+void Renderer::resume(Scene& scene, Film& film)
+{
+	Log& log = App::getLog();
+	Settings& settings = App::getSettings();
+
+	if (!bf::exists(journalFileName))
+	{
+		log.logInfo("Render journal %s not found, starting from the beginning", journalFileName);
+		return;
+	}
+
+	log.logInfo("Resuming render from %s", journalFileName);
+
+	uint64_t sceneHash = scene.getHash();
+	journal.load(journalFileName);
+
+	if (journal.sceneHash != sceneHash)
+		throw std::runtime_error("Render journal was written for a different scene or camera");
+
+	if (journal.pixelSamples != settings.renderer.pixelSamples)
+		throw std::runtime_error(tfm::format("Render journal was written with a different pixel sample count (%d)", journal.pixelSamples));
+
+	FilmFileInfo info = film.load(film.getWidth(), film.getHeight(), filmAutoWriteFileName, type, sceneHash);
+
+	// preemption between writing the journal and replacing the film leaves the matching film in the temporary file
+	std::string tempFileName = filmAutoWriteFileName + ".tmp";
+
+	if (info.checksum != journal.filmChecksum && bf::exists(tempFileName))
+		info = film.load(film.getWidth(), film.getHeight(), tempFileName, type, sceneHash);
+
+	if (info.checksum != journal.filmChecksum)
+		throw std::runtime_error(tfm::format("Film file %s does not match the render journal", filmAutoWriteFileName));
+
+	log.logInfo("Render resumed (image samples: %d, buckets: %d/%d)", journal.completedPasses, journal.getCompletedBucketCount(), journal.getBucketCount());
+}
+
+void Renderer::writeCheckpoint(Scene& scene, Film& film)
+{
+	film.getCumulativeImage().download();
+
+	// both files are written to temporary files first so that a preempted write never replaces the previous checkpoint
+	std::string tempFileName = filmAutoWriteFileName + ".tmp";
+
+	journal.pixelSamples = App::getSettings().renderer.pixelSamples;
+	journal.sceneHash = scene.getHash();
+	journal.filmChecksum = film.save(tempFileName, journal.sceneHash, false);
+	journal.save(journalFileName);
+
+	bf::rename(tempFileName, filmAutoWriteFileName);
+}
+
+// the buckets of a partially rendered image sample are rendered again
+void Renderer::restart()
+{
+	journal.restart();
 }
 
 std::string Renderer::getName() const
@@ -81,3 +170,9 @@ std::string Renderer::getName() const
 		default: return "unknown";
 	}
 }
+
+uint64_t Renderer::getRemainingSampleCount() const
+{
+	Settings& settings = App::getSettings();
+	return journal.getRemainingPixelCount(imageSamples) * settings.renderer.pixelSamples;
+}
@@ -7,6 +7,7 @@
 
 #include "Renderers/CpuRenderer.h"
 #include "Renderers/CudaRenderer.h"
+#include "Renderers/RenderJournal.h"
 #include "Utils/Timer.h"
 
 namespace Valo
@@ -35,8 +36,11 @@ namespace Valo
 		void initialize(const Settings& settings);
 		void resize(uint32_t width, uint32_t height);
 		void render(RenderJob& job);
+		void resume(Scene& scene, Film& film);
+		void restart();
 
 		std::string getName() const;
+		uint64_t getRemainingSampleCount() const;
 
 		RendererType type = RendererType::CPU;
 
@@ -50,12 +54,25 @@ namespace Valo
 		bool filmAutoWrite = false;
 		float filmAutoWriteInterval = 60.0f;
 		std::string filmAutoWriteFileName = "temp_film.bin";
+		std::string journalFileName = "temp_film.journal";
+		bool filmAutoWriteOnInterrupt = true;
+
+		uint32_t imageSamples = 1;
+		uint32_t regionX = 0;
+		uint32_t regionY = 0;
+		uint32_t regionWidth = 0;
+		uint32_t regionHeight = 0;
+		uint32_t bucketSize = 64;
 
 		bool filtering = true;
 
 	private:
 
+		void writeCheckpoint(Scene& scene, Film& film);
+
 		Timer imageAutoWriteTimer;
 		Timer filmAutoWriteTimer;
+
+		RenderJournal journal;
 	};
 }
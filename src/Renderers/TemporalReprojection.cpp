@@ -0,0 +1,133 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include "Renderers/TemporalReprojection.h"
+#include "Core/Camera.h"
+#include "Core/Common.h"
+#include "Core/Film.h"
+#include "Core/Image.h"
+#include "Core/Intersection.h"
+#include "Core/Ray.h"
+#include "Core/Scene.h"
+#include "Math/Color.h"
+#include "Math/Sampler.h"
+#include "Math/Vector2.h"
+
+using namespace Valo;
+
+void TemporalReprojection::reproject(const Scene& scene, const Camera& previousCamera, const Image& previousImage, Film& film, float maxWeight)
+{
+	if (scene.camera.type == CameraType::FISHEYE || previousCamera.type == CameraType::FISHEYE)
+	{
+		valid = false;
+		return;
+	}
+
+	const uint32_t previousWidth = previousImage.getWidth();
+	const uint32_t previousHeight = previousImage.getHeight();
+
+	// the positions of the previous restart are reused if the camera was not stopped in between
+	if (!valid || width != previousWidth || height != previousHeight)
+		updatePositions(scene, previousCamera, previousWidth, previousHeight, positions, hits);
+
+	const uint32_t filmWidth = film.getWidth();
+	const uint32_t filmHeight = film.getHeight();
+
+	updatePositions(scene, scene.camera, filmWidth, filmHeight, newPositions, newHits);
+
+	Image& image = film.getCumulativeImage();
+
+	#pragma omp parallel for
+	for (int32_t y = 0; y < int32_t(filmHeight); ++y)
+	{
+		for (uint32_t x = 0; x < filmWidth; ++x)
+		{
+			const uint32_t index = uint32_t(y) * filmWidth + x;
+			Vector2 previousPixel;
+
+			if (newHits[index])
+			{
+				if (!previousCamera.project(newPositions[index], previousPixel))
+					continue;
+			}
+			else
+			{
+				// misses are matched by direction, so the same pixel is the best guess (pixel centers are at whole coordinates)
+				previousPixel.x = (float(x) + 0.5f) * float(previousWidth) / float(filmWidth) - 0.5f;
+				previousPixel.y = (float(y) + 0.5f) * float(previousHeight) / float(filmHeight) - 0.5f;
+			}
+
+			int32_t previousX = int32_t(std::floor(previousPixel.x + 0.5f));
+			int32_t previousY = int32_t(std::floor(previousPixel.y + 0.5f));
+
+			if (previousX < 0 || previousY < 0 || previousX >= int32_t(previousWidth) || previousY >= int32_t(previousHeight))
+				continue;
+
+			const uint32_t previousIndex = uint32_t(previousY) * previousWidth + uint32_t(previousX);
+
+			if (newHits[index] != hits[previousIndex])
+				continue;
+
+			// disocclusions show up as a different surface at the projected pixel
+			if (newHits[index])
+			{
+				float tolerance = 0.05f * (newPositions[index] - previousCamera.position).length();
+
+				if ((newPositions[index] - positions[previousIndex]).length() > tolerance)
+					continue;
+			}
+
+			Color color = previousImage.getPixel(previousIndex);
+
+			if (color.a <= 0.0f)
+				continue;
+
+			float weight = MIN(color.a, maxWeight);
+			color *= weight / color.a;
+			color.a = weight;
+
+			image.setPixel(index, color);
+		}
+	}
+
+	std::swap(positions, newPositions);
+	std::swap(hits, newHits);
+
+	width = filmWidth;
+	height = filmHeight;
+	valid = true;
+}
+
+void TemporalReprojection::invalidate()
+{
+	valid = false;
+}
+
+void TemporalReprojection::updatePositions(const Scene& scene, const Camera& camera, uint32_t width_, uint32_t height_, std::vector<Vector3>& positions_, std::vector<uint8_t>& hits_)
+{
+	Camera centerCamera = camera;
+	centerCamera.depthOfField = false;
+
+	positions_.resize(size_t(width_) * size_t(height_));
+	hits_.resize(size_t(width_) * size_t(height_));
+
+	#pragma omp parallel for
+	for (int32_t y = 0; y < int32_t(height_); ++y)
+	{
+		Sampler sampler;
+
+		for (uint32_t x = 0; x < width_; ++x)
+		{
+			const uint32_t index = uint32_t(y) * width_ + x;
+
+			CameraRay cameraRay = centerCamera.getRay(Vector2(float(x), float(y)), sampler);
+			cameraRay.ray.isPrimaryRay = true;
+
+			Intersection intersection;
+			hits_[index] = !cameraRay.offLens && scene.intersect(cameraRay.ray, intersection);
+			positions_[index] = hits_[index] ? intersection.position : Vector3();
+		}
+	}
+}
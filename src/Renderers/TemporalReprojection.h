@@ -0,0 +1,48 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Math/Vector3.h"
+
+/*
+
+Carries the accumulated samples of the interactive preview over a camera restart. One primary ray is traced
+through the center of every pixel for both the previous and the new camera, and each new pixel takes the
+color of the previous pixel its hit point projects to, if that pixel saw the same surface (or both missed).
+The history is added with a weight of at most maxWeight samples so that new samples take over quickly.
+Fisheye cameras can't be projected, so nothing is reprojected for them.
+
+*/
+
+namespace Valo
+{
+	class Scene;
+	class Camera;
+	class Image;
+	class Film;
+
+	class TemporalReprojection
+	{
+	public:
+
+		void reproject(const Scene& scene, const Camera& previousCamera, const Image& previousImage, Film& film, float maxWeight);
+		void invalidate();
+
+	private:
+
+		void updatePositions(const Scene& scene, const Camera& camera, uint32_t width, uint32_t height, std::vector<Vector3>& positions, std::vector<uint8_t>& hits);
+
+		std::vector<Vector3> positions;
+		std::vector<uint8_t> hits;
+		std::vector<Vector3> newPositions;
+		std::vector<uint8_t> newHits;
+
+		uint32_t width = 0;
+		uint32_t height = 0;
+		bool valid = false;
+	};
+}
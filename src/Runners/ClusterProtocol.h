@@ -0,0 +1,58 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+
+/*
+
+Coordinator <-> worker messages over TCP. Every message is a MessageHeader followed by size bytes of payload.
+All values are little endian.
+
+worker -> coordinator: HELLO (HelloMessage) once after connecting
+coordinator -> worker: UNIT (WorkUnit) or DONE (no payload) as the reply to HELLO and to every RESULT
+worker -> coordinator: RESULT (WorkUnit + regionWidth * regionHeight float RGBA cumulative pixels, bottom row first)
+
+*/
+
+namespace Valo
+{
+	const uint32_t CLUSTER_PROTOCOL_MAGIC = 0x4d4c4356; // "VCLM"
+	const uint32_t CLUSTER_PROTOCOL_VERSION = 1;
+
+	enum class MessageType : uint32_t { HELLO = 1, UNIT = 2, RESULT = 3, DONE = 4 };
+
+	struct MessageHeader
+	{
+		uint32_t magic = CLUSTER_PROTOCOL_MAGIC;
+		MessageType type = MessageType::DONE;
+		uint64_t size = 0;
+	};
+
+	struct HelloMessage
+	{
+		uint32_t version = CLUSTER_PROTOCOL_VERSION;
+		uint32_t filmWidth = 0;
+		uint32_t filmHeight = 0;
+		uint32_t pixelSamples = 0;
+		uint64_t sceneHash = 0;
+	};
+
+	// a rectangle of the film rendered for a range of image samples (passes)
+	struct WorkUnit
+	{
+		uint32_t id = 0;
+		uint32_t regionX = 0;
+		uint32_t regionY = 0;
+		uint32_t regionWidth = 0;
+		uint32_t regionHeight = 0;
+		uint32_t firstPass = 0;
+		uint32_t passCount = 0;
+		uint32_t reserved = 0;
+	};
+
+	static_assert(sizeof(MessageHeader) == 16, "MessageHeader has wrong size");
+	static_assert(sizeof(HelloMessage) == 24, "HelloMessage has wrong size");
+	static_assert(sizeof(WorkUnit) == 32, "WorkUnit has wrong size");
+}
@@ -28,25 +28,39 @@ int ConsoleRunner::run()
 	Timer totalElapsedTimer;
 	Renderer renderer;
 
-	Scene scene = TestScene::create(settings.scene.testSceneNumber);
+	Scene scene;
 	Film film(false);
 
+	if (settings.scene.useTestScene)
+		scene = TestScene::create(settings.scene.testSceneNumber);
+	else
+		scene.load(settings.scene.fileName);
+
+	scene.configureTextureCache(settings);
+
 	scene.initialize();
 	film.initialize();
+
+	if (!settings.scene.saveFileName.empty())
+		scene.save(settings.scene.saveFileName);
 	renderer.initialize(settings);
 
+	// the film and checkpoint hashes include the camera as update leaves it (clamped and normalized angles)
+	scene.camera.setImagePlaneSize(settings.image.width, settings.image.height);
+	scene.camera.update(0.0f);
+
 	if (settings.film.load)
-		film.load(settings.image.width, settings.image.height, settings.film.loadFileName, renderer.type);
+		film.load(settings.image.width, settings.image.height, settings.film.loadFileName, renderer.type, scene.getHash());
 	else if (settings.film.loadDir)
-		film.loadMultiple(settings.image.width, settings.image.height, settings.film.loadDirName, renderer.type);
+		film.loadMultiple(settings.image.width, settings.image.height, settings.film.loadDirName, renderer.type, scene.getHash());
 	else
 		film.resize(settings.image.width, settings.image.height, renderer.type);
 
 	renderer.resize(settings.image.width, settings.image.height);
 	
-	scene.camera.setImagePlaneSize(settings.image.width, settings.image.height);
-	scene.camera.update(0.0f);
-
+	if (settings.film.resume)
+		renderer.resume(scene, film);
+	
 	renderJob.scene = &scene;
 	renderJob.film = &film;
 	renderJob.interrupted = false;
@@ -54,7 +68,7 @@ int ConsoleRunner::run()
 	
 	SysUtils::setConsoleTextColor(ConsoleTextColor::WHITE_ON_BLACK);
 
-	uint64_t totalSamples = uint64_t(settings.image.width) * uint64_t(settings.image.height) * uint64_t(settings.renderer.imageSamples) * uint64_t(settings.renderer.pixelSamples);
+	uint64_t totalSamples = renderer.getRemainingSampleCount();
 
 	std::cout << tfm::format("\nRendering started (size: %dx%d, pixels: %s, image samples: %d, pixel samples: %d, total samples: %d)\n\n",
 		settings.image.width,
@@ -126,23 +140,20 @@ int ConsoleRunner::run()
 
 	SysUtils::setConsoleTextColor(ConsoleTextColor::DEFAULT);
 
-	film.normalize(renderer.type);
-	film.tonemap(scene.tonemapper, renderer.type);
 	film.getCumulativeImage().download();
-	film.getTonemappedImage().download();
 
 	log.logInfo("Total elapsed time: %s", totalElapsedTimer.getElapsed().getString(true));
 
 	if (settings.image.write)
 	{
-		film.getTonemappedImage().save(settings.image.fileName);
+		film.saveImage(settings.image.fileName, scene.tonemapper);
 
 		if (settings.image.autoView)
 			SysUtils::openFileExternally(settings.image.fileName);
 	}
 	
 	if (settings.film.write)
-		film.save(settings.film.writeFileName, true);
+		film.save(settings.film.writeFileName, scene.getHash(), true);
 
 	return 0;
 }
@@ -0,0 +1,499 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include <memory>
+
+#include <boost/asio.hpp>
+#include <boost/dll/runtime_symbol_info.hpp>
+#include <boost/process/args.hpp>
+#include <boost/process/child.hpp>
+#include <boost/process/io.hpp>
+
+#include "tinyformat/tinyformat.h"
+
+#include "App.h"
+#include "Core/Film.h"
+#include "Core/Image.h"
+#include "Core/Scene.h"
+#include "Math/Color.h"
+#include "Renderers/Renderer.h"
+#include "Runners/ClusterProtocol.h"
+#include "Runners/CoordinatorRunner.h"
+#include "Runners/WorkQueue.h"
+#include "TestScenes/TestScene.h"
+#include "Utils/Log.h"
+#include "Utils/Settings.h"
+#include "Utils/SysUtils.h"
+#include "Utils/Timer.h"
+
+using namespace Valo;
+
+namespace asio = boost::asio;
+namespace bp = boost::process;
+using asio::ip::tcp;
+
+namespace
+{
+	struct Connection
+	{
+		explicit Connection(asio::io_context& ioContext) : socket(ioContext) {}
+
+		tcp::socket socket;
+		std::string name;
+		MessageHeader header;
+		std::vector<char> payload;
+		bool helloReceived = false;
+		bool hasUnit = false;
+		bool idle = false;
+		uint32_t unitId = 0;
+	};
+
+	// all the connections are served from a single thread, so the film and the work queue need no locking
+	class Coordinator
+	{
+	public:
+
+		Coordinator(Film& film, WorkQueue& workQueue, uint32_t port, uint32_t pixelSamples, const std::atomic<bool>& interrupted);
+
+		void run(std::vector<bp::child>& localWorkers);
+		uint64_t getSceneHash() const;
+
+	private:
+
+		void accept();
+		void readMessage(const std::shared_ptr<Connection>& connection);
+		void handleMessage(const std::shared_ptr<Connection>& connection);
+		void handleHello(const std::shared_ptr<Connection>& connection);
+		void handleResult(const std::shared_ptr<Connection>& connection);
+		void sendNextUnit(const std::shared_ptr<Connection>& connection);
+		void sendMessage(Connection& connection, MessageType type, const void* payload, size_t size);
+		void closeConnection(const std::shared_ptr<Connection>& connection);
+		void checkStatus();
+		void finish();
+
+		Film& film;
+		WorkQueue& workQueue;
+		uint32_t pixelSamples = 0;
+		const std::atomic<bool>& interrupted;
+		std::vector<bp::child>* localWorkers = nullptr;
+
+		asio::io_context ioContext;
+		tcp::acceptor acceptor;
+		asio::steady_timer statusTimer;
+		std::vector<std::shared_ptr<Connection>> connections;
+
+		bool hasSceneHash = false;
+		uint64_t sceneHash = 0;
+	};
+
+	Coordinator::Coordinator(Film& film_, WorkQueue& workQueue_, uint32_t port, uint32_t pixelSamples_, const std::atomic<bool>& interrupted_) : film(film_), workQueue(workQueue_), pixelSamples(pixelSamples_), interrupted(interrupted_), acceptor(ioContext), statusTimer(ioContext)
+	{
+		tcp::endpoint endpoint(tcp::v4(), uint16_t(port));
+
+		acceptor.open(endpoint.protocol());
+		acceptor.set_option(tcp::acceptor::reuse_address(true));
+		acceptor.bind(endpoint);
+		acceptor.listen();
+	}
+
+	void Coordinator::run(std::vector<bp::child>& localWorkers_)
+	{
+		localWorkers = &localWorkers_;
+
+		accept();
+		checkStatus();
+
+		ioContext.run();
+	}
+
+	uint64_t Coordinator::getSceneHash() const
+	{
+		return sceneHash;
+	}
+
+	void Coordinator::accept()
+	{
+		auto connection = std::make_shared<Connection>(ioContext);
+
+		acceptor.async_accept(connection->socket, [this, connection](const boost::system::error_code& error)
+		{
+			if (error)
+				return;
+
+			boost::system::error_code endpointError;
+			tcp::endpoint endpoint = connection->socket.remote_endpoint(endpointError);
+			connection->name = endpointError ? std::string("unknown") : tfm::format("%s:%d", endpoint.address().to_string(), endpoint.port());
+
+			connections.push_back(connection);
+			readMessage(connection);
+			accept();
+		});
+	}
+
+	void Coordinator::readMessage(const std::shared_ptr<Connection>& connection)
+	{
+		asio::async_read(connection->socket, asio::buffer(&connection->header, sizeof(connection->header)), [this, connection](const boost::system::error_code& error, size_t)
+		{
+			if (error)
+			{
+				closeConnection(connection);
+				return;
+			}
+
+			uint64_t maxSize = sizeof(WorkUnit) + uint64_t(film.getLength()) * sizeof(Color);
+
+			if (connection->header.magic != CLUSTER_PROTOCOL_MAGIC || connection->header.size > maxSize)
+			{
+				App::getLog().logWarning("Invalid message from worker %s", connection->name);
+				closeConnection(connection);
+				return;
+			}
+
+			connection->payload.resize(size_t(connection->header.size));
+
+			asio::async_read(connection->socket, asio::buffer(connection->payload), [this, connection](const boost::system::error_code& payloadError, size_t)
+			{
+				if (payloadError)
+				{
+					closeConnection(connection);
+					return;
+				}
+
+				handleMessage(connection);
+			});
+		});
+	}
+
+	void Coordinator::handleMessage(const std::shared_ptr<Connection>& connection)
+	{
+		if (connection->header.type == MessageType::HELLO && !connection->helloReceived && connection->payload.size() == sizeof(HelloMessage))
+			handleHello(connection);
+		else if (connection->header.type == MessageType::RESULT && connection->hasUnit && connection->payload.size() >= sizeof(WorkUnit))
+			handleResult(connection);
+		else
+		{
+			App::getLog().logWarning("Unexpected message from worker %s", connection->name);
+			closeConnection(connection);
+		}
+	}
+
+	void Coordinator::handleHello(const std::shared_ptr<Connection>& connection)
+	{
+		Log& log = App::getLog();
+
+		HelloMessage hello;
+		memcpy(&hello, connection->payload.data(), sizeof(hello));
+
+		if (hello.version != CLUSTER_PROTOCOL_VERSION || hello.filmWidth != film.getWidth() || hello.filmHeight != film.getHeight() || hello.pixelSamples != pixelSamples)
+		{
+			log.logWarning("Rejected worker %s: different version, image size or pixel samples", connection->name);
+			closeConnection(connection);
+			return;
+		}
+
+		// the first worker decides which scene is being rendered
+		if (hasSceneHash && hello.sceneHash != sceneHash)
+		{
+			log.logWarning("Rejected worker %s: different scene or camera", connection->name);
+			closeConnection(connection);
+			return;
+		}
+
+		hasSceneHash = true;
+		sceneHash = hello.sceneHash;
+		connection->helloReceived = true;
+
+		log.logInfo("Worker %s connected", connection->name);
+
+		sendNextUnit(connection);
+		readMessage(connection);
+	}
+
+	void Coordinator::handleResult(const std::shared_ptr<Connection>& connection)
+	{
+		Log& log = App::getLog();
+
+		WorkUnit reportedUnit;
+		memcpy(&reportedUnit, connection->payload.data(), sizeof(reportedUnit));
+
+		// the result is merged with the unit that was issued, the worker only has to echo it back
+		bool isValid = (connection->hasUnit && reportedUnit.id == connection->unitId);
+		const WorkUnit& unit = workQueue.getUnit(connection->unitId);
+
+		isValid = isValid && reportedUnit.regionX == unit.regionX && reportedUnit.regionY == unit.regionY && reportedUnit.regionWidth == unit.regionWidth && reportedUnit.regionHeight == unit.regionHeight;
+		isValid = isValid && reportedUnit.firstPass == unit.firstPass && reportedUnit.passCount == unit.passCount;
+
+		uint64_t pixelCount = uint64_t(unit.regionWidth) * uint64_t(unit.regionHeight);
+
+		if (!isValid || connection->payload.size() != sizeof(WorkUnit) + pixelCount * sizeof(Color))
+		{
+			log.logWarning("Invalid result from worker %s", connection->name);
+			closeConnection(connection);
+			return;
+		}
+
+		connection->hasUnit = false;
+
+		if (workQueue.completeUnit(unit.id))
+		{
+			const Color* pixels = reinterpret_cast<const Color*>(connection->payload.data() + sizeof(WorkUnit));
+			Image& image = film.getCumulativeImage();
+
+			for (uint32_t y = 0; y < unit.regionHeight; ++y)
+			{
+				for (uint32_t x = 0; x < unit.regionWidth; ++x)
+				{
+					uint32_t filmX = unit.regionX + x;
+					uint32_t filmY = unit.regionY + y;
+
+					image.setPixel(filmX, filmY, image.getPixel(filmX, filmY) + pixels[y * unit.regionWidth + x]);
+				}
+			}
+
+			log.logInfo("Work unit %d finished by %s (%d/%d)", unit.id, connection->name, workQueue.getCompletedUnitCount(), workQueue.getUnitCount());
+		}
+		else
+			log.logInfo("Discarded a duplicate result of work unit %d from %s", unit.id, connection->name);
+
+		connection->payload = std::vector<char>();
+
+		if (workQueue.isFinished())
+		{
+			finish();
+			return;
+		}
+
+		sendNextUnit(connection);
+		readMessage(connection);
+	}
+
+	void Coordinator::sendNextUnit(const std::shared_ptr<Connection>& connection)
+	{
+		WorkUnit unit;
+
+		if (workQueue.getNextUnit(unit))
+		{
+			connection->hasUnit = true;
+			connection->idle = false;
+			connection->unitId = unit.id;
+
+			sendMessage(*connection, MessageType::UNIT, &unit, sizeof(unit));
+		}
+		else if (workQueue.isFinished())
+			sendMessage(*connection, MessageType::DONE, nullptr, 0);
+		else
+			connection->idle = true;
+	}
+
+	// the outgoing messages are small, so they are written synchronously
+	void Coordinator::sendMessage(Connection& connection, MessageType type, const void* payload, size_t size)
+	{
+		MessageHeader header;
+		header.type = type;
+		header.size = size;
+
+		boost::system::error_code error;
+		asio::write(connection.socket, std::vector<asio::const_buffer> { asio::buffer(&header, sizeof(header)), asio::buffer(payload, size) }, error);
+
+		// the pending read fails after this and closes the connection
+		if (error)
+			connection.socket.close(error);
+	}
+
+	void Coordinator::closeConnection(const std::shared_ptr<Connection>& connection)
+	{
+		auto it = std::find(connections.begin(), connections.end(), connection);
+
+		if (it == connections.end())
+			return;
+
+		connections.erase(it);
+
+		if (connection->helloReceived)
+			App::getLog().logInfo("Worker %s disconnected", connection->name);
+
+		boost::system::error_code error;
+		connection->socket.close(error);
+
+		// the unit of a lost worker goes to the idle workers
+		if (connection->hasUnit)
+		{
+			connection->hasUnit = false;
+			workQueue.releaseUnit(connection->unitId);
+
+			for (const std::shared_ptr<Connection>& otherConnection : connections)
+			{
+				if (otherConnection->idle)
+					sendNextUnit(otherConnection);
+			}
+		}
+	}
+
+	void Coordinator::checkStatus()
+	{
+		if (interrupted)
+		{
+			ioContext.stop();
+			return;
+		}
+
+		bool localWorkersRunning = false;
+
+		for (bp::child& localWorker : *localWorkers)
+		{
+			if (localWorker.running())
+				localWorkersRunning = true;
+		}
+
+		if (!localWorkers->empty() && !localWorkersRunning && connections.empty())
+			throw std::runtime_error("All local workers have exited (see the valo_worker_*.log files)");
+
+		statusTimer.expires_after(std::chrono::milliseconds(250));
+		statusTimer.async_wait([this](const boost::system::error_code& error)
+		{
+			if (!error)
+				checkStatus();
+		});
+	}
+
+	// idle workers are told to exit and workers still rendering duplicate units are disconnected
+	void Coordinator::finish()
+	{
+		for (const std::shared_ptr<Connection>& connection : connections)
+		{
+			if (!connection->hasUnit && connection->helloReceived)
+				sendMessage(*connection, MessageType::DONE, nullptr, 0);
+
+			boost::system::error_code error;
+			connection->socket.close(error);
+		}
+
+		connections.clear();
+		ioContext.stop();
+	}
+
+	std::vector<bp::child> startLocalWorkers(uint32_t count, uint32_t port, uint32_t threadCount)
+	{
+		Settings& settings = App::getSettings();
+
+		std::map<std::string, std::string> workerOptions;
+		workerOptions["coordinator.enabled"] = "false";
+		workerOptions["worker.enabled"] = "true";
+		workerOptions["worker.address"] = "127.0.0.1";
+		workerOptions["worker.port"] = tfm::format("%d", port);
+		workerOptions["general.windowed"] = "false";
+		workerOptions["general.maxCpuThreadCount"] = tfm::format("%d", threadCount);
+		workerOptions["general.cudaDeviceNumber"] = tfm::format("%d", settings.general.cudaDeviceNumber);
+
+		// an option can only be given once, so the ones set for the workers replace the user's
+		std::vector<std::string> arguments;
+
+		for (const Settings::CommandLineOption& option : settings.commandLineOptions)
+		{
+			if (workerOptions.count(option.key) == 0 && option.key != "general.logFileName")
+				arguments.insert(arguments.end(), option.tokens.begin(), option.tokens.end());
+		}
+
+		for (const auto& option : workerOptions)
+			arguments.push_back(tfm::format("--%s=%s", option.first, option.second));
+
+		std::string programFileName = boost::dll::program_location().string();
+		std::vector<bp::child> workers;
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			std::vector<std::string> workerArguments = arguments;
+			workerArguments.push_back(tfm::format("--general.logFileName=valo_worker_%d.log", i + 1));
+
+			workers.emplace_back(programFileName, bp::args(workerArguments), bp::std_out > bp::null);
+		}
+
+		return workers;
+	}
+}
+
+int CoordinatorRunner::run()
+{
+	Settings& settings = App::getSettings();
+	Log& log = App::getLog();
+
+	Timer totalElapsedTimer;
+
+	// the scene is only needed for the tonemapper, the workers do the rendering
+	Scene scene;
+
+	if (settings.scene.useTestScene)
+		scene = TestScene::create(settings.scene.testSceneNumber);
+	else
+		scene.load(settings.scene.fileName);
+
+	Film film(false);
+	film.initialize();
+	film.resize(settings.image.width, settings.image.height, RendererType::CPU);
+
+	WorkUnitType unitType = static_cast<WorkUnitType>(settings.coordinator.unitType);
+	std::vector<WorkUnit> units = WorkQueue::split(settings.image.width, settings.image.height, settings.renderer.regionX, settings.renderer.regionY, settings.renderer.regionWidth, settings.renderer.regionHeight, settings.renderer.imageSamples, unitType, settings.coordinator.unitSize);
+
+	WorkQueue workQueue;
+	workQueue.initialize(units, settings.coordinator.reissueStragglers);
+
+	Coordinator coordinator(film, workQueue, settings.coordinator.port, settings.renderer.pixelSamples, interrupted);
+
+	log.logInfo("Coordinator listening on port %d (work units: %d, local workers: %d)", settings.coordinator.port, workQueue.getUnitCount(), settings.coordinator.localWorkers);
+
+	uint32_t localThreadCount = MAX(uint32_t(1), settings.general.maxCpuThreadCount / MAX(uint32_t(1), settings.coordinator.localWorkers));
+	std::vector<bp::child> localWorkers = startLocalWorkers(settings.coordinator.localWorkers, settings.coordinator.port, localThreadCount);
+
+	coordinator.run(localWorkers);
+
+	// workers that got the done message exit by themselves, the rest are still rendering duplicates
+	for (uint32_t i = 0; i < 20; ++i)
+	{
+		if (std::none_of(localWorkers.begin(), localWorkers.end(), [](bp::child& worker) { return worker.running(); }))
+			break;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	for (bp::child& localWorker : localWorkers)
+	{
+		if (localWorker.running())
+			localWorker.terminate();
+	}
+
+	if (workQueue.isFinished())
+		log.logInfo("Rendering finished (time: %s)", totalElapsedTimer.getElapsed().getString(true));
+	else
+		log.logWarning("Rendering interrupted (work units: %d/%d)", workQueue.getCompletedUnitCount(), workQueue.getUnitCount());
+
+	// an incomplete film has a different sample count in different pixels, which a film file can't describe
+	if (workQueue.isFinished())
+		film.pixelSamples = settings.renderer.imageSamples * settings.renderer.pixelSamples;
+
+	film.getCumulativeImage().upload();
+
+	if (settings.image.write)
+	{
+		film.saveImage(settings.image.fileName, scene.tonemapper);
+
+		if (settings.image.autoView)
+			SysUtils::openFileExternally(settings.image.fileName);
+	}
+
+	if (settings.film.write)
+	{
+		if (workQueue.isFinished())
+			film.save(settings.film.writeFileName, coordinator.getSceneHash(), true);
+		else
+			log.logWarning("The film was not written because work units are missing");
+	}
+
+	return 0;
+}
+
+void CoordinatorRunner::interrupt()
+{
+	interrupted = true;
+}
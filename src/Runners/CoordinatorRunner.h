@@ -0,0 +1,30 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <atomic>
+
+/*
+
+Splits the render into work units (image regions or image sample ranges, see WorkQueue) and hands them out
+to workers (see WorkerRunner) that connect over TCP. Workers can be started on other machines with the same
+scene and settings, and coordinator.localWorkers worker processes are started on this machine. The results
+are merged into the film as they arrive, and the image and film are written like in ConsoleRunner.
+
+*/
+
+namespace Valo
+{
+	class CoordinatorRunner
+	{
+	public:
+
+		int run();
+		void interrupt();
+
+	private:
+
+		std::atomic<bool> interrupted { false };
+	};
+}
@@ -14,35 +14,80 @@
 #include "TestScenes/TestScene.h"
 #include "Utils/Log.h"
 #include "Utils/Settings.h"
+#include "Utils/Timer.h"
 
 using namespace Valo;
 
-WindowRunnerRenderState::WindowRunnerRenderState() : film(true)
+WindowRunnerRenderState::WindowRunnerRenderState() : film(true), renderFilm(false)
 {
 }
 
+WindowRunnerRenderState::~WindowRunnerRenderState()
+{
+	stopRenderThread();
+}
+
 void WindowRunnerRenderState::initialize()
 {
 	Settings& settings = App::getSettings();
 	
-	scene = TestScene::create(settings.scene.testSceneNumber);
+	if (settings.scene.useTestScene)
+		scene = TestScene::create(settings.scene.testSceneNumber);
+	else
+		scene.load(settings.scene.fileName);
+
+	scene.configureTextureCache(settings);
 	scene.initialize();
+
+	if (!settings.scene.saveFileName.empty())
+		scene.save(settings.scene.saveFileName);
+
+	camera = scene.camera;
+
 	film.initialize();
+	renderFilm.initialize();
 	renderer.initialize(settings);
 	filmQuad.initialize();
 	infoPanel.initialize();
 	infoPanel.setState(InfoPanelState(settings.window.infoPanelState));
 
+	// restarts would write a checkpoint every time the camera moves
+	renderer.filmAutoWriteOnInterrupt = false;
+
+	// the main thread resolves with the same tonemapper, so the render thread must not save images
+	renderer.imageAutoWrite = false;
+
+	renderJob.scene = &scene;
+	renderJob.film = &renderFilm;
+	presentJob.scene = &scene;
+	presentJob.film = &film;
+
 	resizeFilm();
 
+	// the render thread has not been started yet, so the film can be loaded directly
+	Film& loadFilm = (renderer.type == RendererType::CPU) ? renderFilm : film;
+
+	{
+		std::lock_guard<std::mutex> lock(renderMutex);
+		applyRestart(loadFilm);
+	}
+
 	if (settings.film.load)
-		film.load(film.getWidth(), film.getHeight(), settings.film.loadFileName, renderer.type);
+		loadFilm.load(loadFilm.getWidth(), loadFilm.getHeight(), settings.film.loadFileName, renderer.type, scene.getHash());
 	else if (settings.film.loadDir)
-		film.loadMultiple(film.getWidth(), film.getHeight(), settings.film.loadDirName, renderer.type);
+		loadFilm.loadMultiple(loadFilm.getWidth(), loadFilm.getHeight(), settings.film.loadDirName, renderer.type, scene.getHash());
+
+	if (renderer.type == RendererType::CPU)
+		publishRenderFilm();
+
+	renderThread = std::thread(&WindowRunnerRenderState::renderLoop, this);
 }
 
 void WindowRunnerRenderState::shutdown()
 {
+	stopRenderThread();
+
+	renderFilm.shutdown();
 	film.shutdown();
 }
 
@@ -59,34 +104,38 @@ void WindowRunnerRenderState::update(float timeStep)
 	if (!ctrlIsPressed && windowRunner.keyWasPressed(GLFW_KEY_F1))
 		infoPanel.selectNextState();
 
-	// RENDERER / CAMERA / INTEGRATOR / FILTER / TONEMAPPER //
+	// RENDERER / CAMERA / INTEGRATOR / FILTER / TONEMAPPER / SAMPLER //
 
 	if (!ctrlIsPressed)
 	{
 		if (windowRunner.keyWasPressed(GLFW_KEY_F2))
 		{
+			pauseRendering();
+
 			if (renderer.type == RendererType::CPU)
 				renderer.type = RendererType::CUDA;
 			else if (renderer.type == RendererType::CUDA)
 				renderer.type = RendererType::CPU;
 
-			film.clear(renderer.type);
+			resizeFilm();
 		}
 
 		if (windowRunner.keyWasPressed(GLFW_KEY_F3))
 		{
-			if (scene.camera.type == CameraType::PERSPECTIVE)
-				scene.camera.type = CameraType::ORTHOGRAPHIC;
-			else if (scene.camera.type == CameraType::ORTHOGRAPHIC)
-				scene.camera.type = CameraType::FISHEYE;
-			else if (scene.camera.type == CameraType::FISHEYE)
-				scene.camera.type = CameraType::PERSPECTIVE;
-
-			film.clear(renderer.type);
+			if (camera.type == CameraType::PERSPECTIVE)
+				camera.type = CameraType::ORTHOGRAPHIC;
+			else if (camera.type == CameraType::ORTHOGRAPHIC)
+				camera.type = CameraType::FISHEYE;
+			else if (camera.type == CameraType::FISHEYE)
+				camera.type = CameraType::PERSPECTIVE;
+
+			restartRendering();
 		}
 
 		if (windowRunner.keyWasPressed(GLFW_KEY_F4))
 		{
+			pauseRendering();
+
 			if (scene.integrator.type == IntegratorType::PATH)
 				scene.integrator.type = IntegratorType::DIRECT_LIGHT;
 			else if (scene.integrator.type == IntegratorType::DIRECT_LIGHT)
@@ -96,11 +145,13 @@ void WindowRunnerRenderState::update(float timeStep)
 			else if (scene.integrator.type == IntegratorType::AMBIENT_OCCLUSION)
 				scene.integrator.type = IntegratorType::PATH;
 
-			film.clear(renderer.type);
+			restartRendering();
 		}
 
 		if (windowRunner.keyWasPressed(GLFW_KEY_F5))
 		{
+			pauseRendering();
+
 			if (scene.renderer.filter.type == FilterType::BOX)
 				scene.renderer.filter.type = FilterType::TENT;
 			else if (scene.renderer.filter.type == FilterType::TENT)
@@ -114,7 +165,7 @@ void WindowRunnerRenderState::update(float timeStep)
 			else if (scene.renderer.filter.type == FilterType::LANCZOS_SINC)
 				scene.renderer.filter.type = FilterType::BOX;
 
-			film.clear(renderer.type);
+			restartRendering();
 		}
 
 		if (windowRunner.keyWasPressed(GLFW_KEY_F6))
@@ -131,26 +182,40 @@ void WindowRunnerRenderState::update(float timeStep)
 
 		if (windowRunner.keyIsDown(GLFW_KEY_PAGE_DOWN))
 		{
-			if (scene.camera.type == CameraType::PERSPECTIVE)
-				scene.camera.fov -= 50.0f * timeStep;
-			else if (scene.camera.type == CameraType::ORTHOGRAPHIC)
-				scene.camera.orthoSize -= 10.0f * timeStep;
-			else if (scene.camera.type == CameraType::FISHEYE)
-				scene.camera.fishEyeAngle -= 50.0f * timeStep;
-
-			film.clear(renderer.type);
+			if (camera.type == CameraType::PERSPECTIVE)
+				camera.fov -= 50.0f * timeStep;
+			else if (camera.type == CameraType::ORTHOGRAPHIC)
+				camera.orthoSize -= 10.0f * timeStep;
+			else if (camera.type == CameraType::FISHEYE)
+				camera.fishEyeAngle -= 50.0f * timeStep;
+
+			restartRendering();
 		}
 
 		if (windowRunner.keyIsDown(GLFW_KEY_PAGE_UP))
 		{
-			if (scene.camera.type == CameraType::PERSPECTIVE)
-				scene.camera.fov += 50.0f * timeStep;
-			else if (scene.camera.type == CameraType::ORTHOGRAPHIC)
-				scene.camera.orthoSize += 10.0f * timeStep;
-			else if (scene.camera.type == CameraType::FISHEYE)
-				scene.camera.fishEyeAngle += 50.0f * timeStep;
-
-			film.clear(renderer.type);
+			if (camera.type == CameraType::PERSPECTIVE)
+				camera.fov += 50.0f * timeStep;
+			else if (camera.type == CameraType::ORTHOGRAPHIC)
+				camera.orthoSize += 10.0f * timeStep;
+			else if (camera.type == CameraType::FISHEYE)
+				camera.fishEyeAngle += 50.0f * timeStep;
+
+			restartRendering();
+		}
+
+		if (windowRunner.keyWasPressed(GLFW_KEY_F9))
+		{
+			pauseRendering();
+
+			if (scene.renderer.samplerType == SamplerType::RANDOM)
+				scene.renderer.samplerType = SamplerType::SOBOL;
+			else if (scene.renderer.samplerType == SamplerType::SOBOL)
+				scene.renderer.samplerType = SamplerType::BLUE_NOISE;
+			else if (scene.renderer.samplerType == SamplerType::BLUE_NOISE)
+				scene.renderer.samplerType = SamplerType::RANDOM;
+
+			restartRendering();
 		}
 	}
 
@@ -189,43 +254,53 @@ void WindowRunnerRenderState::update(float timeStep)
 	
 	if (windowRunner.keyWasPressed(GLFW_KEY_R))
 	{
-		scene.camera.reset();
-		film.clear(renderer.type);
+		camera.reset();
+		restartRendering();
 	}
 
 	if (windowRunner.keyWasPressed(GLFW_KEY_F))
 	{
+		pauseRendering();
+
 		scene.renderer.filtering = !scene.renderer.filtering;
-		film.clear(renderer.type);
+		restartRendering();
 	}
 
 	if (windowRunner.keyWasPressed(GLFW_KEY_P))
-		scene.camera.enableMovement = !scene.camera.enableMovement;
+		camera.enableMovement = !camera.enableMovement;
 
 	if (windowRunner.keyWasPressed(GLFW_KEY_M))
 	{
+		pauseRendering();
+
 		scene.general.normalMapping = !scene.general.normalMapping;
-		film.clear(renderer.type);
+		restartRendering();
 	}
 
 	if (windowRunner.keyWasPressed(GLFW_KEY_N))
 	{
+		pauseRendering();
+
 		scene.general.normalInterpolation = !scene.general.normalInterpolation;
-		film.clear(renderer.type);
+		restartRendering();
 	}
 
 	if (windowRunner.keyWasPressed(GLFW_KEY_B))
 	{
+		pauseRendering();
+
 		scene.general.normalVisualization = !scene.general.normalVisualization;
 		scene.general.interpolationVisualization = false;
-		film.clear(renderer.type);
+		restartRendering();
 	}
 
 	if (windowRunner.keyWasPressed(GLFW_KEY_V))
 	{
+		pauseRendering();
+
 		scene.general.interpolationVisualization = !scene.general.interpolationVisualization;
 		scene.general.normalVisualization = false;
-		film.clear(renderer.type);
+		restartRendering();
 	}
 
 	// EXPOSURE & KEY //
@@ -261,24 +336,35 @@ void WindowRunnerRenderState::update(float timeStep)
 
 	if (ctrlIsPressed)
 	{
-		//if (windowRunner.keyWasPressed(GLFW_KEY_F1))
-		//	scene.save("scene.xml");
+		if (windowRunner.keyWasPressed(GLFW_KEY_F1))
+		{
+			pauseRendering();
+
+			// the render thread's camera has the image plane of the scaled render film
+			Camera renderCamera = scene.camera;
+			scene.camera = camera;
+			scene.save("scene.xml");
+			scene.camera = renderCamera;
+		}
 
 		if (windowRunner.keyWasPressed(GLFW_KEY_F2))
-			scene.camera.saveState("camera.txt");
+			camera.saveState("camera.txt");
 
 		if (windowRunner.keyWasPressed(GLFW_KEY_F3))
 		{
-			film.normalize(renderer.type);
-			film.tonemap(scene.tonemapper, renderer.type);
-			film.getTonemappedImage().download();
-			film.getTonemappedImage().save("image.png");
+			std::lock_guard<std::mutex> filmLock(filmMutex);
+
+			film.getCumulativeImage().download();
+			film.saveImage("image.png", scene.tonemapper);
 		}
 
 		if (windowRunner.keyWasPressed(GLFW_KEY_F4))
 		{
+			pauseRendering();
+			std::lock_guard<std::mutex> filmLock(filmMutex);
+
 			film.getCumulativeImage().download();
-			film.save("film.bin");
+			film.save("film.bin", scene.getHash());
 		}
 	}
 
@@ -302,6 +388,8 @@ void WindowRunnerRenderState::update(float timeStep)
 		if (ctrlIsPressed)
 			testSceneIndex += 10;
 
+		pauseRendering();
+
 		try
 		{
 			scene = TestScene::create(testSceneIndex);
@@ -315,11 +403,12 @@ void WindowRunnerRenderState::update(float timeStep)
 			scene.initialize();
 		}
 
-		scene.camera.setImagePlaneSize(film.getWidth(), film.getHeight());
-		film.clear(renderer.type);
+		camera = scene.camera;
+		camera.setImagePlaneSize(film.getWidth(), film.getHeight());
+		restartRendering();
 	}
 
-	scene.camera.update(timeStep);
+	camera.update(timeStep);
 }
 
 void WindowRunnerRenderState::render(float timeStep, float interpolation)
@@ -327,24 +416,54 @@ void WindowRunnerRenderState::render(float timeStep, float interpolation)
 	(void)timeStep;
 	(void)interpolation;
 
-	if (scene.camera.isMoving())
-		film.clear(renderer.type);
+	bool cameraIsMoving = camera.isMoving();
+
+	if (cameraIsMoving)
+		restartRendering();
 
-	renderer.filtering = !film.hasBeenCleared();
-	film.resetCleared();
+	if (renderer.type == RendererType::CPU)
+		resumeRendering();
+	else
+	{
+		{
+			std::lock_guard<std::mutex> lock(renderMutex);
+
+			if (restartRequested)
+				applyRestart(film);
+		}
+
+		renderer.filtering = !film.hasBeenCleared();
+		film.resetCleared();
+
+		presentJob.interrupted = false;
+		presentJob.totalSampleCount = 0;
+
+		renderer.render(presentJob);
+	}
+
+	std::lock_guard<std::mutex> renderLock(renderMutex);
+	std::lock_guard<std::mutex> filmLock(filmMutex);
+
+	cameraMoving = cameraIsMoving;
+
+	// the texture follows the size of the render film
+	if (presentImageUpdated && renderer.type == RendererType::CPU)
+	{
+		if (presentImage.getWidth() != film.getWidth() || presentImage.getHeight() != film.getHeight())
+			film.resize(presentImage.getWidth(), presentImage.getHeight(), renderer.type);
 
-	RenderJob job;
-	job.scene = &scene;
-	job.film = &film;
-	job.interrupted = false;
-	job.totalSampleCount = 0;
+		std::swap(film.getCumulativeImage(), presentImage);
+		film.pixelSamples = presentPixelSamples;
+		presentImageUpdated = false;
+	}
+
+	// samples per frame for the info panel
+	if (renderer.type == RendererType::CPU)
+		presentJob.totalSampleCount = renderJob.totalSampleCount.exchange(0);
 	
-	renderer.render(job);
-	film.normalize(renderer.type);
-	film.tonemap(scene.tonemapper, renderer.type);
-	film.updateTexture(renderer.type);
+	film.resolve(scene.tonemapper, renderer.type);
 	filmQuad.render(film);
-	infoPanel.render(renderer, job);
+	infoPanel.render(renderer, presentJob);
 }
 
 void WindowRunnerRenderState::windowResized(uint32_t width, uint32_t height)
@@ -366,7 +485,221 @@ void WindowRunnerRenderState::resizeFilm()
     filmWidth = MAX(uint32_t(1), filmWidth);
     filmHeight = MAX(uint32_t(1), filmHeight);
 
+	pauseRendering();
+
+	maxFilmWidth = filmWidth;
+	maxFilmHeight = filmHeight;
+	maxRenderScaleStep = 0;
+
+	if (settings.window.dynamicRenderScale && renderer.type == RendererType::CPU)
+	{
+		while (maxRenderScaleStep < 16 && settings.window.renderScale * std::pow(0.5f, float(maxRenderScaleStep + 1) * 0.5f) >= settings.window.minRenderScale)
+			maxRenderScaleStep++;
+	}
+
+	renderScaleStep = MIN(renderScaleStep, maxRenderScaleStep);
+
 	film.resize(filmWidth, filmHeight, renderer.type);
-	renderer.resize(filmWidth, filmHeight);
-	scene.camera.setImagePlaneSize(filmWidth, filmHeight);
+	resizeRenderFilm(false);
+	camera.setImagePlaneSize(filmWidth, filmHeight);
+
+	restartRendering();
+}
+
+// called from the render thread, or while it is paused
+void WindowRunnerRenderState::resizeRenderFilm(bool seed)
+{
+	float scale = std::pow(0.5f, float(renderScaleStep) * 0.5f);
+	uint32_t width = MAX(uint32_t(1), uint32_t(float(maxFilmWidth) * scale + 0.5f));
+	uint32_t height = MAX(uint32_t(1), uint32_t(float(maxFilmHeight) * scale + 0.5f));
+
+	if (width == renderFilm.getWidth() && height == renderFilm.getHeight())
+		return;
+
+	Image previousImage;
+
+	if (seed)
+		previousImage = std::move(renderFilm.getCumulativeImage());
+
+	renderFilm.resize(width, height, renderer.type);
+	renderer.resize(width, height);
+	scene.camera.setImagePlaneSize(width, height);
+
+	if (seed)
+		renderFilm.seed(previousImage);
+}
+
+// called from the render thread with renderMutex locked when the rendering restarts while the camera moves
+void WindowRunnerRenderState::updateRenderScale()
+{
+	float targetFrameTime = App::getSettings().window.targetFrameTime;
+
+	// one step at a time, the hysteresis keeps the resolution from flipping back and forth
+	if (imageSampleTime > targetFrameTime * 1.25f && renderScaleStep < maxRenderScaleStep)
+		renderScaleStep++;
+	else if (imageSampleTime < targetFrameTime * 0.4f && renderScaleStep > 0)
+		renderScaleStep--;
+	else
+		return;
+
+	resizeRenderFilm(false);
+}
+
+void WindowRunnerRenderState::renderLoop()
+{
+	Settings& settings = App::getSettings();
+	bool reproject = false;
+	uint32_t previousPixelSamples = 0;
+
+	try
+	{
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(renderMutex);
+
+				renderIdle = true;
+				renderCondition.notify_all();
+				renderCondition.wait(lock, [this]() { return !renderPaused || renderThreadShouldStop; });
+
+				if (renderThreadShouldStop)
+					break;
+
+				renderIdle = false;
+				renderJob.interrupted = false;
+				reproject = false;
+
+				if (restartRequested)
+				{
+					reproject = cameraMoving && settings.window.temporalReprojection;
+
+					if (reproject)
+					{
+						previousCamera = scene.camera;
+						previousImage = renderFilm.getCumulativeImage();
+						previousPixelSamples = renderFilm.pixelSamples;
+					}
+					else
+						temporalReprojection.invalidate();
+
+					if (cameraMoving)
+						updateRenderScale();
+
+					applyRestart(renderFilm);
+					renderFirstPass = true;
+				}
+
+				renderer.filtering = !renderFilm.hasBeenCleared();
+			}
+
+			// done outside the lock so that the window does not wait for it
+			if (reproject)
+			{
+				temporalReprojection.reproject(scene, previousCamera, previousImage, renderFilm, settings.window.reprojectionWeight);
+
+				// the sample indices continue after the ones in the history, static pixels would repeat them otherwise
+				renderFilm.pixelSamples = previousPixelSamples;
+			}
+
+			Timer imageSampleTimer;
+			uint32_t startPixelSamples = renderFilm.pixelSamples;
+			renderer.render(renderJob);
+
+			// an interrupted image sample is finished when the rendering continues
+			if (renderFilm.pixelSamples != startPixelSamples)
+			{
+				uint32_t imageSamples = (renderFilm.pixelSamples - startPixelSamples) / MAX(uint32_t(1), App::getSettings().renderer.pixelSamples);
+				imageSampleTime = imageSampleTimer.getElapsedMilliseconds() / float(MAX(uint32_t(1), imageSamples));
+
+				renderFilm.resetCleared();
+				publishRenderFilm();
+
+				std::lock_guard<std::mutex> lock(renderMutex);
+				renderFirstPass = false;
+
+				// refine back to the full resolution once the camera has stopped
+				if (!restartRequested && !cameraMoving && renderScaleStep > 0)
+				{
+					renderScaleStep--;
+					resizeRenderFilm(true);
+					temporalReprojection.invalidate();
+				}
+			}
+		}
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(renderMutex);
+
+		renderException = std::current_exception();
+		renderIdle = true;
+		renderCondition.notify_all();
+	}
+}
+
+void WindowRunnerRenderState::stopRenderThread()
+{
+	if (!renderThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(renderMutex);
+
+		renderThreadShouldStop = true;
+		renderJob.interrupted = true;
+		renderCondition.notify_all();
+	}
+
+	renderThread.join();
+}
+
+// the scene and the render film can be changed until the rendering is resumed
+void WindowRunnerRenderState::pauseRendering()
+{
+	std::unique_lock<std::mutex> lock(renderMutex);
+
+	renderPaused = true;
+	renderJob.interrupted = true;
+	renderCondition.wait(lock, [this]() { return renderIdle; });
+}
+
+void WindowRunnerRenderState::resumeRendering()
+{
+	std::lock_guard<std::mutex> lock(renderMutex);
+
+	if (renderException != nullptr)
+		std::rethrow_exception(renderException);
+
+	renderPaused = (renderer.type != RendererType::CPU);
+	renderCondition.notify_all();
+}
+
+void WindowRunnerRenderState::restartRendering()
+{
+	std::lock_guard<std::mutex> lock(renderMutex);
+
+	restartCamera = camera;
+	restartRequested = true;
+
+	if (!renderFirstPass)
+		renderJob.interrupted = true;
+}
+
+// called with renderMutex locked
+void WindowRunnerRenderState::applyRestart(Film& restartedFilm)
+{
+	scene.camera = restartCamera;
+	scene.camera.setImagePlaneSize(restartedFilm.getWidth(), restartedFilm.getHeight());
+	restartedFilm.clear(renderer.type);
+	renderer.restart();
+	restartRequested = false;
+}
+
+void WindowRunnerRenderState::publishRenderFilm()
+{
+	std::lock_guard<std::mutex> lock(filmMutex);
+
+	presentImage = renderFilm.getCumulativeImage();
+	presentPixelSamples = renderFilm.pixelSamples;
+	presentImageUpdated = true;
 }
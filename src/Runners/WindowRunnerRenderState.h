@@ -3,12 +3,42 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "Core/Camera.h"
 #include "Core/Scene.h"
 #include "Core/Film.h"
 #include "Renderers/Renderer.h"
+#include "Renderers/TemporalReprojection.h"
 #include "Utils/FilmQuad.h"
 #include "Utils/InfoPanel.h"
 
+/*
+
+With the CPU renderer the rendering runs in a background thread, so the window keeps up with the input and
+vsync however long an image sample takes. The render thread accumulates into its own film and copies it to
+the presented film after every finished image sample. The presented film is resolved every frame.
+
+The camera is controlled through a separate copy that is handed to the render thread when the rendering
+restarts. Restarts interrupt the current image sample (except the first one after a restart, so that
+something gets presented while the camera keeps moving). Other scene changes pause the render thread first.
+
+With window.dynamicRenderScale the render film steps down in resolution (by sqrt(2), halving the pixel count)
+while the camera moves and an image sample takes longer than window.targetFrameTime, and steps up when it
+is clearly faster. Once the camera stops, the resolution is stepped back up to window.renderScale after each
+image sample, and each larger film is seeded with the samples of the previous one.
+
+With window.temporalReprojection the samples of the previous camera that still show the same surface are
+carried over to the restarted film (see TemporalReprojection) instead of starting from black.
+
+The CUDA renderer shares the presented film with OpenGL and still renders synchronously in the main thread
+(always at window.renderScale).
+
+*/
+
 namespace Valo
 {
 	class WindowRunnerRenderState
@@ -16,6 +46,7 @@ namespace Valo
 	public:
 
 		WindowRunnerRenderState();
+		~WindowRunnerRenderState();
 
 		void initialize();
 		void shutdown();
@@ -28,11 +59,56 @@ namespace Valo
 	private:
 
 		void resizeFilm();
+		void resizeRenderFilm(bool seed);
+		void updateRenderScale();
+
+		void renderLoop();
+		void stopRenderThread();
+		void pauseRendering();
+		void resumeRendering();
+		void restartRendering();
+		void applyRestart(Film& restartedFilm);
+		void publishRenderFilm();
 
 		Scene scene;
+		Camera camera;
 		Film film;
+		Film renderFilm;
 		Renderer renderer;
 		FilmQuad filmQuad;
 		InfoPanel infoPanel;
+
+		RenderJob renderJob;
+		RenderJob presentJob;
+
+		std::thread renderThread;
+		std::mutex renderMutex;
+		std::mutex filmMutex;
+		std::condition_variable renderCondition;
+		std::exception_ptr renderException = nullptr;
+
+		// guarded by filmMutex
+		Image presentImage;
+		uint32_t presentPixelSamples = 0;
+		bool presentImageUpdated = false;
+
+		// only used by the render thread, or while it is paused
+		uint32_t maxFilmWidth = 0;
+		uint32_t maxFilmHeight = 0;
+		uint32_t renderScaleStep = 0;
+		uint32_t maxRenderScaleStep = 0;
+		float imageSampleTime = 0.0f;
+		TemporalReprojection temporalReprojection;
+		Camera previousCamera;
+		Image previousImage;
+
+		// guarded by renderMutex
+		Camera restartCamera;
+		bool restartRequested = false;
+		bool cameraMoving = false;
+		bool renderPaused = false;
+		bool renderIdle = true;
+		bool renderFirstPass = false;
+		bool renderThreadShouldStop = false;
 	};
 }
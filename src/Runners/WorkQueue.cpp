@@ -0,0 +1,148 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include "Runners/WorkQueue.h"
+#include "Core/Common.h"
+#include "Renderers/RenderJournal.h"
+
+using namespace Valo;
+
+std::vector<WorkUnit> WorkQueue::split(uint32_t filmWidth, uint32_t filmHeight, uint32_t regionX, uint32_t regionY, uint32_t regionWidth, uint32_t regionHeight, uint32_t imageSamples, WorkUnitType type, uint32_t unitSize)
+{
+	unitSize = MAX(uint32_t(1), unitSize);
+
+	// the journal lays out the region exactly like the renderer does
+	RenderJournal journal;
+	uint32_t bucketSize = (type == WorkUnitType::REGION) ? unitSize : MAX(filmWidth, filmHeight);
+	journal.initialize(filmWidth, filmHeight, regionX, regionY, regionWidth, regionHeight, bucketSize);
+
+	uint32_t passCount = (type == WorkUnitType::REGION) ? imageSamples : unitSize;
+	std::vector<WorkUnit> units;
+
+	for (const RenderBucket* bucket : journal.getPendingBuckets(journal.getBucketCount()))
+	{
+		for (uint32_t firstPass = 0; firstPass < imageSamples; firstPass += passCount)
+		{
+			WorkUnit unit;
+			unit.id = uint32_t(units.size());
+			unit.regionX = bucket->x;
+			unit.regionY = bucket->y;
+			unit.regionWidth = bucket->width;
+			unit.regionHeight = bucket->height;
+			unit.firstPass = firstPass;
+			unit.passCount = MIN(passCount, imageSamples - firstPass);
+
+			units.push_back(unit);
+		}
+	}
+
+	return units;
+}
+
+void WorkQueue::initialize(const std::vector<WorkUnit>& units_, bool reissueStragglers_)
+{
+	reissueStragglers = reissueStragglers_;
+	completedUnitCount = 0;
+	issueCount = 0;
+
+	units.clear();
+	pendingUnits.clear();
+
+	for (const WorkUnit& unit : units_)
+	{
+		UnitState state;
+		state.unit = unit;
+		state.unit.id = uint32_t(units.size());
+
+		pendingUnits.push_back(state.unit.id);
+		units.push_back(state);
+	}
+}
+
+bool WorkQueue::getNextUnit(WorkUnit& unit)
+{
+	UnitState* nextState = nullptr;
+
+	while (!pendingUnits.empty() && nextState == nullptr)
+	{
+		UnitState& state = units[pendingUnits.front()];
+		pendingUnits.pop_front();
+
+		if (!state.completed)
+			nextState = &state;
+	}
+
+	// the oldest unit running without a copy
+	if (nextState == nullptr && reissueStragglers)
+	{
+		for (UnitState& state : units)
+		{
+			if (!state.completed && state.runningCount == 1 && (nextState == nullptr || state.issueNumber < nextState->issueNumber))
+				nextState = &state;
+		}
+	}
+
+	if (nextState == nullptr)
+		return false;
+
+	nextState->runningCount++;
+	nextState->issueNumber = issueCount++;
+	unit = nextState->unit;
+
+	return true;
+}
+
+bool WorkQueue::completeUnit(uint32_t id)
+{
+	if (id >= units.size())
+		return false;
+
+	UnitState& state = units[id];
+
+	if (state.runningCount > 0)
+		state.runningCount--;
+
+	if (state.completed)
+		return false;
+
+	state.completed = true;
+	completedUnitCount++;
+
+	return true;
+}
+
+void WorkQueue::releaseUnit(uint32_t id)
+{
+	if (id >= units.size())
+		return;
+
+	UnitState& state = units[id];
+
+	if (state.runningCount > 0)
+		state.runningCount--;
+
+	if (!state.completed && state.runningCount == 0)
+		pendingUnits.push_front(id);
+}
+
+bool WorkQueue::isFinished() const
+{
+	return completedUnitCount == uint32_t(units.size());
+}
+
+uint32_t WorkQueue::getUnitCount() const
+{
+	return uint32_t(units.size());
+}
+
+const WorkUnit& WorkQueue::getUnit(uint32_t id) const
+{
+	return units[id].unit;
+}
+
+uint32_t WorkQueue::getCompletedUnitCount() const
+{
+	return completedUnitCount;
+}
@@ -0,0 +1,58 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "Runners/ClusterProtocol.h"
+
+/*
+
+Hands out work units to workers on request, so faster workers simply get more units. When there are no
+unassigned units left, idle workers get a second copy of the unit that has been running the longest
+(straggler reissue) and the first result wins. Units of lost workers are put back to the front of the queue.
+
+*/
+
+namespace Valo
+{
+	enum class WorkUnitType { REGION, SAMPLE_RANGE };
+
+	class WorkQueue
+	{
+	public:
+
+		static std::vector<WorkUnit> split(uint32_t filmWidth, uint32_t filmHeight, uint32_t regionX, uint32_t regionY, uint32_t regionWidth, uint32_t regionHeight, uint32_t imageSamples, WorkUnitType type, uint32_t unitSize);
+
+		void initialize(const std::vector<WorkUnit>& units, bool reissueStragglers);
+
+		bool getNextUnit(WorkUnit& unit);
+		bool completeUnit(uint32_t id);
+		void releaseUnit(uint32_t id);
+
+		bool isFinished() const;
+		const WorkUnit& getUnit(uint32_t id) const;
+		uint32_t getUnitCount() const;
+		uint32_t getCompletedUnitCount() const;
+
+	private:
+
+		struct UnitState
+		{
+			WorkUnit unit;
+			uint32_t runningCount = 0;
+			uint64_t issueNumber = 0;
+			bool completed = false;
+		};
+
+		std::vector<UnitState> units;
+		std::deque<uint32_t> pendingUnits;
+
+		bool reissueStragglers = true;
+		uint32_t completedUnitCount = 0;
+		uint64_t issueCount = 0;
+	};
+}
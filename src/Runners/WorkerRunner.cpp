@@ -0,0 +1,162 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include <boost/asio.hpp>
+
+#include "App.h"
+#include "Core/Film.h"
+#include "Core/Scene.h"
+#include "Math/Color.h"
+#include "Renderers/Renderer.h"
+#include "Runners/ClusterProtocol.h"
+#include "Runners/WorkerRunner.h"
+#include "TestScenes/TestScene.h"
+#include "Utils/Log.h"
+#include "Utils/Settings.h"
+
+using namespace Valo;
+
+namespace asio = boost::asio;
+using asio::ip::tcp;
+
+int WorkerRunner::run()
+{
+	Settings& settings = App::getSettings();
+	Log& log = App::getLog();
+
+	Renderer renderer;
+	Scene scene;
+	Film film(false);
+
+	if (settings.scene.useTestScene)
+		scene = TestScene::create(settings.scene.testSceneNumber);
+	else
+		scene.load(settings.scene.fileName);
+
+	scene.configureTextureCache(settings);
+
+	scene.initialize();
+	film.initialize();
+	renderer.initialize(settings);
+
+	// the coordinator collects the results, so nothing is written here
+	renderer.imageAutoWrite = false;
+	renderer.filmAutoWrite = false;
+
+	film.resize(settings.image.width, settings.image.height, renderer.type);
+
+	scene.camera.setImagePlaneSize(settings.image.width, settings.image.height);
+	scene.camera.update(0.0f);
+
+	renderJob.scene = &scene;
+	renderJob.film = &film;
+	renderJob.interrupted = false;
+
+	asio::io_context ioContext;
+	tcp::socket socket(ioContext);
+	tcp::resolver resolver(ioContext);
+
+	log.logInfo("Connecting to coordinator %s:%d", settings.worker.address, settings.worker.port);
+
+	// the coordinator may still be starting up
+	for (uint32_t attempt = 0; ; ++attempt)
+	{
+		try
+		{
+			asio::connect(socket, resolver.resolve(settings.worker.address, std::to_string(settings.worker.port)));
+			break;
+		}
+		catch (const boost::system::system_error& ex)
+		{
+			if (attempt >= 20 || renderJob.interrupted)
+				throw std::runtime_error(tfm::format("Could not connect to coordinator %s:%d: %s", settings.worker.address, settings.worker.port, ex.what()));
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(500));
+		}
+	}
+
+	HelloMessage hello;
+	hello.filmWidth = settings.image.width;
+	hello.filmHeight = settings.image.height;
+	hello.pixelSamples = settings.renderer.pixelSamples;
+	hello.sceneHash = scene.getHash();
+
+	MessageHeader helloHeader;
+	helloHeader.type = MessageType::HELLO;
+	helloHeader.size = sizeof(hello);
+
+	asio::write(socket, std::vector<asio::const_buffer> { asio::buffer(&helloHeader, sizeof(helloHeader)), asio::buffer(&hello, sizeof(hello)) });
+
+	uint32_t unitCount = 0;
+
+	while (!renderJob.interrupted)
+	{
+		MessageHeader header;
+		asio::read(socket, asio::buffer(&header, sizeof(header)));
+
+		if (header.magic != CLUSTER_PROTOCOL_MAGIC)
+			throw std::runtime_error("Invalid message from the coordinator");
+
+		if (header.type == MessageType::DONE)
+			break;
+
+		if (header.type != MessageType::UNIT || header.size != sizeof(WorkUnit))
+			throw std::runtime_error("Unexpected message from the coordinator");
+
+		WorkUnit unit;
+		asio::read(socket, asio::buffer(&unit, sizeof(unit)));
+
+		log.logInfo("Rendering work unit %d (region: %d, %d, %dx%d, image samples: %d-%d)", unit.id, unit.regionX, unit.regionY, unit.regionWidth, unit.regionHeight, unit.firstPass, unit.firstPass + unit.passCount - 1);
+
+		renderer.regionX = unit.regionX;
+		renderer.regionY = unit.regionY;
+		renderer.regionWidth = unit.regionWidth;
+		renderer.regionHeight = unit.regionHeight;
+		renderer.resize(film.getWidth(), film.getHeight());
+
+		// only the unit's region is sent back, so earlier units and their filter spill elsewhere can stay
+		if (renderer.type == RendererType::CPU)
+			film.getCumulativeImage().clearRegion(unit.regionX, unit.regionY, unit.regionWidth, unit.regionHeight);
+		else
+			film.clear(renderer.type);
+
+		// the sample indices continue from the earlier passes so that the units add up to a single render
+		film.pixelSamples = unit.firstPass * settings.renderer.pixelSamples;
+		renderer.imageSamples = unit.passCount;
+
+		renderJob.totalSampleCount = 0;
+		renderer.render(renderJob);
+
+		if (renderJob.interrupted)
+			break;
+
+		film.getCumulativeImage().download();
+
+		std::vector<Color> pixels(size_t(unit.regionWidth) * size_t(unit.regionHeight));
+
+		for (uint32_t y = 0; y < unit.regionHeight; ++y)
+		{
+			for (uint32_t x = 0; x < unit.regionWidth; ++x)
+				pixels[y * unit.regionWidth + x] = film.getCumulativeColor(unit.regionX + x, unit.regionY + y);
+		}
+
+		MessageHeader resultHeader;
+		resultHeader.type = MessageType::RESULT;
+		resultHeader.size = sizeof(unit) + pixels.size() * sizeof(Color);
+
+		asio::write(socket, std::vector<asio::const_buffer> { asio::buffer(&resultHeader, sizeof(resultHeader)), asio::buffer(&unit, sizeof(unit)), asio::buffer(pixels.data(), pixels.size() * sizeof(Color)) });
+
+		unitCount++;
+	}
+
+	log.logInfo("Worker %s (work units: %d)", renderJob.interrupted ? "interrupted" : "finished", unitCount);
+
+	return 0;
+}
+
+void WorkerRunner::interrupt()
+{
+	renderJob.interrupted = true;
+}
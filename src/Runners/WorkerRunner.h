@@ -0,0 +1,29 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include "Renderers/Renderer.h"
+
+/*
+
+Connects to a coordinator (see CoordinatorRunner), renders the work units it hands out and sends each
+finished unit back as the cumulative pixels of its region. The worker loads the same scene and settings
+as the coordinator and exits when the coordinator has no more work.
+
+*/
+
+namespace Valo
+{
+	class WorkerRunner
+	{
+	public:
+
+		int run();
+		void interrupt();
+
+	private:
+
+		RenderJob renderJob;
+	};
+}
@@ -0,0 +1,53 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#ifdef RUN_UNIT_TESTS
+
+#include "catch/catch.hpp"
+
+#include "Core/Camera.h"
+#include "Core/Ray.h"
+#include "Math/Sampler.h"
+#include "Math/Vector2.h"
+
+using namespace Valo;
+
+TEST_CASE("Camera projection", "[camera]")
+{
+	for (CameraType type : { CameraType::PERSPECTIVE, CameraType::ORTHOGRAPHIC })
+	{
+		Camera camera;
+		camera.type = type;
+		camera.position = Vector3(1.0f, 2.0f, 3.0f);
+		camera.orientation = EulerAngle(-20.0f, 35.0f, 0.0f);
+		camera.fov = 60.0f;
+		camera.orthoSize = 4.0f;
+		camera.setImagePlaneSize(160, 100);
+		camera.update(0.0f);
+
+		Sampler sampler;
+
+		// a point along the ray through a pixel center projects back to the same pixel
+		for (uint32_t y = 0; y < 100; y += 9)
+		{
+			for (uint32_t x = 0; x < 160; x += 13)
+			{
+				CameraRay cameraRay = camera.getRay(Vector2(float(x), float(y)), sampler);
+				Vector3 point = cameraRay.ray.origin + cameraRay.ray.direction * 7.5f;
+
+				Vector2 pixel;
+				REQUIRE(camera.project(point, pixel));
+				REQUIRE(std::abs(pixel.x - float(x)) < 0.01f);
+				REQUIRE(std::abs(pixel.y - float(y)) < 0.01f);
+			}
+		}
+
+		// points behind the camera are not visible
+		Vector2 pixel;
+		REQUIRE(!camera.project(camera.position - camera.getForward(), pixel));
+	}
+}
+
+#endif
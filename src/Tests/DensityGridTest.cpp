@@ -0,0 +1,52 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#ifdef RUN_UNIT_TESTS
+
+#include "catch/catch.hpp"
+
+#include "Core/AABB.h"
+#include "Utils/DensityGrid.h"
+#include "Utils/PerlinNoise.h"
+
+using namespace Valo;
+
+TEST_CASE("Density grid functionality", "[densitygrid]")
+{
+	PerlinNoise noise;
+	noise.initialize(12345);
+
+	DensityGrid grid;
+	grid.voxelSize = 0.05f;
+	grid.bake(AABB::createFromMinMax(Vector3(-1.0f, -1.0f, -1.0f), Vector3(1.0f, 1.0f, 1.0f)), [&noise](const Vector3& position)
+	{
+		return noise.getNoise(position);
+	});
+
+	REQUIRE(grid.isInside(Vector3(0.0f, 0.0f, 0.0f)));
+	REQUIRE(!grid.isInside(Vector3(2.0f, 0.0f, 0.0f)));
+
+	for (uint32_t i = 0; i < 100; ++i)
+	{
+		Vector3 position(-0.9f + i * 0.018f, 0.3f - i * 0.007f, 0.5f - i * 0.013f);
+		REQUIRE(std::abs(grid.getDensity(position) - noise.getNoise(position)) < 0.05f);
+	}
+
+	// a tiny budget coarsens the grid, an empty one is an error
+	DensityGrid coarseGrid;
+	coarseGrid.voxelSize = 0.001f;
+	coarseGrid.maxMemoryUsage = 1;
+	coarseGrid.bake(AABB::createFromMinMax(Vector3(-1.0f, -1.0f, -1.0f), Vector3(1.0f, 1.0f, 1.0f)), [](const Vector3& position) { return position.x; });
+
+	REQUIRE(std::abs(coarseGrid.getDensity(Vector3(0.25f, 0.0f, 0.0f)) - 0.25f) < 0.001f);
+
+	DensityGrid emptyGrid;
+	emptyGrid.voxelSize = 0.05f;
+	emptyGrid.maxMemoryUsage = 0;
+
+	REQUIRE_THROWS(emptyGrid.bake(AABB::createFromMinMax(Vector3(-1.0f, -1.0f, -1.0f), Vector3(1.0f, 1.0f, 1.0f)), [](const Vector3&) { return 0.0f; }));
+}
+
+#endif
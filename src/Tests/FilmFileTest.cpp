@@ -0,0 +1,83 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#ifdef RUN_UNIT_TESTS
+
+#include "catch/catch.hpp"
+
+#include "Core/FilmFile.h"
+#include "Core/Image.h"
+#include "Math/Color.h"
+
+using namespace Valo;
+
+TEST_CASE("Film file write/merge", "[filmfile]")
+{
+	// large enough to span several chunks
+	Image image1(300, 300);
+	Image image2(300, 300);
+
+	for (uint32_t i = 0; i < image1.getLength(); ++i)
+	{
+		image1.setPixel(i, Color(float(i % 11), float(i % 7), float(i % 3), 1.0f));
+		image2.setPixel(i, Color(float(i % 5), 1.0f, 2.0f, 3.0f));
+	}
+
+	FilmFileInfo info;
+	info.width = 300;
+	info.height = 300;
+	info.pixelSamples = 10;
+	info.sceneHash = 1234;
+
+	FilmFile::write("film1.bin", image1, info);
+	info.pixelSamples = 20;
+	FilmFile::write("film2.bin", image2, info);
+
+	Image merged(300, 300);
+	FilmFileInfo mergedInfo = FilmFile::merge({ "film1.bin", "film2.bin" }, merged);
+
+	REQUIRE(mergedInfo.pixelSamples == 30);
+	REQUIRE(mergedInfo.sceneHash == 1234);
+
+	for (uint32_t i = 0; i < merged.getLength(); ++i)
+	{
+		Color expected = image1.getPixel(i) + image2.getPixel(i);
+		Color actual = merged.getPixel(i);
+
+		REQUIRE(actual.r == expected.r);
+		REQUIRE(actual.g == expected.g);
+		REQUIRE(actual.b == expected.b);
+		REQUIRE(actual.a == expected.a);
+	}
+
+	Image wrongSize(200, 300);
+	REQUIRE_THROWS(FilmFile::merge({ "film1.bin" }, wrongSize));
+
+	info.sceneHash = 5678;
+	FilmFile::write("film3.bin", image2, info);
+	REQUIRE_THROWS(FilmFile::merge({ "film1.bin", "film3.bin" }, merged));
+
+	// zero scene hash is unknown
+	info.sceneHash = 0;
+	FilmFile::write("film4.bin", image2, info);
+	Image unknownMerged(300, 300);
+	REQUIRE(FilmFile::merge({ "film4.bin", "film1.bin" }, unknownMerged).sceneHash == 1234);
+
+	// flip one pixel byte near the end of the file
+	{
+		std::fstream file("film3.bin", std::ios::in | std::ios::out | std::ios::binary);
+		file.seekp(48 + 300 * 300 * 16 - 10);
+		file.put(char(0x7f));
+	}
+
+	REQUIRE_THROWS(FilmFile::merge({ "film3.bin" }, merged));
+
+	// a failed merge leaves the image untouched
+	Color expected = image1.getPixel(1000) + image2.getPixel(1000);
+	REQUIRE(merged.getPixel(1000).r == expected.r);
+	REQUIRE(merged.getPixel(1000).a == expected.a);
+}
+
+#endif
@@ -47,6 +47,21 @@ TEST_CASE("Filter functionality", "[filter]")
 
 		file1.close();
 		file2.close();
+
+		filter.initialize();
+		Vector2 radius = filter.getRadius();
+
+		for (uint32_t i = 0; i < 100; ++i)
+		{
+			FilterSample sample = filter.getSample(Vector2(i / 100.0f, 1.0f - i / 100.0f - 0.001f));
+
+			REQUIRE(std::abs(sample.offset.x) <= radius.x);
+			REQUIRE(std::abs(sample.offset.y) <= radius.y);
+			REQUIRE(std::abs(sample.weight) == 1.0f);
+
+			if (filter.getWeight(sample.offset) > 0.001f)
+				REQUIRE(sample.weight == 1.0f);
+		}
 	}
 }
 
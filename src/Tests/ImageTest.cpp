@@ -6,10 +6,14 @@
 #ifdef RUN_UNIT_TESTS
 
 #include "catch/catch.hpp"
+#include "tinyformat/tinyformat.h"
 
 #include "Core/Image.h"
+#include "Core/ImagePool.h"
 #include "Filters/Filter.h"
 #include "Math/Color.h"
+#include "Math/Random.h"
+#include "Renderers/Renderer.h"
 
 using namespace Valo;
 
@@ -46,6 +50,42 @@ TEST_CASE("Image save/load functionality", "[image]")
 	image.save("image2.hdr");
 }
 
+TEST_CASE("Image streaming writers", "[image]")
+{
+	// tall enough for several deflate strips
+	Image image1(640, 1200);
+
+	for (uint32_t y = 0; y < image1.getHeight(); ++y)
+	{
+		for (uint32_t x = 0; x < image1.getWidth(); ++x)
+			image1.setPixel(x, y, Color(float(x % 256) / 255.0f, float(y % 256) / 255.0f, float((x * y) % 7) / 6.0f, 1.0f));
+	}
+
+	image1.save("image_stream.png");
+	image1.save("image_stream.hdr");
+	image1.save("image_stream.pfm");
+
+	Image image2("image_stream.png");
+	Image image3("image_stream.hdr");
+
+	REQUIRE(image2.getWidth() == image1.getWidth());
+	REQUIRE(image2.getHeight() == image1.getHeight());
+
+	for (uint32_t i = 0; i < image1.getLength(); ++i)
+	{
+		Color color1 = image1.getPixel(i);
+		Color color3 = image3.getPixel(i);
+
+		REQUIRE(image2.getPixel(i).getAbgrValue() == color1.getAbgrValue());
+		REQUIRE(std::abs(color3.r - color1.r) < 0.01f);
+		REQUIRE(std::abs(color3.g - color1.g) < 0.01f);
+		REQUIRE(std::abs(color3.b - color1.b) < 0.01f);
+	}
+
+	std::ifstream file("image_stream.pfm", std::ios::in | std::ios::binary | std::ios::ate);
+	REQUIRE(uint64_t(file.tellg()) == std::string("PF\n640 1200\n-1.0\n").size() + image1.getLength() * 3 * sizeof(float));
+}
+
 TEST_CASE("Image interpolation functionality", "[image]")
 {
 	Image image1(101, 101);
@@ -81,4 +121,179 @@ TEST_CASE("Image interpolation functionality", "[image]")
 	image4.save("interpolation_bicubic.png");
 }
 
+TEST_CASE("Image downsample functionality", "[image]")
+{
+	Image image1(101, 101);
+	Image image2;
+	Image image3;
+
+	image1.fillWithTestPattern();
+	image2.downsample(image1);
+	image3.downsample(image2);
+
+	REQUIRE(image2.getWidth() == 50);
+	REQUIRE(image2.getHeight() == 50);
+	REQUIRE(image3.getWidth() == 25);
+
+	image2.save("downsample_level1.png");
+	image3.save("downsample_level2.png");
+
+	Image image4(2, 2);
+	Image image5;
+
+	image4.setPixel(0, 0, Color(1.0f, 0.0f, 0.0f));
+	image4.setPixel(1, 0, Color(0.0f, 0.0f, 0.0f));
+	image4.setPixel(0, 1, Color(0.0f, 0.0f, 0.0f));
+	image4.setPixel(1, 1, Color(0.0f, 1.0f, 0.0f));
+	image5.downsample(image4);
+
+	REQUIRE(image5.getWidth() == 1);
+	REQUIRE(image5.getPixel(0, 0).r == Approx(0.25f));
+	REQUIRE(image5.getPixel(0, 0).g == Approx(0.25f));
+}
+
+TEST_CASE("Image format functionality", "[image]")
+{
+	Image image1(64, 64);
+	Image image2;
+	Image image3;
+
+	for (uint32_t y = 0; y < 64; ++y)
+	{
+		for (uint32_t x = 0; x < 64; ++x)
+			image1.setPixel(x, y, Color(x / 63.0f, y / 63.0f, (x * y) / 3969.0f, 1.0f));
+	}
+
+	image2 = image1;
+	image3 = image1;
+	image2.setFormat(ImageFormat::RGBA8_SRGB);
+	image3.setFormat(ImageFormat::RGBA16F);
+
+	REQUIRE(image2.getMemoryUsage() == image1.getMemoryUsage() / 4);
+	REQUIRE(image3.getMemoryUsage() == image1.getMemoryUsage() / 2);
+
+	for (uint32_t i = 0; i < image1.getLength(); ++i)
+	{
+		Color original = image1.getPixel(i);
+		Color srgb = image2.getPixel(i);
+		Color half = image3.getPixel(i);
+
+		REQUIRE(srgb.r == Approx(original.r).epsilon(0.01f));
+		REQUIRE(srgb.b == Approx(original.b).epsilon(0.01f));
+		REQUIRE(half.g == Approx(original.g).epsilon(0.001f));
+	}
+
+	REQUIRE(image2.getPixelBilinear(0.5f, 0.5f).r == Approx(image1.getPixelBilinear(0.5f, 0.5f).r).epsilon(0.02f));
+
+	// the 8-bit bilinear fetch has to match the float fetch of the decoded pixels
+	Image image4 = image1;
+	image4.setFormat(ImageFormat::RGBA8);
+
+	Image decoded2 = image2;
+	Image decoded4 = image4;
+	decoded2.setFormat(ImageFormat::RGBA32F);
+	decoded4.setFormat(ImageFormat::RGBA32F);
+
+	for (float v = 0.0f; v <= 1.0f; v += 0.093f)
+	{
+		for (float u = 0.0f; u <= 1.0f; u += 0.071f)
+		{
+			Color c2 = image2.getPixelBilinear(u, v);
+			Color d2 = decoded2.getPixelBilinear(u, v);
+			Color c4 = image4.getPixelBilinear(u, v);
+			Color d4 = decoded4.getPixelBilinear(u, v);
+
+			REQUIRE(std::abs(c2.g - d2.g) < 0.0001f);
+			REQUIRE(std::abs(c2.a - d2.a) < 0.0001f);
+			REQUIRE(std::abs(c4.r - d4.r) < 0.0001f);
+			REQUIRE(std::abs(c4.b - d4.b) < 0.0001f);
+		}
+	}
+
+	image2.save("format_srgb.png");
+	image3.save("format_half.hdr");
+}
+
+TEST_CASE("Image compact accumulation", "[image]")
+{
+	// pixel 0 is dim, pixel 1 is bright enough that a half float sum would overflow
+	Image image(2, 1);
+	image.setFormat(ImageFormat::RGB16F_A32F);
+	image.clear(RendererType::CPU);
+
+	REQUIRE(image.getMemoryUsage() == 2 * 10);
+
+	Random random(1234);
+	double sums[2][3] = { { 0.0, 0.0, 0.0 }, { 0.0, 0.0, 0.0 } };
+	double weights[2] = { 0.0, 0.0 };
+	const float scales[2] = { 0.5f, 100.0f };
+
+	for (uint32_t i = 0; i < 5000; ++i)
+	{
+		for (uint32_t index = 0; index < 2; ++index)
+		{
+			Color color = random.getColor() * scales[index];
+			float weight = 0.2f + 0.8f * random.getFloat();
+
+			// same as Film::addSample
+			Color temp = image.getPixel(index);
+			temp.r += color.r * weight;
+			temp.g += color.g * weight;
+			temp.b += color.b * weight;
+			temp.a += weight;
+			image.setPixel(index, temp);
+
+			sums[index][0] += double(color.r) * weight;
+			sums[index][1] += double(color.g) * weight;
+			sums[index][2] += double(color.b) * weight;
+			weights[index] += weight;
+		}
+	}
+
+	for (uint32_t index = 0; index < 2; ++index)
+	{
+		Color pixel = image.getPixel(index);
+
+		REQUIRE(std::isfinite(pixel.r));
+		REQUIRE(pixel.a == Approx(weights[index]).epsilon(0.001f));
+		REQUIRE((pixel.r / pixel.a) == Approx(sums[index][0] / weights[index]).epsilon(0.01f));
+		REQUIRE((pixel.g / pixel.a) == Approx(sums[index][1] / weights[index]).epsilon(0.01f));
+		REQUIRE((pixel.b / pixel.a) == Approx(sums[index][2] / weights[index]).epsilon(0.01f));
+	}
+}
+
+TEST_CASE("ImagePool preload functionality", "[image]")
+{
+	std::vector<ImageLoadInfo> infos;
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		Image image(16 << i, 16);
+		image.fillWithTestPattern();
+		image.save(tfm::format("preload%d.png", i));
+
+		ImageLoadInfo info;
+		info.fileName = tfm::format("preload%d.png", i);
+		info.generateMipmaps = (i % 2 == 0);
+		infos.push_back(info);
+	}
+
+	infos.push_back(infos[0]);
+
+	ImagePool imagePool;
+	imagePool.preload(infos);
+
+	uint32_t index0 = imagePool.load("preload0.png", false, true);
+	uint32_t index1 = imagePool.load("preload1.png", false);
+	uint32_t index2 = imagePool.load("preload2.png", false, true);
+
+	REQUIRE(index0 == 0);
+	REQUIRE(imagePool.getMipLevelCount(index0) == 5);
+	REQUIRE(index1 == 5);
+	REQUIRE(imagePool.getMipLevelCount(index1) == 1);
+	REQUIRE(index2 == 6);
+	REQUIRE(imagePool.getWidth(index2) == 64);
+	REQUIRE(imagePool.getWidth(index2 + 1) == 32);
+}
+
 #endif
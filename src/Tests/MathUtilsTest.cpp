@@ -8,6 +8,7 @@
 #include "catch/catch.hpp"
 
 #include "Math/MathUtils.h"
+#include "Math/Vector3.h"
 
 using namespace Valo;
 
@@ -34,6 +35,31 @@ TEST_CASE("MathUtils functionality", "[mathutils]")
 
 	REQUIRE(MathUtils::almostSame(MathUtils::degToRad(90.0f), float(M_PI) / 2.0f));
 	REQUIRE(MathUtils::almostSame(MathUtils::degToRad(180.0f), float(M_PI)));
+
+	REQUIRE(MathUtils::floatToHalf(1.0f) == 0x3c00);
+	REQUIRE(MathUtils::floatToHalf(-2.0f) == 0xc000);
+	REQUIRE(MathUtils::floatToHalf(65504.0f) == 0x7bff);
+	REQUIRE(MathUtils::floatToHalf(100000.0f) == 0x7c00);
+	REQUIRE(MathUtils::floatToHalf(5.9604645e-8f) == 0x0001);
+	REQUIRE(MathUtils::halfToFloat(0x3555) == Approx(0.33325195f));
+	REQUIRE(MathUtils::halfToFloat(0x0001) == Approx(5.9604645e-8f));
+
+	bool halfRoundTrips = true;
+
+	for (uint32_t i = 0; i < 0x7c00; ++i)
+		halfRoundTrips = halfRoundTrips && (MathUtils::floatToHalf(MathUtils::halfToFloat(uint16_t(i))) == i);
+
+	REQUIRE(halfRoundTrips);
+
+	Vector3 directions[] = { Vector3(0.0f, 0.0f, 1.0f), Vector3(0.0f, 0.0f, -1.0f), Vector3(1.0f, -2.0f, 0.5f), Vector3(-0.3f, 0.1f, -0.9f), Vector3(0.0f, -1.0f, 0.0f) };
+
+	for (const Vector3& direction : directions)
+	{
+		Vector3 normalized = direction.normalized();
+		Vector3 decoded = MathUtils::decodeOctahedral(MathUtils::encodeOctahedral(normalized));
+
+		REQUIRE(decoded.dot(normalized) > 0.99999f);
+	}
 }
 
 #endif
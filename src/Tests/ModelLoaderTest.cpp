@@ -22,4 +22,137 @@ TEST_CASE("ModelLoader functionality", "[modelloader]")
 	REQUIRE(result.triangles.size() == 32);
 }
 
+TEST_CASE("ModelLoader chunked parsing", "[modelloader]")
+{
+	const uint32_t quadCount = 20000;
+
+	std::ofstream mtlFile("modelloader_test.mtl");
+	mtlFile << "newmtl first\nnewmtl second\n";
+	mtlFile.close();
+
+	// negative indices and material selections have to carry over the chunk boundaries
+	std::ofstream objFile("modelloader_test.obj");
+	objFile << "mtllib modelloader_test.mtl\n";
+
+	for (uint32_t i = 0; i < quadCount; ++i)
+	{
+		if (i % 1000 == 0)
+			objFile << ((i / 1000) % 2 == 0 ? "usemtl first\n" : "usemtl second\n");
+
+		objFile << "v " << i << " 0 0\nv " << i << " 1 0\nv " << i << " 1 1\nv " << i << " 0 1\n";
+		objFile << "f -4 -3 -2 -1\n";
+	}
+
+	objFile.close();
+
+	ModelLoaderInfo info;
+	ModelLoader modelLoader;
+
+	info.modelFileName = "modelloader_test.obj";
+	ModelLoaderResult result = modelLoader.load(info);
+
+	REQUIRE(result.materials.size() == 2);
+	REQUIRE(result.triangles.size() == quadCount * 2);
+
+	for (uint32_t i = 0; i < quadCount; ++i)
+	{
+		const Triangle& triangle = result.triangles[i * 2 + 1];
+
+		REQUIRE(triangle.vertices[0].x == float(i));
+		REQUIRE(triangle.vertices[2].y == 0.0f);
+		REQUIRE(triangle.vertices[2].z == 1.0f);
+		REQUIRE(triangle.materialId == result.materials[(i / 1000) % 2].id);
+	}
+}
+
+TEST_CASE("ModelLoader mesh files", "[modelloader]")
+{
+	std::ofstream objFile("modelloader_test.obj");
+	objFile << "v 1e2 -2.5E-1 0\nv 0 1.5e+1 0\nv 0 0 -1e0\nvt 0 0\nvt 1 0\nvt 0 1\nf 1/1 2/2 3/3\nf 3/3 2/2 1/1\n";
+	objFile.close();
+
+	ModelLoaderInfo info;
+	ModelLoader modelLoader;
+
+	info.modelFileName = "modelloader_test.obj";
+	ModelLoaderResult objResult = modelLoader.load(info);
+
+	REQUIRE(objResult.triangles.size() == 2);
+	REQUIRE(objResult.triangles[0].vertices[0].x == Approx(100.0f));
+	REQUIRE(objResult.triangles[0].vertices[0].y == Approx(-0.25f));
+	REQUIRE(objResult.triangles[0].vertices[1].y == Approx(15.0f));
+	REQUIRE(objResult.triangles[0].vertices[2].z == Approx(-1.0f));
+
+	modelLoader.convert("modelloader_test.obj", "modelloader_test.vmesh");
+
+	info.modelFileName = "modelloader_test.vmesh";
+	ModelLoaderResult meshResult = modelLoader.load(info);
+
+	REQUIRE(meshResult.triangles.size() == objResult.triangles.size());
+
+	for (size_t i = 0; i < meshResult.triangles.size(); ++i)
+	{
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+			REQUIRE(meshResult.triangles[i].vertices[j].x == objResult.triangles[i].vertices[j].x);
+			REQUIRE(meshResult.triangles[i].vertices[j].y == objResult.triangles[i].vertices[j].y);
+			REQUIRE(meshResult.triangles[i].vertices[j].z == objResult.triangles[i].vertices[j].z);
+			REQUIRE(meshResult.triangles[i].normals[j].z == objResult.triangles[i].normals[j].z);
+			REQUIRE(meshResult.triangles[i].texcoords[j].y == objResult.triangles[i].texcoords[j].y);
+		}
+
+		REQUIRE(meshResult.triangles[i].materialId == objResult.triangles[i].materialId);
+	}
+}
+
+TEST_CASE("ModelLoader PLY files", "[modelloader]")
+{
+	std::ofstream plyFile("modelloader_test.ply", std::ios::binary);
+	plyFile << "ply\nformat binary_little_endian 1.0\ncomment test\n";
+	plyFile << "element vertex 4\nproperty float x\nproperty float y\nproperty float z\nproperty uchar red\n";
+	plyFile << "element face 2\nproperty list uchar int vertex_indices\nproperty uchar flags\n";
+	plyFile << "element edge 1\nproperty int vertex1\nproperty int vertex2\nend_header\n";
+
+	float positions[4][3] = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } };
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		uint8_t red = 255;
+		plyFile.write(reinterpret_cast<const char*>(positions[i]), sizeof(positions[i]));
+		plyFile.write(reinterpret_cast<const char*>(&red), 1);
+	}
+
+	uint8_t quadCount = 4;
+	uint8_t triangleCount = 3;
+	uint8_t flags = 0;
+	int32_t quadIndices[4] = { 0, 1, 2, 3 };
+	int32_t triangleIndices[3] = { 3, 2, 1 };
+	int32_t edgeIndices[2] = { 0, 1 };
+
+	plyFile.write(reinterpret_cast<const char*>(&quadCount), 1);
+	plyFile.write(reinterpret_cast<const char*>(quadIndices), sizeof(quadIndices));
+	plyFile.write(reinterpret_cast<const char*>(&flags), 1);
+	plyFile.write(reinterpret_cast<const char*>(&triangleCount), 1);
+	plyFile.write(reinterpret_cast<const char*>(triangleIndices), sizeof(triangleIndices));
+	plyFile.write(reinterpret_cast<const char*>(&flags), 1);
+	plyFile.write(reinterpret_cast<const char*>(edgeIndices), sizeof(edgeIndices));
+	plyFile.close();
+
+	ModelLoaderInfo info;
+	ModelLoader modelLoader;
+
+	info.modelFileName = "modelloader_test.ply";
+	info.scale = Vector3(2.0f, 2.0f, 2.0f);
+	info.defaultMaterialId = 5;
+	ModelLoaderResult result = modelLoader.load(info);
+
+	REQUIRE(result.triangles.size() == 3);
+	REQUIRE(result.triangles[1].vertices[0].x == Approx(0.0f));
+	REQUIRE(result.triangles[1].vertices[1].x == Approx(2.0f));
+	REQUIRE(result.triangles[1].vertices[2].y == Approx(2.0f));
+	REQUIRE(result.triangles[2].vertices[0].y == Approx(2.0f));
+	REQUIRE(result.triangles[2].normals[0].z == Approx(-1.0f));
+	REQUIRE(result.triangles[2].materialId == 5);
+}
+
 #endif
@@ -0,0 +1,51 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#ifdef RUN_UNIT_TESTS
+
+#include "catch/catch.hpp"
+
+#include "Renderers/RenderJournal.h"
+
+using namespace Valo;
+
+TEST_CASE("Render journal save/load", "[renderjournal]")
+{
+	RenderJournal journal;
+	journal.initialize(100, 80, 10, 0, 50, 0, 16);
+
+	// 50x80 region -> 4x5 buckets
+	REQUIRE(journal.getBucketCount() == 20);
+	REQUIRE(journal.getRemainingPixelCount(2) == 2 * 50 * 80);
+
+	std::vector<RenderBucket*> buckets = journal.getPendingBuckets(3);
+	REQUIRE(buckets.size() == 3);
+
+	for (RenderBucket* bucket : buckets)
+		bucket->completed = true;
+
+	journal.completedPasses = 1;
+	journal.pixelSamples = 4;
+	journal.sceneHash = 1234;
+	journal.filmChecksum = 5678;
+	journal.save("journal1.bin");
+
+	RenderJournal loadedJournal;
+	loadedJournal.initialize(100, 80, 10, 0, 50, 0, 16);
+	loadedJournal.load("journal1.bin");
+
+	REQUIRE(loadedJournal.completedPasses == 1);
+	REQUIRE(loadedJournal.pixelSamples == 4);
+	REQUIRE(loadedJournal.sceneHash == 1234);
+	REQUIRE(loadedJournal.filmChecksum == 5678);
+	REQUIRE(loadedJournal.getCompletedBucketCount() == 3);
+	REQUIRE(loadedJournal.getRemainingPixelCount(2) == 50 * 80 - 3 * 16 * 16);
+
+	RenderJournal otherJournal;
+	otherJournal.initialize(100, 80, 0, 0, 0, 0, 16);
+	REQUIRE_THROWS(otherJournal.load("journal1.bin"));
+}
+
+#endif
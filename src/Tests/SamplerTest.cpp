@@ -0,0 +1,60 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#ifdef RUN_UNIT_TESTS
+
+#include "catch/catch.hpp"
+
+#include "Math/Sampler.h"
+#include "Math/Vector2.h"
+
+using namespace Valo;
+
+TEST_CASE("Sampler functionality", "[sampler]")
+{
+	Sampler sampler(SamplerType::SOBOL);
+
+	// the first 16 samples of every dimension pair should be stratified in a 4x4 grid
+	for (uint32_t dimensionPair = 0; dimensionPair < 4; ++dimensionPair)
+	{
+		bool strata[16] = { false };
+
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			sampler.startSample(12, 34, i);
+
+			for (uint32_t j = 0; j < dimensionPair; ++j)
+				sampler.getVector2();
+
+			Vector2 sample = sampler.getVector2();
+
+			REQUIRE(sample.x >= 0.0f);
+			REQUIRE(sample.x < 1.0f);
+			REQUIRE(sample.y >= 0.0f);
+			REQUIRE(sample.y < 1.0f);
+
+			uint32_t stratum = uint32_t(sample.y * 4.0f) * 4 + uint32_t(sample.x * 4.0f);
+			REQUIRE(!strata[stratum]);
+			strata[stratum] = true;
+		}
+	}
+
+	// the streams are pure functions of (pixel, sample index, dimension)
+	for (SamplerType type : { SamplerType::RANDOM, SamplerType::SOBOL, SamplerType::BLUE_NOISE })
+	{
+		Sampler sampler1(type);
+		Sampler sampler2(type);
+		float values[64];
+
+		sampler1.startSample(5, 6, 7);
+		sampler2.startSample(5, 6, 7);
+		sampler2.getFloats(values, 64);
+
+		for (uint32_t i = 0; i < 64; ++i)
+			REQUIRE(sampler1.getFloat() == values[i]);
+	}
+}
+
+#endif
@@ -0,0 +1,119 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#ifdef RUN_UNIT_TESTS
+
+#include "catch/catch.hpp"
+
+#include "Core/Intersection.h"
+#include "Core/Ray.h"
+#include "Core/Scene.h"
+
+using namespace Valo;
+
+namespace
+{
+	Scene createTestScene()
+	{
+		Scene scene;
+
+		scene.camera.position = Vector3(1.0f, 2.0f, 3.0f);
+		scene.camera.fov = 60.0f;
+		scene.integrator.type = IntegratorType::DOT;
+
+		Texture texture(TextureType::CHECKER);
+		texture.id = 3;
+		texture.checkerTexture.stripeWidth = 0.1f;
+		scene.textures.push_back(texture);
+
+		Material material;
+		material.id = 1;
+		material.reflectance = Color(0.5f, 0.25f, 0.125f);
+		material.reflectanceTextureId = 3;
+		scene.materials.push_back(material);
+
+		material = Material();
+		material.id = 2;
+		material.emittance = Color(1.0f, 1.0f, 1.0f);
+		scene.materials.push_back(material);
+
+		Triangle triangle;
+		triangle.vertices[0] = Vector3(-1.0f, -1.0f, 0.0f);
+		triangle.vertices[1] = Vector3(1.0f, -1.0f, 0.0f);
+		triangle.vertices[2] = Vector3(1.0f, 1.0f, 0.0f);
+		triangle.normals[0] = triangle.normals[1] = triangle.normals[2] = Vector3(0.0f, 0.0f, 1.0f);
+		triangle.materialId = 1;
+		scene.triangles.push_back(triangle);
+
+		triangle.vertices[1] = Vector3(1.0f, 1.0f, 0.0f);
+		triangle.vertices[2] = Vector3(-1.0f, 1.0f, 0.0f);
+		triangle.materialId = 2;
+		scene.triangles.push_back(triangle);
+
+		return scene;
+	}
+
+	Intersection intersectTestRay(const Scene& scene, float x, float y)
+	{
+		Ray ray;
+		ray.origin = Vector3(x, y, 5.0f);
+		ray.direction = Vector3(0.0f, 0.0f, -1.0f);
+		ray.precalculate();
+
+		Intersection intersection;
+		scene.intersect(ray, intersection);
+
+		return intersection;
+	}
+}
+
+TEST_CASE("Scene files", "[scene]")
+{
+	Scene scene1 = createTestScene();
+
+	for (const char* fileName : { "scene_test.xml", "scene_test.json" })
+	{
+		scene1.save(fileName);
+
+		Scene scene2;
+		scene2.load(fileName);
+
+		REQUIRE(scene2.camera.position.y == 2.0f);
+		REQUIRE(scene2.camera.fov == 60.0f);
+		REQUIRE(scene2.integrator.type == IntegratorType::DOT);
+		REQUIRE(scene2.textures.size() == 1);
+		REQUIRE(scene2.textures[0].checkerTexture.stripeWidth == 0.1f);
+		REQUIRE(scene2.materials.size() == 2);
+		REQUIRE(scene2.materials[0].reflectance.g == 0.25f);
+		REQUIRE(scene2.materials[0].reflectanceTextureId == 3);
+		REQUIRE(scene2.triangles.size() == 2);
+		REQUIRE(scene2.triangles[1].vertices[2].x == -1.0f);
+		REQUIRE(scene2.triangles[1].materialId == 2);
+	}
+
+	scene1.initialize();
+	scene1.save("scene_test.bin");
+
+	Scene scene3;
+	scene3.load("scene_test.bin");
+	scene3.initialize();
+
+	REQUIRE(scene3.camera.position.z == 3.0f);
+	REQUIRE(scene3.getEmissiveTrianglesCount() == 1);
+	REQUIRE(scene3.getMaterial(0).reflectanceTextureIndex == 0);
+
+	for (float x : { -0.5f, 0.5f })
+	{
+		Intersection intersection1 = intersectTestRay(scene1, x, 0.25f);
+		Intersection intersection3 = intersectTestRay(scene3, x, 0.25f);
+
+		REQUIRE(intersection1.wasFound);
+		REQUIRE(intersection3.wasFound);
+		REQUIRE(intersection1.distance == intersection3.distance);
+		REQUIRE(intersection1.materialIndex == intersection3.materialIndex);
+	}
+}
+
+#endif
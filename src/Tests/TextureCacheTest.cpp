@@ -0,0 +1,100 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#ifdef RUN_UNIT_TESTS
+
+#include <omp.h>
+
+#include <boost/filesystem.hpp>
+
+#include "catch/catch.hpp"
+
+#include "Core/Image.h"
+#include "Core/ImagePool.h"
+#include "Math/Color.h"
+#include "Utils/TextureCache.h"
+
+using namespace Valo;
+
+TEST_CASE("TextureCache functionality", "[texturecache]")
+{
+	Image image(300, 200);
+
+	for (uint32_t y = 0; y < 200; ++y)
+	{
+		for (uint32_t x = 0; x < 300; ++x)
+			image.setPixel(x, y, Color(x / 299.0f, y / 199.0f, float((x / 7 + y / 5) % 2), 1.0f));
+	}
+
+	image.save("texturecache.png");
+	boost::filesystem::remove_all("texturecache_tiles");
+
+	Image reference;
+	ImagePool::loadImage(reference, "texturecache.png", true, true);
+
+	TextureCache textureCache1;
+	textureCache1.maxMemoryUsage = 0; // only the most recent tile is kept in the shared cache
+	textureCache1.cacheDirName = "texturecache_tiles";
+	uint32_t index = textureCache1.load("texturecache.png", true, true);
+
+	REQUIRE(!boost::filesystem::is_empty("texturecache_tiles"));
+
+	REQUIRE(textureCache1.getWidth(index) == 300);
+	REQUIRE(textureCache1.getHeight(index) == 200);
+	REQUIRE(textureCache1.getMipLevelCount(index) == 9);
+
+	bool pixelsMatch = true;
+
+	for (uint32_t y = 0; y <= 100; ++y)
+	{
+		for (uint32_t x = 0; x <= 100; ++x)
+		{
+			float u = x / 100.0f;
+			float v = y / 100.0f;
+
+			Color expected = reference.getPixelBilinear(u, v);
+			Color actual = textureCache1.getPixelBilinear(index, 0, u, v);
+
+			pixelsMatch = pixelsMatch && expected.r == actual.r && expected.g == actual.g && expected.b == actual.b;
+		}
+	}
+
+	REQUIRE(pixelsMatch);
+	REQUIRE(textureCache1.getMemoryUsage() <= 64 * 64 * 4);
+
+	// tiles held by the per-thread caches count towards the budget and are released when it is exceeded
+	TextureCache textureCache3;
+	textureCache3.maxMemoryUsage = 0;
+	textureCache3.cacheDirName = "texturecache_tiles";
+	uint32_t index3 = textureCache3.load("texturecache.png", true, true);
+
+	#pragma omp parallel for
+	for (int32_t y = 0; y <= 100; ++y)
+	{
+		for (uint32_t x = 0; x <= 100; ++x)
+			textureCache3.getPixelBilinear(index3, 0, x / 100.0f, y / 100.0f);
+	}
+
+	REQUIRE(textureCache3.getMemoryUsage() <= uint64_t(omp_get_max_threads() + 1) * 64 * 64 * 4);
+
+	TextureCache textureCache2;
+	textureCache2.cacheDirName = "texturecache_tiles";
+	uint32_t index2 = textureCache2.load("texturecache.png", true, true);
+
+	REQUIRE(textureCache2.getPixelBilinear(index2, 0, 0.3f, 0.7f).g == reference.getPixelBilinear(0.3f, 0.7f).g);
+
+	Image referenceLevel = reference;
+
+	for (uint32_t level = 1; level < 9; ++level)
+	{
+		Image previousLevel = referenceLevel;
+		referenceLevel.downsample(previousLevel);
+	}
+
+	REQUIRE(referenceLevel.getWidth() == 1);
+	REQUIRE(textureCache2.getPixelBilinear(index2, 8, 0.5f, 0.5f).r == referenceLevel.getPixel(0, 0).r);
+}
+
+#endif
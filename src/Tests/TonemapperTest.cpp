@@ -0,0 +1,71 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#ifdef RUN_UNIT_TESTS
+
+#include "catch/catch.hpp"
+
+#include "Core/Image.h"
+#include "Tonemappers/Tonemapper.h"
+
+using namespace Valo;
+
+TEST_CASE("Tonemapper resolve", "[tonemapper]")
+{
+	Image cumulativeImage(64, 32);
+	Image normalizedImage(64, 32);
+	Image tonemappedImage(64, 32);
+
+	for (uint32_t i = 0; i < cumulativeImage.getLength(); ++i)
+	{
+		float weight = 1.0f + float(i % 7);
+		Color color(float(i % 13) * 0.3f, float(i % 5) * 0.1f, float(i % 3) * 2.0f, 1.0f);
+
+		cumulativeImage.setPixel(i, color * weight);
+		normalizedImage.setPixel(i, color);
+	}
+
+	std::vector<uint32_t> resolvedPixels(cumulativeImage.getLength());
+
+	for (uint32_t k = 0; k <= 3; ++k)
+	{
+		Tonemapper tonemapper;
+		tonemapper.type = static_cast<TonemapperType>(k);
+
+		// the second resolve uses the statistics of the first one, which are the same as in apply
+		tonemapper.resolve(cumulativeImage, resolvedPixels.data());
+		tonemapper.resolve(cumulativeImage, resolvedPixels.data());
+		tonemapper.apply(normalizedImage, tonemappedImage);
+
+		for (uint32_t i = 0; i < cumulativeImage.getLength(); ++i)
+		{
+			uint32_t expected = tonemappedImage.getPixel(i).clamped().getAbgrValue();
+
+			for (uint32_t j = 0; j < 32; j += 8)
+				REQUIRE(std::abs(int32_t((resolvedPixels[i] >> j) & 0xff) - int32_t((expected >> j) & 0xff)) <= 1);
+		}
+
+		// the rows written by Film::saveImage
+		std::vector<Color> row(cumulativeImage.getWidth());
+		tonemapper.gatherStatistics(cumulativeImage);
+
+		for (uint32_t y = 0; y < cumulativeImage.getHeight(); ++y)
+		{
+			tonemapper.resolveRow(cumulativeImage, y, row.data());
+
+			for (uint32_t x = 0; x < cumulativeImage.getWidth(); ++x)
+			{
+				Color expected = tonemappedImage.getPixel(x, y);
+
+				REQUIRE(std::abs(row[x].r - expected.r) < 0.0001f);
+				REQUIRE(std::abs(row[x].g - expected.g) < 0.0001f);
+				REQUIRE(std::abs(row[x].b - expected.b) < 0.0001f);
+				REQUIRE(row[x].a == 1.0f);
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,148 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#ifdef RUN_UNIT_TESTS
+
+#include <set>
+#include <tuple>
+
+#include "catch/catch.hpp"
+
+#include "Core/Triangle.h"
+#include "Math/MathUtils.h"
+#include "Math/Random.h"
+#include "Math/Vector2.h"
+#include "Math/Vector3.h"
+
+using namespace Valo;
+
+namespace
+{
+	// Möller-Trumbore, same as Triangle::intersect
+	bool intersectTriangle(const Vector3& vertex0, const Vector3& vertex1, const Vector3& vertex2, const Vector3& origin, const Vector3& direction, float& distance)
+	{
+		Vector3 v0v1 = vertex1 - vertex0;
+		Vector3 v0v2 = vertex2 - vertex0;
+		Vector3 pvec = direction.cross(v0v2);
+		float determinant = v0v1.dot(pvec);
+
+		if (determinant == 0.0f)
+			return false;
+
+		float invDeterminant = 1.0f / determinant;
+		Vector3 tvec = origin - vertex0;
+		float u = tvec.dot(pvec) * invDeterminant;
+
+		if (u < 0.0f || u > 1.0f)
+			return false;
+
+		Vector3 qvec = tvec.cross(v0v1);
+		float v = direction.dot(qvec) * invDeterminant;
+
+		if (v < 0.0f || (u + v) > 1.0f)
+			return false;
+
+		distance = v0v2.dot(qvec) * invDeterminant;
+		return distance >= 0.0f;
+	}
+}
+
+TEST_CASE("Triangle compact functionality", "[triangle]")
+{
+	const uint32_t gridSize = 32;
+	std::vector<Triangle> triangles;
+
+	auto getGridVertex = [](uint32_t x, uint32_t y)
+	{
+		return Vector3(float(x) / gridSize, float(y) / gridSize, 0.1f * std::sin(float(x * y)));
+	};
+
+	// a smooth grid shares its vertices between the triangles
+	for (uint32_t y = 0; y < gridSize; ++y)
+	{
+		for (uint32_t x = 0; x < gridSize; ++x)
+		{
+			Triangle triangle;
+			triangle.vertices[0] = getGridVertex(x, y);
+			triangle.vertices[1] = getGridVertex(x + 1, y);
+			triangle.vertices[2] = getGridVertex(x + 1, y + 1);
+			triangle.normals[0] = triangle.normals[1] = triangle.normals[2] = Vector3(0.0f, 0.0f, 1.0f);
+			triangle.texcoords[0] = Vector2(float(x) / gridSize, float(y) / gridSize);
+			triangle.texcoords[1] = Vector2(float(x + 1) / gridSize, float(y) / gridSize);
+			triangle.texcoords[2] = Vector2(float(x + 1) / gridSize, float(y + 1) / gridSize);
+			triangles.push_back(triangle);
+
+			triangle.vertices[1] = getGridVertex(x + 1, y + 1);
+			triangle.vertices[2] = getGridVertex(x, y + 1);
+			triangle.texcoords[1] = Vector2(float(x + 1) / gridSize, float(y + 1) / gridSize);
+			triangle.texcoords[2] = Vector2(float(x) / gridSize, float(y + 1) / gridSize);
+			triangles.push_back(triangle);
+		}
+	}
+
+	// the same positions with other normals must not be welded to the grid
+	for (uint32_t i = 0; i < gridSize; ++i)
+	{
+		Triangle triangle = triangles[i * 7];
+		triangle.normals[0] = triangle.normals[1] = triangle.normals[2] = Vector3(0.0f, 1.0f, 0.0f);
+		triangles.push_back(triangle);
+	}
+
+	std::vector<CompactVertex> compactVertices;
+	std::vector<CompactTriangle> compactTriangles(triangles.size());
+	Triangle::compact(triangles, compactVertices, compactTriangles.data());
+
+	// the texcoords are the same for equal positions
+	std::set<std::tuple<float, float, float, uint32_t>> uniqueVertices;
+
+	for (const Triangle& triangle : triangles)
+	{
+		for (uint32_t j = 0; j < 3; ++j)
+			uniqueVertices.insert(std::make_tuple(triangle.vertices[j].x, triangle.vertices[j].y, triangle.vertices[j].z, MathUtils::encodeOctahedral(triangle.normals[j])));
+	}
+
+	REQUIRE(compactVertices.size() == uniqueVertices.size());
+	REQUIRE(compactVertices.size() > (gridSize + 1) * (gridSize + 1));
+
+	for (size_t i = 0; i < triangles.size(); ++i)
+	{
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+			const CompactVertex& vertex = compactVertices[compactTriangles[i].vertexIndices[j]];
+
+			REQUIRE(vertex.position.x == triangles[i].vertices[j].x);
+			REQUIRE(vertex.position.y == triangles[i].vertices[j].y);
+			REQUIRE(vertex.position.z == triangles[i].vertices[j].z);
+			REQUIRE(vertex.normal == MathUtils::encodeOctahedral(triangles[i].normals[j]));
+		}
+	}
+
+	Random random(1234);
+	bool intersectionsMatch = true;
+
+	for (uint32_t i = 0; i < 1000; ++i)
+	{
+		Vector3 origin(random.getFloat(), random.getFloat(), 1.0f);
+		Vector3 direction = Vector3(random.getFloat() - 0.5f, random.getFloat() - 0.5f, -1.0f).normalized();
+
+		for (size_t k = 0; k < triangles.size(); ++k)
+		{
+			const Triangle& triangle = triangles[k];
+			const CompactTriangle& compactTriangle = compactTriangles[k];
+
+			float distance1 = 0.0f;
+			float distance2 = 0.0f;
+
+			bool hit1 = intersectTriangle(triangle.vertices[0], triangle.vertices[1], triangle.vertices[2], origin, direction, distance1);
+			bool hit2 = intersectTriangle(compactVertices[compactTriangle.vertexIndices[0]].position, compactVertices[compactTriangle.vertexIndices[1]].position, compactVertices[compactTriangle.vertexIndices[2]].position, origin, direction, distance2);
+
+			intersectionsMatch = intersectionsMatch && (hit1 == hit2) && (!hit1 || distance1 == distance2);
+		}
+	}
+
+	REQUIRE(intersectionsMatch);
+}
+
+#endif
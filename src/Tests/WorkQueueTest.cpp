@@ -0,0 +1,55 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#ifdef RUN_UNIT_TESTS
+
+#include "catch/catch.hpp"
+
+#include "Runners/WorkQueue.h"
+
+using namespace Valo;
+
+TEST_CASE("Work queue split", "[workqueue]")
+{
+	// 100x80 film -> 4x3 regions, all image samples in each
+	std::vector<WorkUnit> regionUnits = WorkQueue::split(100, 80, 0, 0, 0, 0, 5, WorkUnitType::REGION, 32);
+	REQUIRE(regionUnits.size() == 12);
+	REQUIRE(regionUnits[0].passCount == 5);
+
+	// whole film, 5 image samples in ranges of 2
+	std::vector<WorkUnit> sampleUnits = WorkQueue::split(100, 80, 0, 0, 0, 0, 5, WorkUnitType::SAMPLE_RANGE, 2);
+	REQUIRE(sampleUnits.size() == 3);
+	REQUIRE(sampleUnits[2].firstPass == 4);
+	REQUIRE(sampleUnits[2].passCount == 1);
+	REQUIRE(sampleUnits[2].regionWidth == 100);
+}
+
+TEST_CASE("Work queue reissue", "[workqueue]")
+{
+	WorkQueue queue;
+	queue.initialize(WorkQueue::split(64, 32, 0, 0, 0, 0, 1, WorkUnitType::REGION, 32), true);
+
+	WorkUnit unit1, unit2, unit3, unit4;
+	REQUIRE(queue.getNextUnit(unit1));
+	REQUIRE(queue.getNextUnit(unit2));
+
+	// straggler copy of the oldest unit
+	REQUIRE(queue.getNextUnit(unit3));
+	REQUIRE(unit3.id == unit1.id);
+
+	REQUIRE(queue.completeUnit(unit1.id));
+	REQUIRE(!queue.completeUnit(unit3.id));
+
+	// lost worker -> unit is available again
+	queue.releaseUnit(unit2.id);
+	REQUIRE(queue.getNextUnit(unit4));
+	REQUIRE(unit4.id == unit2.id);
+
+	REQUIRE(queue.completeUnit(unit4.id));
+	REQUIRE(queue.isFinished());
+	REQUIRE(!queue.getNextUnit(unit1));
+}
+
+#endif
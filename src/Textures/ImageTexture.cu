@@ -13,13 +13,55 @@ using namespace Valo;
 
 void ImageTexture::initialize(Scene& scene)
 {
-	imageIndex = scene.imagePool.load(imageFileName, applyGamma);
+	useTextureCache = scene.textureCache.enabled;
+
+	if (useTextureCache)
+	{
+		imageIndex = scene.textureCache.load(imageFileName, applyGamma, generateMipmaps);
+		mipLevelCount = scene.textureCache.getMipLevelCount(imageIndex);
+		width = scene.textureCache.getWidth(imageIndex);
+		height = scene.textureCache.getHeight(imageIndex);
+	}
+	else
+	{
+		imageIndex = scene.imagePool.load(imageFileName, applyGamma, generateMipmaps);
+		mipLevelCount = scene.imagePool.getMipLevelCount(imageIndex);
+		width = scene.imagePool.getWidth(imageIndex);
+		height = scene.imagePool.getHeight(imageIndex);
+	}
 }
 
-CUDA_CALLABLE Color ImageTexture::getColor(const Scene& scene, const Vector2& texcoord, const Vector3& position) const
+// texcoordFootprint is the width of the ray cone in texture space (1.0 = whole texture)
+CUDA_CALLABLE Color ImageTexture::getColor(const Scene& scene, const Vector2& texcoord, const Vector3& position, float texcoordFootprint) const
 {
 	(void)position;
 
-	Image& image = scene.imagePool.getImage(imageIndex);
-	return image.getPixelBilinear(texcoord.x, texcoord.y);
+	if (mipLevelCount <= 1 || texcoordFootprint <= 0.0f)
+		return getPixelBilinear(scene, 0, texcoord);
+
+	float texelFootprint = texcoordFootprint * std::sqrt(float(width) * float(height));
+	float level = MIN(MAX(std::log2(MAX(texelFootprint, 1.0f)), 0.0f), float(mipLevelCount - 1));
+	uint32_t level0 = uint32_t(level);
+	uint32_t level1 = MIN(level0 + 1, mipLevelCount - 1);
+	float alpha = level - float(level0);
+
+	Color color0 = getPixelBilinear(scene, level0, texcoord);
+
+	if (level0 == level1 || alpha == 0.0f)
+		return color0;
+
+	Color color1 = getPixelBilinear(scene, level1, texcoord);
+	return Color::lerp(color0, color1, alpha);
+}
+
+CUDA_CALLABLE Color ImageTexture::getPixelBilinear(const Scene& scene, uint32_t level, const Vector2& texcoord) const
+{
+#if !(defined(__CUDA_ARCH__) && (__CUDA_ARCH__ > 0))
+
+	if (useTextureCache)
+		return scene.textureCache.getPixelBilinear(imageIndex, level, texcoord.x, texcoord.y);
+
+#endif
+
+	return scene.imagePool.getImage(imageIndex + level).getPixelBilinear(texcoord.x, texcoord.y);
 }
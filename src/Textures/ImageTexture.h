@@ -18,13 +18,20 @@ namespace Valo
 
 		void initialize(Scene& scene);
 
-		CUDA_CALLABLE Color getColor(const Scene& scene, const Vector2& texcoord, const Vector3& position) const;
+		CUDA_CALLABLE Color getColor(const Scene& scene, const Vector2& texcoord, const Vector3& position, float texcoordFootprint = 0.0f) const;
 		
 		std::string imageFileName;
 		bool applyGamma = false;
+		bool generateMipmaps = true;
 
 	private:
 
+		CUDA_CALLABLE Color getPixelBilinear(const Scene& scene, uint32_t level, const Vector2& texcoord) const;
+
+		bool useTextureCache = false;
 		uint32_t imageIndex = 0;
+		uint32_t mipLevelCount = 1;
+		uint32_t width = 0;
+		uint32_t height = 0;
 	};
 }
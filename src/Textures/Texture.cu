@@ -27,11 +27,11 @@ void Texture::initialize(Scene& scene)
 	}
 }
 
-CUDA_CALLABLE Color Texture::getColor(const Scene& scene, const Vector2& texcoord, const Vector3& position) const
+CUDA_CALLABLE Color Texture::getColor(const Scene& scene, const Vector2& texcoord, const Vector3& position, float texcoordFootprint) const
 {
 	switch (type)
 	{
-		case TextureType::IMAGE: return imageTexture.getColor(scene, texcoord, position);
+		case TextureType::IMAGE: return imageTexture.getColor(scene, texcoord, position, texcoordFootprint);
 		case TextureType::CHECKER: return checkerTexture.getColor(texcoord, position);
 		case TextureType::MARBLE: return marbleTexture.getColor(texcoord, position);
 		case TextureType::WOOD: return woodTexture.getColor(texcoord, position);
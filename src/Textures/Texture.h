@@ -27,7 +27,7 @@ namespace Valo
 
 		void initialize(Scene& scene);
 
-		CUDA_CALLABLE Color getColor(const Scene& scene, const Vector2& texcoord, const Vector3& position) const;
+		CUDA_CALLABLE Color getColor(const Scene& scene, const Vector2& texcoord, const Vector3& position, float texcoordFootprint = 0.0f) const;
 		
 		uint32_t id = 0;
 		TextureType type = TextureType::CHECKER;
@@ -3,8 +3,11 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace Valo
 {
+	class Color;
 	class Image;
 
 	class LinearTonemapper
@@ -12,10 +15,16 @@ namespace Valo
 	public:
 
 		void apply(const Image& inputImage, Image& outputImage);
+		void resolve(const Image& cumulativeImage, uint32_t* outputPixels);
+		void resolveRow(const Image& cumulativeImage, uint32_t y, Color* outputRow) const;
 
 		bool applyGamma = true;
 		bool shouldClamp = true;
 		float gamma = 2.2f;
 		float exposure = 0.0f;
+
+	private:
+
+		Color tonemap(const Color& inputColor) const;
 	};
 }
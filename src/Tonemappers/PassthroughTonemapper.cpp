@@ -6,6 +6,7 @@
 #include "Core/Image.h"
 #include "Math/Color.h"
 #include "Tonemappers/PassthroughTonemapper.h"
+#include "Tonemappers/TonemapperSse.h"
 
 using namespace Valo;
 
@@ -18,3 +19,54 @@ void PassthroughTonemapper::apply(const Image& inputImage, Image& outputImage)
 	for (int32_t i = 0; i < pixelCount; ++i)
 		outputPixels[i] = inputPixels[i];
 }
+
+void PassthroughTonemapper::resolve(const Image& cumulativeImage, uint32_t* outputPixels)
+{
+	int32_t pixelCount = cumulativeImage.getLength();
+
+#ifdef TONEMAPPER_USE_SSE
+
+	if (cumulativeImage.getFormat() == ImageFormat::RGBA32F)
+	{
+		const Color* inputPixels = cumulativeImage.getData();
+		#pragma omp parallel for
+		for (int32_t i = 0; i < pixelCount; ++i)
+		{
+			__m128 outputColor = TonemapperSse::normalize(_mm_loadu_ps(&inputPixels[i].r));
+			outputPixels[i] = TonemapperSse::getAbgrValue(TonemapperSse::clamp(TonemapperSse::setAlpha(outputColor, 1.0f)));
+		}
+
+		return;
+	}
+
+#endif
+
+	#pragma omp parallel for
+	for (int32_t i = 0; i < pixelCount; ++i)
+	{
+		Color outputColor = cumulativeImage.getPixel(uint32_t(i));
+
+		if (outputColor.a != 0.0f)
+			outputColor /= outputColor.a;
+
+		outputColor.a = 1.0f;
+
+		outputPixels[i] = outputColor.clamped().getAbgrValue();
+	}
+}
+
+void PassthroughTonemapper::resolveRow(const Image& cumulativeImage, uint32_t y, Color* outputRow) const
+{
+	uint32_t width = cumulativeImage.getWidth();
+
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		Color outputColor = cumulativeImage.getPixel(x, y);
+
+		if (outputColor.a != 0.0f)
+			outputColor /= outputColor.a;
+
+		outputColor.a = 1.0f;
+		outputRow[x] = outputColor;
+	}
+}
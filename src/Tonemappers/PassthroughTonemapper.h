@@ -3,8 +3,11 @@
 
 #pragma once
 
+#include <cstdint>
+
 namespace Valo
 {
+	class Color;
 	class Image;
 
 	class PassthroughTonemapper
@@ -12,5 +15,7 @@ namespace Valo
 	public:
 
 		void apply(const Image& inputImage, Image& outputImage);
+		void resolve(const Image& cumulativeImage, uint32_t* outputPixels);
+		void resolveRow(const Image& cumulativeImage, uint32_t y, Color* outputRow) const;
 	};
 }
@@ -6,9 +6,16 @@
 #include "Core/Image.h"
 #include "Math/Color.h"
 #include "Tonemappers/ReinhardTonemapper.h"
+#include "Tonemappers/TonemapperSse.h"
 
 using namespace Valo;
 
+namespace
+{
+	const float epsilon = 0.01f;
+	const uint32_t subsampleCount = 16384;
+}
+
 ReinhardTonemapper::ReinhardTonemapper()
 {
 	maxLuminanceAverage.setAverage(1.0f);
@@ -20,7 +27,6 @@ void ReinhardTonemapper::apply(const Image& inputImage, Image& outputImage)
 	Color* outputPixels = outputImage.getData();
 	int32_t pixelCount = inputImage.getLength();
 
-	float epsilon = 0.01f;
 	float luminanceLogSum = 0.0f;
 	float maxLuminance = 1.0f;
 	float maxLuminancePrivate = 0.0f;
@@ -50,44 +56,208 @@ void ReinhardTonemapper::apply(const Image& inputImage, Image& outputImage)
 		}
 	}
 
-	if (enableAveraging)
+	updateStatistics(luminanceLogSum, maxLuminance, uint32_t(pixelCount));
+	statisticsPixelCount = uint32_t(pixelCount);
+
+	#pragma omp parallel for
+	for (int32_t i = 0; i < pixelCount; ++i)
+		outputPixels[i] = tonemap(inputPixels[i]);
+}
+
+void ReinhardTonemapper::resolve(const Image& cumulativeImage, uint32_t* outputPixels)
+{
+	int32_t pixelCount = cumulativeImage.getLength();
+
+	float luminanceLogSum = 0.0f;
+	float maxLuminance = 1.0f;
+	float maxLuminancePrivate = 0.0f;
+	(void)maxLuminancePrivate; // vs2015 compilation warning fix
+
+	if (statisticsPixelCount != uint32_t(pixelCount))
 	{
-		maxLuminanceAverage.setAlpha(averagingAlpha);
-		maxLuminanceAverage.addMeasurement(maxLuminance);
-		maxLuminance = maxLuminanceAverage.getAverage();
+		int32_t stride = MAX(int32_t(1), pixelCount / int32_t(subsampleCount));
+		int32_t sampleCount = (pixelCount + stride - 1) / stride;
+
+		for (int32_t i = 0; i < pixelCount; i += stride)
+		{
+			Color inputColor = cumulativeImage.getPixel(uint32_t(i));
+			float luminance = (inputColor.a != 0.0f) ? (inputColor / inputColor.a).getLuminance() : 0.0f;
+			luminanceLogSum += std::log(epsilon + luminance);
+			maxLuminance = MAX(maxLuminance, luminance);
+		}
+
+		updateStatistics(luminanceLogSum, maxLuminance, uint32_t(sampleCount));
+
+		luminanceLogSum = 0.0f;
+		maxLuminance = 1.0f;
 	}
 
-	const float luminanceLogAvg = std::exp(luminanceLogSum / float(pixelCount));
-	const float luminanceScale = key / luminanceLogAvg;
-	const float maxLuminance2Inv = 1.0f / (maxLuminance * maxLuminance);
-	const float invGamma = 1.0f / gamma;
+	const Color* floatPixels = (cumulativeImage.getFormat() == ImageFormat::RGBA32F) ? cumulativeImage.getData() : nullptr;
+	(void)floatPixels;
 
-	#pragma omp parallel for
-	for (int32_t i = 0; i < pixelCount; ++i)
+	// tonemap with the earlier statistics and gather new ones for the next resolve
+	#pragma omp parallel reduction(+:luminanceLogSum) private(maxLuminancePrivate)
+	{
+		maxLuminancePrivate = 0.0f;
+
+		#pragma omp for
+		for (int32_t i = 0; i < pixelCount; ++i)
+		{
+#ifdef TONEMAPPER_USE_SSE
+
+			// same steps as tonemap, one pixel per register
+			if (floatPixels != nullptr)
+			{
+				__m128 color = TonemapperSse::normalize(_mm_loadu_ps(&floatPixels[i].r));
+
+				Color normalizedColor;
+				_mm_storeu_ps(&normalizedColor.r, color);
+
+				float luminance = normalizedColor.getLuminance();
+				luminanceLogSum += std::log(epsilon + luminance);
+
+				if (luminance > maxLuminancePrivate)
+					maxLuminancePrivate = luminance;
+
+				if (luminance == 0.0f)
+				{
+					outputPixels[i] = Color(0.0f, 0.0f, 0.0f, 1.0f).getAbgrValue();
+					continue;
+				}
+
+				color = _mm_mul_ps(color, _mm_set1_ps(getColorScale(luminance)));
+
+				if (shouldClamp)
+					color = TonemapperSse::clamp(color);
+
+				if (applyGamma)
+					color = TonemapperSse::fastPow(color, 1.0f / gamma);
+
+				outputPixels[i] = TonemapperSse::getAbgrValue(TonemapperSse::clamp(TonemapperSse::setAlpha(color, 1.0f)));
+				continue;
+			}
+
+#endif
+
+			Color inputColor = cumulativeImage.getPixel(uint32_t(i));
+
+			if (inputColor.a != 0.0f)
+				inputColor /= inputColor.a;
+
+			float luminance = inputColor.getLuminance();
+			luminanceLogSum += std::log(epsilon + luminance);
+
+			if (luminance > maxLuminancePrivate)
+				maxLuminancePrivate = luminance;
+
+			outputPixels[i] = tonemap(inputColor).clamped().getAbgrValue();
+		}
+
+		if (maxLuminancePrivate > maxLuminance)
+		{
+			#pragma omp critical
+			{
+				if (maxLuminancePrivate > maxLuminance)
+					maxLuminance = maxLuminancePrivate;
+			}
+		}
+	}
+
+	updateStatistics(luminanceLogSum, maxLuminance, uint32_t(pixelCount));
+	statisticsPixelCount = uint32_t(pixelCount);
+}
+
+void ReinhardTonemapper::gatherStatistics(const Image& cumulativeImage)
+{
+	int32_t pixelCount = cumulativeImage.getLength();
+
+	float luminanceLogSum = 0.0f;
+	float maxLuminance = 1.0f;
+	float maxLuminancePrivate = 0.0f;
+	(void)maxLuminancePrivate; // vs2015 compilation warning fix
+
+	#pragma omp parallel reduction(+:luminanceLogSum) private(maxLuminancePrivate)
 	{
-		Color inputColor = inputPixels[i];
+		maxLuminancePrivate = 0.0f;
 
-		float originalLuminance = inputColor.getLuminance();
+		#pragma omp for
+		for (int32_t i = 0; i < pixelCount; ++i)
+		{
+			Color inputColor = cumulativeImage.getPixel(uint32_t(i));
+			float luminance = (inputColor.a != 0.0f) ? (inputColor / inputColor.a).getLuminance() : 0.0f;
+			luminanceLogSum += std::log(epsilon + luminance);
 
-		if (originalLuminance == 0.0f)
+			if (luminance > maxLuminancePrivate)
+				maxLuminancePrivate = luminance;
+		}
+
+		if (maxLuminancePrivate > maxLuminance)
 		{
-			outputPixels[i] = Color(0.0f, 0.0f, 0.0f, 1.0f);
-			continue;
+			#pragma omp critical
+			{
+				if (maxLuminancePrivate > maxLuminance)
+					maxLuminance = maxLuminancePrivate;
+			}
 		}
+	}
 
-		float scaledLuminance = luminanceScale * originalLuminance;
-		float mappedLuminance = (scaledLuminance * (1.0f + (scaledLuminance * maxLuminance2Inv))) / (1.0f + scaledLuminance);
-		float colorScale = mappedLuminance / originalLuminance;
+	updateStatistics(luminanceLogSum, maxLuminance, uint32_t(pixelCount));
+	statisticsPixelCount = uint32_t(pixelCount);
+}
 
-		Color outputColor = inputColor * colorScale;
+void ReinhardTonemapper::resolveRow(const Image& cumulativeImage, uint32_t y, Color* outputRow) const
+{
+	uint32_t width = cumulativeImage.getWidth();
 
-		if (shouldClamp)
-			outputColor.clamp();
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		Color inputColor = cumulativeImage.getPixel(x, y);
 
-		if (applyGamma)
-			outputColor = Color::fastPow(outputColor, invGamma);
+		if (inputColor.a != 0.0f)
+			inputColor /= inputColor.a;
 
-		outputColor.a = 1.0f;
-		outputPixels[i] = outputColor;
+		outputRow[x] = tonemap(inputColor);
+	}
+}
+
+void ReinhardTonemapper::updateStatistics(float luminanceLogSum, float maxLuminance, uint32_t sampleCount)
+{
+	if (enableAveraging)
+	{
+		maxLuminanceAverage.setAlpha(averagingAlpha);
+		maxLuminanceAverage.addMeasurement(maxLuminance);
+		maxLuminance = maxLuminanceAverage.getAverage();
 	}
+
+	const float luminanceLogAvg = std::exp(luminanceLogSum / float(sampleCount));
+
+	luminanceScale = key / luminanceLogAvg;
+	maxLuminance2Inv = 1.0f / (maxLuminance * maxLuminance);
+}
+
+float ReinhardTonemapper::getColorScale(float originalLuminance) const
+{
+	float scaledLuminance = luminanceScale * originalLuminance;
+	float mappedLuminance = (scaledLuminance * (1.0f + (scaledLuminance * maxLuminance2Inv))) / (1.0f + scaledLuminance);
+
+	return mappedLuminance / originalLuminance;
+}
+
+Color ReinhardTonemapper::tonemap(const Color& inputColor) const
+{
+	float originalLuminance = inputColor.getLuminance();
+
+	if (originalLuminance == 0.0f)
+		return Color(0.0f, 0.0f, 0.0f, 1.0f);
+
+	Color outputColor = inputColor * getColorScale(originalLuminance);
+
+	if (shouldClamp)
+		outputColor.clamp();
+
+	if (applyGamma)
+		outputColor = Color::fastPow(outputColor, 1.0f / gamma);
+
+	outputColor.a = 1.0f;
+	return outputColor;
 }
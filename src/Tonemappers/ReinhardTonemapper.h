@@ -3,12 +3,26 @@
 
 #pragma once
 
+#include <cstdint>
+
 #include "Math/MovingAverage.h"
 
 // https://www.cs.utah.edu/~reinhard/cdrom/tonemap.pdf
 
+/*
+
+resolve uses the luminance statistics gathered during the previous resolve, so the log-average
+and the maximum luminance lag one frame behind. If there are no earlier statistics for the image
+size, they are first estimated from a sparse subsample of the pixels.
+
+resolveRow is used when the image is saved. It uses the statistics from gatherStatistics, which makes
+one pass over the whole cumulative image like apply does.
+
+*/
+
 namespace Valo
 {
+	class Color;
 	class Image;
 
 	class ReinhardTonemapper
@@ -18,6 +32,9 @@ namespace Valo
 		ReinhardTonemapper();
 
 		void apply(const Image& inputImage, Image& outputImage);
+		void resolve(const Image& cumulativeImage, uint32_t* outputPixels);
+		void gatherStatistics(const Image& cumulativeImage);
+		void resolveRow(const Image& cumulativeImage, uint32_t y, Color* outputRow) const;
 
 		bool applyGamma = true;
 		bool shouldClamp = true;
@@ -28,6 +45,14 @@ namespace Valo
 
 	private:
 
+		void updateStatistics(float luminanceLogSum, float maxLuminance, uint32_t sampleCount);
+		float getColorScale(float originalLuminance) const;
+		Color tonemap(const Color& inputColor) const;
+
 		MovingAverage maxLuminanceAverage;
+
+		float luminanceScale = 1.0f;
+		float maxLuminance2Inv = 1.0f;
+		uint32_t statisticsPixelCount = 0;
 	};
 }
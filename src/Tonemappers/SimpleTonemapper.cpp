@@ -7,6 +7,7 @@
 #include "Math/Color.h"
 #include "Math/MathUtils.h"
 #include "Tonemappers/SimpleTonemapper.h"
+#include "Tonemappers/TonemapperSse.h"
 
 using namespace Valo;
 
@@ -16,23 +17,84 @@ void SimpleTonemapper::apply(const Image& inputImage, Image& outputImage)
 	Color* outputPixels = outputImage.getData();
 	int32_t pixelCount = inputImage.getLength();
 
-	const float invGamma = 1.0f / gamma;
+	#pragma omp parallel for
+	for (int32_t i = 0; i < pixelCount; ++i)
+		outputPixels[i] = tonemap(inputPixels[i]);
+}
+
+void SimpleTonemapper::resolve(const Image& cumulativeImage, uint32_t* outputPixels)
+{
+	int32_t pixelCount = cumulativeImage.getLength();
+
+#ifdef TONEMAPPER_USE_SSE
+
+	// same steps as tonemap, one pixel per register
+	if (cumulativeImage.getFormat() == ImageFormat::RGBA32F)
+	{
+		const Color* inputPixels = cumulativeImage.getData();
+		const __m128 exposureScale = _mm_set1_ps(MathUtils::fastPow(2.0f, exposure));
+		const float invGamma = 1.0f / gamma;
+
+		#pragma omp parallel for
+		for (int32_t i = 0; i < pixelCount; ++i)
+		{
+			__m128 outputColor = _mm_mul_ps(TonemapperSse::normalize(_mm_loadu_ps(&inputPixels[i].r)), exposureScale);
+			outputColor = _mm_div_ps(outputColor, _mm_add_ps(_mm_set1_ps(1.0f), outputColor));
+
+			if (shouldClamp)
+				outputColor = TonemapperSse::clamp(outputColor);
+
+			if (applyGamma)
+				outputColor = TonemapperSse::fastPow(outputColor, invGamma);
+
+			outputPixels[i] = TonemapperSse::getAbgrValue(TonemapperSse::clamp(TonemapperSse::setAlpha(outputColor, 1.0f)));
+		}
+
+		return;
+	}
+
+#endif
 
 	#pragma omp parallel for
 	for (int32_t i = 0; i < pixelCount; ++i)
 	{
-		Color outputColor = inputPixels[i];
-		outputColor *= MathUtils::fastPow(2.0f, exposure);
+		Color inputColor = cumulativeImage.getPixel(uint32_t(i));
+
+		if (inputColor.a != 0.0f)
+			inputColor /= inputColor.a;
 
-		outputColor = outputColor / (Color(1.0f, 1.0f, 1.0f, 1.0f) + outputColor);
+		outputPixels[i] = tonemap(inputColor).clamped().getAbgrValue();
+	}
+}
 
-		if (shouldClamp)
-			outputColor.clamp();
+void SimpleTonemapper::resolveRow(const Image& cumulativeImage, uint32_t y, Color* outputRow) const
+{
+	uint32_t width = cumulativeImage.getWidth();
+
+	for (uint32_t x = 0; x < width; ++x)
+	{
+		Color inputColor = cumulativeImage.getPixel(x, y);
 
-		if (applyGamma)
-			outputColor = Color::fastPow(outputColor, invGamma);
+		if (inputColor.a != 0.0f)
+			inputColor /= inputColor.a;
 
-		outputColor.a = 1.0f;
-		outputPixels[i] = outputColor;
+		outputRow[x] = tonemap(inputColor);
 	}
 }
+
+Color SimpleTonemapper::tonemap(const Color& inputColor) const
+{
+	Color outputColor = inputColor;
+	outputColor *= MathUtils::fastPow(2.0f, exposure);
+
+	outputColor = outputColor / (Color(1.0f, 1.0f, 1.0f, 1.0f) + outputColor);
+
+	if (shouldClamp)
+		outputColor.clamp();
+
+	if (applyGamma)
+		outputColor = Color::fastPow(outputColor, 1.0f / gamma);
+
+	outputColor.a = 1.0f;
+	return outputColor;
+}
@@ -22,6 +22,36 @@ void Tonemapper::apply(const Image& inputImage, Image& outputImage)
 	}
 }
 
+void Tonemapper::resolve(const Image& cumulativeImage, uint32_t* outputPixels)
+{
+	switch (type)
+	{
+		case TonemapperType::PASSTHROUGH: passthroughTonemapper.resolve(cumulativeImage, outputPixels); break;
+		case TonemapperType::LINEAR: linearTonemapper.resolve(cumulativeImage, outputPixels); break;
+		case TonemapperType::SIMPLE: simpleTonemapper.resolve(cumulativeImage, outputPixels); break;
+		case TonemapperType::REINHARD: reinhardTonemapper.resolve(cumulativeImage, outputPixels); break;
+		default: break;
+	}
+}
+
+void Tonemapper::gatherStatistics(const Image& cumulativeImage)
+{
+	if (type == TonemapperType::REINHARD)
+		reinhardTonemapper.gatherStatistics(cumulativeImage);
+}
+
+void Tonemapper::resolveRow(const Image& cumulativeImage, uint32_t y, Color* outputRow) const
+{
+	switch (type)
+	{
+		case TonemapperType::PASSTHROUGH: passthroughTonemapper.resolveRow(cumulativeImage, y, outputRow); break;
+		case TonemapperType::LINEAR: linearTonemapper.resolveRow(cumulativeImage, y, outputRow); break;
+		case TonemapperType::SIMPLE: simpleTonemapper.resolveRow(cumulativeImage, y, outputRow); break;
+		case TonemapperType::REINHARD: reinhardTonemapper.resolveRow(cumulativeImage, y, outputRow); break;
+		default: break;
+	}
+}
+
 std::string Tonemapper::getName() const
 {
 	switch (type)
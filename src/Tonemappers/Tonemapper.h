@@ -14,6 +14,7 @@
 
 namespace Valo
 {
+	class Color;
 	class Image;
 
 	enum class TonemapperType { PASSTHROUGH, LINEAR, SIMPLE, REINHARD };
@@ -23,6 +24,11 @@ namespace Valo
 	public:
 
 		void apply(const Image& inputImage, Image& outputImage);
+		void resolve(const Image& cumulativeImage, uint32_t* outputPixels);
+
+		// resolves one row of the cumulative image to tonemapped colors, gatherStatistics has to be called once before
+		void gatherStatistics(const Image& cumulativeImage);
+		void resolveRow(const Image& cumulativeImage, uint32_t y, Color* outputRow) const;
 
 		std::string getName() const;
 
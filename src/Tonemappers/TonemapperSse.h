@@ -0,0 +1,77 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+
+#if !defined(__CUDA_ARCH__) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define TONEMAPPER_USE_SSE
+#endif
+
+/*
+
+SSE versions of the per-pixel steps of the tonemapper resolves. A color is one register (r, g, b, a).
+Each function follows the scalar Color and MathUtils code operation by operation, so the resolved
+pixels are the same as with the scalar path.
+
+*/
+
+#ifdef TONEMAPPER_USE_SSE
+
+namespace Valo
+{
+	namespace TonemapperSse
+	{
+		// Color::operator/= by alpha if alpha is not zero
+		inline __m128 normalize(__m128 color)
+		{
+			__m128 alpha = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3));
+			__m128 normalized = _mm_mul_ps(color, _mm_div_ps(_mm_set1_ps(1.0f), alpha));
+			__m128 mask = _mm_cmpneq_ps(alpha, _mm_setzero_ps());
+
+			return _mm_or_ps(_mm_and_ps(mask, normalized), _mm_andnot_ps(mask, color));
+		}
+
+		inline __m128 clamp(__m128 color)
+		{
+			return _mm_max_ps(_mm_setzero_ps(), _mm_min_ps(color, _mm_set1_ps(1.0f)));
+		}
+
+		inline __m128 setAlpha(__m128 color, float alpha)
+		{
+			const __m128 rgbMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+			return _mm_or_ps(_mm_and_ps(color, rgbMask), _mm_setr_ps(0.0f, 0.0f, 0.0f, alpha));
+		}
+
+		// MathUtils::fastPow, works on the upper halves of the values converted to doubles
+		inline __m128 fastPow(__m128 values, float power)
+		{
+			__m128i low = _mm_castpd_si128(_mm_cvtps_pd(values));
+			__m128i high = _mm_castpd_si128(_mm_cvtps_pd(_mm_movehl_ps(values, values)));
+			__m128i words = _mm_unpacklo_epi64(_mm_shuffle_epi32(low, _MM_SHUFFLE(3, 1, 3, 1)), _mm_shuffle_epi32(high, _MM_SHUFFLE(3, 1, 3, 1)));
+
+			__m128 scaled = _mm_mul_ps(_mm_set1_ps(power), _mm_cvtepi32_ps(_mm_sub_epi32(words, _mm_set1_epi32(1072632447))));
+			__m128i result = _mm_cvttps_epi32(_mm_add_ps(scaled, _mm_set1_ps(1072632447.0f)));
+			__m128i zero = _mm_setzero_si128();
+
+			__m128 resultLow = _mm_cvtpd_ps(_mm_castsi128_pd(_mm_unpacklo_epi32(zero, result)));
+			__m128 resultHigh = _mm_cvtpd_ps(_mm_castsi128_pd(_mm_unpackhi_epi32(zero, result)));
+
+			return _mm_movelh_ps(resultLow, resultHigh);
+		}
+
+		// Color::getAbgrValue, the color has to be clamped
+		inline uint32_t getAbgrValue(__m128 color)
+		{
+			__m128i values = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(color, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+			values = _mm_packs_epi32(values, values);
+			values = _mm_packus_epi16(values, values);
+
+			return uint32_t(_mm_cvtsi128_si32(values));
+		}
+	}
+}
+
+#endif
@@ -75,6 +75,15 @@ void CudaAlloc<T>::write(T* source, size_t count)
 	assert(count <= maxCount);
 
 	memcpy(hostPtr, source, sizeof(T) * count);
+	write(count);
+}
+
+// for data that was written directly to the host memory
+template <typename T>
+void CudaAlloc<T>::write(size_t count)
+{
+	(void)count;
+	assert(count <= maxCount);
 
 #ifdef USE_CUDA
 	CudaUtils::checkError(cudaMemcpy(devicePtr, hostPtr, sizeof(T) * count, cudaMemcpyHostToDevice), "Could not write data to device");
@@ -92,6 +101,46 @@ void CudaAlloc<T>::read(size_t count)
 #endif
 }
 
+// raw host data preceded by the count, only for trivially copyable types
+template <typename T>
+void CudaAlloc<T>::save(std::ostream& stream) const
+{
+	uint64_t count = maxCount;
+
+	stream.write(reinterpret_cast<const char*>(&count), sizeof(count));
+
+	if (count > 0)
+		stream.write(reinterpret_cast<const char*>(hostPtr), sizeof(T) * count);
+
+	if (!stream.good())
+		throw std::runtime_error("Could not write data to stream");
+}
+
+template <typename T>
+void CudaAlloc<T>::load(std::istream& stream)
+{
+	uint64_t count = 0;
+
+	stream.read(reinterpret_cast<char*>(&count), sizeof(count));
+
+	if (!stream.good())
+		throw std::runtime_error("Could not read data from stream");
+
+	if (count == 0)
+	{
+		release();
+		return;
+	}
+
+	resize(size_t(count));
+	stream.read(reinterpret_cast<char*>(hostPtr), sizeof(T) * count);
+
+	if (!stream.good())
+		throw std::runtime_error("Could not read data from stream");
+
+	write(size_t(count));
+}
+
 template <typename T>
 CUDA_CALLABLE T* CudaAlloc<T>::getPtr() const
 {
@@ -118,6 +167,12 @@ T* CudaAlloc<T>::getDevicePtr() const
 	return devicePtr;
 }
 
+template <typename T>
+size_t CudaAlloc<T>::getCount() const
+{
+	return maxCount;
+}
+
 template <typename T>
 void CudaAlloc<T>::release()
 {
@@ -155,12 +210,14 @@ void CudaAlloc<T>::release()
 namespace Valo
 {
 	template class CudaAlloc<uint32_t>;
+	template class CudaAlloc<float>;
 	template class CudaAlloc<Scene>;
 	template class CudaAlloc<Film>;
 	template class CudaAlloc<Image>;
 	template class CudaAlloc<Texture>;
 	template class CudaAlloc<Material>;
-	template class CudaAlloc<Triangle>;
+	template class CudaAlloc<CompactVertex>;
+	template class CudaAlloc<CompactTriangle>;
 	template class CudaAlloc<BVHNode>;
 	template class CudaAlloc<BVHNodeSOA<4>>;
 	template class CudaAlloc<BVHNodeSOA<8>>;
@@ -3,6 +3,8 @@
 
 #pragma once
 
+#include <iosfwd>
+
 #include "Core/Common.h"
 
 namespace Valo
@@ -17,11 +19,16 @@ namespace Valo
 
 		void resize(size_t count);
 		void write(T* source, size_t count);
+		void write(size_t count);
 		void read(size_t count);
 
+		void save(std::ostream& stream) const;
+		void load(std::istream& stream);
+
 		CUDA_CALLABLE T* getPtr() const;
 		T* getHostPtr() const;
 		T* getDevicePtr() const;
+		size_t getCount() const;
 
 	private:
 
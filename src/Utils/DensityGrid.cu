@@ -0,0 +1,217 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include <cfloat>
+
+#include "App.h"
+#include "Core/AABB.h"
+#include "Utils/DensityGrid.h"
+#include "Utils/Log.h"
+#include "Utils/StringUtils.h"
+#include "Utils/Timer.h"
+
+using namespace Valo;
+
+namespace
+{
+	const uint32_t BRICK_SIZE = 8;
+	const uint32_t BRICK_SAMPLES = BRICK_SIZE + 1;
+	const uint32_t BRICK_SAMPLE_COUNT = BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES;
+	const uint32_t UNIFORM_BRICK_FLAG = 0x80000000;
+
+	// index, uniform flag and value during the bake, and the samples of a non-uniform brick
+	const uint64_t WORST_CASE_BRICK_SIZE = sizeof(uint32_t) + sizeof(uint8_t) + sizeof(float) + BRICK_SAMPLE_COUNT * sizeof(float);
+}
+
+DensityGrid::DensityGrid() : bricksAlloc(false), samplesAlloc(false)
+{
+}
+
+void DensityGrid::bake(const AABB& bounds, const std::function<float(const Vector3&)>& densityFunction)
+{
+	Log& log = App::getLog();
+
+	if (voxelSize <= 0.0f)
+		throw std::runtime_error("Density grid voxel size must be positive");
+
+	if (maxMemoryUsage == 0)
+		throw std::runtime_error("Density grid memory budget must be positive");
+
+	Timer timer;
+	float actualVoxelSize = voxelSize;
+	Vector3 extent = bounds.max - bounds.min;
+	uint64_t brickCount;
+
+	for (;;)
+	{
+		voxelCountX = MAX(uint32_t(1), uint32_t(std::ceil(extent.x / actualVoxelSize)));
+		voxelCountY = MAX(uint32_t(1), uint32_t(std::ceil(extent.y / actualVoxelSize)));
+		voxelCountZ = MAX(uint32_t(1), uint32_t(std::ceil(extent.z / actualVoxelSize)));
+
+		brickCountX = (voxelCountX + BRICK_SIZE - 1) / BRICK_SIZE;
+		brickCountY = (voxelCountY + BRICK_SIZE - 1) / BRICK_SIZE;
+		brickCountZ = (voxelCountZ + BRICK_SIZE - 1) / BRICK_SIZE;
+
+		brickCount = uint64_t(brickCountX) * uint64_t(brickCountY) * uint64_t(brickCountZ);
+		uint64_t worstCaseSize = brickCount * WORST_CASE_BRICK_SIZE;
+
+		// a single brick always fits a non-zero budget
+		if (worstCaseSize <= uint64_t(maxMemoryUsage) * 1024 * 1024 || brickCount == 1)
+			break;
+
+		actualVoxelSize *= 1.25f;
+	}
+
+	if (actualVoxelSize != voxelSize)
+		log.logWarning("Density grid voxel size was increased to %f to fit the memory budget (%d MB)", actualVoxelSize, maxMemoryUsage);
+
+	log.logInfo("Baking density grid (voxels: %dx%dx%d, bricks: %d, voxel size: %f)", voxelCountX, voxelCountY, voxelCountZ, brickCount, actualVoxelSize);
+
+	min = bounds.min;
+	max = min + Vector3(float(voxelCountX), float(voxelCountY), float(voxelCountZ)) * actualVoxelSize;
+	invVoxelSize = 1.0f / actualVoxelSize;
+
+	auto sampleBrick = [&](uint64_t brickIndex, float* brickSamples, bool stopIfNotUniform, float& firstSample)
+	{
+		uint32_t bx = uint32_t(brickIndex % brickCountX);
+		uint32_t by = uint32_t((brickIndex / brickCountX) % brickCountY);
+		uint32_t bz = uint32_t(brickIndex / (uint64_t(brickCountX) * brickCountY));
+
+		float minSample = FLT_MAX;
+		float maxSample = -FLT_MAX;
+
+		for (uint32_t z = 0; z < BRICK_SAMPLES; ++z)
+		{
+			for (uint32_t y = 0; y < BRICK_SAMPLES; ++y)
+			{
+				for (uint32_t x = 0; x < BRICK_SAMPLES; ++x)
+				{
+					Vector3 position;
+					position.x = min.x + float(bx * BRICK_SIZE + x) * actualVoxelSize;
+					position.y = min.y + float(by * BRICK_SIZE + y) * actualVoxelSize;
+					position.z = min.z + float(bz * BRICK_SIZE + z) * actualVoxelSize;
+
+					float sample = densityFunction(position);
+
+					if (x == 0 && y == 0 && z == 0)
+						firstSample = sample;
+
+					if (brickSamples != nullptr)
+						brickSamples[(z * BRICK_SAMPLES + y) * BRICK_SAMPLES + x] = sample;
+
+					minSample = MIN(minSample, sample);
+					maxSample = MAX(maxSample, sample);
+
+					if (stopIfNotUniform && (maxSample - minSample) > uniformThreshold)
+						return false;
+				}
+			}
+		}
+
+		return true;
+	};
+
+	// the bricks are classified first and the samples are then written straight to their compacted place,
+	// so the dense worst case is never allocated (the classification stops at the first varying sample)
+
+	std::vector<float> uniformValues(brickCount);
+	std::vector<uint8_t> uniformBricks(brickCount);
+
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (int64_t brickIndex = 0; brickIndex < int64_t(brickCount); ++brickIndex)
+	{
+		uniformBricks[brickIndex] = sampleBrick(uint64_t(brickIndex), nullptr, true, uniformValues[brickIndex]);
+	}
+
+	bricksAlloc.resize(brickCount);
+	uint32_t* bricks = bricksAlloc.getHostPtr();
+	uint64_t sampleCount = 0;
+
+	for (uint64_t i = 0; i < brickCount; ++i)
+	{
+		bricks[i] = uint32_t(sampleCount);
+
+		if (uniformBricks[i])
+		{
+			bricks[i] |= UNIFORM_BRICK_FLAG;
+			sampleCount += 1;
+		}
+		else
+			sampleCount += BRICK_SAMPLE_COUNT;
+	}
+
+	if (sampleCount >= UNIFORM_BRICK_FLAG)
+		throw std::runtime_error("Density grid is too large");
+
+	samplesAlloc.resize(sampleCount);
+	float* samples = samplesAlloc.getHostPtr();
+
+	#pragma omp parallel for schedule(dynamic, 16)
+	for (int64_t i = 0; i < int64_t(brickCount); ++i)
+	{
+		float* destination = &samples[bricks[i] & ~UNIFORM_BRICK_FLAG];
+
+		if (uniformBricks[i])
+			destination[0] = uniformValues[i];
+		else
+		{
+			float firstSample;
+			sampleBrick(uint64_t(i), destination, false, firstSample);
+		}
+	}
+
+	bricksAlloc.write(brickCount);
+	samplesAlloc.write(sampleCount);
+
+	uint64_t memoryUsage = brickCount * sizeof(uint32_t) + sampleCount * sizeof(float);
+	uint64_t uniformBrickCount = std::count(uniformBricks.begin(), uniformBricks.end(), uint8_t(1));
+
+	log.logInfo("Density grid baking finished (time: %s, uniform bricks: %d, memory: %sB)", timer.getElapsed().getString(true), uniformBrickCount, StringUtils::humanizeNumber(double(memoryUsage), true));
+}
+
+CUDA_CALLABLE bool DensityGrid::isInside(const Vector3& position) const
+{
+	if (bricksAlloc.getPtr() == nullptr)
+		return false;
+
+	return position.x >= min.x && position.y >= min.y && position.z >= min.z && position.x <= max.x && position.y <= max.y && position.z <= max.z;
+}
+
+CUDA_CALLABLE float DensityGrid::getDensity(const Vector3& position) const
+{
+	float x = (position.x - min.x) * invVoxelSize;
+	float y = (position.y - min.y) * invVoxelSize;
+	float z = (position.z - min.z) * invVoxelSize;
+
+	uint32_t ix = MIN(uint32_t(MAX(0.0f, x)), voxelCountX - 1);
+	uint32_t iy = MIN(uint32_t(MAX(0.0f, y)), voxelCountY - 1);
+	uint32_t iz = MIN(uint32_t(MAX(0.0f, z)), voxelCountZ - 1);
+
+	float tx = MIN(MAX(x - float(ix), 0.0f), 1.0f);
+	float ty = MIN(MAX(y - float(iy), 0.0f), 1.0f);
+	float tz = MIN(MAX(z - float(iz), 0.0f), 1.0f);
+
+	uint32_t brickIndex = ((iz / BRICK_SIZE) * brickCountY + (iy / BRICK_SIZE)) * brickCountX + (ix / BRICK_SIZE);
+	uint32_t brick = bricksAlloc.getPtr()[brickIndex];
+	const float* samples = samplesAlloc.getPtr() + (brick & ~UNIFORM_BRICK_FLAG);
+
+	if (brick & UNIFORM_BRICK_FLAG)
+		return samples[0];
+
+	const float* s = samples + ((iz % BRICK_SIZE) * BRICK_SAMPLES + (iy % BRICK_SIZE)) * BRICK_SAMPLES + (ix % BRICK_SIZE);
+
+	const uint32_t dy = BRICK_SAMPLES;
+	const uint32_t dz = BRICK_SAMPLES * BRICK_SAMPLES;
+
+	float c00 = s[0] + tx * (s[1] - s[0]);
+	float c10 = s[dy] + tx * (s[dy + 1] - s[dy]);
+	float c01 = s[dz] + tx * (s[dz + 1] - s[dz]);
+	float c11 = s[dz + dy] + tx * (s[dz + dy + 1] - s[dz + dy]);
+
+	float c0 = c00 + ty * (c10 - c00);
+	float c1 = c01 + ty * (c11 - c01);
+
+	return c0 + tz * (c1 - c0);
+}
@@ -0,0 +1,62 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "Core/Common.h"
+#include "Math/Vector3.h"
+#include "Utils/CudaAlloc.h"
+
+/*
+
+Sparse brick grid that caches a scalar density field.
+
+The field is sampled at voxel corners in bricks of 8x8x8 voxels. Each brick stores 9x9x9 samples
+so that a trilinear lookup never has to touch neighbouring bricks. Bricks whose samples are
+(almost) constant are collapsed into a single sample.
+
+If the grid would not fit in maxMemoryUsage (megabytes), the voxel size is increased until it does.
+The budget bounds the peak memory use of the bake: the bricks are classified first and the samples
+of the varying bricks are then written straight to their compacted place.
+
+*/
+
+namespace Valo
+{
+	class AABB;
+
+	class DensityGrid
+	{
+	public:
+
+		DensityGrid();
+
+		void bake(const AABB& bounds, const std::function<float(const Vector3&)>& densityFunction);
+
+		CUDA_CALLABLE bool isInside(const Vector3& position) const;
+		CUDA_CALLABLE float getDensity(const Vector3& position) const;
+
+		float voxelSize = 0.0f; // 0 -> automatic
+		uint32_t maxMemoryUsage = 256;
+		float uniformThreshold = 0.0001f;
+
+	private:
+
+		Vector3 min;
+		Vector3 max;
+		float invVoxelSize = 0.0f;
+
+		uint32_t voxelCountX = 0;
+		uint32_t voxelCountY = 0;
+		uint32_t voxelCountZ = 0;
+		uint32_t brickCountX = 0;
+		uint32_t brickCountY = 0;
+		uint32_t brickCountZ = 0;
+
+		CudaAlloc<uint32_t> bricksAlloc;
+		CudaAlloc<float> samplesAlloc;
+	};
+}
@@ -0,0 +1,501 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include <limits>
+
+#include <omp.h>
+#include <zlib.h>
+
+#include "tinyformat/tinyformat.h"
+
+#include "Utils/ImageWriter.h"
+#include "Core/Common.h"
+#include "Math/Color.h"
+#include "Utils/StringUtils.h"
+
+using namespace Valo;
+
+namespace
+{
+	const uint32_t PNG_STRIP_SIZE = 1024 * 1024; // filtered bytes per deflate strip
+	const uint32_t PNG_DICTIONARY_SIZE = 32 * 1024;
+	const uint32_t ROWS_PER_THREAD = 16; // rows per thread in one hdr/pfm batch
+
+	void appendUint32(std::vector<uint8_t>& output, uint32_t value)
+	{
+		output.push_back(uint8_t(value >> 24));
+		output.push_back(uint8_t(value >> 16));
+		output.push_back(uint8_t(value >> 8));
+		output.push_back(uint8_t(value));
+	}
+
+	void writeChunk(std::ofstream& file, const char* type, const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> header;
+		appendUint32(header, uint32_t(data.size()));
+		header.insert(header.end(), type, type + 4);
+
+		uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+
+		if (!data.empty())
+			crc = crc32(crc, data.data(), uInt(data.size()));
+
+		std::vector<uint8_t> footer;
+		appendUint32(footer, uint32_t(crc));
+
+		file.write(reinterpret_cast<const char*>(header.data()), header.size());
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		file.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+	}
+
+	uint8_t paethPredictor(int32_t a, int32_t b, int32_t c)
+	{
+		int32_t p = a + b - c;
+		int32_t pa = std::abs(p - a);
+		int32_t pb = std::abs(p - b);
+		int32_t pc = std::abs(p - c);
+
+		if (pa <= pb && pa <= pc)
+			return uint8_t(a);
+
+		if (pb <= pc)
+			return uint8_t(b);
+
+		return uint8_t(c);
+	}
+
+	// tries all the filter types and keeps the one with the smallest sum of absolute values, like stb_image_write
+	void filterRow(const uint8_t* row, const uint8_t* previousRow, uint32_t rowSize, uint8_t* output, std::vector<uint8_t>& scratch)
+	{
+		const uint32_t bpp = 4;
+		int32_t bestSum = std::numeric_limits<int32_t>::max();
+
+		scratch.resize(rowSize);
+
+		for (uint8_t filterType = 0; filterType < 5; ++filterType)
+		{
+			int32_t sum = 0;
+
+			for (uint32_t i = 0; i < rowSize; ++i)
+			{
+				int32_t a = (i >= bpp) ? row[i - bpp] : 0;
+				int32_t b = (previousRow != nullptr) ? previousRow[i] : 0;
+				int32_t c = (previousRow != nullptr && i >= bpp) ? previousRow[i - bpp] : 0;
+				uint8_t value = row[i];
+
+				switch (filterType)
+				{
+					case 1: value = uint8_t(value - a); break;
+					case 2: value = uint8_t(value - b); break;
+					case 3: value = uint8_t(value - ((a + b) >> 1)); break;
+					case 4: value = uint8_t(value - paethPredictor(a, b, c)); break;
+					default: break;
+				}
+
+				scratch[i] = value;
+				sum += std::abs(int32_t(int8_t(value)));
+			}
+
+			if (sum < bestSum)
+			{
+				bestSum = sum;
+				output[0] = filterType;
+				memcpy(output + 1, scratch.data(), rowSize);
+			}
+		}
+	}
+
+	bool deflateStrip(const std::vector<uint8_t>& input, const uint8_t* dictionary, uint32_t dictionarySize, bool isLast, std::vector<uint8_t>& output)
+	{
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+
+		if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			return false;
+
+		if (dictionarySize > 0 && deflateSetDictionary(&stream, dictionary, dictionarySize) != Z_OK)
+		{
+			deflateEnd(&stream);
+			return false;
+		}
+
+		output.resize(deflateBound(&stream, uLong(input.size())) + 16);
+
+		stream.next_in = const_cast<Bytef*>(input.data());
+		stream.avail_in = uInt(input.size());
+		stream.next_out = output.data();
+		stream.avail_out = uInt(output.size());
+
+		int flush = isLast ? Z_FINISH : Z_SYNC_FLUSH;
+		bool success = true;
+
+		for (;;)
+		{
+			int result = deflate(&stream, flush);
+
+			if (result == Z_STREAM_ERROR)
+			{
+				success = false;
+				break;
+			}
+
+			if (stream.avail_out != 0 && (flush == Z_SYNC_FLUSH || result == Z_STREAM_END))
+				break;
+
+			size_t used = output.size() - stream.avail_out;
+			output.resize(output.size() * 2);
+			stream.next_out = output.data() + used;
+			stream.avail_out = uInt(output.size() - used);
+		}
+
+		output.resize(output.size() - stream.avail_out);
+		deflateEnd(&stream);
+
+		return success;
+	}
+
+	void encodeRgbe(const Color& color, uint8_t* rgbe)
+	{
+		float r = MAX(color.r, 0.0f);
+		float g = MAX(color.g, 0.0f);
+		float b = MAX(color.b, 0.0f);
+		float maxComponent = MAX(r, MAX(g, b));
+
+		if (maxComponent < 1e-32f)
+		{
+			rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+			return;
+		}
+
+		int exponent;
+		float scale = std::frexp(maxComponent, &exponent) * 256.0f / maxComponent;
+
+		rgbe[0] = uint8_t(r * scale);
+		rgbe[1] = uint8_t(g * scale);
+		rgbe[2] = uint8_t(b * scale);
+		rgbe[3] = uint8_t(exponent + 128);
+	}
+
+	void runLengthEncode(const uint8_t* data, uint32_t width, std::vector<uint8_t>& output)
+	{
+		uint32_t x = 0;
+
+		while (x < width)
+		{
+			uint32_t runStart = x;
+			uint32_t runLength = 0;
+
+			// find the next run of at least three equal values
+			while (runStart < width)
+			{
+				runLength = 1;
+
+				while (runStart + runLength < width && runLength < 127 && data[runStart + runLength] == data[runStart])
+					++runLength;
+
+				if (runLength >= 3)
+					break;
+
+				runStart += runLength;
+			}
+
+			if (runStart >= width)
+			{
+				runStart = width;
+				runLength = 0;
+			}
+
+			while (x < runStart)
+			{
+				uint32_t count = MIN(uint32_t(128), runStart - x);
+				output.push_back(uint8_t(count));
+				output.insert(output.end(), data + x, data + x + count);
+				x += count;
+			}
+
+			if (runLength > 0)
+			{
+				output.push_back(uint8_t(128 + runLength));
+				output.push_back(data[runStart]);
+				x = runStart + runLength;
+			}
+		}
+	}
+
+	void encodeHdrRow(const Color* row, uint32_t width, std::vector<uint8_t>& output, std::vector<uint8_t>& scratch)
+	{
+		output.clear();
+		scratch.resize(width * 4);
+
+		// flat scanlines are the only option outside of the run-length encoding limits
+		if (width < 8 || width > 32767)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+				encodeRgbe(row[x], &scratch[x * 4]);
+
+			output = scratch;
+			return;
+		}
+
+		// components are stored separately for the run-length encoding
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			uint8_t rgbe[4];
+			encodeRgbe(row[x], rgbe);
+
+			for (uint32_t c = 0; c < 4; ++c)
+				scratch[c * width + x] = rgbe[c];
+		}
+
+		output.push_back(2);
+		output.push_back(2);
+		output.push_back(uint8_t(width >> 8));
+		output.push_back(uint8_t(width & 0xff));
+
+		for (uint32_t c = 0; c < 4; ++c)
+			runLengthEncode(&scratch[c * width], width, output);
+	}
+
+	// encodes the rows in parallel batches and writes them to the file in order
+	void writeRows(std::ofstream& file, uint32_t width, uint32_t height, bool topToBottom, const ImageWriter::RowFunction& getRow, const std::function<void(const Color*, std::vector<uint8_t>&, std::vector<uint8_t>&)>& encodeRow)
+	{
+		uint32_t batchSize = uint32_t(omp_get_max_threads()) * ROWS_PER_THREAD;
+		std::vector<std::vector<uint8_t>> encodedRows(batchSize);
+
+		for (uint32_t firstRow = 0; firstRow < height; firstRow += batchSize)
+		{
+			uint32_t rowCount = MIN(batchSize, height - firstRow);
+
+			#pragma omp parallel
+			{
+				std::vector<Color> pixels(width);
+				std::vector<uint8_t> scratch;
+
+				#pragma omp for schedule(dynamic)
+				for (int32_t i = 0; i < int32_t(rowCount); ++i)
+				{
+					uint32_t fileRow = firstRow + uint32_t(i);
+					getRow(topToBottom ? height - 1 - fileRow : fileRow, pixels.data());
+					encodeRow(pixels.data(), encodedRows[i], scratch);
+				}
+			}
+
+			for (uint32_t i = 0; i < rowCount; ++i)
+				file.write(reinterpret_cast<const char*>(encodedRows[i].data()), encodedRows[i].size());
+		}
+	}
+
+	std::ofstream openFile(const std::string& fileName, uint32_t width, uint32_t height)
+	{
+		if (width == 0 || height == 0)
+			throw std::runtime_error("Could not save the image (empty image)");
+
+		std::ofstream file(fileName, std::ios::out | std::ios::binary);
+
+		if (!file.is_open())
+			throw std::runtime_error(tfm::format("Could not open the image file for writing: %s", fileName));
+
+		return file;
+	}
+
+	void closeFile(std::ofstream& file)
+	{
+		file.close();
+
+		if (file.fail())
+			throw std::runtime_error("Could not write the image file");
+	}
+}
+
+bool ImageWriter::isSupported(const std::string& fileName)
+{
+	return StringUtils::endsWith(fileName, ".png") || StringUtils::endsWith(fileName, ".hdr") || StringUtils::endsWith(fileName, ".pfm");
+}
+
+void ImageWriter::write(const std::string& fileName, uint32_t width, uint32_t height, const RowFunction& getRow)
+{
+	if (StringUtils::endsWith(fileName, ".png"))
+		writePng(fileName, width, height, getRow);
+	else if (StringUtils::endsWith(fileName, ".hdr"))
+		writeHdr(fileName, width, height, getRow);
+	else if (StringUtils::endsWith(fileName, ".pfm"))
+		writePfm(fileName, width, height, getRow);
+	else
+		throw std::runtime_error("Could not save the image (non-supported format)");
+}
+
+void ImageWriter::writePng(const std::string& fileName, uint32_t width, uint32_t height, const RowFunction& getRow)
+{
+	std::ofstream file = openFile(fileName, width, height);
+
+	const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+	std::vector<uint8_t> header;
+	appendUint32(header, width);
+	appendUint32(header, height);
+	header.push_back(8); // bit depth
+	header.push_back(6); // RGBA
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+	writeChunk(file, "IHDR", header);
+
+	uint32_t rowSize = width * 4;
+	uint32_t stripRows = MAX(uint32_t(1), PNG_STRIP_SIZE / (rowSize + 1));
+	uint32_t stripCount = (height + stripRows - 1) / stripRows;
+	uint32_t batchSize = uint32_t(omp_get_max_threads());
+
+	std::vector<std::vector<uint8_t>> filteredStrips(batchSize);
+	std::vector<std::vector<uint8_t>> compressedStrips(batchSize);
+	std::vector<uLong> stripAdlers(batchSize);
+	std::vector<uint8_t> previousTail;
+	uLong adler = adler32(0L, Z_NULL, 0);
+	std::atomic<bool> failed(false);
+
+	for (uint32_t firstStrip = 0; firstStrip < stripCount; firstStrip += batchSize)
+	{
+		uint32_t batchStripCount = MIN(batchSize, stripCount - firstStrip);
+
+		#pragma omp parallel
+		{
+			std::vector<Color> pixels(width);
+			std::vector<uint8_t> rows[2] = { std::vector<uint8_t>(rowSize), std::vector<uint8_t>(rowSize) };
+			std::vector<uint8_t> scratch;
+
+			// png rows go from top to bottom, the previous row is needed for filtering
+			auto getBytes = [&](uint32_t fileRow, std::vector<uint8_t>& bytes)
+			{
+				getRow(height - 1 - fileRow, pixels.data());
+
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					uint32_t abgr = pixels[x].clamped().getAbgrValue();
+
+					bytes[x * 4] = uint8_t(abgr);
+					bytes[x * 4 + 1] = uint8_t(abgr >> 8);
+					bytes[x * 4 + 2] = uint8_t(abgr >> 16);
+					bytes[x * 4 + 3] = uint8_t(abgr >> 24);
+				}
+			};
+
+			#pragma omp for schedule(dynamic)
+			for (int32_t i = 0; i < int32_t(batchStripCount); ++i)
+			{
+				uint32_t firstRow = (firstStrip + uint32_t(i)) * stripRows;
+				uint32_t rowCount = MIN(stripRows, height - firstRow);
+				std::vector<uint8_t>& filtered = filteredStrips[i];
+				filtered.resize(rowCount * (rowSize + 1));
+
+				if (firstRow > 0)
+					getBytes(firstRow - 1, rows[1]);
+
+				for (uint32_t j = 0; j < rowCount; ++j)
+				{
+					std::vector<uint8_t>& current = rows[j % 2];
+					std::vector<uint8_t>& previous = rows[(j + 1) % 2];
+
+					getBytes(firstRow + j, current);
+					filterRow(current.data(), (firstRow + j > 0) ? previous.data() : nullptr, rowSize, &filtered[j * (rowSize + 1)], scratch);
+				}
+
+				stripAdlers[i] = adler32(adler32(0L, Z_NULL, 0), filtered.data(), uInt(filtered.size()));
+			}
+
+			// each strip is primed with the end of the previous one
+			#pragma omp for schedule(dynamic)
+			for (int32_t i = 0; i < int32_t(batchStripCount); ++i)
+			{
+				const uint8_t* dictionary = nullptr;
+				uint32_t dictionarySize = 0;
+
+				if (i > 0)
+				{
+					const std::vector<uint8_t>& previous = filteredStrips[i - 1];
+					dictionarySize = MIN(PNG_DICTIONARY_SIZE, uint32_t(previous.size()));
+					dictionary = previous.data() + previous.size() - dictionarySize;
+				}
+				else if (!previousTail.empty())
+				{
+					dictionarySize = uint32_t(previousTail.size());
+					dictionary = previousTail.data();
+				}
+
+				bool isLast = (firstStrip + uint32_t(i) == stripCount - 1);
+
+				if (!deflateStrip(filteredStrips[i], dictionary, dictionarySize, isLast, compressedStrips[i]))
+					failed = true;
+			}
+		}
+
+		if (failed)
+			throw std::runtime_error("Could not compress the image data");
+
+		for (uint32_t i = 0; i < batchStripCount; ++i)
+		{
+			std::vector<uint8_t> data;
+
+			if (firstStrip + i == 0)
+			{
+				data.push_back(0x78); // zlib header, deflate with a 32 kB window
+				data.push_back(0x9c);
+			}
+
+			data.insert(data.end(), compressedStrips[i].begin(), compressedStrips[i].end());
+			adler = adler32_combine(adler, stripAdlers[i], z_off_t(filteredStrips[i].size()));
+
+			if (firstStrip + i == stripCount - 1)
+				appendUint32(data, uint32_t(adler));
+
+			writeChunk(file, "IDAT", data);
+		}
+
+		const std::vector<uint8_t>& lastStrip = filteredStrips[batchStripCount - 1];
+		uint32_t tailSize = MIN(PNG_DICTIONARY_SIZE, uint32_t(lastStrip.size()));
+		previousTail.assign(lastStrip.end() - tailSize, lastStrip.end());
+	}
+
+	writeChunk(file, "IEND", std::vector<uint8_t>());
+	closeFile(file);
+}
+
+void ImageWriter::writeHdr(const std::string& fileName, uint32_t width, uint32_t height, const RowFunction& getRow)
+{
+	std::ofstream file = openFile(fileName, width, height);
+
+	file << "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n" << tfm::format("-Y %d +X %d\n", height, width);
+
+	writeRows(file, width, height, true, getRow, [width](const Color* row, std::vector<uint8_t>& output, std::vector<uint8_t>& scratch)
+	{
+		encodeHdrRow(row, width, output, scratch);
+	});
+
+	closeFile(file);
+}
+
+void ImageWriter::writePfm(const std::string& fileName, uint32_t width, uint32_t height, const RowFunction& getRow)
+{
+	std::ofstream file = openFile(fileName, width, height);
+
+	// negative scale means little endian, rows go from bottom to top
+	file << tfm::format("PF\n%d %d\n-1.0\n", width, height);
+
+	writeRows(file, width, height, false, getRow, [width](const Color* row, std::vector<uint8_t>& output, std::vector<uint8_t>& scratch)
+	{
+		(void)scratch;
+
+		output.resize(width * 3 * sizeof(float));
+		float* values = reinterpret_cast<float*>(output.data());
+
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			values[x * 3] = row[x].r;
+			values[x * 3 + 1] = row[x].g;
+			values[x * 3 + 2] = row[x].b;
+		}
+	});
+
+	closeFile(file);
+}
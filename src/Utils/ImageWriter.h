@@ -0,0 +1,44 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+/*
+
+Streaming image writers. The pixels are requested one row at a time through getRow (y = 0 is the
+bottom row, like in Image) and only a bounded batch of rows is kept in memory, so the output never
+needs a full-size copy of the image. getRow is called from several threads at once.
+
+PNG rows are processed in strips that are filtered and deflated in parallel. Each strip is its own
+raw deflate stream primed with the tail of the previous strip and ended with a sync flush, so the
+compressed strips can be concatenated into one valid zlib stream.
+
+HDR is written as run-length encoded RGBE scanlines and PFM as raw float RGB scanlines.
+
+write picks the format from the file extension. Callers such as Film::saveImage use it to write
+the image straight from their own data, normalizing and tonemapping one row at a time.
+
+*/
+
+namespace Valo
+{
+	class Color;
+
+	class ImageWriter
+	{
+	public:
+
+		typedef std::function<void(uint32_t y, Color* row)> RowFunction;
+
+		static bool isSupported(const std::string& fileName);
+		static void write(const std::string& fileName, uint32_t width, uint32_t height, const RowFunction& getRow);
+
+		static void writePng(const std::string& fileName, uint32_t width, uint32_t height, const RowFunction& getRow);
+		static void writeHdr(const std::string& fileName, uint32_t width, uint32_t height, const RowFunction& getRow);
+		static void writePfm(const std::string& fileName, uint32_t width, uint32_t height, const RowFunction& getRow);
+	};
+}
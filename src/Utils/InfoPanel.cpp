@@ -141,7 +141,7 @@ void InfoPanel::renderFull(const Renderer& renderer, const RenderJob& job)
 	nvgTextBounds(context, 0.0f, 0.0f, "1234567890.", nullptr, bounds);
 	float charWidth = (bounds[2] - bounds[0]) / 11.0f;
 	float panelWidth = 34 * charWidth;
-	float panelHeight = 17 * lineSpacing + lineSpacing / 2.0f;
+	float panelHeight = 18 * lineSpacing + lineSpacing / 2.0f;
 	float currentX = charWidth / 2.0f + 4.0f;
 	float currentY = -bounds[1] + 4.0f;
 
@@ -177,8 +177,9 @@ void InfoPanel::renderFull(const Renderer& renderer, const RenderJob& job)
 	currentY += lineSpacing;
 
 	float totalPixels = float(film.getWidth() * film.getWidth());
+	float renderScale = float(film.getWidth()) / float(MAX(uint32_t(1), windowRunner.getWindowWidth()));
 
-	nvgText(context, currentX, currentY, tfm::format("Film: %dx%d (%.2fx) (%s)", film.getWidth(), film.getHeight(), settings.window.renderScale, StringUtils::humanizeNumber(totalPixels)).c_str(), nullptr);
+	nvgText(context, currentX, currentY, tfm::format("Film: %dx%d (%.2fx) (%s)", film.getWidth(), film.getHeight(), renderScale, StringUtils::humanizeNumber(totalPixels)).c_str(), nullptr);
 	currentY += lineSpacing;
 
 	nvgText(context, currentX, currentY, tfm::format("Position: (%.2f, %.2f, %.2f)", scene.camera.position.x, scene.camera.position.y, scene.camera.position.z).c_str(), nullptr);
@@ -227,6 +228,9 @@ void InfoPanel::renderFull(const Renderer& renderer, const RenderJob& job)
 	nvgText(context, currentX, currentY, tfm::format("Filter: %s (%s)", scene.renderer.filter.getName(), (renderer.filtering && scene.renderer.filtering) ? "on" : "off").c_str(), nullptr);
 	currentY += lineSpacing;
 
+	nvgText(context, currentX, currentY, tfm::format("Sampler: %s", Sampler(scene.renderer.samplerType).getName()).c_str(), nullptr);
+	currentY += lineSpacing;
+
 	float tonemapperValue = 0.0f;
 
 	switch (scene.tonemapper.type)
@@ -3,7 +3,13 @@
 
 #include "Precompiled.h"
 
+#include <limits>
+#include <unordered_map>
+
+#include <omp.h>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 #include "App.h"
 #include "Math/Matrix4x4.h"
@@ -17,9 +23,13 @@
 
 using namespace Valo;
 namespace bf = boost::filesystem;
+namespace bi = boost::interprocess;
 
 namespace
 {
+	const uint64_t MIN_CHUNK_SIZE = 64 * 1024;
+	const uint64_t MAX_CHUNK_SIZE = 16 * 1024 * 1024;
+
 	std::string getAbsolutePath(const std::string& rootDirectory, const std::string& relativeFileName)
 	{
 		bf::path tempPath(rootDirectory);
@@ -192,6 +202,38 @@ namespace
 			}
 		}
 
+		if (c == 'e' || c == 'E')
+		{
+			if (++startIndex >= endIndex)
+				return sign * accumulator;
+
+			int32_t exponentSign = 1;
+			int32_t exponent = 0;
+			c = buffer[startIndex];
+
+			if (c == '-' || c == '+')
+			{
+				exponentSign = (c == '-') ? -1 : 1;
+
+				if (++startIndex >= endIndex)
+					return sign * accumulator;
+
+				c = buffer[startIndex];
+			}
+
+			while (c >= '0' && c <= '9')
+			{
+				exponent = exponent * 10 + c - '0';
+
+				if (++startIndex >= endIndex)
+					break;
+
+				c = buffer[startIndex];
+			}
+
+			accumulator *= std::pow(10.0f, float(exponentSign * MIN(exponent, 64)));
+		}
+
 		return sign * accumulator;
 	}
 
@@ -245,239 +287,1224 @@ namespace
 		if (hasNormals)
 			normalIndex = getInt(buffer, wordStartIndex, wordEndIndex);
 	}
-}
 
-ModelLoaderResult ModelLoader::load(const ModelLoaderInfo& info)
-{
-	Log& log = App::getLog();
+	const uint32_t MESH_FILE_VERSION = 1;
+	const uint32_t NO_MATERIAL_SLOT = 0xffffffff;
 
-	log.logInfo("Reading OBJ file %s(%s)", info.loadOnlyMaterials ? "(materials only) " : "", info.modelFileName);
+	struct MeshFileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t flags;
+		uint32_t reserved;
+		uint64_t vertexCount;
+		uint64_t normalCount;
+		uint64_t texcoordCount;
+		uint64_t triangleCount;
+		uint64_t textureCount;
+		uint64_t materialCount;
+	};
+
+	struct MeshFileTriangle
+	{
+		uint32_t vertexIndices[3];
+		uint32_t normalIndices[3];
+		uint32_t texcoordIndices[3];
+		uint32_t materialSlot;
+	};
 
-	Timer timer;
-	std::string rootDirectory = bf::absolute(info.modelFileName).parent_path().string();
-	currentMaterialId = info.defaultMaterialId;
+	struct MeshFileTexture
+	{
+		uint32_t id;
+		uint32_t applyGamma;
+		uint32_t generateMipmaps;
+		uint32_t fileNameLength;
+	};
 
-	Matrix4x4 scaling = Matrix4x4::scale(info.scale);
-	Matrix4x4 rotation = Matrix4x4::rotateXYZ(info.rotate);
-	Matrix4x4 translation = Matrix4x4::translate(info.translate);
-	Matrix4x4 transformation = translation * rotation * scaling;
-	Matrix4x4 transformationInvT = transformation.inverted().transposed();
+	struct MeshFileMaterial
+	{
+		uint32_t id;
+		uint32_t externalId;
+		uint32_t normalInterpolation;
+		uint32_t autoInvertNormal;
+		uint32_t invertNormal;
+		uint32_t invisible;
+		uint32_t primaryRayInvisible;
+		uint32_t showEmittance;
+		float texcoordScale[2];
+		float emittance[3];
+		uint32_t emittanceTextureId;
+		float reflectance[3];
+		uint32_t reflectanceTextureId;
+		uint32_t normalTextureId;
+		uint32_t maskTextureId;
+		uint32_t nameLength;
+	};
+
+	// exact bit patterns, used for welding the mesh file vertices
+	struct VertexKey
+	{
+		uint32_t values[3];
 
-	ModelLoaderResult result;
+		bool operator==(const VertexKey& other) const
+		{
+			return values[0] == other.values[0] && values[1] == other.values[1] && values[2] == other.values[2];
+		}
+	};
 
-	vertices.clear();
-	normals.clear();
-	texcoords.clear();
+	struct VertexKeyHash
+	{
+		size_t operator()(const VertexKey& key) const
+		{
+			uint64_t hash = 14695981039346656037ULL;
 
-	materialsMap.clear();
-	externalMaterialsMap.clear();
+			for (uint32_t value : key.values)
+				hash = (hash ^ value) * 1099511628211ULL;
 
-	if (!info.loadOnlyMaterials)
+			return size_t(hash);
+		}
+	};
+
+	uint32_t addUniqueVertex(std::unordered_map<VertexKey, uint32_t, VertexKeyHash>& vertexMap, std::vector<float>& vertexData, const float* values, uint32_t valueCount)
 	{
-		result.triangles.reserve(info.triangleCountEstimate);
-		vertices.reserve(info.triangleCountEstimate / 2);
-		normals.reserve(info.triangleCountEstimate / 2);
-		texcoords.reserve(info.triangleCountEstimate / 2);
+		VertexKey key = { { 0, 0, 0 } };
+		memcpy(key.values, values, valueCount * sizeof(float));
+
+		auto result = vertexMap.emplace(key, uint32_t(vertexMap.size()));
+
+		if (result.second)
+		{
+			if (vertexMap.size() > std::numeric_limits<uint32_t>::max())
+				throw std::runtime_error("Too many vertices for a mesh file");
+
+			vertexData.insert(vertexData.end(), values, values + valueCount);
+		}
+
+		return result.first->second;
 	}
-	
-	std::ifstream file(info.modelFileName, std::ios::in | std::ios::binary | std::ios::ate);
 
-	if (!file.good())
-		throw std::runtime_error(tfm::format("Could not open the OBJ file"));
+	void writeMeshString(std::ofstream& file, const std::string& value)
+	{
+		const char padding[4] = { 0, 0, 0, 0 };
 
-	auto size = file.tellg();
-	file.seekg(0, std::ios::beg);
+		file.write(value.data(), value.size());
+		file.write(padding, (4 - value.size() % 4) % 4);
+	}
 
-	std::vector<char> fileBuffer(size);
-	file.read(&fileBuffer[0], size);
+	const char* readMeshData(const char* buffer, uint64_t bufferLength, uint64_t& offset, uint64_t count, uint64_t elementSize)
+	{
+		if (count > (bufferLength - offset) / elementSize)
+			throw std::runtime_error("Mesh file is truncated");
 
-	file.close();
+		const char* data = buffer + offset;
+		offset += count * elementSize;
 
-	char* fileBufferPtr = &fileBuffer[0];
-	uint32_t fileBufferLength = uint32_t(fileBuffer.size());
-	uint32_t lineStartIndex = 0;
-	uint32_t lineEndIndex = 0;
-	uint32_t lineNumber = 0;
+		return data;
+	}
 
-	if (info.substituteMaterial)
-		processMaterialFile(rootDirectory, info.substituteMaterialFileName, result);
+	std::string readMeshString(const char* buffer, uint64_t bufferLength, uint64_t& offset, uint32_t length)
+	{
+		std::string value(readMeshData(buffer, bufferLength, offset, length, 1), length);
+		readMeshData(buffer, bufferLength, offset, (4 - length % 4) % 4, 1);
+
+		return value;
+	}
 
-	while (getLine(fileBufferPtr, fileBufferLength, lineStartIndex, lineEndIndex))
+	const char* mapFile(const std::string& fileName, const char* fileType, bi::mapped_region& mappedRegion, uint64_t& fileSize)
 	{
-		lineNumber++;
+		if (!bf::exists(fileName))
+			throw std::runtime_error(tfm::format("Could not open the %s file", fileType));
 
-		uint32_t wordStartIndex = lineStartIndex;
-		uint32_t wordEndIndex = 0;
+		fileSize = bf::file_size(fileName);
 
-		getWord(fileBufferPtr, lineEndIndex, wordStartIndex, wordEndIndex);
+		if (fileSize == 0)
+			return nullptr;
 
-		if (!info.loadOnlyMaterials)
+		try
+		{
+			bi::file_mapping fileMapping(fileName.c_str(), bi::read_only);
+			mappedRegion = bi::mapped_region(fileMapping, bi::read_only);
+		}
+		catch (const bi::interprocess_exception& ex)
+		{
+			throw std::runtime_error(tfm::format("Could not map the %s file: %s", fileType, ex.what()));
+		}
+
+		mappedRegion.advise(bi::mapped_region::advice_sequential);
+		return static_cast<const char*>(mappedRegion.get_address());
+	}
+
+	enum class PlyType { INT8, UINT8, INT16, UINT16, INT32, UINT32, FLOAT32, FLOAT64 };
+
+	struct PlyProperty
+	{
+		std::string name;
+		PlyType type = PlyType::FLOAT32;
+		PlyType countType = PlyType::UINT8;
+		bool isList = false;
+		uint64_t offset = 0;
+	};
+
+	struct PlyElement
+	{
+		std::string name;
+		uint64_t count = 0;
+		std::vector<PlyProperty> properties;
+		bool isFixedSize = true;
+		uint64_t size = 0;
+	};
+
+	PlyType getPlyType(const std::string& typeName)
+	{
+		if (typeName == "char" || typeName == "int8")
+			return PlyType::INT8;
+		else if (typeName == "uchar" || typeName == "uint8")
+			return PlyType::UINT8;
+		else if (typeName == "short" || typeName == "int16")
+			return PlyType::INT16;
+		else if (typeName == "ushort" || typeName == "uint16")
+			return PlyType::UINT16;
+		else if (typeName == "int" || typeName == "int32")
+			return PlyType::INT32;
+		else if (typeName == "uint" || typeName == "uint32")
+			return PlyType::UINT32;
+		else if (typeName == "float" || typeName == "float32")
+			return PlyType::FLOAT32;
+		else if (typeName == "double" || typeName == "float64")
+			return PlyType::FLOAT64;
+		else
+			throw std::runtime_error(tfm::format("Unknown PLY property type (%s)", typeName));
+	}
+
+	uint64_t getPlyTypeSize(PlyType type)
+	{
+		switch (type)
+		{
+			case PlyType::INT8:
+			case PlyType::UINT8: return 1;
+			case PlyType::INT16:
+			case PlyType::UINT16: return 2;
+			case PlyType::INT32:
+			case PlyType::UINT32:
+			case PlyType::FLOAT32: return 4;
+			case PlyType::FLOAT64: return 8;
+			default: return 0;
+		}
+	}
+
+	template <typename T>
+	T readPlyScalar(const char* data)
+	{
+		T value;
+		memcpy(&value, data, sizeof(T));
+		return value;
+	}
+
+	double readPlyValue(const char* data, PlyType type)
+	{
+		switch (type)
+		{
+			case PlyType::INT8: return readPlyScalar<int8_t>(data);
+			case PlyType::UINT8: return readPlyScalar<uint8_t>(data);
+			case PlyType::INT16: return readPlyScalar<int16_t>(data);
+			case PlyType::UINT16: return readPlyScalar<uint16_t>(data);
+			case PlyType::INT32: return readPlyScalar<int32_t>(data);
+			case PlyType::UINT32: return readPlyScalar<uint32_t>(data);
+			case PlyType::FLOAT32: return readPlyScalar<float>(data);
+			case PlyType::FLOAT64: return readPlyScalar<double>(data);
+			default: return 0.0;
+		}
+	}
+
+	int32_t findPlyProperty(const PlyElement& element, std::initializer_list<const char*> names)
+	{
+		for (size_t i = 0; i < element.properties.size(); ++i)
 		{
-			if (compareWord(fileBufferPtr, wordStartIndex, wordEndIndex, "f")) // face
+			for (const char* name : names)
 			{
-				if (!processFace(fileBufferPtr, lineStartIndex + 2, lineEndIndex, lineNumber, result))
-					break;
+				if (element.properties[i].name == name)
+					return int32_t(i);
 			}
-			else if (compareWord(fileBufferPtr, wordStartIndex, wordEndIndex, "v")) // vertex
-			{
-				Vector3 vertex;
-				wordStartIndex += 2;
+		}
+
+		return -1;
+	}
 
-				vertex.x = getFloat(fileBufferPtr, wordStartIndex, lineEndIndex);
-				vertex.y = getFloat(fileBufferPtr, wordStartIndex, lineEndIndex);
-				vertex.z = getFloat(fileBufferPtr, wordStartIndex, lineEndIndex);
+	// returns the offset of the element data
+	uint64_t parsePlyHeader(const char* buffer, uint64_t bufferLength, std::vector<PlyElement>& elements)
+	{
+		uint64_t offset = 0;
+		uint32_t lineNumber = 0;
 
-				vertices.push_back(transformation.transformPosition(vertex));
-			}
-			else if (compareWord(fileBufferPtr, wordStartIndex, wordEndIndex, "vn")) // normal
-			{
-				Vector3 normal;
-				wordStartIndex += 3;
+		for (;;)
+		{
+			uint64_t lineEndIndex = offset;
+
+			while (lineEndIndex < bufferLength && buffer[lineEndIndex] != '\n')
+				lineEndIndex++;
 
-				normal.x = getFloat(fileBufferPtr, wordStartIndex, lineEndIndex);
-				normal.y = getFloat(fileBufferPtr, wordStartIndex, lineEndIndex);
-				normal.z = getFloat(fileBufferPtr, wordStartIndex, lineEndIndex);
+			if (lineEndIndex >= bufferLength)
+				throw std::runtime_error("PLY header is incomplete");
 
-				normals.push_back(transformationInvT.transformDirection(normal).normalized());
+			std::string line(buffer + offset, lineEndIndex - offset);
+			offset = lineEndIndex + 1;
+
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+
+			std::istringstream ss(line);
+			std::string keyword;
+			ss >> keyword;
+
+			if (lineNumber++ == 0)
+			{
+				if (keyword != "ply")
+					throw std::runtime_error("Not a PLY file");
 			}
-			else if (compareWord(fileBufferPtr, wordStartIndex, wordEndIndex, "vt")) // texcoord
+			else if (keyword == "format")
 			{
-				Vector2 texcoord;
-				wordStartIndex += 3;
+				std::string format;
+				ss >> format;
 
-				texcoord.x = getFloat(fileBufferPtr, wordStartIndex, lineEndIndex);
-				texcoord.y = getFloat(fileBufferPtr, wordStartIndex, lineEndIndex);
-
-				texcoords.push_back(texcoord);
+				if (format != "binary_little_endian")
+					throw std::runtime_error(tfm::format("Unsupported PLY format (%s)", format));
 			}
-			else if (compareWord(fileBufferPtr, wordStartIndex, wordEndIndex, "usemtl")) // select material
+			else if (keyword == "element")
 			{
-				wordStartIndex = wordEndIndex;
-				getWord(fileBufferPtr, lineEndIndex, wordStartIndex, wordEndIndex);
-				std::string materialName(fileBufferPtr + wordStartIndex, wordEndIndex - wordStartIndex);
+				PlyElement element;
+				ss >> element.name >> element.count;
+				elements.push_back(element);
+			}
+			else if (keyword == "property")
+			{
+				if (elements.empty())
+					throw std::runtime_error("PLY property is not part of an element");
 
-				if (externalMaterialsMap.count(materialName))
-					currentMaterialId = externalMaterialsMap[materialName];
-				else if (materialsMap.count(materialName))
-					currentMaterialId = materialsMap[materialName];
-				else
+				PlyProperty property;
+				std::string typeName;
+				ss >> typeName;
+
+				if (typeName == "list")
 				{
-					log.logWarning("Could not find material named \"%s\"", materialName);
-					currentMaterialId = info.defaultMaterialId;
+					property.isList = true;
+					ss >> typeName;
+					property.countType = getPlyType(typeName);
+					ss >> typeName;
 				}
+
+				property.type = getPlyType(typeName);
+				ss >> property.name;
+
+				elements.back().properties.push_back(property);
 			}
+			else if (keyword == "end_header")
+				break;
 		}
 
-		if (!info.substituteMaterial && compareWord(fileBufferPtr, wordStartIndex, wordEndIndex, "mtllib")) // new material file
+		for (PlyElement& element : elements)
 		{
-			wordStartIndex = wordEndIndex;
-			getWord(fileBufferPtr, lineEndIndex, wordStartIndex, wordEndIndex);
-			std::string mtlFileName(fileBufferPtr + wordStartIndex, wordEndIndex - wordStartIndex);
-
-			processMaterialFile(rootDirectory, mtlFileName, result);
+			for (PlyProperty& property : element.properties)
+			{
+				property.offset = element.size;
+				element.size += getPlyTypeSize(property.type);
+				element.isFixedSize = element.isFixedSize && !property.isList;
+			}
 		}
-		
-		lineStartIndex = lineEndIndex;
-	}
 
-	log.logInfo("OBJ file reading finished (time: %s, vertices: %s, normals: %s, texcoords: %s, triangles: %s, materials: %s, textures: %s)", timer.getElapsed().getString(true), vertices.size(), normals.size(), texcoords.size(), result.triangles.size(), result.materials.size(), result.textures.size());
+		return offset;
+	}
 
-	return result;
-}
+	// property offsets of a single element item, the offset of a list points to its count
+	uint64_t getPlyItemLayout(const PlyElement& element, const char* buffer, uint64_t bufferLength, uint64_t offset, uint64_t* propertyOffsets)
+	{
+		uint64_t itemSize = 0;
 
-void ModelLoader::processMaterialFile(const std::string& rootDirectory, const std::string& mtlFileName, ModelLoaderResult& result)
-{
-	std::string absoluteMtlFileName = getAbsolutePath(rootDirectory, mtlFileName);
-	App::getLog().logInfo("Reading MTL file (%s)", absoluteMtlFileName);
-	std::ifstream file(absoluteMtlFileName);
+		for (size_t i = 0; i < element.properties.size(); ++i)
+		{
+			const PlyProperty& property = element.properties[i];
+			propertyOffsets[i] = itemSize;
 
-	if (!file.good())
-		throw std::runtime_error("Could not open the MTL file");
+			if (property.isList)
+			{
+				uint64_t countSize = getPlyTypeSize(property.countType);
 
-	Material currentMaterial;
-	bool materialPending = false;
+				if (countSize > bufferLength - offset - itemSize)
+					throw std::runtime_error("PLY file is truncated");
 
-	std::string line;
-	std::string part;
-	std::string currentMaterialName;
+				int64_t count = int64_t(readPlyValue(buffer + offset + itemSize, property.countType));
 
-	while (std::getline(file, line))
-	{
-		std::stringstream ss(line);
-		ss >> part;
+				if (count < 0 || uint64_t(count) > bufferLength)
+					throw std::runtime_error("PLY file has an invalid list");
 
-		if (part == "newmtl") // new material
-		{
-			if (materialPending)
-				result.materials.push_back(currentMaterial);
+				itemSize += countSize + uint64_t(count) * getPlyTypeSize(property.type);
+			}
+			else
+				itemSize += getPlyTypeSize(property.type);
 
-			materialPending = true;
-			currentMaterialId = ++materialIdCounter;
+			if (itemSize > bufferLength - offset)
+				throw std::runtime_error("PLY file is truncated");
+		}
 
-			currentMaterial = Material();
-			currentMaterial.id = currentMaterialId;
+		return itemSize;
+	}
 
-			ss >> currentMaterialName;
-			materialsMap[currentMaterialName] = currentMaterialId;
-		}
-		else if (part == "materialId")
-			ss >> externalMaterialsMap[currentMaterialName];
-		else if (part == "normalInterpolation")
-			ss >> currentMaterial.normalInterpolation;
-		else if (part == "autoInvertNormal")
-			ss >> currentMaterial.autoInvertNormal;
-		else if (part == "invertNormal")
-			ss >> currentMaterial.invertNormal;
-		else if (part == "invisible")
-			ss >> currentMaterial.invisible;
-		else if (part == "primaryRayInvisible")
-			ss >> currentMaterial.primaryRayInvisible;
-		else if (part == "showEmittance")
-			ss >> currentMaterial.showEmittance;
-		else if (part == "texcoordScale")
+	uint64_t skipPlyElement(const char* buffer, uint64_t bufferLength, uint64_t offset, const PlyElement& element)
+	{
+		if (element.isFixedSize)
 		{
-			ss >> currentMaterial.texcoordScale.x;
-			ss >> currentMaterial.texcoordScale.y;
+			if (element.size > 0 && element.count > (bufferLength - offset) / element.size)
+				throw std::runtime_error("PLY file is truncated");
+
+			return offset + element.count * element.size;
 		}
-		else if (part == "emittance" || part == "Ke")
+
+		std::vector<uint64_t> propertyOffsets(element.properties.size());
+
+		for (uint64_t i = 0; i < element.count; ++i)
+			offset += getPlyItemLayout(element, buffer, bufferLength, offset, propertyOffsets.data());
+
+		return offset;
+	}
+
+	uint64_t readPlyVertices(const char* buffer, uint64_t bufferLength, uint64_t offset, const PlyElement& element, const Matrix4x4& transformation, const Matrix4x4& transformationInvT, std::vector<Vector3>& vertices, std::vector<Vector3>& normals, std::vector<Vector2>& texcoords)
+	{
+		int32_t xIndex = findPlyProperty(element, { "x" });
+		int32_t yIndex = findPlyProperty(element, { "y" });
+		int32_t zIndex = findPlyProperty(element, { "z" });
+		int32_t nxIndex = findPlyProperty(element, { "nx" });
+		int32_t nyIndex = findPlyProperty(element, { "ny" });
+		int32_t nzIndex = findPlyProperty(element, { "nz" });
+		int32_t uIndex = findPlyProperty(element, { "u", "s", "texture_u" });
+		int32_t vIndex = findPlyProperty(element, { "v", "t", "texture_v" });
+
+		if (xIndex < 0 || yIndex < 0 || zIndex < 0)
+			throw std::runtime_error("PLY vertices have no positions");
+
+		if (element.count > bufferLength - offset || (element.isFixedSize && element.count > (bufferLength - offset) / element.size))
+			throw std::runtime_error("PLY file is truncated");
+
+		bool hasNormals = (nxIndex >= 0 && nyIndex >= 0 && nzIndex >= 0);
+		bool hasTexcoords = (uIndex >= 0 && vIndex >= 0);
+		const std::vector<PlyProperty>& properties = element.properties;
+
+		vertices.resize(element.count);
+
+		if (hasNormals)
+			normals.resize(element.count);
+
+		if (hasTexcoords)
+			texcoords.resize(element.count);
+
+		auto readVertex = [&](const char* item, const uint64_t* propertyOffsets, uint64_t index)
 		{
-			ss >> currentMaterial.emittance.r;
-			ss >> currentMaterial.emittance.g;
-			ss >> currentMaterial.emittance.b;
-		}
-		else if ((part == "emittanceMap" || part == "map_Ke") && currentMaterial.emittanceTextureId == 0)
+			Vector3 position;
+			position.x = float(readPlyValue(item + propertyOffsets[xIndex], properties[xIndex].type));
+			position.y = float(readPlyValue(item + propertyOffsets[yIndex], properties[yIndex].type));
+			position.z = float(readPlyValue(item + propertyOffsets[zIndex], properties[zIndex].type));
+
+			vertices[index] = transformation.transformPosition(position);
+
+			if (hasNormals)
+			{
+				Vector3 normal;
+				normal.x = float(readPlyValue(item + propertyOffsets[nxIndex], properties[nxIndex].type));
+				normal.y = float(readPlyValue(item + propertyOffsets[nyIndex], properties[nyIndex].type));
+				normal.z = float(readPlyValue(item + propertyOffsets[nzIndex], properties[nzIndex].type));
+
+				normals[index] = transformationInvT.transformDirection(normal).normalized();
+			}
+
+			if (hasTexcoords)
+			{
+				texcoords[index].x = float(readPlyValue(item + propertyOffsets[uIndex], properties[uIndex].type));
+				texcoords[index].y = float(readPlyValue(item + propertyOffsets[vIndex], properties[vIndex].type));
+			}
+		};
+
+		std::vector<uint64_t> propertyOffsets(properties.size());
+
+		if (element.isFixedSize)
 		{
-			Texture texture;
-			texture.type = TextureType::IMAGE;
-			texture.id = ++currentTextureId;
-			currentMaterial.emittanceTextureId = texture.id;
+			for (size_t i = 0; i < properties.size(); ++i)
+				propertyOffsets[i] = properties[i].offset;
 
-			ss >> part;
-			texture.imageTexture.imageFileName = getAbsolutePath(rootDirectory, part);
-			texture.imageTexture.applyGamma = !StringUtils::endsWith(texture.imageTexture.imageFileName, ".hdr");
+			#pragma omp parallel for
+			for (int64_t i = 0; i < int64_t(element.count); ++i)
+				readVertex(buffer + offset + uint64_t(i) * element.size, propertyOffsets.data(), uint64_t(i));
 
-			result.textures.push_back(texture);
+			return offset + element.count * element.size;
 		}
-		else if (part == "reflectance" || part == "Kr" || part == "Kd")
+
+		for (uint64_t i = 0; i < element.count; ++i)
 		{
-			ss >> currentMaterial.reflectance.r;
-			ss >> currentMaterial.reflectance.g;
-			ss >> currentMaterial.reflectance.b;
+			uint64_t itemSize = getPlyItemLayout(element, buffer, bufferLength, offset, propertyOffsets.data());
+			readVertex(buffer + offset, propertyOffsets.data(), i);
+			offset += itemSize;
 		}
-		else if ((part == "reflectanceMap" || part == "map_Kr" || part == "map_Kd") && currentMaterial.reflectanceTextureId == 0)
-		{
-			Texture texture;
-			texture.type = TextureType::IMAGE;
-			texture.id = ++currentTextureId;
-			currentMaterial.reflectanceTextureId = texture.id;
 
-			ss >> part;
-			texture.imageTexture.imageFileName = getAbsolutePath(rootDirectory, part);
-			texture.imageTexture.applyGamma = !StringUtils::endsWith(texture.imageTexture.imageFileName, ".hdr");
+		return offset;
+	}
 
-			result.textures.push_back(texture);
-		}
-		else if ((part == "normalMap" || part == "map_normal") && currentMaterial.normalTextureId == 0)
+	uint64_t readPlyFaces(const char* buffer, uint64_t bufferLength, uint64_t offset, const PlyElement& element, const std::vector<Vector3>& vertices, const std::vector<Vector3>& normals, const std::vector<Vector2>& texcoords, uint32_t materialId, std::vector<Triangle>& triangles, uint64_t& invalidFaceCount)
+	{
+		int32_t indicesIndex = findPlyProperty(element, { "vertex_indices", "vertex_index" });
+
+		if (indicesIndex < 0 || !element.properties[indicesIndex].isList)
+			throw std::runtime_error("PLY faces have no vertex indices");
+
+		if (element.count > bufferLength - offset)
+			throw std::runtime_error("PLY file is truncated");
+
+		const PlyProperty& indicesProperty = element.properties[indicesIndex];
+		uint64_t countSize = getPlyTypeSize(indicesProperty.countType);
+		uint64_t indexSize = getPlyTypeSize(indicesProperty.type);
+		std::vector<uint64_t> propertyOffsets(element.properties.size());
+
+		bool hasNormals = !normals.empty();
+		bool hasTexcoords = !texcoords.empty();
+
+		triangles.reserve(triangles.size() + element.count);
+
+		for (uint64_t i = 0; i < element.count; ++i)
+		{
+			uint64_t itemSize = getPlyItemLayout(element, buffer, bufferLength, offset, propertyOffsets.data());
+			const char* indexData = buffer + offset + propertyOffsets[indicesIndex];
+			uint64_t indexCount = uint64_t(readPlyValue(indexData, indicesProperty.countType));
+
+			indexData += countSize;
+			offset += itemSize;
+
+			if (indexCount < 3)
+			{
+				invalidFaceCount++;
+				continue;
+			}
+
+			uint64_t indices[3];
+
+			for (uint64_t j = 0; j < indexCount; ++j)
+			{
+				int64_t index = int64_t(readPlyValue(indexData + j * indexSize, indicesProperty.type));
+
+				if (index < 0 || index >= int64_t(vertices.size()))
+					throw std::runtime_error(tfm::format("PLY face vertex index (%d) is out of bounds (face: %d)", index, i));
+
+				// triangle fan
+				indices[MIN(j, uint64_t(2))] = uint64_t(index);
+
+				if (j < 2)
+					continue;
+
+				Triangle triangle;
+				triangle.materialId = materialId;
+
+				for (uint32_t k = 0; k < 3; ++k)
+				{
+					triangle.vertices[k] = vertices[indices[k]];
+
+					if (hasTexcoords)
+						triangle.texcoords[k] = texcoords[indices[k]];
+				}
+
+				if (hasNormals)
+				{
+					for (uint32_t k = 0; k < 3; ++k)
+						triangle.normals[k] = normals[indices[k]];
+				}
+				else
+				{
+					Vector3 v0tov1 = triangle.vertices[1] - triangle.vertices[0];
+					Vector3 v0tov2 = triangle.vertices[2] - triangle.vertices[0];
+					Vector3 normal = v0tov1.cross(v0tov2).normalized();
+
+					triangle.normals[0] = triangle.normals[1] = triangle.normals[2] = normal;
+				}
+
+				triangles.push_back(triangle);
+				indices[1] = indices[2];
+			}
+		}
+
+		return offset;
+	}
+
+	// positive indices are absolute, negative indices are stored relative to the start of the chunk
+	// the lowest bit tells them apart
+	int64_t encodeIndex(int32_t index, uint64_t localCount)
+	{
+		if (index < 0)
+			return (int64_t(localCount) + index) * 2 + 1;
+
+		return (int64_t(index) - 1) * 2;
+	}
+
+	int64_t decodeIndex(int64_t encodedIndex, uint64_t chunkOffset)
+	{
+		int64_t index = (encodedIndex - (encodedIndex & 1)) / 2;
+
+		if (encodedIndex & 1)
+			index += int64_t(chunkOffset);
+
+		return index;
+	}
+}
+
+struct ModelLoader::Chunk
+{
+	enum class DirectiveType { MTLLIB, USEMTL };
+
+	struct Directive
+	{
+		DirectiveType type;
+		std::string name;
+		uint64_t faceIndex;
+	};
+
+	struct Face
+	{
+		uint32_t lineNumber;
+		uint32_t vertexCount;
+		bool hasNormals;
+		bool hasTexcoords;
+	};
+
+	uint64_t startIndex = 0;
+	uint64_t endIndex = 0;
+
+	std::vector<Vector3> vertices;
+	std::vector<Vector3> normals;
+	std::vector<Vector2> texcoords;
+	std::vector<Face> faces;
+	std::vector<int64_t> faceIndices;
+	std::vector<Directive> directives;
+	std::vector<std::pair<uint64_t, uint32_t>> materialRuns;
+
+	uint32_t lineCount = 0;
+	uint64_t triangleCount = 0;
+
+	// prefix sums over the preceding chunks
+	uint64_t lineOffset = 0;
+	uint64_t vertexOffset = 0;
+	uint64_t normalOffset = 0;
+	uint64_t texcoordOffset = 0;
+	uint64_t triangleOffset = 0;
+
+	bool failed = false;
+	std::string errorMessage;
+	uint32_t errorLineNumber = 0;
+	uint64_t validTriangleCount = 0;
+};
+
+ModelLoaderResult ModelLoader::load(const ModelLoaderInfo& info)
+{
+	currentMaterialId = info.defaultMaterialId;
+
+	Matrix4x4 scaling = Matrix4x4::scale(info.scale);
+	Matrix4x4 rotation = Matrix4x4::rotateXYZ(info.rotate);
+	Matrix4x4 translation = Matrix4x4::translate(info.translate);
+	transformation = translation * rotation * scaling;
+	transformationInvT = transformation.inverted().transposed();
+
+	vertices.clear();
+	normals.clear();
+	texcoords.clear();
+
+	materialsMap.clear();
+	externalMaterialsMap.clear();
+
+	if (StringUtils::endsWith(info.modelFileName, ".vmesh"))
+		return loadMesh(info);
+
+	if (StringUtils::endsWith(info.modelFileName, ".ply"))
+		return loadPly(info);
+
+	return loadObj(info);
+}
+
+ModelLoaderResult ModelLoader::loadObj(const ModelLoaderInfo& info)
+{
+	Log& log = App::getLog();
+
+	log.logInfo("Reading OBJ file %s(%s)", info.loadOnlyMaterials ? "(materials only) " : "", info.modelFileName);
+
+	Timer timer;
+	std::string rootDirectory = bf::absolute(info.modelFileName).parent_path().string();
+	ModelLoaderResult result;
+
+	bi::mapped_region mappedRegion;
+	uint64_t fileSize = 0;
+	const char* fileBuffer = mapFile(info.modelFileName, "OBJ", mappedRegion, fileSize);
+
+	uint64_t chunkCount = MAX(uint64_t(1), MIN(fileSize / MIN_CHUNK_SIZE, MAX(uint64_t(omp_get_max_threads()) * 4, fileSize / MAX_CHUNK_SIZE + 1)));
+	std::vector<Chunk> chunks(chunkCount);
+
+	// move the chunk boundaries to the next line starts
+	for (uint64_t i = 1; i < chunkCount; ++i)
+	{
+		uint64_t startIndex = MAX(chunks[i - 1].startIndex, fileSize * i / chunkCount);
+
+		while (startIndex > 0 && startIndex < fileSize && fileBuffer[startIndex - 1] != '\n' && fileBuffer[startIndex - 1] != '\r')
+			startIndex++;
+
+		chunks[i].startIndex = startIndex;
+		chunks[i - 1].endIndex = startIndex;
+	}
+
+	chunks.back().endIndex = fileSize;
+
+	for (const Chunk& chunk : chunks)
+	{
+		if (chunk.endIndex - chunk.startIndex > std::numeric_limits<uint32_t>::max())
+			throw std::runtime_error(tfm::format("Could not split OBJ file into parse chunks: a line is longer than the parse chunk (chunk size: %d bytes)", chunk.endIndex - chunk.startIndex));
+	}
+
+	if (info.substituteMaterial)
+		processMaterialFile(rootDirectory, info.substituteMaterialFileName, result);
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int64_t i = 0; i < int64_t(chunks.size()); ++i)
+		parseChunk(fileBuffer + chunks[i].startIndex, uint32_t(chunks[i].endIndex - chunks[i].startIndex), info, chunks[i]);
+
+	// the rest of the file after a malformed face is ignored
+	for (size_t i = 0; i < chunks.size(); ++i)
+	{
+		if (chunks[i].failed)
+		{
+			chunks.resize(i + 1);
+			break;
+		}
+	}
+
+	uint64_t lineCount = 0;
+	uint64_t vertexCount = 0;
+	uint64_t normalCount = 0;
+	uint64_t texcoordCount = 0;
+	uint64_t triangleCount = 0;
+
+	for (Chunk& chunk : chunks)
+	{
+		chunk.lineOffset = lineCount;
+		chunk.vertexOffset = vertexCount;
+		chunk.normalOffset = normalCount;
+		chunk.texcoordOffset = texcoordCount;
+		chunk.triangleOffset = triangleCount;
+
+		lineCount += chunk.lineCount;
+		vertexCount += chunk.vertices.size();
+		normalCount += chunk.normals.size();
+		texcoordCount += chunk.texcoords.size();
+		triangleCount += chunk.triangleCount;
+	}
+
+	// material files and selections are processed in the file order
+	for (Chunk& chunk : chunks)
+	{
+		chunk.materialRuns.emplace_back(0, currentMaterialId);
+
+		for (const Chunk::Directive& directive : chunk.directives)
+		{
+			if (directive.type == Chunk::DirectiveType::MTLLIB)
+				processMaterialFile(rootDirectory, directive.name, result);
+			else if (externalMaterialsMap.count(directive.name))
+				currentMaterialId = externalMaterialsMap[directive.name];
+			else if (materialsMap.count(directive.name))
+				currentMaterialId = materialsMap[directive.name];
+			else
+			{
+				log.logWarning("Could not find material named \"%s\"", directive.name);
+				currentMaterialId = info.defaultMaterialId;
+			}
+
+			if (chunk.materialRuns.back().first == directive.faceIndex)
+				chunk.materialRuns.back().second = currentMaterialId;
+			else
+				chunk.materialRuns.emplace_back(directive.faceIndex, currentMaterialId);
+		}
+	}
+
+	vertices.resize(vertexCount);
+	normals.resize(normalCount);
+	texcoords.resize(texcoordCount);
+	result.triangles.resize(triangleCount);
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int64_t i = 0; i < int64_t(chunks.size()); ++i)
+	{
+		Chunk& chunk = chunks[i];
+
+		std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertices.begin() + chunk.vertexOffset);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + chunk.normalOffset);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoordOffset);
+
+		std::vector<Vector3>().swap(chunk.vertices);
+		std::vector<Vector3>().swap(chunk.normals);
+		std::vector<Vector2>().swap(chunk.texcoords);
+	}
+
+	// faces can refer to any preceding chunk, so all the vertex data has to be merged first
+	#pragma omp parallel for schedule(dynamic)
+	for (int64_t i = 0; i < int64_t(chunks.size()); ++i)
+		processFaces(chunks[i], result);
+
+	for (const Chunk& chunk : chunks)
+	{
+		if (chunk.failed)
+		{
+			log.logWarning("%s (line: %s)", chunk.errorMessage, chunk.lineOffset + chunk.errorLineNumber);
+			result.triangles.resize(chunk.triangleOffset + chunk.validTriangleCount);
+			break;
+		}
+	}
+
+	log.logInfo("OBJ file reading finished (time: %s, chunks: %s, vertices: %s, normals: %s, texcoords: %s, triangles: %s, materials: %s, textures: %s)", timer.getElapsed().getString(true), chunks.size(), vertices.size(), normals.size(), texcoords.size(), result.triangles.size(), result.materials.size(), result.textures.size());
+
+	return result;
+}
+
+ModelLoaderResult ModelLoader::loadPly(const ModelLoaderInfo& info)
+{
+	Log& log = App::getLog();
+
+	log.logInfo("Reading PLY file %s(%s)", info.loadOnlyMaterials ? "(materials only) " : "", info.modelFileName);
+
+	Timer timer;
+	std::string rootDirectory = bf::absolute(info.modelFileName).parent_path().string();
+	ModelLoaderResult result;
+
+	if (info.substituteMaterial)
+		processMaterialFile(rootDirectory, info.substituteMaterialFileName, result);
+
+	if (info.loadOnlyMaterials)
+		return result;
+
+	bi::mapped_region mappedRegion;
+	uint64_t fileSize = 0;
+	const char* fileBuffer = mapFile(info.modelFileName, "PLY", mappedRegion, fileSize);
+
+	std::vector<PlyElement> elements;
+	uint64_t offset = parsePlyHeader(fileBuffer, fileSize, elements);
+	uint64_t invalidFaceCount = 0;
+
+	for (const PlyElement& element : elements)
+	{
+		if (element.name == "vertex")
+			offset = readPlyVertices(fileBuffer, fileSize, offset, element, transformation, transformationInvT, vertices, normals, texcoords);
+		else if (element.name == "face")
+			offset = readPlyFaces(fileBuffer, fileSize, offset, element, vertices, normals, texcoords, currentMaterialId, result.triangles, invalidFaceCount);
+		else
+			offset = skipPlyElement(fileBuffer, fileSize, offset, element);
+	}
+
+	if (invalidFaceCount > 0)
+		log.logWarning("PLY file has faces with too few vertices (%d)", invalidFaceCount);
+
+	log.logInfo("PLY file reading finished (time: %s, vertices: %s, normals: %s, texcoords: %s, triangles: %s)", timer.getElapsed().getString(true), vertices.size(), normals.size(), texcoords.size(), result.triangles.size());
+
+	return result;
+}
+
+ModelLoaderResult ModelLoader::loadMesh(const ModelLoaderInfo& info)
+{
+	Log& log = App::getLog();
+
+	log.logInfo("Reading mesh file %s(%s)", info.loadOnlyMaterials ? "(materials only) " : "", info.modelFileName);
+
+	Timer timer;
+	std::string rootDirectory = bf::absolute(info.modelFileName).parent_path().string();
+	ModelLoaderResult result;
+
+	bi::mapped_region mappedRegion;
+	uint64_t fileSize = 0;
+	const char* fileBuffer = mapFile(info.modelFileName, "mesh", mappedRegion, fileSize);
+	uint64_t offset = 0;
+
+	MeshFileHeader header;
+	memcpy(&header, readMeshData(fileBuffer, fileSize, offset, 1, sizeof(MeshFileHeader)), sizeof(MeshFileHeader));
+
+	if (memcmp(header.magic, "VMSH", 4) != 0)
+		throw std::runtime_error("Not a mesh file");
+
+	if (header.version != MESH_FILE_VERSION)
+		throw std::runtime_error(tfm::format("Unsupported mesh file version (%d)", header.version));
+
+	const float* meshVertices = reinterpret_cast<const float*>(readMeshData(fileBuffer, fileSize, offset, header.vertexCount, 3 * sizeof(float)));
+	const float* meshNormals = reinterpret_cast<const float*>(readMeshData(fileBuffer, fileSize, offset, header.normalCount, 3 * sizeof(float)));
+	const float* meshTexcoords = reinterpret_cast<const float*>(readMeshData(fileBuffer, fileSize, offset, header.texcoordCount, 2 * sizeof(float)));
+	const MeshFileTriangle* meshTriangles = reinterpret_cast<const MeshFileTriangle*>(readMeshData(fileBuffer, fileSize, offset, header.triangleCount, sizeof(MeshFileTriangle)));
+
+	if (info.substituteMaterial)
+		processMaterialFile(rootDirectory, info.substituteMaterialFileName, result);
+
+	std::map<uint32_t, uint32_t> textureIds;
+
+	for (uint64_t i = 0; i < header.textureCount; ++i)
+	{
+		MeshFileTexture meshTexture;
+		memcpy(&meshTexture, readMeshData(fileBuffer, fileSize, offset, 1, sizeof(MeshFileTexture)), sizeof(MeshFileTexture));
+		std::string fileName = readMeshString(fileBuffer, fileSize, offset, meshTexture.fileNameLength);
+
+		if (info.substituteMaterial)
+			continue;
+
+		Texture texture;
+		texture.type = TextureType::IMAGE;
+		texture.id = ++currentTextureId;
+		texture.imageTexture.imageFileName = bf::path(fileName).is_absolute() ? fileName : getAbsolutePath(rootDirectory, fileName);
+		texture.imageTexture.applyGamma = (meshTexture.applyGamma != 0);
+		texture.imageTexture.generateMipmaps = (meshTexture.generateMipmaps != 0);
+
+		textureIds[meshTexture.id] = texture.id;
+		result.textures.push_back(texture);
+	}
+
+	auto getTextureId = [&textureIds](uint32_t meshTextureId)
+	{
+		auto it = textureIds.find(meshTextureId);
+		return (it != textureIds.end()) ? it->second : 0;
+	};
+
+	std::vector<uint32_t> slotMaterialIds(header.materialCount, info.defaultMaterialId);
+
+	for (uint64_t i = 0; i < header.materialCount; ++i)
+	{
+		MeshFileMaterial meshMaterial;
+		memcpy(&meshMaterial, readMeshData(fileBuffer, fileSize, offset, 1, sizeof(MeshFileMaterial)), sizeof(MeshFileMaterial));
+		std::string materialName = readMeshString(fileBuffer, fileSize, offset, meshMaterial.nameLength);
+
+		if (info.substituteMaterial)
+		{
+			if (externalMaterialsMap.count(materialName))
+				slotMaterialIds[i] = externalMaterialsMap[materialName];
+			else if (materialsMap.count(materialName))
+				slotMaterialIds[i] = materialsMap[materialName];
+			else
+				log.logWarning("Could not find material named \"%s\"", materialName);
+
+			continue;
+		}
+
+		Material material;
+		material.id = ++materialIdCounter;
+		material.normalInterpolation = (meshMaterial.normalInterpolation != 0);
+		material.autoInvertNormal = (meshMaterial.autoInvertNormal != 0);
+		material.invertNormal = (meshMaterial.invertNormal != 0);
+		material.invisible = (meshMaterial.invisible != 0);
+		material.primaryRayInvisible = (meshMaterial.primaryRayInvisible != 0);
+		material.showEmittance = (meshMaterial.showEmittance != 0);
+		material.texcoordScale = Vector2(meshMaterial.texcoordScale[0], meshMaterial.texcoordScale[1]);
+		material.emittance = Color(meshMaterial.emittance[0], meshMaterial.emittance[1], meshMaterial.emittance[2]);
+		material.emittanceTextureId = getTextureId(meshMaterial.emittanceTextureId);
+		material.reflectance = Color(meshMaterial.reflectance[0], meshMaterial.reflectance[1], meshMaterial.reflectance[2]);
+		material.reflectanceTextureId = getTextureId(meshMaterial.reflectanceTextureId);
+		material.normalTextureId = getTextureId(meshMaterial.normalTextureId);
+		material.maskTextureId = getTextureId(meshMaterial.maskTextureId);
+
+		materialsMap[materialName] = material.id;
+		slotMaterialIds[i] = material.id;
+
+		if (meshMaterial.externalId != 0)
+		{
+			externalMaterialsMap[materialName] = meshMaterial.externalId;
+			slotMaterialIds[i] = meshMaterial.externalId;
+		}
+
+		result.materials.push_back(material);
+	}
+
+	if (!info.loadOnlyMaterials)
+	{
+		vertices.resize(header.vertexCount);
+		normals.resize(header.normalCount);
+
+		#pragma omp parallel for
+		for (int64_t i = 0; i < int64_t(header.vertexCount); ++i)
+			vertices[i] = transformation.transformPosition(Vector3(meshVertices[i * 3], meshVertices[i * 3 + 1], meshVertices[i * 3 + 2]));
+
+		#pragma omp parallel for
+		for (int64_t i = 0; i < int64_t(header.normalCount); ++i)
+			normals[i] = transformationInvT.transformDirection(Vector3(meshNormals[i * 3], meshNormals[i * 3 + 1], meshNormals[i * 3 + 2])).normalized();
+
+		result.triangles.resize(header.triangleCount);
+		uint64_t invalidTriangleCount = 0;
+
+		#pragma omp parallel for reduction(+:invalidTriangleCount)
+		for (int64_t i = 0; i < int64_t(header.triangleCount); ++i)
+		{
+			const MeshFileTriangle& meshTriangle = meshTriangles[i];
+			Triangle& triangle = result.triangles[i];
+
+			if (meshTriangle.materialSlot != NO_MATERIAL_SLOT && meshTriangle.materialSlot >= header.materialCount)
+			{
+				invalidTriangleCount++;
+				continue;
+			}
+
+			triangle.materialId = (meshTriangle.materialSlot != NO_MATERIAL_SLOT) ? slotMaterialIds[meshTriangle.materialSlot] : info.defaultMaterialId;
+
+			for (uint32_t j = 0; j < 3; ++j)
+			{
+				if (meshTriangle.vertexIndices[j] >= header.vertexCount || meshTriangle.normalIndices[j] >= header.normalCount || meshTriangle.texcoordIndices[j] >= header.texcoordCount)
+				{
+					invalidTriangleCount++;
+					break;
+				}
+
+				uint32_t texcoordIndex = meshTriangle.texcoordIndices[j];
+
+				triangle.vertices[j] = vertices[meshTriangle.vertexIndices[j]];
+				triangle.normals[j] = normals[meshTriangle.normalIndices[j]];
+				triangle.texcoords[j] = Vector2(meshTexcoords[texcoordIndex * 2], meshTexcoords[texcoordIndex * 2 + 1]);
+			}
+		}
+
+		if (invalidTriangleCount > 0)
+			throw std::runtime_error(tfm::format("Mesh file has invalid triangles (%d)", invalidTriangleCount));
+	}
+
+	log.logInfo("Mesh file reading finished (time: %s, vertices: %s, normals: %s, texcoords: %s, triangles: %s, materials: %s, textures: %s)", timer.getElapsed().getString(true), vertices.size(), normals.size(), header.texcoordCount, result.triangles.size(), result.materials.size(), result.textures.size());
+
+	return result;
+}
+
+void ModelLoader::convert(const std::string& modelFileName, const std::string& meshFileName)
+{
+	Log& log = App::getLog();
+
+	ModelLoaderInfo info;
+	info.modelFileName = modelFileName;
+	info.defaultMaterialId = NO_MATERIAL_SLOT;
+
+	ModelLoaderResult result = load(info);
+
+	log.logInfo("Writing mesh file (%s)", meshFileName);
+
+	Timer timer;
+
+	// triangles refer to the materials by slot so that the ids can be reassigned when loading
+	std::map<uint32_t, std::string> materialNames;
+	std::map<uint32_t, uint32_t> materialSlots;
+	std::vector<uint32_t> externalIds(result.materials.size(), 0);
+
+	for (const auto& material : materialsMap)
+		materialNames[material.second] = material.first;
+
+	for (uint32_t i = 0; i < uint32_t(result.materials.size()); ++i)
+	{
+		const std::string& materialName = materialNames[result.materials[i].id];
+
+		if (externalMaterialsMap.count(materialName))
+			externalIds[i] = externalMaterialsMap[materialName];
+
+		materialSlots.emplace(result.materials[i].id, i);
+
+		if (externalIds[i] != 0)
+			materialSlots.emplace(externalIds[i], i);
+	}
+
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> vertexMap;
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> normalMap;
+	std::unordered_map<VertexKey, uint32_t, VertexKeyHash> texcoordMap;
+
+	std::vector<float> meshVertices;
+	std::vector<float> meshNormals;
+	std::vector<float> meshTexcoords;
+	std::vector<MeshFileTriangle> meshTriangles(result.triangles.size());
+
+	for (size_t i = 0; i < result.triangles.size(); ++i)
+	{
+		const Triangle& triangle = result.triangles[i];
+		MeshFileTriangle& meshTriangle = meshTriangles[i];
+
+		for (uint32_t j = 0; j < 3; ++j)
+		{
+			float vertex[3] = { triangle.vertices[j].x, triangle.vertices[j].y, triangle.vertices[j].z };
+			float normal[3] = { triangle.normals[j].x, triangle.normals[j].y, triangle.normals[j].z };
+			float texcoord[2] = { triangle.texcoords[j].x, triangle.texcoords[j].y };
+
+			meshTriangle.vertexIndices[j] = addUniqueVertex(vertexMap, meshVertices, vertex, 3);
+			meshTriangle.normalIndices[j] = addUniqueVertex(normalMap, meshNormals, normal, 3);
+			meshTriangle.texcoordIndices[j] = addUniqueVertex(texcoordMap, meshTexcoords, texcoord, 2);
+		}
+
+		auto it = materialSlots.find(triangle.materialId);
+		meshTriangle.materialSlot = (it != materialSlots.end()) ? it->second : NO_MATERIAL_SLOT;
+	}
+
+	MeshFileHeader header;
+	memcpy(header.magic, "VMSH", 4);
+	header.version = MESH_FILE_VERSION;
+	header.flags = 0;
+	header.reserved = 0;
+	header.vertexCount = vertexMap.size();
+	header.normalCount = normalMap.size();
+	header.texcoordCount = texcoordMap.size();
+	header.triangleCount = meshTriangles.size();
+	header.textureCount = result.textures.size();
+	header.materialCount = result.materials.size();
+
+	std::ofstream file(meshFileName, std::ios::out | std::ios::binary);
+
+	if (!file.good())
+		throw std::runtime_error(tfm::format("Could not open the mesh file for writing"));
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(MeshFileHeader));
+	file.write(reinterpret_cast<const char*>(meshVertices.data()), meshVertices.size() * sizeof(float));
+	file.write(reinterpret_cast<const char*>(meshNormals.data()), meshNormals.size() * sizeof(float));
+	file.write(reinterpret_cast<const char*>(meshTexcoords.data()), meshTexcoords.size() * sizeof(float));
+	file.write(reinterpret_cast<const char*>(meshTriangles.data()), meshTriangles.size() * sizeof(MeshFileTriangle));
+
+	bf::path meshDirectory = bf::absolute(meshFileName).parent_path();
+
+	for (const Texture& texture : result.textures)
+	{
+		std::string fileName = bf::path(texture.imageTexture.imageFileName).lexically_relative(meshDirectory).generic_string();
+
+		if (fileName.empty())
+			fileName = texture.imageTexture.imageFileName;
+
+		MeshFileTexture meshTexture;
+		meshTexture.id = texture.id;
+		meshTexture.applyGamma = texture.imageTexture.applyGamma;
+		meshTexture.generateMipmaps = texture.imageTexture.generateMipmaps;
+		meshTexture.fileNameLength = uint32_t(fileName.size());
+
+		file.write(reinterpret_cast<const char*>(&meshTexture), sizeof(MeshFileTexture));
+		writeMeshString(file, fileName);
+	}
+
+	for (uint32_t i = 0; i < uint32_t(result.materials.size()); ++i)
+	{
+		const Material& material = result.materials[i];
+		const std::string& materialName = materialNames[material.id];
+
+		MeshFileMaterial meshMaterial;
+		meshMaterial.id = material.id;
+		meshMaterial.externalId = externalIds[i];
+		meshMaterial.normalInterpolation = material.normalInterpolation;
+		meshMaterial.autoInvertNormal = material.autoInvertNormal;
+		meshMaterial.invertNormal = material.invertNormal;
+		meshMaterial.invisible = material.invisible;
+		meshMaterial.primaryRayInvisible = material.primaryRayInvisible;
+		meshMaterial.showEmittance = material.showEmittance;
+		meshMaterial.texcoordScale[0] = material.texcoordScale.x;
+		meshMaterial.texcoordScale[1] = material.texcoordScale.y;
+		meshMaterial.emittance[0] = material.emittance.r;
+		meshMaterial.emittance[1] = material.emittance.g;
+		meshMaterial.emittance[2] = material.emittance.b;
+		meshMaterial.emittanceTextureId = material.emittanceTextureId;
+		meshMaterial.reflectance[0] = material.reflectance.r;
+		meshMaterial.reflectance[1] = material.reflectance.g;
+		meshMaterial.reflectance[2] = material.reflectance.b;
+		meshMaterial.reflectanceTextureId = material.reflectanceTextureId;
+		meshMaterial.normalTextureId = material.normalTextureId;
+		meshMaterial.maskTextureId = material.maskTextureId;
+		meshMaterial.nameLength = uint32_t(materialName.size());
+
+		file.write(reinterpret_cast<const char*>(&meshMaterial), sizeof(MeshFileMaterial));
+		writeMeshString(file, materialName);
+	}
+
+	file.close();
+
+	if (file.fail())
+		throw std::runtime_error(tfm::format("Could not write the mesh file"));
+
+	log.logInfo("Mesh file writing finished (time: %s, vertices: %s, normals: %s, texcoords: %s, triangles: %s, size: %sB)", timer.getElapsed().getString(true), header.vertexCount, header.normalCount, header.texcoordCount, header.triangleCount, StringUtils::humanizeNumber(double(bf::file_size(meshFileName)), true));
+}
+
+void ModelLoader::processMaterialFile(const std::string& rootDirectory, const std::string& mtlFileName, ModelLoaderResult& result)
+{
+	std::string absoluteMtlFileName = getAbsolutePath(rootDirectory, mtlFileName);
+	App::getLog().logInfo("Reading MTL file (%s)", absoluteMtlFileName);
+	std::ifstream file(absoluteMtlFileName);
+
+	if (!file.good())
+		throw std::runtime_error("Could not open the MTL file");
+
+	Material currentMaterial;
+	bool materialPending = false;
+
+	std::string line;
+	std::string part;
+	std::string currentMaterialName;
+
+	while (std::getline(file, line))
+	{
+		std::stringstream ss(line);
+		ss >> part;
+
+		if (part == "newmtl") // new material
+		{
+			if (materialPending)
+				result.materials.push_back(currentMaterial);
+
+			materialPending = true;
+			currentMaterialId = ++materialIdCounter;
+
+			currentMaterial = Material();
+			currentMaterial.id = currentMaterialId;
+
+			ss >> currentMaterialName;
+			materialsMap[currentMaterialName] = currentMaterialId;
+		}
+		else if (part == "materialId")
+			ss >> externalMaterialsMap[currentMaterialName];
+		else if (part == "normalInterpolation")
+			ss >> currentMaterial.normalInterpolation;
+		else if (part == "autoInvertNormal")
+			ss >> currentMaterial.autoInvertNormal;
+		else if (part == "invertNormal")
+			ss >> currentMaterial.invertNormal;
+		else if (part == "invisible")
+			ss >> currentMaterial.invisible;
+		else if (part == "primaryRayInvisible")
+			ss >> currentMaterial.primaryRayInvisible;
+		else if (part == "showEmittance")
+			ss >> currentMaterial.showEmittance;
+		else if (part == "texcoordScale")
+		{
+			ss >> currentMaterial.texcoordScale.x;
+			ss >> currentMaterial.texcoordScale.y;
+		}
+		else if (part == "emittance" || part == "Ke")
+		{
+			ss >> currentMaterial.emittance.r;
+			ss >> currentMaterial.emittance.g;
+			ss >> currentMaterial.emittance.b;
+		}
+		else if ((part == "emittanceMap" || part == "map_Ke") && currentMaterial.emittanceTextureId == 0)
+		{
+			Texture texture;
+			texture.type = TextureType::IMAGE;
+			texture.id = ++currentTextureId;
+			currentMaterial.emittanceTextureId = texture.id;
+
+			ss >> part;
+			texture.imageTexture.imageFileName = getAbsolutePath(rootDirectory, part);
+			texture.imageTexture.applyGamma = !StringUtils::endsWith(texture.imageTexture.imageFileName, ".hdr");
+
+			result.textures.push_back(texture);
+		}
+		else if (part == "reflectance" || part == "Kr" || part == "Kd")
+		{
+			ss >> currentMaterial.reflectance.r;
+			ss >> currentMaterial.reflectance.g;
+			ss >> currentMaterial.reflectance.b;
+		}
+		else if ((part == "reflectanceMap" || part == "map_Kr" || part == "map_Kd") && currentMaterial.reflectanceTextureId == 0)
+		{
+			Texture texture;
+			texture.type = TextureType::IMAGE;
+			texture.id = ++currentTextureId;
+			currentMaterial.reflectanceTextureId = texture.id;
+
+			ss >> part;
+			texture.imageTexture.imageFileName = getAbsolutePath(rootDirectory, part);
+			texture.imageTexture.applyGamma = !StringUtils::endsWith(texture.imageTexture.imageFileName, ".hdr");
+
+			result.textures.push_back(texture);
+		}
+		else if ((part == "normalMap" || part == "map_normal") && currentMaterial.normalTextureId == 0)
 		{
 			Texture texture;
 			texture.type = TextureType::IMAGE;
@@ -511,125 +1538,231 @@ void ModelLoader::processMaterialFile(const std::string& rootDirectory, const st
 		result.materials.push_back(currentMaterial);
 }
 
-bool ModelLoader::processFace(const char* buffer, uint32_t lineStartIndex, uint32_t lineEndIndex, uint32_t lineNumber, ModelLoaderResult& result)
+void ModelLoader::parseChunk(const char* buffer, uint32_t bufferLength, const ModelLoaderInfo& info, Chunk& chunk)
 {
-	Log& log = App::getLog();
-
-	uint32_t vertexIndices[4];
-	uint32_t normalIndices[4];
-	uint32_t texcoordIndices[4];
-	uint32_t vertexCount = 0;
-
-	bool hasNormals = false;
-	bool hasTexcoords = false;
-
-	uint32_t wordStartIndex = lineStartIndex;
-	uint32_t wordEndIndex = 0;
+	uint32_t lineStartIndex = 0;
+	uint32_t lineEndIndex = 0;
 
-	for (uint32_t i = 0; i < 4; ++i)
+	while (getLine(buffer, bufferLength, lineStartIndex, lineEndIndex))
 	{
-		if (!getWord(buffer, lineEndIndex, wordStartIndex, wordEndIndex))
-			break;
+		chunk.lineCount++;
 
-		if (i == 0)
-			checkIndices(buffer, wordStartIndex, wordEndIndex, hasNormals, hasTexcoords);
+		uint32_t wordStartIndex = lineStartIndex;
+		uint32_t wordEndIndex = 0;
 
-		vertexCount++;
+		getWord(buffer, lineEndIndex, wordStartIndex, wordEndIndex);
 
-		int32_t vertexIndex;
-		int32_t texcoordIndex;
-		int32_t normalIndex;
+		if (!info.loadOnlyMaterials)
+		{
+			if (compareWord(buffer, wordStartIndex, wordEndIndex, "f")) // face
+			{
+				if (!parseFace(buffer, lineStartIndex + 2, lineEndIndex, chunk))
+					break;
+			}
+			else if (compareWord(buffer, wordStartIndex, wordEndIndex, "v")) // vertex
+			{
+				Vector3 vertex;
+				wordStartIndex += 2;
 
-		getIndices(buffer, wordStartIndex, wordEndIndex, hasNormals, hasTexcoords, vertexIndex, normalIndex, texcoordIndex);
+				vertex.x = getFloat(buffer, wordStartIndex, lineEndIndex);
+				vertex.y = getFloat(buffer, wordStartIndex, lineEndIndex);
+				vertex.z = getFloat(buffer, wordStartIndex, lineEndIndex);
 
-		if (vertexIndex < 0)
-			vertexIndex = int32_t(vertices.size()) + vertexIndex;
-		else
-			vertexIndex--;
+				chunk.vertices.push_back(transformation.transformPosition(vertex));
+			}
+			else if (compareWord(buffer, wordStartIndex, wordEndIndex, "vn")) // normal
+			{
+				Vector3 normal;
+				wordStartIndex += 3;
 
-		if (vertexIndex < 0 || vertexIndex >= int32_t(vertices.size()))
-		{
-			log.logWarning("Vertex index (%s) was out of bounds (line: %s)", vertexIndex, lineNumber);
-			return false;
-		}
+				normal.x = getFloat(buffer, wordStartIndex, lineEndIndex);
+				normal.y = getFloat(buffer, wordStartIndex, lineEndIndex);
+				normal.z = getFloat(buffer, wordStartIndex, lineEndIndex);
 
-		vertexIndices[i] = uint32_t(vertexIndex);
+				chunk.normals.push_back(transformationInvT.transformDirection(normal).normalized());
+			}
+			else if (compareWord(buffer, wordStartIndex, wordEndIndex, "vt")) // texcoord
+			{
+				Vector2 texcoord;
+				wordStartIndex += 3;
 
-		if (hasTexcoords)
-		{
-			if (texcoordIndex < 0)
-				texcoordIndex = int32_t(texcoords.size()) + texcoordIndex;
-			else
-				texcoordIndex--;
+				texcoord.x = getFloat(buffer, wordStartIndex, lineEndIndex);
+				texcoord.y = getFloat(buffer, wordStartIndex, lineEndIndex);
 
-			if (texcoordIndex < 0 || texcoordIndex >= int32_t(texcoords.size()))
-			{
-				log.logWarning("Texcoord index (%s) was out of bounds (line: %s)", texcoordIndex, lineNumber);
-				return false;
+				chunk.texcoords.push_back(texcoord);
 			}
+			else if (compareWord(buffer, wordStartIndex, wordEndIndex, "usemtl")) // select material
+			{
+				wordStartIndex = wordEndIndex;
+				getWord(buffer, lineEndIndex, wordStartIndex, wordEndIndex);
 
-			texcoordIndices[i] = uint32_t(texcoordIndex);
+				Chunk::Directive directive;
+				directive.type = Chunk::DirectiveType::USEMTL;
+				directive.name = std::string(buffer + wordStartIndex, wordEndIndex - wordStartIndex);
+				directive.faceIndex = chunk.faces.size();
+
+				chunk.directives.push_back(directive);
+			}
 		}
 
-		if (hasNormals)
+		if (!info.substituteMaterial && compareWord(buffer, wordStartIndex, wordEndIndex, "mtllib")) // new material file
 		{
-			if (normalIndex < 0)
-				normalIndex = int32_t(normals.size()) + normalIndex;
-			else
-				normalIndex--;
+			wordStartIndex = wordEndIndex;
+			getWord(buffer, lineEndIndex, wordStartIndex, wordEndIndex);
 
-			if (normalIndex < 0 || normalIndex >= int32_t(normals.size()))
-			{
-				log.logWarning("Normal index (%s) was out of bounds (line: %s)", normalIndex, lineNumber);
-				return false;
-			}
+			Chunk::Directive directive;
+			directive.type = Chunk::DirectiveType::MTLLIB;
+			directive.name = std::string(buffer + wordStartIndex, wordEndIndex - wordStartIndex);
+			directive.faceIndex = chunk.faces.size();
 
-			normalIndices[i] = uint32_t(normalIndex);
+			chunk.directives.push_back(directive);
 		}
 
+		lineStartIndex = lineEndIndex;
+	}
+}
+
+bool ModelLoader::parseFace(const char* buffer, uint32_t lineStartIndex, uint32_t lineEndIndex, Chunk& chunk)
+{
+	Chunk::Face face;
+	face.lineNumber = chunk.lineCount;
+	face.vertexCount = 0;
+	face.hasNormals = false;
+	face.hasTexcoords = false;
+
+	uint32_t wordStartIndex = lineStartIndex;
+	uint32_t wordEndIndex = 0;
+
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (!getWord(buffer, lineEndIndex, wordStartIndex, wordEndIndex))
+			break;
+
+		if (i == 0)
+			checkIndices(buffer, wordStartIndex, wordEndIndex, face.hasNormals, face.hasTexcoords);
+
+		face.vertexCount++;
+
+		int32_t vertexIndex = 0;
+		int32_t texcoordIndex = 0;
+		int32_t normalIndex = 0;
+
+		getIndices(buffer, wordStartIndex, wordEndIndex, face.hasNormals, face.hasTexcoords, vertexIndex, normalIndex, texcoordIndex);
+
+		chunk.faceIndices.push_back(encodeIndex(vertexIndex, chunk.vertices.size()));
+
+		if (face.hasTexcoords)
+			chunk.faceIndices.push_back(encodeIndex(texcoordIndex, chunk.texcoords.size()));
+
+		if (face.hasNormals)
+			chunk.faceIndices.push_back(encodeIndex(normalIndex, chunk.normals.size()));
+
 		wordStartIndex = wordEndIndex;
 	}
 
-	if (vertexCount < 3)
+	if (face.vertexCount < 3)
 	{
-		log.logWarning("Too few vertices (%s) in a face (line: %s)", vertexCount, lineNumber);
+		chunk.failed = true;
+		chunk.errorMessage = tfm::format("Too few vertices (%s) in a face", face.vertexCount);
+		chunk.errorLineNumber = face.lineNumber;
+
 		return false;
 	}
 
-	// triangulate
-	for (uint32_t i = 2; i < vertexCount; ++i)
-	{
-		Triangle triangle;
-		triangle.materialId = currentMaterialId;
+	chunk.faces.push_back(face);
+	chunk.triangleCount += face.vertexCount - 2;
+
+	return true;
+}
 
-		triangle.vertices[0] = vertices[vertexIndices[0]];
-		triangle.vertices[1] = vertices[vertexIndices[i - 1]];
-		triangle.vertices[2] = vertices[vertexIndices[i]];
+void ModelLoader::processFaces(Chunk& chunk, ModelLoaderResult& result)
+{
+	auto resolveIndex = [&chunk](int64_t encodedIndex, uint64_t chunkOffset, uint64_t count, const char* name, uint32_t lineNumber, uint64_t& index)
+	{
+		int64_t decodedIndex = decodeIndex(encodedIndex, chunkOffset);
 
-		if (hasNormals)
+		if (decodedIndex < 0 || decodedIndex >= int64_t(count))
 		{
-			triangle.normals[0] = normals[normalIndices[0]];
-			triangle.normals[1] = normals[normalIndices[i - 1]];
-			triangle.normals[2] = normals[normalIndices[i]];
+			chunk.failed = true;
+			chunk.errorMessage = tfm::format("%s index (%s) was out of bounds", name, decodedIndex);
+			chunk.errorLineNumber = lineNumber;
+
+			return false;
 		}
-		else
+
+		index = uint64_t(decodedIndex);
+		return true;
+	};
+
+	uint64_t vertexIndices[4];
+	uint64_t normalIndices[4];
+	uint64_t texcoordIndices[4];
+
+	uint64_t faceIndicesIndex = 0;
+	uint64_t triangleIndex = 0;
+	size_t materialRunIndex = 0;
+
+	for (uint64_t faceIndex = 0; faceIndex < chunk.faces.size(); ++faceIndex)
+	{
+		const Chunk::Face& face = chunk.faces[faceIndex];
+
+		while (materialRunIndex + 1 < chunk.materialRuns.size() && chunk.materialRuns[materialRunIndex + 1].first <= faceIndex)
+			materialRunIndex++;
+
+		for (uint32_t i = 0; i < face.vertexCount; ++i)
 		{
-			Vector3 v0tov1 = triangle.vertices[1] - triangle.vertices[0];
-			Vector3 v0tov2 = triangle.vertices[2] - triangle.vertices[0];
-			Vector3 normal = v0tov1.cross(v0tov2).normalized();
+			if (!resolveIndex(chunk.faceIndices[faceIndicesIndex++], chunk.vertexOffset, vertices.size(), "Vertex", face.lineNumber, vertexIndices[i]))
+			{
+				chunk.validTriangleCount = triangleIndex;
+				return;
+			}
 
-			triangle.normals[0] = triangle.normals[1] = triangle.normals[2] = normal;
+			if (face.hasTexcoords && !resolveIndex(chunk.faceIndices[faceIndicesIndex++], chunk.texcoordOffset, texcoords.size(), "Texcoord", face.lineNumber, texcoordIndices[i]))
+			{
+				chunk.validTriangleCount = triangleIndex;
+				return;
+			}
+
+			if (face.hasNormals && !resolveIndex(chunk.faceIndices[faceIndicesIndex++], chunk.normalOffset, normals.size(), "Normal", face.lineNumber, normalIndices[i]))
+			{
+				chunk.validTriangleCount = triangleIndex;
+				return;
+			}
 		}
 
-		if (hasTexcoords)
+		// triangulate
+		for (uint32_t i = 2; i < face.vertexCount; ++i)
 		{
-			triangle.texcoords[0] = texcoords[texcoordIndices[0]];
-			triangle.texcoords[1] = texcoords[texcoordIndices[i - 1]];
-			triangle.texcoords[2] = texcoords[texcoordIndices[i]];
-		}
+			Triangle& triangle = result.triangles[chunk.triangleOffset + triangleIndex++];
+			triangle.materialId = chunk.materialRuns[materialRunIndex].second;
+
+			triangle.vertices[0] = vertices[vertexIndices[0]];
+			triangle.vertices[1] = vertices[vertexIndices[i - 1]];
+			triangle.vertices[2] = vertices[vertexIndices[i]];
+
+			if (face.hasNormals)
+			{
+				triangle.normals[0] = normals[normalIndices[0]];
+				triangle.normals[1] = normals[normalIndices[i - 1]];
+				triangle.normals[2] = normals[normalIndices[i]];
+			}
+			else
+			{
+				Vector3 v0tov1 = triangle.vertices[1] - triangle.vertices[0];
+				Vector3 v0tov2 = triangle.vertices[2] - triangle.vertices[0];
+				Vector3 normal = v0tov1.cross(v0tov2).normalized();
+
+				triangle.normals[0] = triangle.normals[1] = triangle.normals[2] = normal;
+			}
 
-		result.triangles.push_back(triangle);
+			if (face.hasTexcoords)
+			{
+				triangle.texcoords[0] = texcoords[texcoordIndices[0]];
+				triangle.texcoords[1] = texcoords[texcoordIndices[i - 1]];
+				triangle.texcoords[2] = texcoords[texcoordIndices[i]];
+			}
+		}
 	}
 
-	return true;
+	chunk.validTriangleCount = triangleIndex;
 }
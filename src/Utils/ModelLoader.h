@@ -9,15 +9,37 @@
 #include "Core/Triangle.h"
 #include "Materials/Material.h"
 #include "Math/EulerAngle.h"
+#include "Math/Matrix4x4.h"
 #include "Math/Vector3.h"
 #include "Textures/Texture.h"
 
 /*
 
-Only OBJ (and MTL) files are supported.
+OBJ (and MTL) files, binary little endian PLY files and Valo binary mesh files (.vmesh) are supported.
 
-Restrictions:
- - numbers cannot have scientific notation
+The OBJ file is memory mapped and split into line aligned chunks that are parsed in parallel.
+The per-chunk results are merged with prefix sums over their counts. Negative indices and the
+usemtl state are resolved as if the file was read from start to end.
+
+The PLY vertex element is decoded in parallel and the faces are triangulated straight from the
+mapped file. Positions, normals (nx, ny, nz) and texcoords (u/v, s/t or texture_u/texture_v) are
+read from the vertex element and vertex_indices from the face element, other elements and
+properties are skipped. PLY files have no materials, the triangles get the default material or
+the last material of the substitute material file.
+
+The binary mesh file is created with convert. It holds indexed positions, normals and texcoords,
+a material slot per triangle and the material and texture tables of the source model. Texture
+file names are stored relative to the mesh file. The file is memory mapped and the triangles are
+built directly from the mapped data. All values are little endian.
+
+Binary mesh file layout:
+ - header (magic "VMSH", version, counts)
+ - positions (3 x float per vertex)
+ - normals (3 x float per normal)
+ - texcoords (2 x float per texcoord)
+ - triangles (3 x uint32 position, normal and texcoord indices, uint32 material slot)
+ - textures (id, gamma and mipmap flags, file name)
+ - materials (id, external id, parameters, name)
 
 */
 
@@ -48,16 +70,28 @@ namespace Valo
 	public:
 
 		ModelLoaderResult load(const ModelLoaderInfo& info);
+		void convert(const std::string& modelFileName, const std::string& meshFileName);
 
 	private:
 
+		struct Chunk;
+
+		ModelLoaderResult loadObj(const ModelLoaderInfo& info);
+		ModelLoaderResult loadPly(const ModelLoaderInfo& info);
+		ModelLoaderResult loadMesh(const ModelLoaderInfo& info);
+
 		void processMaterialFile(const std::string& rootDirectory, const std::string& mtlFileName, ModelLoaderResult& result);
-		bool processFace(const char* buffer, uint32_t lineStartIndex, uint32_t lineEndIndex, uint32_t lineNumber, ModelLoaderResult& result);
+		void parseChunk(const char* buffer, uint32_t bufferLength, const ModelLoaderInfo& info, Chunk& chunk);
+		bool parseFace(const char* buffer, uint32_t lineStartIndex, uint32_t lineEndIndex, Chunk& chunk);
+		void processFaces(Chunk& chunk, ModelLoaderResult& result);
 
 		uint32_t currentMaterialId = 0;
 		uint32_t materialIdCounter = 1000;
 		uint32_t currentTextureId = 1000;
 
+		Matrix4x4 transformation;
+		Matrix4x4 transformationInvT;
+
 		std::vector<Vector3> vertices;
 		std::vector<Vector3> normals;
 		std::vector<Vector2> texcoords;
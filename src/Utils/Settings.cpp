@@ -22,11 +22,17 @@ bool Settings::load(int argc, char** argv)
 		("general.windowed", po::value(&general.windowed)->default_value(true), "")
 		("general.maxCpuThreadCount", po::value(&general.maxCpuThreadCount)->default_value(0), "")
 		("general.cudaDeviceNumber", po::value(&general.cudaDeviceNumber)->default_value(0), "")
+		("general.logFileName", po::value(&general.logFileName)->default_value("valo.log"), "")
 
 		("renderer.type", po::value(&renderer.type)->default_value(0), "")
 		("renderer.skip", po::value(&renderer.skip)->default_value(false), "")
 		("renderer.imageSamples", po::value(&renderer.imageSamples)->default_value(1), "")
 		("renderer.pixelSamples", po::value(&renderer.pixelSamples)->default_value(1), "")
+		("renderer.regionX", po::value(&renderer.regionX)->default_value(0), "")
+		("renderer.regionY", po::value(&renderer.regionY)->default_value(0), "")
+		("renderer.regionWidth", po::value(&renderer.regionWidth)->default_value(0), "")
+		("renderer.regionHeight", po::value(&renderer.regionHeight)->default_value(0), "")
+		("renderer.bucketSize", po::value(&renderer.bucketSize)->default_value(64), "")
 
 		("window.width", po::value(&window.width)->default_value(1280), "")
 		("window.height", po::value(&window.height)->default_value(800), "")
@@ -34,6 +40,11 @@ bool Settings::load(int argc, char** argv)
 		("window.vsync", po::value(&window.vsync)->default_value(false), "")
 		("window.hideCursor", po::value(&window.hideCursor)->default_value(false), "")
 		("window.renderScale", po::value(&window.renderScale)->default_value(0.25f), "")
+		("window.dynamicRenderScale", po::value(&window.dynamicRenderScale)->default_value(false), "")
+		("window.minRenderScale", po::value(&window.minRenderScale)->default_value(0.05f), "")
+		("window.targetFrameTime", po::value(&window.targetFrameTime)->default_value(33.0f), "")
+		("window.temporalReprojection", po::value(&window.temporalReprojection)->default_value(false), "")
+		("window.reprojectionWeight", po::value(&window.reprojectionWeight)->default_value(4.0f), "")
 		("window.infoPanelState", po::value(&window.infoPanelState)->default_value(2), "")
 		("window.infoPanelFontSize", po::value(&window.infoPanelFontSize)->default_value(18), "")
 		("window.checkGLErrors", po::value(&window.checkGLErrors)->default_value(true), "")
@@ -41,6 +52,10 @@ bool Settings::load(int argc, char** argv)
 		("scene.fileName", po::value(&scene.fileName)->default_value("scene.xml"), "")
 		("scene.useTestScene", po::value(&scene.useTestScene)->default_value(true), "")
 		("scene.testSceneNumber", po::value(&scene.testSceneNumber)->default_value(1), "")
+		("scene.saveFileName", po::value(&scene.saveFileName)->default_value(""), "")
+		("scene.textureCache", po::value(&scene.textureCache)->default_value(false), "")
+		("scene.textureCacheSize", po::value(&scene.textureCacheSize)->default_value(512), "")
+		("scene.textureCacheDirName", po::value(&scene.textureCacheDirName)->default_value("texture_cache"), "")
 
 		("image.width", po::value(&image.width)->default_value(1280), "")
 		("image.height", po::value(&image.height)->default_value(800), "")
@@ -60,16 +75,39 @@ bool Settings::load(int argc, char** argv)
 		("film.autoView", po::value(&film.autoView)->default_value(true), "")
 		("film.autoWrite", po::value(&film.autoWrite)->default_value(false), "")
 		("film.autoWriteInterval", po::value(&film.autoWriteInterval)->default_value(60.0f), "")
-		("film.autoWriteFileName", po::value(&film.autoWriteFileName)->default_value("temp_film.bin"), "");
+		("film.autoWriteFileName", po::value(&film.autoWriteFileName)->default_value("temp_film.bin"), "")
+		("film.journalFileName", po::value(&film.journalFileName)->default_value("temp_film.journal"), "")
+		("film.resume", po::value(&film.resume)->default_value(false), "")
+		("film.compactAccumulation", po::value(&film.compactAccumulation)->default_value(false), "")
+
+		("coordinator.enabled", po::value(&coordinator.enabled)->default_value(false), "")
+		("coordinator.port", po::value(&coordinator.port)->default_value(50500), "")
+		("coordinator.localWorkers", po::value(&coordinator.localWorkers)->default_value(0), "")
+		("coordinator.unitType", po::value(&coordinator.unitType)->default_value(0), "")
+		("coordinator.unitSize", po::value(&coordinator.unitSize)->default_value(128), "")
+		("coordinator.reissueStragglers", po::value(&coordinator.reissueStragglers)->default_value(true), "")
+
+		("worker.enabled", po::value(&worker.enabled)->default_value(false), "")
+		("worker.address", po::value(&worker.address)->default_value("localhost"), "")
+		("worker.port", po::value(&worker.port)->default_value(50500), "")
+
+		("convert.enabled", po::value(&convert.enabled)->default_value(false), "")
+		("convert.inputFileName", po::value(&convert.inputFileName)->default_value("model.obj"), "")
+		("convert.outputFileName", po::value(&convert.outputFileName)->default_value("model.vmesh"), "");
 	
 	std::ifstream iniFile("valo.ini");
 	po::variables_map vm;
 
 	try
 	{
-		po::store(po::parse_command_line(argc, argv, options), vm);
+		po::parsed_options parsedOptions = po::parse_command_line(argc, argv, options);
+
+		po::store(parsedOptions, vm);
 		po::store(po::parse_config_file(iniFile, options), vm);
 		po::notify(vm);
+
+		for (const po::option& option : parsedOptions.options)
+			commandLineOptions.push_back({ option.string_key, option.original_tokens });
 	}
 	catch (const po::error& e)
 	{
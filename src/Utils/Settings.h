@@ -11,11 +11,21 @@ namespace Valo
 
 		bool load(int argc, char** argv);
 
+		struct CommandLineOption
+		{
+			std::string key;
+			std::vector<std::string> tokens;
+		};
+
+		// the options given on the command line as they were written, for passing them on to child processes
+		std::vector<CommandLineOption> commandLineOptions;
+
 		struct General
 		{
 			bool windowed;
 			uint32_t maxCpuThreadCount;
 			uint32_t cudaDeviceNumber;
+			std::string logFileName;
 		} general;
 
 		struct Renderer
@@ -24,6 +34,11 @@ namespace Valo
 			bool skip;
 			uint32_t imageSamples;
 			uint32_t pixelSamples;
+			uint32_t regionX;
+			uint32_t regionY;
+			uint32_t regionWidth;
+			uint32_t regionHeight;
+			uint32_t bucketSize;
 		} renderer;
 
 		struct Window
@@ -34,6 +49,11 @@ namespace Valo
 			bool vsync;
 			bool hideCursor;
 			float renderScale;
+			bool dynamicRenderScale;
+			float minRenderScale;
+			float targetFrameTime;
+			bool temporalReprojection;
+			float reprojectionWeight;
 			uint32_t infoPanelState;
 			uint32_t infoPanelFontSize;
 			bool checkGLErrors;
@@ -44,6 +64,10 @@ namespace Valo
 			std::string fileName;
 			bool useTestScene;
 			uint32_t testSceneNumber;
+			std::string saveFileName;
+			bool textureCache;
+			uint32_t textureCacheSize;
+			std::string textureCacheDirName;
 		} scene;
 
 		struct Image
@@ -70,6 +94,33 @@ namespace Valo
 			bool autoWrite;
 			float autoWriteInterval;
 			std::string autoWriteFileName;
+			std::string journalFileName;
+			bool resume;
+			bool compactAccumulation;
 		} film;
+
+		struct Coordinator
+		{
+			bool enabled;
+			uint32_t port;
+			uint32_t localWorkers;
+			uint32_t unitType;
+			uint32_t unitSize;
+			bool reissueStragglers;
+		} coordinator;
+
+		struct Worker
+		{
+			bool enabled;
+			std::string address;
+			uint32_t port;
+		} worker;
+
+		struct Convert
+		{
+			bool enabled;
+			std::string inputFileName;
+			std::string outputFileName;
+		} convert;
 	};
 }
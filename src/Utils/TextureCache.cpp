@@ -0,0 +1,451 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#include "Precompiled.h"
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <boost/filesystem.hpp>
+
+#include "tinyformat/tinyformat.h"
+
+#include "App.h"
+#include "Core/Common.h"
+#include "Core/Image.h"
+#include "Core/ImagePool.h"
+#include "Math/MathUtils.h"
+#include "Utils/Log.h"
+#include "Utils/StringUtils.h"
+#include "Utils/SysUtils.h"
+#include "Utils/TextureCache.h"
+#include "Utils/Timer.h"
+
+using namespace Valo;
+
+namespace bf = boost::filesystem;
+
+namespace
+{
+	const uint32_t TILED_FILE_MAGIC = 0x31435456; // VTC1
+	const uint32_t TILED_FILE_VERSION = 1;
+	const uint32_t TILE_SIZE = 64;
+	const uint32_t THREAD_CACHE_SIZE = 64;
+
+	struct TiledFileHeader
+	{
+		uint32_t magic = TILED_FILE_MAGIC;
+		uint32_t version = TILED_FILE_VERSION;
+		uint64_t sourceFileSize = 0;
+		int64_t sourceModificationTime = 0;
+		uint32_t format = 0;
+		uint32_t flags = 0;
+		uint32_t levelCount = 0;
+		uint32_t tileSize = TILE_SIZE;
+	};
+
+	struct ThreadCacheEntry
+	{
+		uint32_t cacheId = 0;
+		uint64_t key = 0;
+		std::shared_ptr<const Image> tile;
+	};
+
+	struct ThreadCacheState
+	{
+		uint32_t cacheId = 0;
+		uint32_t generation = 0;
+	};
+
+	thread_local ThreadCacheEntry threadCache[THREAD_CACHE_SIZE];
+	thread_local ThreadCacheState threadCacheState;
+	std::atomic<uint32_t> nextCacheId(1);
+
+	uint32_t getFlags(bool applyGamma, bool generateMipmaps)
+	{
+		return (applyGamma ? 1 : 0) | (generateMipmaps ? 2 : 0);
+	}
+
+	int64_t getModificationTime(const std::string& fileName)
+	{
+		boost::system::error_code error;
+		std::time_t time = bf::last_write_time(fileName, error);
+		return error ? -1 : int64_t(time);
+	}
+
+	// the full source path is hashed so that textures with the same name do not collide in the cache directory
+	std::string getTiledFileName(const std::string& sourceFileName, const std::string& cacheDirName)
+	{
+		std::string sourcePath = bf::absolute(sourceFileName).generic_string();
+		uint64_t hash = 14695981039346656037ULL; // FNV-1a
+
+		for (char c : sourcePath)
+		{
+			hash ^= uint8_t(c);
+			hash *= 1099511628211ULL;
+		}
+
+		std::string tiledFileName = tfm::format("%s_%016x.tiles", bf::path(sourceFileName).filename().string(), hash);
+		return (bf::path(cacheDirName) / tiledFileName).string();
+	}
+}
+
+struct TextureCache::Data
+{
+	struct Texture
+	{
+		std::string fileName;
+		ImageFormat format = ImageFormat::RGBA32F;
+		uint32_t levelCount = 0;
+		std::vector<uint32_t> widths;
+		std::vector<uint32_t> heights;
+		std::vector<uint32_t> tileCountsX;
+		std::vector<uint32_t> firstTiles;
+		std::vector<uint64_t> tileOffsets;
+		std::unique_ptr<std::mutex> fileMutex;
+		std::unique_ptr<std::ifstream> file;
+	};
+
+	bool open(Texture& texture, const std::string& sourceFileName, bool applyGamma, bool generateMipmaps);
+	void convert(const std::string& sourceFileName, const std::string& tiledFileName, bool applyGamma, bool generateMipmaps);
+	std::shared_ptr<const Image> getTile(uint32_t textureIndex, uint32_t level, uint32_t tileX, uint32_t tileY, uint64_t key, uint64_t maxMemoryUsage);
+	std::shared_ptr<const Image> readTile(uint32_t textureIndex, uint32_t level, uint32_t tileX, uint32_t tileY);
+
+	uint32_t id = 0;
+	std::vector<Texture> textures;
+	std::map<std::string, uint32_t> texturesMap;
+
+	// front is the most recently used
+	std::mutex mutex;
+	std::list<std::pair<uint64_t, std::shared_ptr<const Image>>> tiles;
+	std::unordered_map<uint64_t, std::list<std::pair<uint64_t, std::shared_ptr<const Image>>>::iterator> tilesMap;
+
+	// all the tiles alive, decremented by the tile deleter which can outlive the cache
+	std::shared_ptr<std::atomic<uint64_t>> memoryUsage = std::make_shared<std::atomic<uint64_t>>(0);
+
+	// incremented when the budget is exceeded by tiles held in the per-thread caches
+	std::atomic<uint32_t> generation { 0 };
+};
+
+TextureCache::TextureCache() : data(std::make_shared<Data>())
+{
+	data->id = nextCacheId++;
+}
+
+uint32_t TextureCache::load(const std::string& fileName, bool applyGamma, bool generateMipmaps)
+{
+	if (data->texturesMap.count(fileName))
+		return data->texturesMap[fileName];
+
+	Data::Texture texture;
+	texture.fileName = getTiledFileName(fileName, cacheDirName);
+	texture.fileMutex = std::unique_ptr<std::mutex>(new std::mutex());
+
+	if (!data->open(texture, fileName, applyGamma, generateMipmaps))
+	{
+		texture.file.reset();
+		data->convert(fileName, texture.fileName, applyGamma, generateMipmaps);
+
+		if (!data->open(texture, fileName, applyGamma, generateMipmaps))
+			throw std::runtime_error(tfm::format("Could not open the tiled texture file: %s", texture.fileName));
+	}
+
+	App::getLog().logInfo("Opened tiled texture %s (size: %dx%d, levels: %d, tiles: %d)", texture.fileName, texture.widths[0], texture.heights[0], texture.levelCount, texture.tileOffsets.size());
+
+	data->textures.push_back(std::move(texture));
+	uint32_t index = uint32_t(data->textures.size() - 1);
+	data->texturesMap[fileName] = index;
+
+	return index;
+}
+
+Color TextureCache::getPixelBilinear(uint32_t textureIndex, uint32_t level, float u, float v) const
+{
+	const Data::Texture& texture = data->textures[textureIndex];
+	uint32_t width = texture.widths[level];
+	uint32_t height = texture.heights[level];
+
+	float x = u * float(width - 1);
+	float y = v * float(height - 1);
+
+	uint32_t ix = uint32_t(x);
+	uint32_t iy = uint32_t(y);
+
+	float tx2 = MathUtils::smoothstep(x - float(ix));
+	float ty2 = MathUtils::smoothstep(y - float(iy));
+	float tx1 = 1.0f - tx2;
+	float ty1 = 1.0f - ty2;
+
+	uint32_t ix1 = MIN(ix + 1, width - 1);
+	uint32_t iy1 = MIN(iy + 1, height - 1);
+
+	Color c11 = getPixel(textureIndex, level, ix, iy);
+	Color c21 = getPixel(textureIndex, level, ix1, iy);
+	Color c12 = getPixel(textureIndex, level, ix, iy1);
+	Color c22 = getPixel(textureIndex, level, ix1, iy1);
+
+	return (tx1 * c11 + tx2 * c21) * ty1 + (tx1 * c12 + tx2 * c22) * ty2;
+}
+
+uint32_t TextureCache::getMipLevelCount(uint32_t textureIndex) const
+{
+	return data->textures[textureIndex].levelCount;
+}
+
+uint32_t TextureCache::getWidth(uint32_t textureIndex) const
+{
+	return data->textures[textureIndex].widths[0];
+}
+
+uint32_t TextureCache::getHeight(uint32_t textureIndex) const
+{
+	return data->textures[textureIndex].heights[0];
+}
+
+uint64_t TextureCache::getMemoryUsage() const
+{
+	return data->memoryUsage->load();
+}
+
+Color TextureCache::getPixel(uint32_t textureIndex, uint32_t level, uint32_t x, uint32_t y) const
+{
+	const Data::Texture& texture = data->textures[textureIndex];
+
+	uint32_t tileX = x / TILE_SIZE;
+	uint32_t tileY = y / TILE_SIZE;
+	uint64_t key = (uint64_t(textureIndex) << 32) | (texture.firstTiles[level] + tileY * texture.tileCountsX[level] + tileX);
+	uint64_t hash = (key ^ (uint64_t(data->id) << 56)) * 0x9e3779b97f4a7c15ULL;
+	uint32_t generation = data->generation.load(std::memory_order_relaxed);
+
+	if (threadCacheState.cacheId == data->id && threadCacheState.generation != generation)
+	{
+		for (ThreadCacheEntry& entry : threadCache)
+		{
+			if (entry.cacheId == data->id)
+			{
+				entry.cacheId = 0;
+				entry.tile.reset();
+			}
+		}
+	}
+
+	threadCacheState.cacheId = data->id;
+	threadCacheState.generation = generation;
+
+	ThreadCacheEntry& entry = threadCache[(hash >> 32) % THREAD_CACHE_SIZE];
+
+	if (entry.cacheId != data->id || entry.key != key)
+	{
+		entry.tile = data->getTile(textureIndex, level, tileX, tileY, key, uint64_t(maxMemoryUsage) * 1024 * 1024);
+		entry.cacheId = data->id;
+		entry.key = key;
+	}
+
+	return entry.tile->getPixel(x - tileX * TILE_SIZE, y - tileY * TILE_SIZE);
+}
+
+bool TextureCache::Data::open(Texture& texture, const std::string& sourceFileName, bool applyGamma, bool generateMipmaps)
+{
+	texture.file = std::unique_ptr<std::ifstream>(new std::ifstream(texture.fileName, std::ios::in | std::ios::binary));
+
+	if (!texture.file->is_open())
+		return false;
+
+	TiledFileHeader header;
+	texture.file->read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	if (!*texture.file || header.magic != TILED_FILE_MAGIC || header.version != TILED_FILE_VERSION || header.tileSize != TILE_SIZE || header.levelCount == 0)
+		return false;
+
+	if (header.sourceFileSize != SysUtils::getFileSize(sourceFileName) || header.sourceModificationTime != getModificationTime(sourceFileName) || header.flags != getFlags(applyGamma, generateMipmaps))
+		return false;
+
+	texture.format = ImageFormat(header.format);
+	texture.levelCount = header.levelCount;
+	texture.widths.resize(header.levelCount);
+	texture.heights.resize(header.levelCount);
+	texture.tileCountsX.resize(header.levelCount);
+	texture.firstTiles.resize(header.levelCount);
+
+	uint32_t tileCount = 0;
+
+	for (uint32_t level = 0; level < header.levelCount; ++level)
+	{
+		texture.file->read(reinterpret_cast<char*>(&texture.widths[level]), sizeof(uint32_t));
+		texture.file->read(reinterpret_cast<char*>(&texture.heights[level]), sizeof(uint32_t));
+
+		texture.tileCountsX[level] = (texture.widths[level] + TILE_SIZE - 1) / TILE_SIZE;
+		texture.firstTiles[level] = tileCount;
+		tileCount += texture.tileCountsX[level] * ((texture.heights[level] + TILE_SIZE - 1) / TILE_SIZE);
+	}
+
+	texture.tileOffsets.resize(tileCount);
+	texture.file->read(reinterpret_cast<char*>(texture.tileOffsets.data()), tileCount * sizeof(uint64_t));
+
+	return bool(*texture.file);
+}
+
+void TextureCache::Data::convert(const std::string& sourceFileName, const std::string& tiledFileName, bool applyGamma, bool generateMipmaps)
+{
+	Log& log = App::getLog();
+	log.logInfo("Converting %s to a tiled texture file", sourceFileName);
+
+	Timer timer;
+	std::vector<Image> levels = ImagePool::loadLevels(sourceFileName, applyGamma, generateMipmaps, true);
+
+	TiledFileHeader header;
+	header.sourceFileSize = SysUtils::getFileSize(sourceFileName);
+	header.sourceModificationTime = getModificationTime(sourceFileName);
+	header.format = uint32_t(levels[0].getFormat());
+	header.flags = getFlags(applyGamma, generateMipmaps);
+	header.levelCount = uint32_t(levels.size());
+
+	uint32_t pixelSize = uint32_t(levels[0].getMemoryUsage() / levels[0].getLength());
+	uint64_t tileCount = 0;
+
+	for (const Image& level : levels)
+		tileCount += uint64_t((level.getWidth() + TILE_SIZE - 1) / TILE_SIZE) * ((level.getHeight() + TILE_SIZE - 1) / TILE_SIZE);
+
+	std::vector<uint64_t> tileOffsets;
+	uint64_t offset = sizeof(header) + levels.size() * 2 * sizeof(uint32_t) + tileCount * sizeof(uint64_t);
+
+	for (const Image& level : levels)
+	{
+		for (uint32_t tileY = 0; tileY < level.getHeight(); tileY += TILE_SIZE)
+		{
+			for (uint32_t tileX = 0; tileX < level.getWidth(); tileX += TILE_SIZE)
+			{
+				tileOffsets.push_back(offset);
+				offset += uint64_t(MIN(TILE_SIZE, level.getWidth() - tileX)) * MIN(TILE_SIZE, level.getHeight() - tileY) * pixelSize;
+			}
+		}
+	}
+
+	bf::path cacheDir = bf::path(tiledFileName).parent_path();
+
+	if (!cacheDir.empty())
+		bf::create_directories(cacheDir);
+
+	// write to a temporary file first so that an interrupted conversion never leaves a valid looking file behind
+	std::string tempFileName = tiledFileName + ".tmp";
+	std::ofstream file(tempFileName, std::ios::out | std::ios::binary);
+
+	if (!file.is_open())
+		throw std::runtime_error(tfm::format("Could not open the tiled texture file for writing: %s", tempFileName));
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	for (const Image& level : levels)
+	{
+		uint32_t width = level.getWidth();
+		uint32_t height = level.getHeight();
+
+		file.write(reinterpret_cast<const char*>(&width), sizeof(uint32_t));
+		file.write(reinterpret_cast<const char*>(&height), sizeof(uint32_t));
+	}
+
+	file.write(reinterpret_cast<const char*>(tileOffsets.data()), tileOffsets.size() * sizeof(uint64_t));
+
+	std::vector<char> tileData(TILE_SIZE * TILE_SIZE * pixelSize);
+
+	for (const Image& level : levels)
+	{
+		const char* levelData = static_cast<const char*>(level.getRawData());
+
+		for (uint32_t tileY = 0; tileY < level.getHeight(); tileY += TILE_SIZE)
+		{
+			for (uint32_t tileX = 0; tileX < level.getWidth(); tileX += TILE_SIZE)
+			{
+				uint32_t tileWidth = MIN(TILE_SIZE, level.getWidth() - tileX);
+				uint32_t tileHeight = MIN(TILE_SIZE, level.getHeight() - tileY);
+				uint32_t rowSize = tileWidth * pixelSize;
+
+				for (uint32_t y = 0; y < tileHeight; ++y)
+					memcpy(&tileData[y * rowSize], &levelData[(uint64_t(tileY + y) * level.getWidth() + tileX) * pixelSize], rowSize);
+
+				file.write(tileData.data(), rowSize * tileHeight);
+			}
+		}
+	}
+
+	file.close();
+
+	if (!file)
+		throw std::runtime_error(tfm::format("Could not write the tiled texture file: %s", tempFileName));
+
+	bf::rename(tempFileName, tiledFileName);
+
+	log.logInfo("Tiled texture conversion finished (time: %s, levels: %d, tiles: %d)", timer.getElapsed().getString(true), levels.size(), tileCount);
+}
+
+std::shared_ptr<const Image> TextureCache::Data::getTile(uint32_t textureIndex, uint32_t level, uint32_t tileX, uint32_t tileY, uint64_t key, uint64_t maxMemoryUsage)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = tilesMap.find(key);
+
+		if (it != tilesMap.end())
+		{
+			tiles.splice(tiles.begin(), tiles, it->second);
+			return it->second->second;
+		}
+	}
+
+	// the disk read is done without holding the shared lock
+	std::shared_ptr<const Image> tile = readTile(textureIndex, level, tileX, tileY);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = tilesMap.find(key);
+
+	// another thread was faster
+	if (it != tilesMap.end())
+		return it->second->second;
+
+	tiles.emplace_front(key, tile);
+	tilesMap[key] = tiles.begin();
+
+	while (*memoryUsage > maxMemoryUsage && tiles.size() > 1)
+	{
+		tilesMap.erase(tiles.back().first);
+		tiles.pop_back();
+	}
+
+	// the rest is held by the per-thread caches
+	if (*memoryUsage > maxMemoryUsage)
+		++generation;
+
+	return tile;
+}
+
+std::shared_ptr<const Image> TextureCache::Data::readTile(uint32_t textureIndex, uint32_t level, uint32_t tileX, uint32_t tileY)
+{
+	Texture& texture = textures[textureIndex];
+
+	uint32_t tileWidth = MIN(TILE_SIZE, texture.widths[level] - tileX * TILE_SIZE);
+	uint32_t tileHeight = MIN(TILE_SIZE, texture.heights[level] - tileY * TILE_SIZE);
+	uint64_t tileOffset = texture.tileOffsets[texture.firstTiles[level] + tileY * texture.tileCountsX[level] + tileX];
+
+	std::unique_ptr<Image> tile(new Image(tileWidth, tileHeight, texture.format));
+
+	{
+		std::lock_guard<std::mutex> lock(*texture.fileMutex);
+
+		texture.file->seekg(std::streamoff(tileOffset));
+		texture.file->read(static_cast<char*>(tile->getRawData()), std::streamsize(tile->getMemoryUsage()));
+
+		if (!*texture.file)
+			throw std::runtime_error(tfm::format("Could not read a tile from the tiled texture file: %s", texture.fileName));
+	}
+
+	std::shared_ptr<std::atomic<uint64_t>> tileMemoryUsage = memoryUsage;
+	uint64_t tileSize = tile->getMemoryUsage();
+	*tileMemoryUsage += tileSize;
+
+	return std::shared_ptr<const Image>(tile.release(), [tileMemoryUsage, tileSize](const Image* image)
+	{
+		*tileMemoryUsage -= tileSize;
+		delete image;
+	});
+}
@@ -0,0 +1,59 @@
+// Copyright © 2016 Mikko Ronkainen <firstname@mikkoronkainen.com>
+// License: MIT, see the LICENSE file.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "Math/Color.h"
+
+/*
+
+Demand paged image texture storage for the CPU renderer.
+
+Each texture is converted once to a tiled file that holds all the mip levels in 64x64 pixel tiles
+using the compact image formats. The tiled files are written to cacheDirName and named after the
+source file and a hash of its full path. Only the file header is read at load time, tiles are read
+from the disk the first time they are accessed.
+
+Every thread first checks a small direct mapped cache of its own without any locking. On a miss
+the shared cache is consulted, which keeps the tiles in LRU order and evicts the least recently
+used ones when maxMemoryUsage (megabytes) is exceeded. The budget counts every tile in memory,
+also the ones only a per-thread cache still references. If evicting is not enough, the threads
+release their cached tiles on their next access.
+
+Copies share the same cache.
+
+*/
+
+namespace Valo
+{
+	class TextureCache
+	{
+	public:
+
+		TextureCache();
+
+		uint32_t load(const std::string& fileName, bool applyGamma, bool generateMipmaps);
+
+		Color getPixelBilinear(uint32_t textureIndex, uint32_t level, float u, float v) const;
+
+		uint32_t getMipLevelCount(uint32_t textureIndex) const;
+		uint32_t getWidth(uint32_t textureIndex) const;
+		uint32_t getHeight(uint32_t textureIndex) const;
+		uint64_t getMemoryUsage() const;
+
+		bool enabled = false;
+		uint32_t maxMemoryUsage = 512;
+		std::string cacheDirName = "texture_cache";
+
+	private:
+
+		Color getPixel(uint32_t textureIndex, uint32_t level, uint32_t x, uint32_t y) const;
+
+		struct Data;
+		std::shared_ptr<Data> data;
+	};
+}
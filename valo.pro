@@ -2,10 +2,10 @@ TARGET = valo
 TEMPLATE = app
 DESTDIR = bin
 OBJECTS_DIR = build
-CONFIG += c++11
+CONFIG += c++11 ltcg
 QMAKE_LIBDIR += platform/linux/lib
 QMAKE_CXXFLAGS += -fopenmp -march=native
-LIBS += -lstdc++ -ldl -lm -lpthread -lGL -lglfw -lboost_system -lboost_filesystem -lboost_program_options -fopenmp
+LIBS += -lstdc++ -ldl -lm -lpthread -lGL -lglfw -lboost_system -lboost_filesystem -lboost_program_options -lz -fopenmp
 QMAKE_POST_LINK += platform/linux/post-build.sh
 
 INCLUDEPATH += include \